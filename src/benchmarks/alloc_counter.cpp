@@ -0,0 +1,45 @@
+/*
+** SelfPortrait API
+** See Copyright Notice in reflection.h
+*/
+#include "alloc_counter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<unsigned long long> allocations(0);
+
+namespace alloc_counter {
+
+	unsigned long long count()
+	{
+		return allocations.load(std::memory_order_relaxed);
+	}
+
+}
+
+void* operator new(std::size_t size)
+{
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	void* p = std::malloc(size == 0 ? 1 : size);
+	if (p == nullptr) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void* operator new[](std::size_t size)
+{
+	return ::operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	::operator delete(p);
+}
@@ -0,0 +1,15 @@
+/*
+** SelfPortrait API
+** See Copyright Notice in reflection.h
+*/
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+namespace alloc_counter {
+
+	// number of calls to the global operator new since the start of the program
+	unsigned long long count();
+
+}
+
+#endif /* ALLOC_COUNTER_H */
@@ -0,0 +1,13 @@
+/*
+** SelfPortrait API
+** See Copyright Notice in reflection.h
+*/
+#include "generated_classes.h"
+
+// the generated classes inherit these members, they are copied when a class is built
+REFL_BEGIN_CLASS(generated_classes::GeneratedBase)
+	REFL_CONST_METHOD(get, int)
+	REFL_METHOD(set, void, int)
+	REFL_ATTRIBUTE(value, int)
+	REFL_DEFAULT_CONSTRUCTOR()
+REFL_END_CLASS
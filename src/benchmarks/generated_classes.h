@@ -0,0 +1,37 @@
+/*
+** SelfPortrait API
+** See Copyright Notice in reflection.h
+*/
+#ifndef GENERATED_CLASSES_H
+#define GENERATED_CLASSES_H
+
+#include "reflection_impl.h"
+
+/** A large metadata library for the startup benchmark: the build generates
+ *  sources with one GENERATED_CLASS(N) line per class, each line must be
+ *  its own because REFL_BEGIN_CLASS makes its names unique with __LINE__ */
+namespace generated_classes {
+
+	class GeneratedBase {
+	public:
+		int get() const { return value; }
+		void set(int v) { value = v; }
+
+		int value = 0;
+	};
+
+	template<int N>
+	class Generated: public GeneratedBase {
+	public:
+		Generated() { value = N; }
+	};
+
+}
+
+#define GENERATED_CLASS(N) \
+REFL_BEGIN_CLASS(generated_classes::Generated<N>) \
+	REFL_SUPER_CLASS(generated_classes::GeneratedBase) \
+	REFL_DEFAULT_CONSTRUCTOR() \
+REFL_END_CLASS
+
+#endif /* GENERATED_CLASSES_H */
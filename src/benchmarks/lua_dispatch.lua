@@ -0,0 +1,63 @@
+-- Measures the cost of calling reflected methods and accessing attributes from Lua.
+-- Run by the bench executable, which registers test_functions::TestStruct
+
+require "libluaselfportrait"
+
+local function report(label, times, elapsed)
+    print(string.format("%s = %d calls in %.3f s, %.0f calls/s", label, times, elapsed, times / elapsed))
+end
+
+function benchmark(times)
+
+    local TestStruct = Class.lookup("test_functions::TestStruct")
+    local s = TestStruct:construct()
+    s.elem1 = 1
+    s.elem2 = 2
+    s.elem3 = 3
+    s.elem4 = 4
+
+    local sum = TestStruct:findMethod(function(m) return m:name() == "sum" end)
+
+    local expected = 0
+    for i = 1, times do
+        expected = expected + i + 10
+    end
+
+    -- obj:method(...) goes through __index and the cached dispatch closure
+    local total = 0
+    local start = os.clock()
+    for i = 1, times do
+        total = total + s:sum(i)
+    end
+    report("lua obj:method(x)", times, os.clock() - start)
+    assert(total == expected, "wrong result")
+
+    -- same call through the Method object, without name lookup
+    total = 0
+    start = os.clock()
+    for i = 1, times do
+        total = total + sum:call(s, i)
+    end
+    report("lua Method:call(obj, x)", times, os.clock() - start)
+    assert(total == expected, "wrong result")
+
+    -- field access through the metatable of the class, compared to a plain table
+    local t = { elem1 = 1, elem2 = 2, elem3 = 3, elem4 = 4 }
+
+    total = 0
+    start = os.clock()
+    for i = 1, times do
+        t.elem4 = i
+        total = total + t.elem1 + t.elem4
+    end
+    report("lua table field write + 2 reads", times, os.clock() - start)
+
+    local fieldTotal = 0
+    start = os.clock()
+    for i = 1, times do
+        s.elem4 = i
+        fieldTotal = fieldTotal + s.elem1 + s.elem4
+    end
+    report("lua obj field write + 2 reads", times, os.clock() - start)
+    assert(total == fieldTotal, "wrong result")
+end
@@ -0,0 +1,65 @@
+-- Compares passing Lua tables to C++ in one conversion against building
+-- the C++ objects element by element with reflective calls.
+-- Run by the bench executable, which registers the test_functions
+
+require "libluaselfportrait"
+
+local function report(label, times, elapsed)
+    print(string.format("%s = %d in %.3f s, %.0f per s", label, times, elapsed, times / elapsed))
+end
+
+function benchmark(times)
+
+    local sumVector = Function.lookup("test_functions::sumVector")
+    local sumStruct = Function.lookup("test_functions::sumStruct")
+    local IntVector = Class.lookup("test_functions::IntVector")
+    local TestStruct = Class.lookup("test_functions::TestStruct")
+
+    local vectorSize = 1000
+    local numbers = {}
+    for i = 1, vectorSize do
+        numbers[i] = i
+    end
+    local expected = vectorSize * (vectorSize + 1) / 2
+    local vectors = times / vectorSize
+
+    local start = os.clock()
+    for i = 1, vectors do
+        assert(sumVector:call(numbers) == expected, "wrong result")
+    end
+    report("table to std::vector<int>, elements", times, os.clock() - start)
+
+    start = os.clock()
+    for i = 1, vectors do
+        local v = IntVector:construct()
+        for _, n in ipairs(numbers) do
+            v:add(n)
+        end
+        assert(v:sum() == expected, "wrong result")
+    end
+    report("element by element, elements", times, os.clock() - start)
+
+    start = os.clock()
+    for i = 1, times do
+        assert(sumStruct:call({ elem1 = 1, elem2 = 2, elem3 = 3, elem4 = i }) == 6 + i, "wrong result")
+    end
+    report("table to struct", times, os.clock() - start)
+
+    start = os.clock()
+    for i = 1, times do
+        local s = TestStruct:construct()
+        s.elem1 = 1
+        s.elem2 = 2
+        s.elem3 = 3
+        s.elem4 = i
+        assert(sumStruct:call(s) == 6 + i, "wrong result")
+    end
+    report("struct field by field", times, os.clock() - start)
+
+    local s = TestStruct:construct()
+    start = os.clock()
+    for i = 1, times do
+        local t = s:totable()
+    end
+    report("struct to table", times, os.clock() - start)
+end
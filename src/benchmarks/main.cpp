@@ -3,14 +3,25 @@
 ** See Copyright Notice in reflection.h
 */
 #include "test_functions.h"
+#include "alloc_counter.h"
 #include "reflection.h"
+#include "serializer.h"
+#include "lua_utils.h"
 
+#include <dlfcn.h>
 #include <time.h>
 #include <stdlib.h>
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
 using namespace std;
 
 static const int times = 100000000;
+static const int allocTimes = 1000;
 
 void noargtest()
 {
@@ -109,6 +120,14 @@ void arg1test()
 
 	std::cout << "reflective 1 args = " << (final - start) << std::endl;
 
+	const unsigned long long allocations = alloc_counter::count();
+
+	for (int i = 0; i < allocTimes; ++i) {
+		reflFunc.call(0);
+	}
+
+	std::cout << "allocations per reflective call = " << (alloc_counter::count() - allocations) / double(allocTimes) << std::endl;
+
 }
 
 
@@ -159,6 +178,14 @@ void arg2test()
 
 	std::cout << "reflective 2 args = " << (final - start) << std::endl;
 
+	const unsigned long long allocations = alloc_counter::count();
+
+	for (int i = 0; i < allocTimes; ++i) {
+		reflFunc.call(0, 1);
+	}
+
+	std::cout << "allocations per reflective call = " << (alloc_counter::count() - allocations) / double(allocTimes) << std::endl;
+
 }
 
 void arg3test()
@@ -208,6 +235,14 @@ void arg3test()
 
 	std::cout << "reflective 3 args = " << (final - start) << std::endl;
 
+	const unsigned long long allocations = alloc_counter::count();
+
+	for (int i = 0; i < allocTimes; ++i) {
+		reflFunc.call(0, 1, 2);
+	}
+
+	std::cout << "allocations per reflective call = " << (alloc_counter::count() - allocations) / double(allocTimes) << std::endl;
+
 }
 
 void arg4test()
@@ -257,6 +292,14 @@ void arg4test()
 
 	std::cout << "reflective 4 args = " << (final - start) << std::endl;
 
+	const unsigned long long allocations = alloc_counter::count();
+
+	for (int i = 0; i < allocTimes; ++i) {
+		reflFunc.call(0, 1, 2, 3);
+	}
+
+	std::cout << "allocations per reflective call = " << (alloc_counter::count() - allocations) / double(allocTimes) << std::endl;
+
 }
 
 void arg5test()
@@ -306,6 +349,14 @@ void arg5test()
 
 	std::cout << "reflective 5 args = " << (final - start) << std::endl;
 
+	const unsigned long long allocations = alloc_counter::count();
+
+	for (int i = 0; i < allocTimes; ++i) {
+		reflFunc.call(0, 1, 2, 3, 4);
+	}
+
+	std::cout << "allocations per reflective call = " << (alloc_counter::count() - allocations) / double(allocTimes) << std::endl;
+
 }
 
 void arg6test()
@@ -355,6 +406,14 @@ void arg6test()
 
 	std::cout << "reflective 6 args = " << (final - start) << std::endl;
 
+	const unsigned long long allocations = alloc_counter::count();
+
+	for (int i = 0; i < allocTimes; ++i) {
+		reflFunc.call(0, 1, 2, 3, 4, 5);
+	}
+
+	std::cout << "allocations per reflective call = " << (alloc_counter::count() - allocations) / double(allocTimes) << std::endl;
+
 }
 
 void arg7test()
@@ -404,6 +463,14 @@ void arg7test()
 
 	std::cout << "reflective 7 args = " << (final - start) << std::endl;
 
+	const unsigned long long allocations = alloc_counter::count();
+
+	for (int i = 0; i < allocTimes; ++i) {
+		reflFunc.call(0, 1, 2, 3, 4, 5, 6);
+	}
+
+	std::cout << "allocations per reflective call = " << (alloc_counter::count() - allocations) / double(allocTimes) << std::endl;
+
 }
 
 void arg8test()
@@ -453,6 +520,14 @@ void arg8test()
 
 	std::cout << "reflective 8 args = " << (final - start) << std::endl;
 
+	const unsigned long long allocations = alloc_counter::count();
+
+	for (int i = 0; i < allocTimes; ++i) {
+		reflFunc.call(0, 1, 2, 3, 4, 5, 6, 7);
+	}
+
+	std::cout << "allocations per reflective call = " << (alloc_counter::count() - allocations) / double(allocTimes) << std::endl;
+
 }
 
 void arg9test()
@@ -502,6 +577,14 @@ void arg9test()
 
 	std::cout << "reflective 9 args = " << (final - start) << std::endl;
 
+	const unsigned long long allocations = alloc_counter::count();
+
+	for (int i = 0; i < allocTimes; ++i) {
+		reflFunc.call(0, 1, 2, 3, 4, 5, 6, 7, 8);
+	}
+
+	std::cout << "allocations per reflective call = " << (alloc_counter::count() - allocations) / double(allocTimes) << std::endl;
+
 }
 
 
@@ -555,6 +638,15 @@ void structArgCpy1Test()
 
 	std::cout << "reflective 1 struct arg = " << (final - start) << std::endl;
 
+	const unsigned long long allocations = alloc_counter::count();
+
+	for (int i = 0; i < allocTimes; ++i) {
+		args[0] = TestStruct();
+		noargRefl.callArgArray(args);
+	}
+
+	std::cout << "allocations per reflective call = " << (alloc_counter::count() - allocations) / double(allocTimes) << std::endl;
+
 }
 
 void structArgCpy2Test()
@@ -605,6 +697,16 @@ void structArgCpy2Test()
 
 	std::cout << "reflective 2 struct arg = " << (final - start) << std::endl;
 
+	const unsigned long long allocations = alloc_counter::count();
+
+	for (int i = 0; i < allocTimes; ++i) {
+		args[0] = TestStruct();
+		args[1] = TestStruct();
+		noargRefl.callArgArray(args);
+	}
+
+	std::cout << "allocations per reflective call = " << (alloc_counter::count() - allocations) / double(allocTimes) << std::endl;
+
 }
 
 void structArgCpy3Test()
@@ -655,6 +757,17 @@ void structArgCpy3Test()
 
 	std::cout << "reflective 3 struct arg = " << (final - start) << std::endl;
 
+	const unsigned long long allocations = alloc_counter::count();
+
+	for (int i = 0; i < allocTimes; ++i) {
+		args[0] = TestStruct();
+		args[1] = TestStruct();
+		args[2] = TestStruct();
+		noargRefl.callArgArray(args);
+	}
+
+	std::cout << "allocations per reflective call = " << (alloc_counter::count() - allocations) / double(allocTimes) << std::endl;
+
 }
 
 void structArgCpy4Test()
@@ -705,6 +818,18 @@ void structArgCpy4Test()
 
 	std::cout << "reflective 4 struct arg = " << (final - start) << std::endl;
 
+	const unsigned long long allocations = alloc_counter::count();
+
+	for (int i = 0; i < allocTimes; ++i) {
+		args[0] = TestStruct();
+		args[1] = TestStruct();
+		args[2] = TestStruct();
+		args[3] = TestStruct();
+		noargRefl.callArgArray(args);
+	}
+
+	std::cout << "allocations per reflective call = " << (alloc_counter::count() - allocations) / double(allocTimes) << std::endl;
+
 }
 
 void structArgCpy5Test()
@@ -755,6 +880,19 @@ void structArgCpy5Test()
 
 	std::cout << "reflective 5 struct arg = " << (final - start) << std::endl;
 
+	const unsigned long long allocations = alloc_counter::count();
+
+	for (int i = 0; i < allocTimes; ++i) {
+		args[0] = TestStruct();
+		args[1] = TestStruct();
+		args[2] = TestStruct();
+		args[3] = TestStruct();
+		args[4] = TestStruct();
+		noargRefl.callArgArray(args);
+	}
+
+	std::cout << "allocations per reflective call = " << (alloc_counter::count() - allocations) / double(allocTimes) << std::endl;
+
 }
 
 void structArgCpy6Test()
@@ -805,6 +943,20 @@ void structArgCpy6Test()
 
 	std::cout << "reflective 6 struct arg = " << (final - start) << std::endl;
 
+	const unsigned long long allocations = alloc_counter::count();
+
+	for (int i = 0; i < allocTimes; ++i) {
+		args[0] = TestStruct();
+		args[1] = TestStruct();
+		args[2] = TestStruct();
+		args[3] = TestStruct();
+		args[4] = TestStruct();
+		args[5] = TestStruct();
+		noargRefl.callArgArray(args);
+	}
+
+	std::cout << "allocations per reflective call = " << (alloc_counter::count() - allocations) / double(allocTimes) << std::endl;
+
 }
 
 void structArgCpy7Test()
@@ -855,6 +1007,21 @@ void structArgCpy7Test()
 
 	std::cout << "reflective 7 struct arg = " << (final - start) << std::endl;
 
+	const unsigned long long allocations = alloc_counter::count();
+
+	for (int i = 0; i < allocTimes; ++i) {
+		args[0] = TestStruct();
+		args[1] = TestStruct();
+		args[2] = TestStruct();
+		args[3] = TestStruct();
+		args[4] = TestStruct();
+		args[5] = TestStruct();
+		args[6] = TestStruct();
+		noargRefl.callArgArray(args);
+	}
+
+	std::cout << "allocations per reflective call = " << (alloc_counter::count() - allocations) / double(allocTimes) << std::endl;
+
 }
 
 
@@ -906,6 +1073,22 @@ void structArgCpy8Test()
 
 	std::cout << "reflective 8 struct arg = " << (final - start) << std::endl;
 
+	const unsigned long long allocations = alloc_counter::count();
+
+	for (int i = 0; i < allocTimes; ++i) {
+		args[0] = TestStruct();
+		args[1] = TestStruct();
+		args[2] = TestStruct();
+		args[3] = TestStruct();
+		args[4] = TestStruct();
+		args[5] = TestStruct();
+		args[6] = TestStruct();
+		args[7] = TestStruct();
+		noargRefl.callArgArray(args);
+	}
+
+	std::cout << "allocations per reflective call = " << (alloc_counter::count() - allocations) / double(allocTimes) << std::endl;
+
 }
 
 
@@ -957,6 +1140,23 @@ void structArgCpy9Test()
 
 	std::cout << "reflective 9 struct arg = " << (final - start) << std::endl;
 
+	const unsigned long long allocations = alloc_counter::count();
+
+	for (int i = 0; i < allocTimes; ++i) {
+		args[0] = TestStruct();
+		args[1] = TestStruct();
+		args[2] = TestStruct();
+		args[3] = TestStruct();
+		args[4] = TestStruct();
+		args[5] = TestStruct();
+		args[6] = TestStruct();
+		args[7] = TestStruct();
+		args[8] = TestStruct();
+		noargRefl.callArgArray(args);
+	}
+
+	std::cout << "allocations per reflective call = " << (alloc_counter::count() - allocations) / double(allocTimes) << std::endl;
+
 }
 
 void structArgRef1Test()
@@ -1009,6 +1209,15 @@ void structArgRef1Test()
 
 	std::cout << "reflective 1 struct arg = " << (final - start) << std::endl;
 
+	const unsigned long long allocations = alloc_counter::count();
+
+	for (int i = 0; i < allocTimes; ++i) {
+		args[0] = TestStruct();
+		noargRefl.callArgArray(args);
+	}
+
+	std::cout << "allocations per reflective call = " << (alloc_counter::count() - allocations) / double(allocTimes) << std::endl;
+
 }
 
 void structArgRef2Test()
@@ -1059,6 +1268,16 @@ void structArgRef2Test()
 
 	std::cout << "reflective 2 struct arg = " << (final - start) << std::endl;
 
+	const unsigned long long allocations = alloc_counter::count();
+
+	for (int i = 0; i < allocTimes; ++i) {
+		args[0] = TestStruct();
+		args[1] = TestStruct();
+		noargRefl.callArgArray(args);
+	}
+
+	std::cout << "allocations per reflective call = " << (alloc_counter::count() - allocations) / double(allocTimes) << std::endl;
+
 }
 
 void structArgRef3Test()
@@ -1109,6 +1328,17 @@ void structArgRef3Test()
 
 	std::cout << "reflective 3 struct arg = " << (final - start) << std::endl;
 
+	const unsigned long long allocations = alloc_counter::count();
+
+	for (int i = 0; i < allocTimes; ++i) {
+		args[0] = TestStruct();
+		args[1] = TestStruct();
+		args[2] = TestStruct();
+		noargRefl.callArgArray(args);
+	}
+
+	std::cout << "allocations per reflective call = " << (alloc_counter::count() - allocations) / double(allocTimes) << std::endl;
+
 }
 
 void structArgRef4Test()
@@ -1159,6 +1389,18 @@ void structArgRef4Test()
 
 	std::cout << "reflective 4 struct arg = " << (final - start) << std::endl;
 
+	const unsigned long long allocations = alloc_counter::count();
+
+	for (int i = 0; i < allocTimes; ++i) {
+		args[0] = TestStruct();
+		args[1] = TestStruct();
+		args[2] = TestStruct();
+		args[3] = TestStruct();
+		noargRefl.callArgArray(args);
+	}
+
+	std::cout << "allocations per reflective call = " << (alloc_counter::count() - allocations) / double(allocTimes) << std::endl;
+
 }
 
 void structArgRef5Test()
@@ -1209,6 +1451,19 @@ void structArgRef5Test()
 
 	std::cout << "reflective 5 struct arg = " << (final - start) << std::endl;
 
+	const unsigned long long allocations = alloc_counter::count();
+
+	for (int i = 0; i < allocTimes; ++i) {
+		args[0] = TestStruct();
+		args[1] = TestStruct();
+		args[2] = TestStruct();
+		args[3] = TestStruct();
+		args[4] = TestStruct();
+		noargRefl.callArgArray(args);
+	}
+
+	std::cout << "allocations per reflective call = " << (alloc_counter::count() - allocations) / double(allocTimes) << std::endl;
+
 }
 
 void structArgRef6Test()
@@ -1259,6 +1514,20 @@ void structArgRef6Test()
 
 	std::cout << "reflective 6 struct arg = " << (final - start) << std::endl;
 
+	const unsigned long long allocations = alloc_counter::count();
+
+	for (int i = 0; i < allocTimes; ++i) {
+		args[0] = TestStruct();
+		args[1] = TestStruct();
+		args[2] = TestStruct();
+		args[3] = TestStruct();
+		args[4] = TestStruct();
+		args[5] = TestStruct();
+		noargRefl.callArgArray(args);
+	}
+
+	std::cout << "allocations per reflective call = " << (alloc_counter::count() - allocations) / double(allocTimes) << std::endl;
+
 }
 
 void structArgRef7Test()
@@ -1309,6 +1578,21 @@ void structArgRef7Test()
 
 	std::cout << "reflective 7 struct arg = " << (final - start) << std::endl;
 
+	const unsigned long long allocations = alloc_counter::count();
+
+	for (int i = 0; i < allocTimes; ++i) {
+		args[0] = TestStruct();
+		args[1] = TestStruct();
+		args[2] = TestStruct();
+		args[3] = TestStruct();
+		args[4] = TestStruct();
+		args[5] = TestStruct();
+		args[6] = TestStruct();
+		noargRefl.callArgArray(args);
+	}
+
+	std::cout << "allocations per reflective call = " << (alloc_counter::count() - allocations) / double(allocTimes) << std::endl;
+
 }
 
 
@@ -1360,6 +1644,22 @@ void structArgRef8Test()
 
 	std::cout << "reflective 8 struct arg = " << (final - start) << std::endl;
 
+	const unsigned long long allocations = alloc_counter::count();
+
+	for (int i = 0; i < allocTimes; ++i) {
+		args[0] = TestStruct();
+		args[1] = TestStruct();
+		args[2] = TestStruct();
+		args[3] = TestStruct();
+		args[4] = TestStruct();
+		args[5] = TestStruct();
+		args[6] = TestStruct();
+		args[7] = TestStruct();
+		noargRefl.callArgArray(args);
+	}
+
+	std::cout << "allocations per reflective call = " << (alloc_counter::count() - allocations) / double(allocTimes) << std::endl;
+
 }
 
 
@@ -1411,6 +1711,23 @@ void structArgRef9Test()
 
 	std::cout << "reflective 9 struct arg = " << (final - start) << std::endl;
 
+	const unsigned long long allocations = alloc_counter::count();
+
+	for (int i = 0; i < allocTimes; ++i) {
+		args[0] = TestStruct();
+		args[1] = TestStruct();
+		args[2] = TestStruct();
+		args[3] = TestStruct();
+		args[4] = TestStruct();
+		args[5] = TestStruct();
+		args[6] = TestStruct();
+		args[7] = TestStruct();
+		args[8] = TestStruct();
+		noargRefl.callArgArray(args);
+	}
+
+	std::cout << "allocations per reflective call = " << (alloc_counter::count() - allocations) / double(allocTimes) << std::endl;
+
 }
 
 
@@ -1926,6 +2243,706 @@ void polyArgRef9Test()
 }
 
 
+// numbers to strings and back through variants, as when objects are loaded from text
+void stringConversionTest()
+{
+	static const int values = 1000000;
+
+	std::vector<VariantValue> numbers;
+	std::vector<VariantValue> strings;
+	for (int i = 0; i < values; ++i) {
+		numbers.emplace_back(i * 1.25);
+		strings.emplace_back(std::to_string(i));
+	}
+
+	std::size_t length = 0;
+
+	auto start = std::chrono::steady_clock::now();
+
+	for (const VariantValue& v: numbers) {
+		length += v.convertTo<std::string>().size();
+	}
+
+	auto final = std::chrono::steady_clock::now();
+
+	std::cout << "double to string = " << std::chrono::duration_cast<std::chrono::microseconds>(final - start).count() << " us" << std::endl;
+
+	long long sum = 0;
+
+	start = std::chrono::steady_clock::now();
+
+	for (const VariantValue& v: strings) {
+		sum += v.convertTo<int>();
+	}
+
+	final = std::chrono::steady_clock::now();
+
+	std::cout << "string to int = " << std::chrono::duration_cast<std::chrono::microseconds>(final - start).count() << " us" << std::endl;
+
+	double fsum = 0;
+
+	start = std::chrono::steady_clock::now();
+
+	for (const VariantValue& v: strings) {
+		fsum += v.convertTo<double>();
+	}
+
+	final = std::chrono::steady_clock::now();
+
+	std::cout << "string to double = " << std::chrono::duration_cast<std::chrono::microseconds>(final - start).count() << " us" << std::endl;
+
+	if (length == 0 || sum != (long long)values * (values - 1) / 2 || fsum != sum) {
+		std::cerr << "wrong conversion" << std::endl;
+		exit(1);
+	}
+}
+
+void conversionTest()
+{
+	using namespace test_functions;
+
+	static const int coldTimes = times / 1000;
+
+	VariantValue registered;
+	registered.construct<MultiDerived>();
+
+	VariantValue unregistered;
+	unregistered.construct<UnregisteredDerived>();
+
+	// the work of a miss of the conversion cache, which is only filled once
+	clock_t start = clock();
+
+	int offset = 0;
+	for (int i = 0; i < coldTimes; ++i) {
+		if (registeredConversion(typeid(MultiDerived), typeid(OtherBase), offset) != RegisteredConversion::OFFSET) {
+			std::cerr << "conversion failed" << std::endl;
+			exit(1);
+		}
+	}
+
+	clock_t final = clock();
+
+	std::cout << "cold registered conversion = " << (final - start) << std::endl;
+
+	// the fallback throws a pointer to the value and catches a pointer to the base
+	UnregisteredDerived* derived = &unregistered.value<UnregisteredDerived&>();
+
+	start = clock();
+
+	for (int i = 0; i < coldTimes; ++i) {
+		try {
+			throw derived;
+		} catch (OtherBase*) {
+			continue;
+		} catch (...) {}
+		std::cerr << "conversion failed" << std::endl;
+		exit(1);
+	}
+
+	final = clock();
+
+	std::cout << "cold unregistered conversion = " << (final - start) << std::endl;
+
+	start = clock();
+
+	for (int i = 0; i < times; ++i) {
+		if (!registered.isA<OtherBase>()) {
+			std::cerr << "conversion failed" << std::endl;
+			exit(1);
+		}
+	}
+
+	final = clock();
+
+	std::cout << "warm conversion = " << (final - start) << std::endl;
+}
+
+void conversionThreadsTest()
+{
+	using namespace test_functions;
+
+	const unsigned int maxThreads = std::max(1u, std::thread::hardware_concurrency());
+
+	// warm up, registration and base class resolution aren't synchronized
+	VariantValue warmup;
+	warmup.construct<MultiDerived>();
+	warmup.isA<OtherBase>();
+
+	for (unsigned int numThreads = 1; numThreads <= maxThreads; numThreads *= 2) {
+
+		const int perThread = times / numThreads;
+
+		auto start = std::chrono::steady_clock::now();
+
+		std::vector<std::thread> threads;
+		for (unsigned int t = 0; t < numThreads; ++t) {
+			threads.emplace_back([perThread]() {
+				VariantValue value;
+				value.construct<MultiDerived>();
+				for (int i = 0; i < perThread; ++i) {
+					if (!value.isA<OtherBase>()) {
+						std::cerr << "conversion failed" << std::endl;
+						exit(1);
+					}
+				}
+			});
+		}
+		for (std::thread& t: threads) {
+			t.join();
+		}
+
+		auto final = std::chrono::steady_clock::now();
+
+		std::cout << numThreads << " threads conversion = " << std::chrono::duration_cast<std::chrono::milliseconds>(final - start).count() << " ms" << std::endl;
+	}
+}
+
+void preparedCallTest(const char* name, const std::vector<VariantValue>& args)
+{
+	std::list<Function> functions = Function::findFunctions(name);
+
+	if (functions.size() != 1) {
+		std::cerr << "wrong number of functions found" << std::endl;
+		exit(1);
+	}
+
+	Function reflFunc = functions.front();
+
+	test_functions::resetCounter();
+
+	clock_t start = clock();
+
+	for (int i = 0; i < times; ++i) {
+		reflFunc.callArgArray(args);
+	}
+
+	clock_t final = clock();
+
+	if (test_functions::getCounter() != times) {
+		std::cerr << "wrong counter" << std::endl;
+		exit(1);
+	}
+
+	std::cout << "reflective " << name << " = " << (final - start) << std::endl;
+
+	PreparedCall prepared = reflFunc.prepare(args);
+
+	test_functions::resetCounter();
+
+	start = clock();
+
+	for (int i = 0; i < times; ++i) {
+		prepared.callArgArray(args);
+	}
+
+	final = clock();
+
+	if (test_functions::getCounter() != times) {
+		std::cerr << "wrong counter" << std::endl;
+		exit(1);
+	}
+
+	std::cout << "prepared " << name << " = " << (final - start) << std::endl;
+
+	const unsigned long long allocations = alloc_counter::count();
+
+	for (int i = 0; i < allocTimes; ++i) {
+		prepared.callArgArray(args);
+	}
+
+	std::cout << "allocations per prepared call = " << (alloc_counter::count() - allocations) / double(allocTimes) << std::endl;
+}
+
+void batchTest()
+{
+	using namespace test_functions;
+
+	static const int numObjects = 1000000;
+
+	Class testStruct = Class::lookup("test_functions::TestStruct");
+	Method sum = *testStruct.methodsNamed("sum").begin();
+	Attribute elem1 = testStruct.attribute("elem1");
+
+	std::vector<VariantValue> objects(numObjects);
+	for (int i = 0; i < numObjects; ++i) {
+		objects[i].construct<TestStruct>(TestStruct{i, 1, 2, 3});
+	}
+
+	const auto args = make_arguments(10);
+	std::vector<VariantValue> results(numObjects);
+
+	auto start = std::chrono::steady_clock::now();
+
+	for (int i = 0; i < numObjects; ++i) {
+		results[i] = sum.callArgArray(objects[i], args);
+	}
+
+	auto final = std::chrono::steady_clock::now();
+
+	std::cout << "reflective method calls = " << std::chrono::duration_cast<std::chrono::microseconds>(final - start).count() << " us" << std::endl;
+
+	start = std::chrono::steady_clock::now();
+	sum.callBatch(objects, args, results);
+	final = std::chrono::steady_clock::now();
+
+	std::cout << "batch method call = " << std::chrono::duration_cast<std::chrono::microseconds>(final - start).count() << " us" << std::endl;
+
+	const unsigned int maxThreads = std::max(1u, std::thread::hardware_concurrency());
+
+	start = std::chrono::steady_clock::now();
+	sum.callBatch(objects, args, results, maxThreads);
+	final = std::chrono::steady_clock::now();
+
+	std::cout << "batch method call on " << maxThreads << " threads = " << std::chrono::duration_cast<std::chrono::microseconds>(final - start).count() << " us" << std::endl;
+
+	if (results[numObjects - 1].value<int>() != numObjects - 1 + 16) {
+		std::cerr << "wrong result" << std::endl;
+		exit(1);
+	}
+
+	start = std::chrono::steady_clock::now();
+
+	for (int i = 0; i < numObjects; ++i) {
+		results[i] = elem1.get(objects[i]);
+	}
+
+	final = std::chrono::steady_clock::now();
+
+	std::cout << "reflective attribute reads = " << std::chrono::duration_cast<std::chrono::microseconds>(final - start).count() << " us" << std::endl;
+
+	start = std::chrono::steady_clock::now();
+	elem1.getBatch(objects, results);
+	final = std::chrono::steady_clock::now();
+
+	std::cout << "batch attribute read = " << std::chrono::duration_cast<std::chrono::microseconds>(final - start).count() << " us" << std::endl;
+
+	start = std::chrono::steady_clock::now();
+	elem1.getBatch(objects, results, maxThreads);
+	final = std::chrono::steady_clock::now();
+
+	std::cout << "batch attribute read on " << maxThreads << " threads = " << std::chrono::duration_cast<std::chrono::microseconds>(final - start).count() << " us" << std::endl;
+
+	if (results[numObjects - 1].value<const int&>() != numObjects - 1) {
+		std::cerr << "wrong result" << std::endl;
+		exit(1);
+	}
+}
+
+void rawAccessorTest()
+{
+	using namespace test_functions;
+
+	static const int numObjects = 1000000;
+
+	Class testStruct = Class::lookup("test_functions::TestStruct");
+	Attribute elem1 = testStruct.attribute("elem1");
+	RawAttributeAccessor raw = elem1.rawAccessor();
+
+	std::vector<TestStruct> structs(numObjects);
+	std::vector<VariantValue> objects(numObjects);
+	for (int i = 0; i < numObjects; ++i) {
+		structs[i] = TestStruct{i, 1, 2, 3};
+		objects[i].construct<TestStruct&>(structs[i]);
+	}
+
+	long long sum = 0;
+
+	auto start = std::chrono::steady_clock::now();
+
+	for (int i = 0; i < numObjects; ++i) {
+		sum += structs[i].elem1;
+	}
+
+	auto final = std::chrono::steady_clock::now();
+
+	std::cout << "direct field scan = " << std::chrono::duration_cast<std::chrono::microseconds>(final - start).count() << " us" << std::endl;
+
+	start = std::chrono::steady_clock::now();
+
+	for (int i = 0; i < numObjects; ++i) {
+		sum -= elem1.get(objects[i]).value<const int&>();
+	}
+
+	final = std::chrono::steady_clock::now();
+
+	std::cout << "reflective field scan = " << std::chrono::duration_cast<std::chrono::microseconds>(final - start).count() << " us" << std::endl;
+
+	start = std::chrono::steady_clock::now();
+
+	for (int i = 0; i < numObjects; ++i) {
+		sum += raw.get<int>(&structs[i]);
+	}
+
+	final = std::chrono::steady_clock::now();
+
+	std::cout << "raw accessor field scan = " << std::chrono::duration_cast<std::chrono::microseconds>(final - start).count() << " us" << std::endl;
+
+	if (sum != (long long)numObjects * (numObjects - 1) / 2) {
+		std::cerr << "wrong sum" << std::endl;
+		exit(1);
+	}
+
+	std::vector<TestStruct> copies(numObjects);
+	std::vector<RawAttributeAccessor> fields;
+	for (const Attribute& a: testStruct.attributes()) {
+		fields.push_back(a.rawAccessor());
+	}
+
+	start = std::chrono::steady_clock::now();
+
+	for (int i = 0; i < numObjects; ++i) {
+		for (const Attribute& a: testStruct.attributes()) {
+			a.set(objects[i], a.get(objects[i]));
+		}
+	}
+
+	final = std::chrono::steady_clock::now();
+
+	std::cout << "reflective struct copy = " << std::chrono::duration_cast<std::chrono::microseconds>(final - start).count() << " us" << std::endl;
+
+	start = std::chrono::steady_clock::now();
+
+	for (int i = 0; i < numObjects; ++i) {
+		for (const RawAttributeAccessor& f: fields) {
+			f.copy(&copies[i], &structs[i]);
+		}
+	}
+
+	final = std::chrono::steady_clock::now();
+
+	std::cout << "raw accessor struct copy = " << std::chrono::duration_cast<std::chrono::microseconds>(final - start).count() << " us" << std::endl;
+
+	if (copies[numObjects - 1].elem1 != numObjects - 1) {
+		std::cerr << "wrong copy" << std::endl;
+		exit(1);
+	}
+}
+
+void overloadResolutionTest()
+{
+	static const int calls = times / 10;
+
+	Function intarg2 = Function::findFunctions("test_functions::intarg2").front();
+	const auto args = make_arguments(1, 2);
+
+	test_functions::resetCounter();
+
+	auto start = std::chrono::steady_clock::now();
+
+	for (int i = 0; i < calls; ++i) {
+		intarg2.callArgArray(args);
+	}
+
+	auto final = std::chrono::steady_clock::now();
+
+	std::cout << "known function = " << std::chrono::duration_cast<std::chrono::microseconds>(final - start).count() << " us" << std::endl;
+
+	start = std::chrono::steady_clock::now();
+
+	for (int i = 0; i < calls; ++i) {
+		Function::resolve("test_functions::intarg2", args).callArgArray(args);
+	}
+
+	final = std::chrono::steady_clock::now();
+
+	std::cout << "resolved by name = " << std::chrono::duration_cast<std::chrono::microseconds>(final - start).count() << " us" << std::endl;
+
+	const Symbol name = Symbol::find("test_functions::intarg2");
+
+	start = std::chrono::steady_clock::now();
+
+	for (int i = 0; i < calls; ++i) {
+		Function::resolve(name, args).callArgArray(args);
+	}
+
+	final = std::chrono::steady_clock::now();
+
+	std::cout << "resolved by symbol = " << std::chrono::duration_cast<std::chrono::microseconds>(final - start).count() << " us" << std::endl;
+
+	if (test_functions::getCounter() != 3 * (long)calls) {
+		std::cerr << "wrong counter" << std::endl;
+		exit(1);
+	}
+}
+
+void proxyCallTest()
+{
+	using namespace test_functions;
+
+	static const int calls = times / 10;
+
+	Class interceptor = Class::lookup("test_functions::Interceptor");
+	Method intercept = interceptor.methodsNamed("intercept").front();
+
+	Proxy proxy(interceptor);
+	proxy.addImplementation(intercept, [](ArgumentView args) -> VariantValue {
+		return VariantValue(args[0].value<int>() + args[1].value<int>());
+	});
+
+	VariantValue handle = proxy.reference(interceptor);
+
+	DirectInterceptor direct;
+	Interceptor* targets[] = { &direct, &handle.convertTo<Interceptor&>() };
+	const char* labels[] = { "direct virtual call", "proxy call" };
+
+	for (int t = 0; t < 2; ++t) {
+		Interceptor* target = targets[t];
+		long long sum = 0;
+
+		auto start = std::chrono::steady_clock::now();
+
+		for (int i = 0; i < calls; ++i) {
+			sum += target->intercept(i, 1);
+		}
+
+		auto final = std::chrono::steady_clock::now();
+
+		if (sum != (long long)calls * (calls + 1) / 2) {
+			std::cerr << "wrong sum" << std::endl;
+			exit(1);
+		}
+
+		std::cout << labels[t] << " = " << std::chrono::duration_cast<std::chrono::microseconds>(final - start).count() << " us" << std::endl;
+	}
+}
+
+// loads a library with the metadata of many classes, only the looked up ones are built
+void startupTest()
+{
+	auto start = std::chrono::steady_clock::now();
+
+	void* lib = dlopen(BENCH_BIN "/generated_classes.so", RTLD_NOW | RTLD_LOCAL);
+
+	auto final = std::chrono::steady_clock::now();
+
+	if (lib == nullptr) {
+		std::cerr << "cannot load generated classes: " << dlerror() << std::endl;
+		return;
+	}
+
+	std::cout << "load library = " << std::chrono::duration_cast<std::chrono::microseconds>(final - start).count() << " us" << std::endl;
+
+	std::vector<std::string> names;
+	while (true) {
+		std::string name = "generated_classes::Generated<" + std::to_string(names.size()) + ">";
+		if (!Symbol::find(name).isValid()) {
+			break;
+		}
+		names.push_back(std::move(name));
+	}
+
+	if (names.size() < 10) {
+		std::cerr << "too few generated classes" << std::endl;
+		return;
+	}
+
+	const std::size_t step = names.size() / 10;
+	const char* labels[] = { "first lookup of 10 classes", "first lookup of all classes", "repeated lookup of all classes" };
+
+	for (int pass = 0; pass < 3; ++pass) {
+		std::size_t methods = 0;
+
+		start = std::chrono::steady_clock::now();
+
+		for (std::size_t i = pass == 0 ? step / 2 : 0; i < names.size(); i += pass == 0 ? step : 1) {
+			methods += Class::lookup(names[i]).methods().size();
+		}
+
+		final = std::chrono::steady_clock::now();
+
+		// every class inherits get and set
+		if (methods != 2 * (pass == 0 ? 10 : names.size())) {
+			std::cerr << "wrong number of methods" << std::endl;
+			exit(1);
+		}
+
+		std::cout << labels[pass] << " = " << std::chrono::duration_cast<std::chrono::microseconds>(final - start).count() << " us" << std::endl;
+	}
+}
+
+// runs the benchmark function of a script in this directory
+void luaScriptTest(const char* script, int times)
+{
+	LuaUtils::LuaStateHolder L(BENCH_SRC "/?.lua", BENCH_BIN "/../lua_module/?.so");
+
+	const std::string path = std::string(BENCH_SRC "/") + script;
+
+	if (luaL_loadfile(L, path.c_str()) || lua_pcall(L, 0, 0, 0)) {
+		std::cerr << "cannot run " << script << ": " << lua_tostring(L, -1) << std::endl;
+		return;
+	}
+
+	lua_getglobal(L, "benchmark");
+	lua_pushinteger(L, times);
+	if (lua_pcall(L, 1, 0, 0)) {
+		std::cerr << "lua benchmark failed: " << lua_tostring(L, -1) << std::endl;
+		exit(1);
+	}
+}
+
+void constructAtTest()
+{
+	using namespace test_functions;
+
+	static const int numObjects = 1000000;
+
+	// not trivially copyable, so VariantValue keeps it on the heap
+	Class intVector = Class::lookup("test_functions::IntVector");
+	Constructor constructor = intVector.constructors().front();
+
+	std::vector<VariantValue> objects;
+	objects.reserve(numObjects);
+
+	unsigned long long allocations = alloc_counter::count();
+
+	auto start = std::chrono::steady_clock::now();
+
+	for (int i = 0; i < numObjects; ++i) {
+		objects.push_back(constructor.call());
+	}
+
+	auto final = std::chrono::steady_clock::now();
+
+	std::cout << "construct = " << std::chrono::duration_cast<std::chrono::microseconds>(final - start).count() << " us, "
+		<< (alloc_counter::count() - allocations) / double(numObjects) << " allocations per object" << std::endl;
+
+	objects.clear();
+
+	// one buffer for all the objects, built and destroyed in place
+	const std::size_t size = intVector.sizeOf();
+	const std::size_t stride = (size + intVector.alignOf() - 1) / intVector.alignOf() * intVector.alignOf();
+	std::unique_ptr<char[]> buffer(new char[stride * numObjects + intVector.alignOf()]);
+	void* first = buffer.get();
+	std::size_t space = stride * numObjects + intVector.alignOf();
+	char* storage = static_cast<char*>(std::align(intVector.alignOf(), size, first, space));
+
+	allocations = alloc_counter::count();
+
+	start = std::chrono::steady_clock::now();
+
+	for (int i = 0; i < numObjects; ++i) {
+		constructor.constructAt(storage + i * stride);
+	}
+
+	final = std::chrono::steady_clock::now();
+
+	std::cout << "constructAt = " << std::chrono::duration_cast<std::chrono::microseconds>(final - start).count() << " us, "
+		<< (alloc_counter::count() - allocations) / double(numObjects) << " allocations per object" << std::endl;
+
+	start = std::chrono::steady_clock::now();
+
+	for (int i = 0; i < numObjects; ++i) {
+		intVector.destroyAt(storage + i * stride);
+	}
+
+	final = std::chrono::steady_clock::now();
+
+	std::cout << "destroyAt = " << std::chrono::duration_cast<std::chrono::microseconds>(final - start).count() << " us" << std::endl;
+}
+
+void arenaTest()
+{
+	using namespace test_functions;
+
+	static const int requests = 100000;
+	static const int valuesPerRequest = 10;
+
+	unsigned long long allocations = alloc_counter::count();
+
+	auto start = std::chrono::steady_clock::now();
+
+	for (int i = 0; i < requests; ++i) {
+		VariantValue values[valuesPerRequest];
+		for (VariantValue& v: values) {
+			v.construct<IntVector>();
+		}
+	}
+
+	auto final = std::chrono::steady_clock::now();
+
+	std::cout << "default allocator = " << std::chrono::duration_cast<std::chrono::microseconds>(final - start).count() << " us, "
+		<< (alloc_counter::count() - allocations) / double(requests * valuesPerRequest) << " allocations per value" << std::endl;
+
+	allocations = alloc_counter::count();
+
+	start = std::chrono::steady_clock::now();
+
+	for (int i = 0; i < requests; ++i) {
+		VariantArena arena;
+		VariantValue values[valuesPerRequest];
+		for (VariantValue& v: values) {
+			v.construct<IntVector>();
+		}
+	}
+
+	final = std::chrono::steady_clock::now();
+
+	std::cout << "arena = " << std::chrono::duration_cast<std::chrono::microseconds>(final - start).count() << " us, "
+		<< (alloc_counter::count() - allocations) / double(requests * valuesPerRequest) << " allocations per value" << std::endl;
+}
+
+// throughput in GB/s of size bytes handled in the time between start and final
+template<class Time>
+double gigabytesPerSecond(std::size_t size, Time start, Time final)
+{
+	return size / (std::chrono::duration_cast<std::chrono::nanoseconds>(final - start).count() + 1.0);
+}
+
+template<class T>
+void serializationTest(const char* className, const std::vector<T>& objects)
+{
+	BinarySerializer serializer(Class::lookup(className));
+
+	// the first write only sizes the buffer, request processing reuses its buffers
+	std::string data;
+	serializer.writeArray(objects.data(), objects.size(), data);
+	data.clear();
+
+	auto start = std::chrono::steady_clock::now();
+
+	serializer.writeArray(objects.data(), objects.size(), data);
+
+	auto final = std::chrono::steady_clock::now();
+
+	std::cout << className << " write = " << gigabytesPerSecond(data.size(), start, final) << " GB/s (" << data.size() << " bytes)" << std::endl;
+
+	std::vector<T> copies(objects.size());
+
+	start = std::chrono::steady_clock::now();
+
+	const std::size_t read = serializer.readArray(copies.data(), copies.size(), data.data(), data.size());
+
+	final = std::chrono::steady_clock::now();
+
+	std::cout << className << " read = " << gigabytesPerSecond(read, start, final) << " GB/s" << std::endl;
+
+	if (read != data.size()) {
+		std::cerr << "wrong serialization" << std::endl;
+		exit(1);
+	}
+}
+
+void serializationTest()
+{
+	using namespace test_functions;
+
+	static const int numObjects = 1000000;
+
+	std::vector<TestStruct> structs(numObjects);
+	std::vector<Record> records(numObjects);
+	for (int i = 0; i < numObjects; ++i) {
+		structs[i] = TestStruct{i, 1, 2, 3};
+		records[i].id = i;
+		records[i].score = i * 0.5;
+		records[i].name = "record " + std::to_string(i);
+		records[i].values.assign(i % 16, i);
+		records[i].position = structs[i];
+	}
+
+	serializationTest("test_functions::TestStruct", structs);
+	serializationTest("test_functions::Record", records);
+}
+
 int main()
 {
 
@@ -1965,7 +2982,7 @@ int main()
 
 	std::cout << "1 args function call with conversion:" << std::endl;
 
-	arg1test();
+	arg1Conversiontest();
 
 	std::cout << "1 struct args by copy function call:" << std::endl;
 	structArgCpy1Test();
@@ -2048,5 +3065,48 @@ int main()
 	std::cout << "9 poly args by ref function call:" << std::endl;
 	polyArgRef9Test();
 
+	std::cout << "prepared function call:" << std::endl;
+	preparedCallTest("test_functions::intarg3", { 0, 1, 2 });
+	preparedCallTest("test_functions::polyArg3", { test_functions::Derived(), test_functions::Derived(), test_functions::Derived() });
+
+	std::cout << "overload resolution (" << times / 10 << " calls):" << std::endl;
+	overloadResolutionTest();
+
+	std::cout << "proxy method call (" << times / 10 << " calls):" << std::endl;
+	proxyCallTest();
+
+	std::cout << "startup (generated metadata library):" << std::endl;
+	startupTest();
+
+	std::cout << "batch calls (1000000 objects):" << std::endl;
+	batchTest();
+
+	std::cout << "attribute access (1000000 objects):" << std::endl;
+	rawAccessorTest();
+
+	std::cout << "construction (1000000 objects):" << std::endl;
+	constructAtTest();
+
+	std::cout << "request scoped values (100000 requests, 10 values each):" << std::endl;
+	arenaTest();
+
+	std::cout << "binary serialization (1000000 objects):" << std::endl;
+	serializationTest();
+
+	std::cout << "lua method calls:" << std::endl;
+	luaScriptTest("lua_dispatch.lua", 1000000);
+
+	std::cout << "lua table conversion:" << std::endl;
+	luaScriptTest("lua_tables.lua", 100000);
+
+	std::cout << "string conversion (1000000 values):" << std::endl;
+	stringConversionTest();
+
+	std::cout << "base class conversion (" << times / 1000 << " cold, " << times << " warm):" << std::endl;
+	conversionTest();
+
+	std::cout << "concurrent base class conversion (" << times << " total):" << std::endl;
+	conversionThreadsTest();
+
 	return 0;
 }
@@ -172,6 +172,20 @@ namespace test_functions {
 		++global_counter;
 	}
 
+	int sumStruct(const TestStruct& s)
+	{
+		return s.sum(0);
+	}
+
+	int sumVector(const std::vector<int>& v)
+	{
+		int sum = 0;
+		for (int i: v) {
+			sum += i;
+		}
+		return sum;
+	}
+
 }
 
 REFL_FUNCTION(test_functions::noargs, void)
@@ -236,6 +250,7 @@ REFL_ATTRIBUTE(elem1, int)
 REFL_ATTRIBUTE(elem2, int)
 REFL_ATTRIBUTE(elem3, int)
 REFL_ATTRIBUTE(elem4, int)
+REFL_CONST_METHOD(sum, int, int)
 REFL_END_CLASS
 
 REFL_FUNCTION(test_functions::polyArg1, void, const test_functions::Base &)
@@ -273,3 +288,40 @@ REFL_METHOD(foo, void)
 REFL_METHOD(operator=, test_functions::Derived &, const test_functions::Derived &)
 REFL_END_CLASS
 
+REFL_BEGIN_CLASS(test_functions::OtherBase)
+REFL_DEFAULT_CONSTRUCTOR()
+REFL_END_CLASS
+
+REFL_BEGIN_CLASS(test_functions::MultiDerived)
+REFL_SUPER_CLASS(test_functions::Base)
+REFL_SUPER_CLASS(test_functions::OtherBase)
+REFL_DEFAULT_CONSTRUCTOR()
+REFL_END_CLASS
+
+REFL_FUNCTION(test_functions::sumStruct, int, const test_functions::TestStruct &)
+
+REFL_FUNCTION(test_functions::sumVector, int, const std::vector<int> &)
+
+REFL_BEGIN_CLASS(test_functions::IntVector)
+REFL_DEFAULT_CONSTRUCTOR()
+REFL_METHOD(add, void, int)
+REFL_CONST_METHOD(sum, int)
+REFL_END_CLASS
+
+REFL_BEGIN_CLASS(test_functions::Record)
+REFL_DEFAULT_CONSTRUCTOR()
+REFL_ATTRIBUTE(id, int)
+REFL_ATTRIBUTE(score, double)
+REFL_ATTRIBUTE(name, std::string)
+REFL_ATTRIBUTE(values, std::vector<int>)
+REFL_ATTRIBUTE(position, test_functions::TestStruct)
+REFL_END_CLASS
+
+REFL_BEGIN_STUB(test_functions::Interceptor, test_functions__InterceptorStub)
+REFL_STUB_METHOD(test_functions::Interceptor, intercept, int, int, int)
+REFL_END_STUB
+
+REFL_BEGIN_CLASS(test_functions::Interceptor)
+REFL_STUB(test_functions__InterceptorStub)
+REFL_METHOD(intercept, int, int, int)
+REFL_END_CLASS
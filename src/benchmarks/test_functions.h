@@ -5,6 +5,9 @@
 #ifndef TEST_FUNCTIONS_H
 #define TEST_FUNCTIONS_H
 
+#include <string>
+#include <vector>
+
 namespace test_functions {
 
 	long getCounter();
@@ -28,6 +31,8 @@ namespace test_functions {
 		int elem2;
 		int elem3;
 		int elem4;
+
+		int sum(int offset) const { return offset + elem1 + elem2 + elem3 + elem4; }
 	};
 
 	void structArgCpy1(TestStruct);
@@ -59,6 +64,19 @@ namespace test_functions {
 		virtual void foo() {}
 	};
 
+	struct OtherBase {
+		virtual ~OtherBase() {}
+		int other;
+	};
+
+	// registered with both superclasses, OtherBase lives at a non-zero offset
+	struct MultiDerived: public Base, public OtherBase {
+	};
+
+	// same layout, but not known to the reflection system
+	struct UnregisteredDerived: public Base, public OtherBase {
+	};
+
 	void polyArg1(const Base&);
 	void polyArg2(const Base&, const Base&);
 	void polyArg3(const Base&, const Base&, const Base&);
@@ -68,6 +86,36 @@ namespace test_functions {
 	void polyArg7(const Base&, const Base&, const Base&, const Base&, const Base&, const Base&, const Base&);
 	void polyArg8(const Base&, const Base&, const Base&, const Base&, const Base&, const Base&, const Base&, const Base&);
 	void polyArg9(const Base&, const Base&, const Base&, const Base&, const Base&, const Base&, const Base&, const Base&, const Base&);
+
+	// for the conversion of Lua tables
+	int sumStruct(const TestStruct&);
+	int sumVector(const std::vector<int>&);
+
+	struct IntVector {
+		std::vector<int> values;
+
+		void add(int v) { values.push_back(v); }
+		int sum() const { return sumVector(values); }
+	};
+
+	// implemented by a Proxy in the proxy call benchmark
+	struct Interceptor {
+		virtual ~Interceptor() {}
+		virtual int intercept(int, int) = 0;
+	};
+
+	struct DirectInterceptor: public Interceptor {
+		int intercept(int a, int b) override { return a + b; }
+	};
+
+	// for the serialization benchmark, not copyable as a whole
+	struct Record {
+		int id;
+		double score;
+		std::string name;
+		std::vector<int> values;
+		TestStruct position;
+	};
 }
 
 
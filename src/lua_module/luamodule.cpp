@@ -9,11 +9,295 @@
 
 #include "luamodule.h"
 
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <typeindex>
+#include <unordered_map>
+
+#include "registry_map.h"
+
 namespace SelfPortraitLua {
 
 //=====================Definitions==============================================
 
 
+//---------------Marshaling------------------------------------------------------
+
+namespace {
+
+template<class T, int LuaType>
+VariantValue typedArgument(lua_State* L, int idx)
+{
+	if (lua_type(L, idx) == LuaType) {
+		VariantValue v;
+		v.construct<T>(LuaUtils::LuaValue<T>::getStackValue(L, idx));
+		return v;
+	}
+	return Lua_Variant::getFromStack(L, idx);
+}
+
+// Since Lua 5.3 numbers can be 64 bit integers, which are read without going
+// through a lua_Number. lua_tointeger rounds or fails for numbers with a
+// fractional part, depending on the Lua version, so those are truncated
+// like a C++ conversion would.
+template<class T>
+VariantValue integerArgument(lua_State* L, int idx)
+{
+	if (lua_type(L, idx) == LUA_TNUMBER) {
+		VariantValue v;
+#if LUA_VERSION_NUM >= 503
+		int isInteger = 0;
+		const lua_Integer i = lua_tointegerx(L, idx, &isInteger);
+		if (isInteger) {
+			v.construct<T>(static_cast<T>(i));
+			return v;
+		}
+#endif
+		v.construct<T>(static_cast<T>(lua_tonumber(L, idx)));
+		return v;
+	}
+	return Lua_Variant::getFromStack(L, idx);
+}
+
+ArgumentMarshaler marshalerFor(const std::type_info* type)
+{
+	static const struct {
+		const std::type_info& type;
+		ArgumentMarshaler marshaler;
+	} marshalers[] = {
+		{ typeid(bool),               typedArgument<bool,               LUA_TBOOLEAN> },
+		{ typeid(char),               integerArgument<char> },
+		{ typeid(short),              integerArgument<short> },
+		{ typeid(int),                integerArgument<int> },
+		{ typeid(long),               integerArgument<long> },
+		{ typeid(long long),          integerArgument<long long> },
+		{ typeid(unsigned char),      integerArgument<unsigned char> },
+		{ typeid(unsigned short),     integerArgument<unsigned short> },
+		{ typeid(unsigned int),       integerArgument<unsigned int> },
+		{ typeid(unsigned long),      integerArgument<unsigned long> },
+		{ typeid(unsigned long long), integerArgument<unsigned long long> },
+		{ typeid(float),              typedArgument<float,              LUA_TNUMBER> },
+		{ typeid(double),             typedArgument<double,             LUA_TNUMBER> },
+		{ typeid(std::string),        typedArgument<std::string,        LUA_TSTRING> },
+		{ typeid(const char*),        typedArgument<const char*,        LUA_TSTRING> },
+	};
+
+	for (const auto& m: marshalers) {
+		if (m.type == *type) {
+			return m.marshaler;
+		}
+	}
+	return Lua_Variant::getFromStack;
+}
+
+// most calls have few arguments, these don't need to allocate an argument vector
+class StackArguments {
+public:
+	StackArguments(lua_State* L, const LuaMarshaler& marshaler, int firstArg)
+		: m_size(::std::max(lua_gettop(L) - firstArg + 1, 0))
+		, m_data(m_inplace)
+	{
+		if (m_size > inplaceArgs) {
+			m_heap.resize(m_size);
+			m_data = m_heap.data();
+		}
+		marshaler.getArguments(L, firstArg, m_size, m_data);
+	}
+
+	ArgumentView view() const { return ArgumentView(m_data, m_size); }
+
+private:
+	enum { inplaceArgs = 8 };
+
+	const int m_size;
+	VariantValue m_inplace[inplaceArgs];
+	vector<VariantValue> m_heap;
+	VariantValue* m_data;
+};
+
+}
+
+//---------------Table conversions
+
+namespace {
+
+// registered by add() while libraries load and read by every call, so reads must not lock
+struct TableConversionRegistry {
+	TableConversionRegistry() {
+		add<vector<int>>();
+		add<vector<long>>();
+		add<vector<long long>>();
+		add<vector<unsigned int>>();
+		add<vector<float>>();
+		add<vector<double>>();
+		add<vector<std::string>>();
+		add<std::map<std::string, int>>();
+		add<std::map<std::string, double>>();
+		add<std::map<std::string, std::string>>();
+		add<std::map<int, int>>();
+		add<std::map<int, double>>();
+		add<std::map<int, std::string>>();
+	}
+
+	template<class C>
+	void add() {
+		conversions.assign(std::type_index(typeid(C)), TableConversions::of<C>());
+	}
+
+	registry_map<std::type_index, TableConversion> conversions;
+};
+
+TableConversionRegistry& tableConversionRegistry()
+{
+	static TableConversionRegistry registry;
+	return registry;
+}
+
+}
+
+void TableConversions::add(const std::type_info& type, TableConversion conversion)
+{
+	tableConversionRegistry().conversions.assign(std::type_index(type), conversion);
+}
+
+const TableConversion* TableConversions::find(const std::type_info& type)
+{
+	return tableConversionRegistry().conversions.find(std::type_index(type));
+}
+
+//---------------Values
+
+ValueMarshaler::ValueMarshaler()
+	: m_marshaler(Lua_Variant::getFromStack)
+	, m_table(nullptr)
+	, m_struct(nullptr)
+{}
+
+#ifndef NO_RTTI
+ValueMarshaler::ValueMarshaler(const std::type_info& type)
+	: m_marshaler(marshalerFor(&type))
+	, m_table(TableConversions::find(type))
+	, m_struct(nullptr)
+{
+	if (m_table == nullptr) {
+		Class c = Class::lookup(type);
+		if (c.isValid()) {
+			m_struct = StructMarshaler::forClass(c);
+		}
+	}
+}
+#endif
+
+VariantValue ValueMarshaler::get(lua_State* L, int idx) const
+{
+	if (lua_type(L, idx) == LUA_TTABLE) {
+		if (m_table != nullptr) {
+			return m_table->fromTable(L, idx);
+		} else if (m_struct != nullptr) {
+			return m_struct->fromTable(L, idx);
+		}
+	}
+	return m_marshaler(L, idx);
+}
+
+//---------------Reflected classes
+
+const StructMarshaler* StructMarshaler::forClass(const Class& c)
+{
+	// fields can be of reflected classes too, their marshalers are created while the lock is held
+	static std::recursive_mutex mutex;
+	static std::unordered_map<Class, std::unique_ptr<StructMarshaler>> marshalers;
+
+	std::lock_guard<std::recursive_mutex> lock(mutex);
+
+	auto it = marshalers.find(c);
+	if (it != marshalers.end()) {
+		return it->second.get();
+	}
+
+	StructMarshaler* m = new StructMarshaler(c);
+	marshalers[c].reset(m);
+	m->addFields();
+	return m;
+}
+
+StructMarshaler::StructMarshaler(const Class& c)
+	: m_class(c)
+	, m_constructor(c.findConstructor([](const Constructor& cons) { return cons.isDefaultConstructor(); }))
+{}
+
+void StructMarshaler::addFields()
+{
+	for (const Attribute& a: m_class.attributes()) {
+		if (a.isStatic() || a.isConst()) {
+			continue;
+		}
+#ifndef NO_RTTI
+		m_fields.push_back(Field{ a.name(), a, ValueMarshaler(a.type()) });
+#else
+		m_fields.push_back(Field{ a.name(), a, ValueMarshaler() });
+#endif
+	}
+}
+
+VariantValue StructMarshaler::fromTable(lua_State* L, int idx) const
+{
+	if (!m_constructor.isValid()) {
+		luaL_error(L, "%s", strconv::fmt_str("Class %1 has no default constructor, it can't be created from a table", m_class.fullyQualifiedName()).c_str());
+	}
+
+	const int table = (idx < 0) ? lua_gettop(L) + idx + 1 : idx;
+
+	VariantValue object = m_constructor.call();
+
+	for (const Field& f: m_fields) {
+		lua_getfield(L, table, f.name.c_str());
+		if (!lua_isnil(L, -1)) {
+			f.attribute.set(object, f.value.get(L, lua_gettop(L)));
+		}
+		lua_pop(L, 1);
+	}
+	return object;
+}
+
+void StructMarshaler::toTable(lua_State* L, const VariantValue& object) const
+{
+	lua_createtable(L, 0, m_fields.size());
+
+	for (const Field& f: m_fields) {
+		VariantValue value = f.attribute.get(object);
+		if (f.value.structure() != nullptr) {
+			f.value.structure()->toTable(L, value);
+		} else {
+			Lua_Variant::pushResult(L, ::std::move(value));
+		}
+		lua_setfield(L, -2, f.name.c_str());
+	}
+}
+
+//---------------Calls
+
+LuaMarshaler::LuaMarshaler(const vector<const std::type_info*>& argumentTypes)
+{
+	m_arguments.reserve(argumentTypes.size());
+	for (const std::type_info* type: argumentTypes) {
+		m_arguments.emplace_back(*type);
+	}
+}
+
+void LuaMarshaler::getArguments(lua_State* L, int firstArg, int numArgs, VariantValue* args) const
+{
+	for (int i = 0; i < numArgs; ++i) {
+		if (static_cast< ::std::size_t>(i) < m_arguments.size()) {
+			args[i] = m_arguments[i].get(L, firstArg + i);
+		} else {
+			args[i] = Lua_Variant::getFromStack(L, firstArg + i);
+		}
+	}
+}
+
+
 //---------------Variant--------------------------------------------------------
 
 const char * Lua_Variant::metatableName = "SelfPortraitVariant";
@@ -55,42 +339,60 @@ void Lua_Variant::initialize()
 	methods["isPOD"]           = exception_translator<isPOD>;
 	methods["sizeOf"]          = exception_translator<sizeOf>;
 	methods["alignOf"]         = exception_translator<alignOf>;
+	methods["totable"]         = exception_translator<totable>;
 }
 
 int Lua_Variant::index(lua_State* L) {
     Lua_Variant* c = Lua_Variant::checkUserData(L);
     const char * index = luaL_checkstring(L, 2);
 
-    auto it = Adapted::methods.find(index);
-
-    if (it != Adapted::methods.end()) {
-        lua_pushcfunction(L, it->second);
-        return 1;
-    } else {
+    if (c->m_class.isValid()) {
 
-        if(c->m_class.isValid()) {
+        pushDispatchTable(L, c->m_class);
+        lua_pushvalue(L, 2);
+        lua_rawget(L, 3);
 
-            Class clazz = c->m_class;
+        if (!lua_isnil(L, -1)) {
+            return 1;
+        }
+        lua_pop(L, 1);
 
-            Attribute attr;
+        auto it = Adapted::methods.find(index);
+        const Symbol name = Symbol::find(index);
 
-            if (clazz.findMethod([&](const Method& m){ return m.name() == index; }).isValid()) {
-                LuaAdapter<Lua_Class>::create(L,clazz);
-                lua_pushstring(L, index);
-                lua_pushcclosure(L, method_stub, 2);
-                return 1;
+        if (it != Adapted::methods.end()) {
+            lua_pushcfunction(L, it->second);
+        } else if (!c->m_class.methodsNamed(name).empty()) {
+            MethodDispatch::create(L, c->m_class, name);
+            lua_pushcclosure(L, method_stub, 1);
+        } else {
+            Attribute attr = c->m_class.attribute(name);
 
-            } else if ((attr = clazz.findAttribute([&](const Attribute& a){ return a.name() == index; })).isValid()) {
+            if (attr.isValid()) {
+                lua_settop(L, 2);
                 Lua_Attribute::create(L,attr);
                 lua_pushvalue(L, 1);
                 lua_remove(L, 1);
                 lua_remove(L, 1);
                 return Lua_Attribute::get(L);
             }
+            luaL_error(L, "class has no property %s\n", index);
         }
 
-        luaL_error(L, "class has no property %s\n", index);
+        lua_pushvalue(L, 2);
+        lua_pushvalue(L, -2);
+        lua_rawset(L, 3);
+        return 1;
+    }
+
+    auto it = Adapted::methods.find(index);
+
+    if (it != Adapted::methods.end()) {
+        lua_pushcfunction(L, it->second);
+        return 1;
     }
+
+    luaL_error(L, "class has no property %s\n", index);
     return 0;
 }
 
@@ -103,7 +405,7 @@ int Lua_Variant::newindex(lua_State* L) {
         Class clazz = c->m_class;
         Attribute attr;
 
-        if ((attr = clazz.findAttribute([&](const Attribute& a){ return a.name() == index; })).isValid()) {
+        if ((attr = clazz.attribute(Symbol::find(index))).isValid()) {
             Lua_Attribute::create(L,attr);
             lua_pushvalue(L, 1);
             lua_remove(L, 1);
@@ -141,16 +443,13 @@ VariantValue Lua_Variant::getFromStack(lua_State* L, int idx)
 			break;
 		}
 		case LUA_TTABLE: {
-			luaL_error(L, "variant from table not implemented yet");
+			luaL_error(L, "tables can only be passed to parameters of a container type or of a reflected class");
 			break;
 		}
 		case LUA_TUSERDATA: {
 			void *p = lua_touserdata(L, idx);
 			if (p != nullptr) {
-				lua_getmetatable(L, idx);
-				lua_getfield(L, LUA_REGISTRYINDEX, Lua_Variant::metatableName);  /* get correct metatable */
-				if (lua_rawequal(L, -1, -2)) {  /* does it have the correct mt? */
-					lua_pop(L, 2);  /* remove both metatables */
+				if (isUserData(L, idx)) {
 					return ::std::move(reinterpret_cast<Lua_Variant*>(p)->m_variant.createReference());
 				} else {
 					luaL_error(L, "unknown userdata cannot be converted to variant");
@@ -168,6 +467,51 @@ VariantValue Lua_Variant::getFromStack(lua_State* L, int idx)
 	return VariantValue();
 }
 
+int Lua_Variant::pushResult(lua_State* L, VariantValue&& ret)
+{
+	using LuaUtils::LuaValue;
+
+	if (!ret.isValid()) {
+		return 0;
+	}
+
+	const void* value = ret.ptrToValue();
+
+	switch (ret.typeDescriptor()->tag) {
+		// bools have always been passed to Lua as numbers
+		case ValueTag::BOOL:    LuaValue<int>::pushValue(L, *static_cast<const bool*>(value)); break;
+		case ValueTag::CHAR:    LuaValue<char>::pushValue(L, *static_cast<const char*>(value)); break;
+		case ValueTag::SCHAR:   LuaValue<int>::pushValue(L, *static_cast<const signed char*>(value)); break;
+		case ValueTag::UCHAR:   LuaValue<unsigned char>::pushValue(L, *static_cast<const unsigned char*>(value)); break;
+		case ValueTag::SHORT:   LuaValue<short>::pushValue(L, *static_cast<const short*>(value)); break;
+		case ValueTag::USHORT:  LuaValue<unsigned short>::pushValue(L, *static_cast<const unsigned short*>(value)); break;
+		case ValueTag::INT:     LuaValue<int>::pushValue(L, *static_cast<const int*>(value)); break;
+		case ValueTag::UINT:    LuaValue<unsigned int>::pushValue(L, *static_cast<const unsigned int*>(value)); break;
+		case ValueTag::LONG:    LuaValue<long>::pushValue(L, *static_cast<const long*>(value)); break;
+		case ValueTag::LLONG:   LuaValue<long long>::pushValue(L, *static_cast<const long long*>(value)); break;
+		// might not fit into a lua_Integer
+		case ValueTag::ULONG:   LuaValue<double>::pushValue(L, *static_cast<const unsigned long*>(value)); break;
+		case ValueTag::ULLONG:  LuaValue<double>::pushValue(L, *static_cast<const unsigned long long*>(value)); break;
+		case ValueTag::FLOAT:   LuaValue<float>::pushValue(L, *static_cast<const float*>(value)); break;
+		case ValueTag::DOUBLE:  LuaValue<double>::pushValue(L, *static_cast<const double*>(value)); break;
+		case ValueTag::LDOUBLE: LuaValue<long double>::pushValue(L, *static_cast<const long double*>(value)); break;
+		case ValueTag::STRING:  LuaValue<std::string>::pushValue(L, *static_cast<const std::string*>(value)); break;
+		default:
+			if (ret.isArithmetical()) {
+				lua_pushnumber(L, ret.convertTo<lua_Number>());
+			} else if (ret.isStdString()) {
+				LuaValue<std::string>::pushValue(L, ret.convertTo<std::string>());
+			} else {
+				Class clazz;
+#ifndef NO_RTTI
+				clazz = Class::lookup(ret.typeId());
+#endif
+				create(L, clazz, std::move(ret));
+			}
+	}
+	return 1;
+}
+
 int Lua_Variant::newInstance(lua_State* L)
 {
 	int n = lua_gettop(L);
@@ -307,29 +651,219 @@ int Lua_Variant::alignOf(lua_State* L)
 	return 1;
 }
 
+int Lua_Variant::totable(lua_State* L)
+{
+	Lua_Variant* v = checkUserData(L);
+
+#ifndef NO_RTTI
+	if (const TableConversion* conversion = TableConversions::find(v->m_variant.typeId())) {
+		conversion->toTable(L, v->m_variant);
+		return 1;
+	}
+#endif
+	if (!v->m_class.isValid()) {
+		luaL_error(L, "only containers and objects of reflected classes can be converted to tables");
+	}
+	StructMarshaler::forClass(v->m_class)->toTable(L, v->m_variant);
+	return 1;
+}
+
 int Lua_Variant::method_stub(lua_State* L)
 {
-    Lua_Class& c = *Lua_Class::checkUserData(L, lua_upvalueindex(1));
-    const string name = luaL_checkstring(L, lua_upvalueindex(2));
+    const MethodDispatch& d = *MethodDispatch::checkUserData(L, lua_upvalueindex(1));
     const int numArgs = lua_gettop(L) - 1;
 
-    auto methods = c.wrapped().findAllMethods([&](const Method& m){ return m.name() == name && m.numberOfArguments() == numArgs;});
+    const vector<Method>& methods = d.overloads(numArgs);
 
     if (methods.size() == 0) {
-        luaL_error(L, strconv::fmt_str("Class %1 has no method named %2", c.wrapped().fullyQualifiedName(), name).c_str());
+        luaL_error(L, "%s", strconv::fmt_str("Class %1 has no method named %2", d.getClass().fullyQualifiedName(), d.name()).c_str());
     } else if (methods.size() > 1) {
-        luaL_error(L, strconv::fmt_str("Class %1 has more than one method named %2 with %3 arguments", c.wrapped().fullyQualifiedName(), name, numArgs).c_str());
+        luaL_error(L, "%s", strconv::fmt_str("Class %1 has more than one method named %2 with %3 arguments", d.getClass().fullyQualifiedName(), d.name(), numArgs).c_str());
     }
 
-    Method& m = methods.front();
+    const Method& m = methods.front();
 
-    Lua_Method::create(L, m);
-    for (int i = 1; i <= numArgs+1; ++i) {
-        lua_pushvalue(L, 1);
-        lua_remove(L, 1);
+    const LuaMarshaler& marshaler = d.marshaler(numArgs);
+
+    // like obj.staticMethod(args) in C++, the object only selects the class
+    if (m.isStatic()) {
+        VariantValue none;
+        return Lua_Method::call(L, m, marshaler, none, 2);
+    }
+    return Lua_Method::call(L, m, marshaler, checkUserData(L, 1)->m_variant, 2);
+}
+
+namespace {
+
+// the per class tables are kept in tables of the registry, keyed by the address of a static
+const char dispatchTablesKey = 0;
+const char metatablesKey = 0;
+
+// marks the metatables of variants
+const char variantMetatableKey = 0;
+
+void* registryKey(const char& key)
+{
+    return const_cast<char*>(&key);
+}
+
+// the classes are keyed by the address of their metadata
+void* classKey(const Class& c)
+{
+    return reinterpret_cast<void*>(std::hash<Class>()(c));
+}
+
+// pushes t[key], or a new table that is stored there
+void pushSubTable(lua_State* L, int t, void* key)
+{
+    if (t < 0 && t > LUA_REGISTRYINDEX) {
+        t = lua_gettop(L) + t + 1;
+    }
+    lua_pushlightuserdata(L, key);
+    lua_rawget(L, t);
+    if (lua_isnil(L, -1)) {
+        lua_pop(L, 1);
+        lua_newtable(L);
+        lua_pushlightuserdata(L, key);
+        lua_pushvalue(L, -2);
+        lua_rawset(L, t);
     }
+}
+
+void markAsVariantMetatable(lua_State* L)
+{
+    lua_pushlightuserdata(L, registryKey(variantMetatableKey));
+    lua_pushboolean(L, 1);
+    lua_rawset(L, -3);
+}
+
+}
+
+void Lua_Variant::_register(lua_State* L)
+{
+    LuaAdapter<Lua_Variant>::_register(L);
 
-    return Lua_Method::call(L);
+    luaL_getmetatable(L, metatableName);
+    markAsVariantMetatable(L);
+    lua_pop(L, 1);
+}
+
+Lua_Variant* Lua_Variant::checkUserData(lua_State* L, int pos)
+{
+    if (!isUserData(L, pos)) {
+        luaL_argerror(L, pos, "Variant expected");
+    }
+    return static_cast<Lua_Variant*>(lua_touserdata(L, pos));
+}
+
+bool Lua_Variant::isUserData(lua_State* L, int pos)
+{
+    if (lua_type(L, pos) != LUA_TUSERDATA || !lua_getmetatable(L, pos)) {
+        return false;
+    }
+    lua_pushlightuserdata(L, registryKey(variantMetatableKey));
+    lua_rawget(L, -2);
+    const bool ret = lua_toboolean(L, -1);
+    lua_pop(L, 2);
+    return ret;
+}
+
+void Lua_Variant::pushDispatchTable(lua_State* L, const Class& c)
+{
+    pushSubTable(L, LUA_REGISTRYINDEX, registryKey(dispatchTablesKey));
+    pushSubTable(L, -1, classKey(c));
+    lua_remove(L, -2);
+}
+
+void Lua_Variant::pushMetatable(lua_State* L, const Class& c)
+{
+    if (!c.isValid()) {
+        luaL_getmetatable(L, metatableName);
+        return;
+    }
+
+    pushSubTable(L, LUA_REGISTRYINDEX, registryKey(metatablesKey));
+    lua_pushlightuserdata(L, classKey(c));
+    lua_rawget(L, -2);
+
+    if (!lua_isnil(L, -1)) {
+        lua_remove(L, -2);
+        return;
+    }
+    lua_pop(L, 1);
+
+    // the metamethods are the functions of the default metatable, Lua 5.1
+    // only compares two values whose __eq or __lt are the same function
+    lua_newtable(L);
+    luaL_getmetatable(L, metatableName);
+    for (const luaL_Reg* f = lib_m; f->name != NULL; ++f) {
+        lua_getfield(L, -1, f->name);
+        lua_setfield(L, -3, f->name);
+    }
+    lua_pop(L, 1);
+    markAsVariantMetatable(L);
+
+    pushDispatchTable(L, c);
+    lua_newtable(L); // getters
+    lua_newtable(L); // setters
+
+    for (const Attribute& a: c.attributes()) {
+        const string name = a.name();
+
+        // methods take precedence, these attributes are found by index
+        if (methods.count(name) != 0 || !c.methodsNamed(a.symbol()).empty()) {
+            continue;
+        }
+
+        FieldAccessor::create(L, c, a);
+        lua_pushvalue(L, -1);
+        lua_setfield(L, -4, name.c_str());
+        lua_setfield(L, -2, name.c_str());
+    }
+
+    lua_pushcclosure(L, exception_translator<classNewindex>, 1);
+    lua_setfield(L, -4, "__newindex");
+    lua_pushcclosure(L, exception_translator<classIndex>, 2);
+    lua_setfield(L, -2, "__index");
+
+    lua_pushlightuserdata(L, classKey(c));
+    lua_pushvalue(L, -2);
+    lua_rawset(L, -4);
+    lua_remove(L, -2);
+}
+
+// only installed in the metatables of variants, the object doesn't need to be checked
+int Lua_Variant::classIndex(lua_State* L)
+{
+    // methods that were already looked up
+    lua_pushvalue(L, 2);
+    lua_rawget(L, lua_upvalueindex(1));
+    if (!lua_isnil(L, -1)) {
+        return 1;
+    }
+    lua_pop(L, 1);
+
+    lua_pushvalue(L, 2);
+    lua_rawget(L, lua_upvalueindex(2));
+    if (!lua_isnil(L, -1)) {
+        return FieldAccessor::toUserData(L, -1)->get(L, *static_cast<Lua_Variant*>(lua_touserdata(L, 1)));
+    }
+
+    lua_settop(L, 2);
+    return index(L);
+}
+
+int Lua_Variant::classNewindex(lua_State* L)
+{
+    lua_pushvalue(L, 2);
+    lua_rawget(L, lua_upvalueindex(1));
+    if (!lua_isnil(L, -1)) {
+        FieldAccessor::toUserData(L, -1)->set(L, *static_cast<Lua_Variant*>(lua_touserdata(L, 1)), 3);
+        return 0;
+    }
+
+    lua_settop(L, 3);
+    return newindex(L);
 }
 
 
@@ -695,7 +1229,6 @@ int Lua_Method::isStatic(lua_State* L)
 int Lua_Method::call(lua_State* L)
 {
 	Lua_Method* m = checkUserData(L);
-    vector<VariantValue> args;
 
 	VariantValue obj;
 
@@ -710,32 +1243,73 @@ int Lua_Method::call(lua_State* L)
 		obj = Lua_Variant::getFromStack(L, begin++);
 	}
 
-    for (int i = begin; i <= n; ++i) {
-		args.push_back(Lua_Variant::getFromStack(L, i));
+	if (!m->m_hasMarshaler) {
+		m->m_marshaler = LuaMarshaler::forCallable(m->m_method);
+		m->m_hasMarshaler = true;
 	}
 
-	VariantValue ret;
+	return call(L, m->m_method, m->m_marshaler, obj, begin); // if the method is static, it ignores obj
+}
 
-	ret = m->m_method.callArgArray(obj, args); // if the method is static, it ignores the first arg
+int Lua_Method::call(lua_State* L, const Method& m, const LuaMarshaler& marshaler, VariantValue& obj, int firstArg)
+{
+	StackArguments args(L, marshaler, firstArg);
+	return Lua_Variant::pushResult(L, m.callArgArray(obj, args.view()));
+}
 
-	if (ret.isValid()) {
 
-		if (ret.isArithmetical()) {
-			lua_pushnumber(L, ret.convertTo<lua_Number>());
-		} else if (ret.isStdString()) {
-			lua_pushstring(L, ret.convertTo<std::string>().c_str());
-		} else {
-            Class clazz;
-#ifndef NO_RTTI
-            clazz = Class::lookup(ret.typeId());
-#endif
-            Lua_Variant::create(L, clazz, std::move(ret));
+//---------------Method dispatch------------------------------------------------
+
+const char * MethodDispatch::metatableName = "SelfPortrait.MethodDispatch";
+
+MethodDispatch::MethodDispatch(const Class& c, Symbol name)
+	: m_class(c)
+	, m_name(name)
+{
+	for (const Method& m: c.methodsNamed(name)) {
+		const ::std::size_t numArgs = m.numberOfArguments();
+		if (numArgs >= m_byArity.size()) {
+			m_byArity.resize(numArgs + 1);
 		}
+		Overloads& o = m_byArity[numArgs];
+		o.methods.push_back(m);
+	}
+	for (Overloads& o: m_byArity) {
+		if (o.methods.size() == 1) {
+			o.marshaler = LuaMarshaler::forCallable(o.methods.front());
+		}
+	}
+}
 
-		return 1;
-	} else {
-		return 0;
+void MethodDispatch::create(lua_State* L, const Class& c, Symbol name)
+{
+	void * f = lua_newuserdata(L, sizeof(MethodDispatch));
+	new(f) MethodDispatch(c, name);
+	if (luaL_newmetatable(L, metatableName)) {
+		lua_pushcfunction(L, gc);
+		lua_setfield(L, -2, "__gc");
 	}
+	lua_setmetatable(L, -2);
+}
+
+MethodDispatch* MethodDispatch::checkUserData(lua_State* L, int pos)
+{
+	return (MethodDispatch*)luaL_checkudata(L, pos, metatableName);
+}
+
+const vector<Method>& MethodDispatch::overloads(int numArgs) const
+{
+	static const vector<Method> none;
+	if (numArgs < 0 || static_cast< ::std::size_t>(numArgs) >= m_byArity.size()) {
+		return none;
+	}
+	return m_byArity[numArgs].methods;
+}
+
+int MethodDispatch::gc(lua_State* L)
+{
+	checkUserData(L, 1)->~MethodDispatch();
+	return 0;
 }
 
 
@@ -747,6 +1321,116 @@ int Lua_Method::getClass(lua_State* L)
 }
 
 
+//---------------Field access---------------------------------------------------
+
+const char * FieldAccessor::metatableName = "SelfPortrait.FieldAccessor";
+
+FieldAccessor::FieldAccessor(const Class& c, const Attribute& a)
+	: m_attribute(a)
+	, m_raw()
+#ifndef NO_RTTI
+	, m_value(a.type())
+#endif
+	, m_get(attributeGet)
+	, m_set(attributeSet)
+{
+#ifndef NO_RTTI
+	// inherited attributes might be at an offset in a base class subobject
+	if (a.isStatic() || a.getClass() != c) {
+		return;
+	}
+
+	static const struct {
+		const std::type_info& type;
+		Getter get;
+		Setter set;
+	} accessors[] = {
+		// bools have always been passed to Lua as numbers
+		{ typeid(bool),               rawGet<bool, int>,                          attributeSet },
+		{ typeid(char),               rawGet<char, char>,                         rawSetNumber<char> },
+		{ typeid(short),              rawGet<short, short>,                       rawSetNumber<short> },
+		{ typeid(int),                rawGet<int, int>,                           rawSetNumber<int> },
+		{ typeid(long),               rawGet<long, long>,                         rawSetNumber<long> },
+		{ typeid(long long),          rawGet<long long, long long>,               rawSetNumber<long long> },
+		{ typeid(unsigned char),      rawGet<unsigned char, unsigned char>,       rawSetNumber<unsigned char> },
+		{ typeid(unsigned short),     rawGet<unsigned short, unsigned short>,     rawSetNumber<unsigned short> },
+		{ typeid(unsigned int),       rawGet<unsigned int, unsigned int>,         rawSetNumber<unsigned int> },
+		// might not fit into a lua_Integer
+		{ typeid(unsigned long),      rawGet<unsigned long, double>,              rawSetNumber<unsigned long> },
+		{ typeid(unsigned long long), rawGet<unsigned long long, double>,         rawSetNumber<unsigned long long> },
+		{ typeid(float),              rawGet<float, float>,                       rawSetNumber<float> },
+		{ typeid(double),             rawGet<double, double>,                     rawSetNumber<double> },
+		{ typeid(std::string),        rawGet<std::string, std::string>,           rawSetString },
+	};
+
+	for (const auto& accessor: accessors) {
+		if (accessor.type == a.type()) {
+			m_raw = a.rawAccessor();
+			m_get = accessor.get;
+			m_set = accessor.set;
+			return;
+		}
+	}
+#endif
+}
+
+void FieldAccessor::create(lua_State* L, const Class& c, const Attribute& a)
+{
+	void * f = lua_newuserdata(L, sizeof(FieldAccessor));
+	new(f) FieldAccessor(c, a);
+	if (luaL_newmetatable(L, metatableName)) {
+		lua_pushcfunction(L, gc);
+		lua_setfield(L, -2, "__gc");
+	}
+	lua_setmetatable(L, -2);
+}
+
+int FieldAccessor::gc(lua_State* L)
+{
+	toUserData(L, 1)->~FieldAccessor();
+	return 0;
+}
+
+int FieldAccessor::attributeGet(lua_State* L, const FieldAccessor& f, const VariantValue& object)
+{
+	return Lua_Variant::pushResult(L, f.m_attribute.get(object));
+}
+
+void FieldAccessor::attributeSet(lua_State* L, const FieldAccessor& f, VariantValue& object, int idx)
+{
+	f.m_attribute.set(object, f.m_value.get(L, idx));
+}
+
+template<class T, class Pushed>
+int FieldAccessor::rawGet(lua_State* L, const FieldAccessor& f, const VariantValue& object)
+{
+	LuaUtils::LuaValue<Pushed>::pushValue(L, f.m_raw.get<T>(object.ptrToValue()));
+	return 1;
+}
+
+template<class T>
+void FieldAccessor::rawSetNumber(lua_State* L, const FieldAccessor& f, VariantValue& object, int idx)
+{
+	if (lua_type(L, idx) != LUA_TNUMBER || object.isConst()) {
+		// let the attribute convert the value or report the error
+		attributeSet(L, f, object, idx);
+		return;
+	}
+	f.m_raw.set<T>(const_cast<void*>(object.ptrToValue()), static_cast<T>(lua_tonumber(L, idx)));
+}
+
+void FieldAccessor::rawSetString(lua_State* L, const FieldAccessor& f, VariantValue& object, int idx)
+{
+	if (lua_type(L, idx) != LUA_TSTRING || object.isConst()) {
+		attributeSet(L, f, object, idx);
+		return;
+	}
+	size_t length = 0;
+	const char* str = lua_tolstring(L, idx, &length);
+	f.m_raw.set<std::string>(const_cast<void*>(object.ptrToValue()), std::string(str, length));
+}
+
+
 //---------------Constructor----------------------------------------------------
 
 const char * Lua_Constructor::metatableName = "SelfPortrait.Constructor";
@@ -770,15 +1454,14 @@ void Lua_Constructor::initialize()
 int Lua_Constructor::call(lua_State* L)
 {
 	Lua_Constructor* c = checkUserData(L);
-	vector<VariantValue> args;
-
-	int n = lua_gettop(L);
 
-	for (int i = 2; i <= n; ++i) {
-		args.push_back(Lua_Variant::getFromStack(L, i));
+	if (!c->m_hasMarshaler) {
+		c->m_marshaler = LuaMarshaler::forCallable(c->m_constructor);
+		c->m_hasMarshaler = true;
 	}
 
-    Lua_Variant::create(L, c->wrapped().getClass(), ::std::move(c->m_constructor.callArgArray(args)));
+	StackArguments args(L, c->m_marshaler, 2);
+    Lua_Variant::create(L, c->wrapped().getClass(), c->m_constructor.callArgArray(args.view()));
 	return 1;
 }
 
@@ -845,19 +1528,7 @@ int Lua_Attribute::get(lua_State* L)
 		obj = Lua_Variant::getFromStack(L, 2);
 	}
 
-	VariantValue ret = c->m_attribute.get(obj);
-	if (ret.isArithmetical()) {
-		lua_pushnumber(L, ret.convertTo<lua_Number>());
-	} else if (ret.isStdString()) {
-		lua_pushstring(L, ret.convertTo<std::string>().c_str());
-	} else {
-        Class clazz;
-#ifndef NO_RTTI
-        clazz = Class::lookup(ret.typeId());
-#endif
-        Lua_Variant::create(L, clazz, std::move(ret));
-	}
-
+	Lua_Variant::pushResult(L, c->m_attribute.get(obj));
 	return 1;
 }
 
@@ -949,36 +1620,14 @@ int Lua_Function::name(lua_State* L)
 int Lua_Function::call(lua_State* L)
 {
 	Lua_Function* f = checkUserData(L);
-	vector<VariantValue> args;
-
 
-	int n = lua_gettop(L);
-
-	for (int i = 2; i <= n; ++i) {
-		args.push_back(Lua_Variant::getFromStack(L, i));
+	if (!f->m_hasMarshaler) {
+		f->m_marshaler = LuaMarshaler::forCallable(f->m_function);
+		f->m_hasMarshaler = true;
 	}
 
-	VariantValue ret;
-
-	ret = f->m_function.callArgArray(args);
-
-	if (ret.isValid()) {
-
-		if (ret.isArithmetical()) {
-			lua_pushnumber(L, ret.convertTo<lua_Number>());
-		} else if (ret.isStdString()) {
-			lua_pushstring(L, ret.convertTo<std::string>().c_str());
-		} else {      
-            Class clazz;
-#ifndef NO_RTTI
-            clazz = Class::lookup(ret.typeId());
-#endif
-            Lua_Variant::create(L, clazz, std::move(ret));
-		}
-		return 1;
-	} else {
-		return 0;
-	}
+	StackArguments args(L, f->m_marshaler, 2);
+	return Lua_Variant::pushResult(L, f->m_function.callArgArray(args.view()));
 }
 
 int Lua_Function::numberOfArguments(lua_State* L)
@@ -1096,7 +1745,7 @@ void LuaClosureWrapper::deleter::operator()(shared_state* s) const {
     delete s;
 }
 
-VariantValue LuaClosureWrapper::operator()(const std::vector<VariantValue>& vargs) const {
+VariantValue LuaClosureWrapper::operator()(ArgumentView vargs) const {
 
 
     lua_rawgeti(L, LUA_REGISTRYINDEX, ss->envIndex);
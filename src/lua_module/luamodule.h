@@ -12,6 +12,7 @@
 #include <string>
 #include <vector>
 #include <exception>
+#include <typeinfo>
 
 namespace SelfPortraitLua {
 
@@ -147,6 +148,127 @@ const struct luaL_Reg LuaAdapter<T>::lib_m[] = {
     { NULL, NULL }
 };
 
+//---------------Marshaling------------------------------------------------------
+
+/* Converts the value at idx to an argument of one parameter type */
+typedef VariantValue (*ArgumentMarshaler)(lua_State* L, int idx);
+
+/* Converts a Lua table to a C++ container in one pass and back */
+struct TableConversion {
+    VariantValue (*fromTable)(lua_State* L, int idx);
+    void (*toTable)(lua_State* L, const VariantValue& value);
+};
+
+/* The containers that are passed to C++ as Lua tables. Vectors and maps of
+ * numbers and strings are known by default, other containers can be added if
+ * they have a LuaUtils::LuaValue specialization. Containers returned from C++
+ * stay variants, which may refer to the container of the callee, until
+ * Variant:totable() copies them to a table. Lookups don't lock. */
+class TableConversions {
+public:
+    template<class C>
+    static void add() {
+        add(typeid(C), of<C>());
+    }
+
+    template<class C>
+    static TableConversion of() {
+        return TableConversion{ fromTable<C>, toTable<C> };
+    }
+
+    /* nullptr if values of the type aren't converted to tables */
+    static const TableConversion* find(const std::type_info& type);
+
+private:
+    static void add(const std::type_info& type, TableConversion conversion);
+
+    template<class C>
+    static VariantValue fromTable(lua_State* L, int idx) {
+        VariantValue v;
+        v.construct<C>(LuaUtils::LuaValue<C>::getStackValue(L, idx));
+        return v;
+    }
+
+    template<class C>
+    static void toTable(lua_State* L, const VariantValue& value) {
+        LuaUtils::LuaValue<C>::pushValue(L, *static_cast<const C*>(value.ptrToValue()));
+    }
+};
+
+class StructMarshaler;
+
+/* Converts a Lua value to a value of one C++ type. Tables are converted if
+ * the type is a known container or a reflected class */
+class ValueMarshaler {
+public:
+    ValueMarshaler();
+#ifndef NO_RTTI
+    explicit ValueMarshaler(const std::type_info& type);
+#endif
+
+    VariantValue get(lua_State* L, int idx) const;
+
+    /* the conversion of tables to objects of a reflected class, if the type is one */
+    const StructMarshaler* structure() const { return m_struct; }
+
+private:
+    ArgumentMarshaler m_marshaler;
+    const TableConversion* m_table;
+    const StructMarshaler* m_struct;
+};
+
+/* Creates objects of a reflected class from tables with a field for each
+ * attribute, and tables from objects. Missing fields keep the value set
+ * by the default constructor, fields that aren't attributes are ignored. */
+class StructMarshaler {
+public:
+    /* the marshaler of class c, created on the first use and kept forever */
+    static const StructMarshaler* forClass(const Class& c);
+
+    VariantValue fromTable(lua_State* L, int idx) const;
+    void toTable(lua_State* L, const VariantValue& object) const;
+
+private:
+    explicit StructMarshaler(const Class& c);
+    void addFields();
+
+    struct Field {
+        string name;
+        Attribute attribute;
+        ValueMarshaler value;
+    };
+
+    Class m_class;
+    Constructor m_constructor;
+    vector<Field> m_fields;
+};
+
+/* Converts the arguments of a call straight to the parameter types of the
+ * callee, e.g. numbers passed to an int parameter become ints and strings
+ * passed to a const char* parameter aren't copied. Values that don't match
+ * the parameter type are converted with Lua_Variant::getFromStack and left
+ * to the reflection layer. */
+class LuaMarshaler {
+public:
+    LuaMarshaler() {}
+    explicit LuaMarshaler(const vector<const std::type_info*>& argumentTypes);
+
+    template<class Callable>
+    static LuaMarshaler forCallable(const Callable& c) {
+#ifndef NO_RTTI
+        return LuaMarshaler(c.argumentTypes());
+#else
+        return LuaMarshaler();
+#endif
+    }
+
+    /* fills args with the numArgs values starting at firstArg */
+    void getArguments(lua_State* L, int firstArg, int numArgs, VariantValue* args) const;
+
+private:
+    vector<ValueMarshaler> m_arguments;
+};
+
 //---------------Variant--------------------------------------------------------
 class Lua_Variant: public LuaAdapter<Lua_Variant> {
 public:
@@ -158,10 +280,18 @@ public:
 
     static void initialize();
 
+    static void _register(lua_State* L);
 
+    /* variants of reflected classes have a metatable of their own, see pushMetatable */
+    static Lua_Variant* checkUserData(lua_State* L, int pos = 1);
+    static bool isUserData(lua_State* L, int pos = 1);
 
     static VariantValue getFromStack(lua_State* L, int idx = 1);
 
+    /* pushes numbers and strings as Lua values and everything else as a
+     * variant, returns the number of values pushed */
+    static int pushResult(lua_State* L, VariantValue&& ret);
+
     static int newInstance(lua_State* L);
     static int tostring(lua_State* L);
     static int tonumber(lua_State* L);
@@ -173,6 +303,7 @@ public:
     static int isPOD(lua_State* L);
     static int sizeOf(lua_State* L);
     static int alignOf(lua_State* L);
+    static int totable(lua_State* L);
 
     static int add(lua_State* L);
     static int sub(lua_State* L);
@@ -184,6 +315,18 @@ public:
     static int attribute_stub(lua_State* L);
     static int method_stub(lua_State* L);
 
+    /* pushes the table that maps names to the functions __index returns for
+     * objects of class c. It is filled lazily and lives in the registry */
+    static void pushDispatchTable(lua_State* L, const Class& c);
+
+    /* pushes the metatable of the objects of class c. Its __index and
+     * __newindex find the attributes in tables that map their names to
+     * FieldAccessors. It is created on first use and lives in the registry.
+     * Variants of unknown classes share the metatable named metatableName */
+    static void pushMetatable(lua_State* L, const Class& c);
+    static int classIndex(lua_State* L);
+    static int classNewindex(lua_State* L);
+
     static const char * metatableName;
     static const char * userDataName;
 
@@ -193,7 +336,7 @@ public:
         lc->m_variant = ::std::move(v);
 
         lc->m_class = c;
-        luaL_getmetatable(L, Lua_Variant::metatableName);
+        pushMetatable(L, c);
         lua_setmetatable(L, -2);
     }
 
@@ -205,7 +348,7 @@ public:
         void * f = lua_newuserdata(L, sizeof(Adapted));
         Adapted * lc = new(f) Adapted(args...);
         lc->m_class = c;
-        luaL_getmetatable(L, Adapted::metatableName);
+        pushMetatable(L, c);
         lua_setmetatable(L, -2);
     }
 
@@ -219,6 +362,7 @@ private:
     static const struct luaL_Reg lib_m[];
 
     friend class LuaAdapter<Lua_Variant>;
+    friend class FieldAccessor;
 };
 
 
@@ -272,9 +416,10 @@ private:
 
 class Lua_Method: public LuaAdapter<Lua_Method> {
 public:
-    Lua_Method(Method m) : m_method(m) {}
+    Lua_Method(Method m) : m_method(m), m_marshaler(), m_hasMarshaler(false) {}
 
     static int call(lua_State* L);
+    static int call(lua_State* L, const Method& m, const LuaMarshaler& marshaler, VariantValue& obj, int firstArg);
     static int name(lua_State* L);
     static int fullName(lua_State* L);
     static int numberOfArguments(lua_State* L);
@@ -294,17 +439,103 @@ public:
 
 private:
     Method m_method;
+    LuaMarshaler m_marshaler; // created by the first call
+    bool m_hasMarshaler;
     static MethodTable methods;
     static const struct luaL_Reg lib_f[];
     friend class LuaAdapter<Lua_Method>;
 };
 
 
+//---------------Method dispatch------------------------------------------------
+
+/* The overloads of a method name in a class, indexed by the number of
+ * arguments. Lua_Variant::index creates it the first time the name is looked
+ * up on an object of the class and keeps it as the upvalue of the cached
+ * method_stub closure, so repeated calls don't search the class again. The
+ * name is kept as a Symbol, messages are the only place its string is used. */
+class MethodDispatch {
+public:
+    MethodDispatch(const Class& c, Symbol name);
+
+    static void create(lua_State* L, const Class& c, Symbol name);
+    static MethodDispatch* checkUserData(lua_State* L, int pos);
+
+    /* the methods that take exactly numArgs arguments. Copies are kept, so
+     * they don't depend on the name index of the class */
+    const vector<Method>& overloads(int numArgs) const;
+
+    /* marshals the arguments of the method taking numArgs arguments, if there is only one */
+    const LuaMarshaler& marshaler(int numArgs) const { return m_byArity[numArgs].marshaler; }
+
+    const Class& getClass() const { return m_class; }
+    const string& name() const { return m_name.str(); }
+
+    static const char * metatableName;
+
+private:
+    static int gc(lua_State* L);
+
+    struct Overloads {
+        vector<Method> methods;
+        LuaMarshaler marshaler;
+    };
+
+    Class m_class;
+    Symbol m_name;
+    vector<Overloads> m_byArity;
+};
+
+
+//---------------Field access---------------------------------------------------
+
+/* Reads and writes one attribute of the objects of a class from Lua. The
+ * accessors of a class are kept in the tables of its metatable. Attributes of
+ * arithmetic type or std::string declared by the class itself are accessed at
+ * their offset in the object, the others through the Attribute. */
+class FieldAccessor {
+public:
+    FieldAccessor(const Class& c, const Attribute& a);
+
+    static void create(lua_State* L, const Class& c, const Attribute& a);
+    static FieldAccessor* toUserData(lua_State* L, int pos) { return static_cast<FieldAccessor*>(lua_touserdata(L, pos)); }
+
+    /* pushes the attribute of object */
+    int get(lua_State* L, const Lua_Variant& object) const { return m_get(L, *this, object.m_variant); }
+
+    /* sets the attribute of object to the value at idx */
+    void set(lua_State* L, Lua_Variant& object, int idx) const { m_set(L, *this, object.m_variant, idx); }
+
+    static const char * metatableName;
+
+private:
+    typedef int (*Getter)(lua_State* L, const FieldAccessor& f, const VariantValue& object);
+    typedef void (*Setter)(lua_State* L, const FieldAccessor& f, VariantValue& object, int idx);
+
+    static int gc(lua_State* L);
+
+    static int attributeGet(lua_State* L, const FieldAccessor& f, const VariantValue& object);
+    static void attributeSet(lua_State* L, const FieldAccessor& f, VariantValue& object, int idx);
+
+    template<class T, class Pushed>
+    static int rawGet(lua_State* L, const FieldAccessor& f, const VariantValue& object);
+    template<class T>
+    static void rawSetNumber(lua_State* L, const FieldAccessor& f, VariantValue& object, int idx);
+    static void rawSetString(lua_State* L, const FieldAccessor& f, VariantValue& object, int idx);
+
+    Attribute m_attribute;
+    RawAttributeAccessor m_raw;
+    ValueMarshaler m_value;
+    Getter m_get;
+    Setter m_set;
+};
+
+
 //---------------Constructor----------------------------------------------------
 
 class Lua_Constructor: public LuaAdapter<Lua_Constructor> {
 public:
-    Lua_Constructor(Constructor c) : m_constructor(c) {}
+    Lua_Constructor(Constructor c) : m_constructor(c), m_marshaler(), m_hasMarshaler(false) {}
 
     static int call(lua_State* L);
     static int numberOfArguments(lua_State* L);
@@ -321,6 +552,8 @@ public:
 
 private:
     Constructor m_constructor;
+    LuaMarshaler m_marshaler; // created by the first call
+    bool m_hasMarshaler;
     static MethodTable methods;
     static const struct luaL_Reg lib_f[];
     friend class LuaAdapter<Lua_Constructor>;
@@ -359,7 +592,7 @@ private:
 
 class Lua_Function: public LuaAdapter<Lua_Function> {
 public:
-    Lua_Function(Function f) : m_function(f) {}
+    Lua_Function(Function f) : m_function(f), m_marshaler(), m_hasMarshaler(false) {}
 
     static int name(lua_State* L);
     static int call(lua_State* L);
@@ -377,6 +610,8 @@ public:
 
 private:
     Function m_function;
+    LuaMarshaler m_marshaler; // created by the first call
+    bool m_hasMarshaler;
     static MethodTable methods;
     static const struct luaL_Reg lib_f[];
     friend class LuaAdapter<Lua_Function>;
@@ -406,7 +641,7 @@ struct LuaClosureWrapper {
 
     }
 
-    VariantValue operator()(const std::vector<VariantValue>& vargs) const;
+    VariantValue operator()(ArgumentView vargs) const;
 };
 
 
@@ -337,6 +337,69 @@ namespace definitions {
 		}
 	}
 
+	void merge(TranslationUnit& u, TranslationUnit&& other) {
+
+		for (auto& x: other.include_directives) {
+			if (find(u.include_directives.begin(), u.include_directives.end(), x) == u.include_directives.end()) {
+				u.include_directives.push_back(std::move(x));
+			}
+		}
+
+		const size_t knownFunctions = u.functions.size();
+		for (auto& x: other.functions) {
+			auto end = u.functions.begin() + knownFunctions;
+			auto it = find_if(u.functions.begin(), end, [&](const Function& f) {
+				return f.name == x.name && f.argument_type_spellings == x.argument_type_spellings;
+			});
+			if (it == end) {
+				u.functions.push_back(std::move(x));
+			}
+		}
+
+		for (auto& x: other.classes) {
+			auto it = u.classIndex.find(x->name);
+			if (it == u.classIndex.end()) {
+				u.classIndex[x->name] = x;
+				u.classes.push_back(x);
+			} else if (x->inMainFile && !it->second->inMainFile) {
+				replace(u.classes.begin(), u.classes.end(), it->second, x);
+				it->second = x;
+			}
+		}
+	}
+
+	std::vector<TranslationUnit> shard(const TranslationUnit& u, size_t numShards) {
+
+		vector<shared_ptr<Class> > classes;
+		for (const auto& x: u.classes) {
+			if (x->inMainFile) {
+				classes.push_back(x);
+			}
+		}
+		sort(classes.begin(), classes.end(), [](const shared_ptr<Class>& c1, const shared_ptr<Class>& c2) -> bool {
+			 return c1->name < c2->name;
+		});
+
+		const size_t items = classes.size() + u.functions.size();
+		numShards = max<size_t>(1, min(numShards, items));
+
+		vector<TranslationUnit> ret(numShards);
+		for (size_t i = 0; i < numShards; ++i) {
+			ret[i].include_directives = u.include_directives;
+			ret[i].classIndex = u.classIndex;
+		}
+
+		// contiguous chunks of about the same size, functions first
+		size_t i = 0;
+		for (const auto& x: u.functions) {
+			ret[i++ * numShards / items].functions.push_back(x);
+		}
+		for (const auto& x: classes) {
+			ret[i++ * numShards / items].classes.push_back(x);
+		}
+		return ret;
+	}
+
 	TranslationUnitBuilder::TranslationUnitBuilder(TranslationUnit& tu)
 		: m_tu(tu) {}
 
@@ -164,6 +164,19 @@ namespace definitions {
 
 	void print(const TranslationUnit& u, std::ostream& o, bool diagOn = false);
 
+	/* Moves the definitions of other into u. Headers included by several
+	 * translation units give several definitions of the same class, only one is
+	 * kept (the one from the unit whose main file defines the class, if any).
+	 * Functions declared in more than one unit are kept once.
+	 */
+	void merge(TranslationUnit& u, TranslationUnit&& other);
+
+	/* Splits the classes and functions of u into at most numShards units that can
+	 * be printed to separate files. All shards share the include directives and
+	 * the class index of u.
+	 */
+	std::vector<TranslationUnit> shard(const TranslationUnit& u, std::size_t numShards);
+
 }
 
 #endif /* DEFINITIONS_H */
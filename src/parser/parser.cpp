@@ -3,6 +3,7 @@
 ** See Copyright Notice in reflection.h
 */
 #include "llvm/Support/Host.h"
+#include "llvm/Support/Threading.h"
 
 #include "clang/Driver/Compilation.h"
 #include "clang/Driver/Driver.h"
@@ -30,6 +31,7 @@
 #include "clang/Basic/LangOptions.h"
 #include "clang/Sema/Sema.h"
 #include "clang/Sema/Template.h"
+#include "clang/Tooling/JSONCompilationDatabase.h"
 
 
 #include <vector>
@@ -40,6 +42,10 @@
 #include <sstream>
 #include <stdexcept>
 #include <unordered_map>
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
 
 #include "definitions.h"
 using namespace definitions;
@@ -222,6 +228,11 @@ public:
 		return os;
 	}
 
+	// the consumer can't be used after this
+	TranslationUnit takeTranslationUnit() {
+		return std::move(m_tu);
+	}
+
 	Access convertClangsAccessSpec(AccessSpecifier as) const {
 		if (as == AS_none) {
 			throw std::logic_error("stumbled upon an AS_none, figure out what it means in this context");
@@ -471,9 +482,198 @@ public:
 };
 
 
+namespace {
+
+	const char* clangResourcePath = "/usr/lib64/clang/3.2/";
+
+	/* Parses one translation unit. args are the arguments of the clang command line,
+	 * starting with the program name. Returns false if clang reported errors.
+	 */
+	bool parseTranslationUnit(const vector<string>& args, bool forceTemplates, TranslationUnit& result, raw_ostream& diagOut)
+	{
+		vector<const char*> cargs;
+		for (const string& a: args) {
+			cargs.push_back(a.c_str());
+		}
+
+		// TextDiagnosticPrinter deletes this on on destruction
+		DiagnosticOptions* options = new DiagnosticOptions();
+		options->ShowCarets = 1;
+		options->ShowColors = 1;
+
+
+		TextDiagnosticPrinter DiagClient(diagOut, options, /*OwnsOutputStream*/ false);
+
+		llvm::IntrusiveRefCntPtr<DiagnosticIDs> DiagID(new DiagnosticIDs());
+		llvm::IntrusiveRefCntPtr<DiagnosticsEngine> Diags(new DiagnosticsEngine(DiagID, options, &DiagClient, false));
+
+		llvm::OwningPtr<ASTUnit> unit(ASTUnit::LoadFromCommandLine(&cargs[0], &cargs[0]+cargs.size(), Diags, clangResourcePath, /*OnlyLocalDecls=*/false, /*CaptureDiagnostics=*/false, 0, 0, true, /*PrecompilePreamble=*/false, /*TUKind=*/TU_Complete, /*CacheCodeCompletionResults=*/false, /*AllowPCHWithCompilerErrors=*/false));
+		//llvm::OwningPtr<ASTUnit> unit(ASTUnit::LoadFromCommandLine(&args[0], &args[0]+args.size(), Diags, "/usr/lib/clang/3.1/", /*OnlyLocalDecls=*/false, /*CaptureDiagnostics=*/false, 0, 0, true, /*PrecompilePreamble=*/false, /*TUKind=*/TU_Complete, /*CacheCodeCompletionResults=*/false, /*AllowPCHWithCompilerErrors=*/false));
+
+
+		if (!unit || DiagClient.getNumErrors() > 0) {
+			return false;
+		}
+
+		ASTContext& astContext = unit->getASTContext();
+		MyASTConsumer astConsumer(&unit->getSourceManager(), astContext, unit->getSema(), forceTemplates);
+
+		for (auto it = astContext.getTranslationUnitDecl()->decls_begin(); it != astContext.getTranslationUnitDecl()->decls_end(); ++it) {
+			Decl* subdecl = *it;
+			SourceLocation location = subdecl->getLocation();
+
+			astConsumer.handleDecl(subdecl, unit->isInMainFileID(location));
+		}
+
+		result = astConsumer.takeTranslationUnit();
+		return true;
+	}
+
+	/* Parses every job on its own thread pool worker, one ASTUnit per job.
+	 * The diagnostics of a job are printed together once it's done.
+	 * The units are merged in the order of the jobs, so the output doesn't
+	 * depend on the scheduling.
+	 */
+	bool parseTranslationUnits(const vector<vector<string> >& jobs, bool forceTemplates, unsigned int numThreads, TranslationUnit& result)
+	{
+		vector<TranslationUnit> units(jobs.size());
+		vector<char> succeeded(jobs.size(), false);
+		std::atomic<size_t> next(0);
+		std::mutex diagMutex;
+
+		auto worker = [&]() {
+			for (size_t i = next++; i < jobs.size(); i = next++) {
+				string diagnostics;
+				raw_string_ostream diagOut(diagnostics);
+
+				succeeded[i] = parseTranslationUnit(jobs[i], forceTemplates, units[i], diagOut);
+
+				diagOut.flush();
+				if (!diagnostics.empty()) {
+					std::lock_guard<std::mutex> lock(diagMutex);
+					llvm::errs() << diagnostics;
+				}
+			}
+		};
+
+		numThreads = max(1u, min<unsigned int>(numThreads, jobs.size()));
+		vector<std::thread> threads;
+		for (unsigned int t = 1; t < numThreads; ++t) {
+			threads.emplace_back(worker);
+		}
+		worker();
+		for (std::thread& t: threads) {
+			t.join();
+		}
+
+		bool ok = true;
+		for (size_t i = 0; i < jobs.size(); ++i) {
+			if (succeeded[i]) {
+				merge(result, std::move(units[i]));
+			} else {
+				ok = false;
+			}
+		}
+		return ok;
+	}
+
+	bool isAbsolute(const string& path) {
+		return !path.empty() && path[0] == '/';
+	}
+
+	string absolutePath(const string& directory, const string& path) {
+		return isAbsolute(path) || directory.empty() ? path : directory + "/" + path;
+	}
+
+	/* The arguments of a compile_commands.json entry that matter for parsing.
+	 * The commands are run in their own directory but all our jobs share the
+	 * working directory, so relative paths are made absolute.
+	 */
+	vector<string> compileCommandArguments(const clang::tooling::CompileCommand& command, const string& file)
+	{
+		vector<string> ret;
+		const vector<string>& cl = command.CommandLine;
+
+		for (size_t i = 1; i < cl.size(); ++i) {
+			const string& a = cl[i];
+
+			if (a == "-c" || a == "-MD" || a == "-MMD" || a == "-MP") {
+				continue;
+			} else if (a == "-o" || a == "-MF" || a == "-MT" || a == "-MQ") {
+				++i; // skip the value too
+			} else if (a == "-I" || a == "-isystem" || a == "-include" || a == "-iquote") {
+				ret.push_back(a);
+				if (i + 1 < cl.size()) {
+					ret.push_back(absolutePath(command.Directory, cl[++i]));
+				}
+			} else if (a.compare(0, 2, "-I") == 0) {
+				ret.push_back("-I" + absolutePath(command.Directory, a.substr(2)));
+			} else if (absolutePath(command.Directory, a) == file) {
+				continue; // added by the caller
+			} else {
+				ret.push_back(a);
+			}
+		}
+		return ret;
+	}
+
+	/* The output file of a shard, out.cpp becomes out.0.cpp, out.1.cpp... */
+	string shardFileName(const string& output, size_t index, size_t numShards)
+	{
+		if (numShards == 1) {
+			return output;
+		}
+		const size_t slash = output.rfind('/');
+		size_t dot = output.rfind('.');
+		if (dot == string::npos || (slash != string::npos && dot < slash)) {
+			dot = output.size();
+		}
+		ostringstream ss;
+		ss << output.substr(0, dot) << "." << index << output.substr(dot);
+		return ss.str();
+	}
+
+	bool writeOutput(const string& output, const TranslationUnit& tu, bool iFaceDiags)
+	{
+		std::ofstream out;
+		if (output != "-") {
+			out.open(output);
+			if (!out.is_open()) {
+				cerr << "cannot open output file " << output << endl;
+				return false;
+			}
+		} else {
+			out.copyfmt(std::cout);
+			out.clear(std::cout.rdstate());
+			out.basic_ios<char>::rdbuf(std::cout.rdbuf());
+		}
+
+		definitions::print(tu, out, iFaceDiags);
+		return true;
+	}
+
+	// reads a positive number given to an option
+	unsigned int optionValue(int argc, const char* argv[], int& i, set<int>& skip)
+	{
+		if ((i+1) == argc) {
+			cerr << "No argument given to " << argv[i] << " option" << endl;
+			exit(1);
+		}
+		skip.insert(i);
+		skip.insert(++i);
+		const int value = atoi(argv[i]);
+		if (value <= 0) {
+			cerr << "Invalid argument given to " << argv[i-1] << " option" << endl;
+			exit(1);
+		}
+		return value;
+	}
+}
+
+
 int main(int argc, const char* argv[])
 {
-	vector<const char*> args;
+	vector<string> args;
 	set<int> skip;
 	bool foundCpp = false;
 	bool foundCpp11 = false;
@@ -481,6 +681,10 @@ int main(int argc, const char* argv[])
 	bool iFaceDiags = false;
 	bool forceTemplates = true;
 	string output;
+	string headerList;
+	string compileCommands;
+	unsigned int numThreads = max(1u, std::thread::hardware_concurrency());
+	unsigned int numShards = 1;
 
 	args.push_back(argv[0]);
     args.push_back("-I/usr/lib64/clang/3.2/include"); // why can't clang find this from the resource path?
@@ -517,6 +721,22 @@ int main(int argc, const char* argv[])
 		} else if (strcmp(argv[i], "--no-force-templates") == 0) {
 			forceTemplates = false;
 			skip.insert(i);
+		} else if (strcmp(argv[i], "--header-list") == 0 || strcmp(argv[i], "--compile-commands") == 0) {
+			if ((i+1) == argc) {
+				cerr << "No argument given to " << argv[i] << " option" << endl;
+				exit(1);
+			}
+			if (strcmp(argv[i], "--header-list") == 0) {
+				headerList = argv[i+1];
+			} else {
+				compileCommands = argv[i+1];
+			}
+			skip.insert(i);
+			skip.insert(++i);
+		} else if (strcmp(argv[i], "--jobs") == 0) {
+			numThreads = optionValue(argc, argv, i, skip);
+		} else if (strcmp(argv[i], "--shards") == 0) {
+			numShards = optionValue(argc, argv, i, skip);
 		}
 	}
 
@@ -525,69 +745,101 @@ int main(int argc, const char* argv[])
 		exit(1);
 	}
 
+	if (numShards > 1 && output == "-") {
+		cerr << "Sharded output needs an output file" << endl;
+		exit(1);
+	}
+
+	vector<string> languageArgs;
 
 	if (!foundCpp) {
-		args.push_back("-xc++");
+		languageArgs.push_back("-xc++");
 	}
 
 	if (!foundCpp11) {
-		args.push_back("-std=c++11");
+		languageArgs.push_back("-std=c++11");
 	}
 
 	if (!foundSpellChecking) {
-		args.push_back("-fno-spell-checking");
+		languageArgs.push_back("-fno-spell-checking");
 	}
 
+	args.insert(args.end(), languageArgs.begin(), languageArgs.end());
+
 	for (int i = 1; i < argc; ++i) {
 		if (!contains(skip, i)) {
 			args.push_back(argv[i]);
 		}
 	}
 
-    // TextDiagnosticPrinter deletes this on on destruction
-    DiagnosticOptions* options = new DiagnosticOptions();
-    options->ShowCarets = 1;
-    options->ShowColors = 1;
+	TranslationUnit tu;
 
+	if (headerList.empty() && compileCommands.empty()) {
 
-    TextDiagnosticPrinter DiagClient(llvm::errs(), options, /*OwnsOutputStream*/ false);
+		if (!parseTranslationUnit(args, forceTemplates, tu, llvm::errs())) {
+			return 1;
+		}
 
-	llvm::IntrusiveRefCntPtr<DiagnosticIDs> DiagID(new DiagnosticIDs());
-    llvm::IntrusiveRefCntPtr<DiagnosticsEngine> Diags(new DiagnosticsEngine(DiagID, options, &DiagClient, false));
+	} else {
 
-    llvm::OwningPtr<ASTUnit> unit(ASTUnit::LoadFromCommandLine(&args[0], &args[0]+args.size(), Diags, "/usr/lib64/clang/3.2/", /*OnlyLocalDecls=*/false, /*CaptureDiagnostics=*/false, 0, 0, true, /*PrecompilePreamble=*/false, /*TUKind=*/TU_Complete, /*CacheCodeCompletionResults=*/false, /*AllowPCHWithCompilerErrors=*/false));
-    //llvm::OwningPtr<ASTUnit> unit(ASTUnit::LoadFromCommandLine(&args[0], &args[0]+args.size(), Diags, "/usr/lib/clang/3.1/", /*OnlyLocalDecls=*/false, /*CaptureDiagnostics=*/false, 0, 0, true, /*PrecompilePreamble=*/false, /*TUKind=*/TU_Complete, /*CacheCodeCompletionResults=*/false, /*AllowPCHWithCompilerErrors=*/false));
+		// one job per header or compile command, each with its own clang command line
+		vector<vector<string> > jobs;
 
+		if (!headerList.empty()) {
+			ifstream listFile(headerList);
+			if (!listFile.is_open()) {
+				cerr << "cannot open header list " << headerList << endl;
+				exit(1);
+			}
+			string header;
+			while (getline(listFile, header)) {
+				if (!header.empty()) {
+					jobs.push_back(args);
+					jobs.back().push_back(header);
+				}
+			}
+		}
 
-    if (DiagClient.getNumErrors() > 0) {
-		return 1;
-	}
+		if (!compileCommands.empty()) {
+			string error;
+			llvm::OwningPtr<clang::tooling::JSONCompilationDatabase> db(clang::tooling::JSONCompilationDatabase::loadFromFile(compileCommands, error));
+			if (!db) {
+				cerr << "cannot read " << compileCommands << ": " << error << endl;
+				exit(1);
+			}
+			for (const string& file: db->getAllFiles()) {
+				for (const clang::tooling::CompileCommand& command: db->getCompileCommands(file)) {
+					const string path = absolutePath(command.Directory, file);
+					vector<string> job(args);
+					vector<string> commandArgs = compileCommandArguments(command, path);
+					job.insert(job.end(), commandArgs.begin(), commandArgs.end());
+					job.push_back(path);
+					jobs.push_back(job);
+				}
+			}
+		}
 
-	ASTContext& astContext = unit->getASTContext();
-	MyASTConsumer astConsumer(&unit->getSourceManager(), astContext, unit->getSema(), forceTemplates);
+		if (jobs.empty()) {
+			cerr << "Nothing to parse" << endl;
+			exit(1);
+		}
 
-	for (auto it = astContext.getTranslationUnitDecl()->decls_begin(); it != astContext.getTranslationUnitDecl()->decls_end(); ++it) {
-		Decl* subdecl = *it;
-		SourceLocation location = subdecl->getLocation();
+		if (numThreads > 1 && !llvm::llvm_start_multithreaded()) {
+			cerr << "LLVM was built without thread support, parsing on a single thread" << endl;
+			numThreads = 1;
+		}
 
-		astConsumer.handleDecl(subdecl, unit->isInMainFileID(location));
+		if (!parseTranslationUnits(jobs, forceTemplates, numThreads, tu)) {
+			return 1;
+		}
 	}
 
-	std::ofstream out;
-	if (output != "-") {
-		out.open(output);
-		if (!out.is_open()) {
-			cerr << "cannot open output file " << output << endl;
+	vector<TranslationUnit> shards = shard(tu, numShards);
+	for (size_t i = 0; i < shards.size(); ++i) {
+		if (!writeOutput(shardFileName(output, i, shards.size()), shards[i], iFaceDiags)) {
 			exit(1);
 		}
-	} else {
-		out.copyfmt(std::cout);
-		out.clear(std::cout.rdstate());
-		out.basic_ios<char>::rdbuf(std::cout.rdbuf());
 	}
 
-	astConsumer.print(out, iFaceDiags);
-
-
 	return 0;
 }
@@ -14,6 +14,7 @@
 
 #include "variant.h"
 #include "reflection.h"
+#include "serializer.h"
 #include "str_utils.h"
 
 namespace {
@@ -145,14 +146,21 @@ public:
 #ifndef NO_RTTI
 			, const ::std::type_info& typeId
 #endif
+			, const TypeDescriptor& descriptor
+			, const SerialType& serialType
+			, ::std::ptrdiff_t offset
 			)
 		: m_name(name)
+		, m_symbol(Symbol::intern(name))
 		, m_typeSpelling(typeSpelling)
 		, m_isConst(isConst)
 		, m_isStatic(isStatic)
 #ifndef NO_RTTI
 		, m_typeId(typeId)
 #endif
+		, m_descriptor(descriptor)
+		, m_serialType(serialType)
+		, m_offset(offset)
 	{}
 	virtual ~AbstractAttributeImpl() {}
 
@@ -163,7 +171,15 @@ public:
 	bool isConst() const { return m_isConst; }
 	bool isStatic() const { return m_isStatic; }
 
+	const TypeDescriptor& descriptor() const { return m_descriptor; }
+
+	const SerialType& serialType() const { return m_serialType; }
+
+	// position of the attribute inside an object of its class, -1 for static attributes
+	::std::ptrdiff_t offset() const { return m_offset; }
+
 	const char* name() const { return m_name; }
+	Symbol symbol() const { return m_symbol; }
 	::std::string typeSpelling() const { return normalizedTypeName(m_typeSpelling); }
 
 	VariantValue get() const {
@@ -183,6 +199,13 @@ public:
 	
 	virtual VariantValue get(const VariantValue& object) const = 0;
 
+	// objects and results have the same size
+	virtual void getBatch(ArgumentView objects, VariantValue* results) const {
+		for (::std::size_t i = 0; i < objects.size(); ++i) {
+			results[i] = this->get(objects[i]);
+		}
+	}
+
 	virtual void set(bool isConst, const VariantValue& object, const VariantValue& value) const = 0;
 
 	void set(VariantValue& object, const VariantValue& value) const {
@@ -199,12 +222,16 @@ public:
 
 private:
 	const char* m_name;
+	const Symbol m_symbol;
 	const char* m_typeSpelling;
 	const unsigned int m_isConst : 1;
 	const unsigned int m_isStatic : 1;
 #ifndef NO_RTTI
 	const ::std::type_info& m_typeId;
 #endif
+	const TypeDescriptor& m_descriptor;
+	const SerialType& m_serialType;
+	const ::std::ptrdiff_t m_offset;
 };
 
 namespace {
@@ -227,17 +254,29 @@ public:
 #ifndef NO_RTTI
 			  , typeid(Type)
 #endif
+			  , type_descriptor<Type>::value
+			  , serial_type<Type>::value
+			  , memberOffset(ptr)
 			  )
 		, m_ptr(ptr) {}
 
 	virtual VariantValue get(const VariantValue& object) const override {
-		bool success = false;
-		const Clazz& ref = object.convertTo<const Clazz&>(&success);
+		return ADescr::get(verifiedObject(object), m_ptr);
+	}
 
-		if (!success) {
-			throw ::std::runtime_error("accessing attribute of an object of a different class");
+	virtual void getBatch(ArgumentView objects, VariantValue* results) const override {
+		// the offset of the Clazz subobject only depends on the type of the value
+		const TypeDescriptor* type = nullptr;
+		::std::ptrdiff_t offset = 0;
+		for (::std::size_t i = 0; i < objects.size(); ++i) {
+			const VariantValue& object = objects[i];
+			if (!object.isValid() || object.typeDescriptor() != type) {
+				const Clazz& ref = verifiedObject(object);
+				type = object.typeDescriptor();
+				offset = reinterpret_cast<const char*>(&ref) - static_cast<const char*>(object.ptrToValue());
+			}
+			results[i] = ADescr::get(*reinterpret_cast<const Clazz*>(static_cast<const char*>(object.ptrToValue()) + offset), m_ptr);
 		}
-		return ADescr::get(ref, m_ptr);
 	}
 
 	virtual void set(bool isConst, const VariantValue& object, const VariantValue& value) const override {
@@ -254,6 +293,23 @@ public:
 	}
 	
 private:
+	// the member is only addressed, the storage is never read
+	static ::std::ptrdiff_t memberOffset(ptr_to_attr ptr) {
+		static typename ::std::aligned_storage<sizeof(Clazz), alignof(Clazz)>::type storage;
+		const Clazz* object = reinterpret_cast<const Clazz*>(&storage);
+		return reinterpret_cast<const char*>(&(object->*ptr)) - reinterpret_cast<const char*>(object);
+	}
+
+	static const Clazz& verifiedObject(const VariantValue& object) {
+		bool success = false;
+		const Clazz& ref = object.convertTo<const Clazz&>(&success);
+
+		if (!success) {
+			throw ::std::runtime_error("accessing attribute of an object of a different class");
+		}
+		return ref;
+	}
+
 	ptr_to_attr m_ptr;
 };
 
@@ -275,6 +331,9 @@ public:
 #ifndef NO_RTTI
 			  , typeid(Type)
 #endif
+			  , type_descriptor<Type>::value
+			  , serial_type<Type>::value
+			  , -1
 			  )
 		, m_ptr(ptr) {}
 
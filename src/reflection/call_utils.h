@@ -5,6 +5,7 @@
 #ifndef CALL_UTILS_H
 #define CALL_UTILS_H
 
+#include "collection_utils.h"
 #include "typelist.h"
 #include "typeutils.h"
 #include "str_conversion.h"
@@ -30,13 +31,63 @@ namespace {
 		}
 	};
 
+	// checks that arg can be passed as a parameter of type T. Arguments of that
+	// type are left as they are, moving them out is left to the call itself
+	template<class T>
+	int verify_argument(const VariantValue& arg, bool* success) {
+		if (arg.isA<T>()) {
+			*success = true;
+		} else {
+			sink(arg.moveValue<T>(success));
+		}
+		return 0;
+	}
+
 	template<class Arguments, std::size_t... I >
-	void verify_call(const ::std::vector<VariantValue>& args) {
+	void verify_call(ArgumentView args) {
 		call_verifier<sizeof...(I)> ver(args.size());
-		sink(args[I].moveValue<typename type_at<Arguments, I>::type>(&ver.success[I])...);
+		sink(verify_argument<typename type_at<Arguments, I>::type>(args[I], &ver.success[I])...);
 		ver.assert_conversion_succeded();
 	}
 
+	// records if the parameter of type T can use the value stored in arg directly
+	template<class T>
+	int prepare_argument(const VariantValue& arg, PreparedArgument& prepared) {
+		typedef typename ::std::remove_reference<T>::type Value;
+		prepared.type = arg.typeDescriptor();
+		prepared.isConst = arg.isConst();
+		prepared.direct = arg.isA<Value&>();
+		prepared.consumed = !::std::is_lvalue_reference<T>::value;
+		prepared.offset = prepared.direct ? reinterpret_cast<const char*>(&arg.value<Value&>()) - reinterpret_cast<const char*>(arg.ptrToValue()) : 0;
+		return 0;
+	}
+
+	template<class Arguments, class Ind>
+	struct argument_preparer;
+
+	template<class Arguments, ::std::size_t... I, template< ::std::size_t...> class Ind>
+	struct argument_preparer<Arguments, Ind<I...>> {
+		static void prepare(ArgumentView args, PreparedArgument* prepared) {
+			call_verifier<sizeof...(I)> ver(args.size());
+			sink(prepare_argument<typename type_at<Arguments, I>::type>(args[I], prepared[I])...);
+		}
+	};
+
+	template<class Arguments>
+	void prepare_arguments(ArgumentView args, PreparedArgument* prepared) {
+		argument_preparer<Arguments, typename make_indices<typelist_size<Arguments>::value>::type>::prepare(args, prepared);
+	}
+
+	// the argument of a prepared call, the types were checked by prepare_argument
+	template<class T>
+	typename VariantValue::converter<T>::type prepared_value(const VariantValue& arg, const PreparedArgument& prepared) {
+		typedef typename ::std::remove_reference<T>::type Value;
+		if (prepared.direct) {
+			return ::std::forward<T>(*reinterpret_cast<Value*>(const_cast<char*>(reinterpret_cast<const char*>(arg.ptrToValue())) + prepared.offset));
+		}
+		return arg.moveValueThrow<T>();
+	}
+
 	template<class Clazz>
 	Clazz& verifyObject(const volatile VariantValue& object, bool methodIsConst) {
 		bool success = false;
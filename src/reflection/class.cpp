@@ -5,14 +5,24 @@
 #include "class.h"
 #include "proxy.h"
 
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <utility>
+
 const std::string& ClassImpl::fullyQualifiedName() const
 {
 	return m_fqn;
 }
 
+Symbol ClassImpl::symbol() const
+{
+	return m_symbol;
+}
+
 const ClassImpl::MethodList& ClassImpl::methods() const
 {
-	return m_methods;
+	return index().methods;
 }
 
 const ClassImpl::ConstructorList& ClassImpl::constructors() const
@@ -22,12 +32,26 @@ const ClassImpl::ConstructorList& ClassImpl::constructors() const
 
 const ClassImpl::ClassList& ClassImpl::superclasses() const
 {
-	return m_superclasses;
+	return index().superclasses;
 }
 
 const ClassImpl::AttributeList& ClassImpl::attributes() const
 {
-	return m_attributes;
+	return index().attributes;
+}
+
+bool ClassImpl::inheritsFrom(const ClassImpl* base) const
+{
+	return findAncestor(base) != nullptr;
+}
+
+int ClassImpl::inheritanceDistance(const ClassImpl* base) const
+{
+	if (base == this) {
+		return 0;
+	}
+	const Ancestor* a = findAncestor(base);
+	return a ? a->distance : -1;
 }
 
 bool ClassImpl::open() const {
@@ -36,8 +60,136 @@ bool ClassImpl::open() const {
 
 void ClassImpl::close() {
 	m_open = false;
+	buildIndex();
+}
+
+namespace {
+
+	std::atomic<unsigned int> hierarchy_generation(0);
+
+	template<class Key>
+	struct KeyLess {
+		typedef std::pair<Symbol, std::size_t> Lookup;
+
+		bool operator()(const Key& key, Symbol name) const {
+			return key.name < name;
+		}
+		bool operator()(Symbol name, const Key& key) const {
+			return name < key.name;
+		}
+		bool operator()(const Key& key, const Lookup& l) const {
+			return key.name < l.first || (key.name == l.first && key.numArgs < l.second);
+		}
+		bool operator()(const Lookup& l, const Key& key) const {
+			return l.first < key.name || (l.first == key.name && l.second < key.numArgs);
+		}
+	};
+
+	template<class T, class K, class Less>
+	void sortedCopy(const std::list<T>& items, std::vector<K>&& keys, std::vector<T>& table, std::vector<K>& sortedKeys, Less less) {
+		std::vector<std::size_t> order;
+		for (std::size_t i = 0; i < keys.size(); ++i) {
+			order.push_back(i);
+		}
+		// stable, so that equal names keep the registration order (own members before inherited ones)
+		std::stable_sort(order.begin(), order.end(), [&](std::size_t i1, std::size_t i2) {
+			return less(keys[i1], keys[i2]);
+		});
+		const std::vector<T> flat(items.begin(), items.end());
+		table.clear();
+		sortedKeys.clear();
+		for (std::size_t i: order) {
+			table.push_back(flat[i]);
+			sortedKeys.push_back(std::move(keys[i]));
+		}
+	}
+}
+
+const ClassImpl::Index& ClassImpl::buildIndex() const
+{
+	std::unique_ptr<Index> index(new Index());
+	index->methods = m_methods;
+	index->attributes = m_attributes;
+	index->superclasses = m_superclasses;
+	index->ancestors = m_ancestors;
+
+	std::vector<MethodKey> methodKeys;
+	for (const Method& m: m_methods) {
+		methodKeys.push_back({ m.symbol(), m.numberOfArguments() });
+	}
+	sortedCopy(index->methods, std::move(methodKeys), index->methodTable, index->methodKeys, [](const MethodKey& k1, const MethodKey& k2) {
+		return k1.name < k2.name || (k1.name == k2.name && k1.numArgs < k2.numArgs);
+	});
+
+	std::vector<Symbol> attributeNames;
+	for (const Attribute& a: m_attributes) {
+		attributeNames.push_back(a.symbol());
+	}
+	sortedCopy(index->attributes, std::move(attributeNames), index->attributeTable, index->attributeNames, std::less<Symbol>());
+
+	if (m_stubCreator != nullptr) {
+		// numbered from 0 for each interface. Rebuilds that add inherited methods keep the
+		// slots handed out so far, stubs remember theirs
+		std::vector<std::pair<std::size_t, std::size_t> > slots;
+		if (!m_indexes.empty()) {
+			slots = m_indexes.back()->proxySlots;
+		}
+		const std::size_t assigned = slots.size();
+		std::hash<Method> hash;
+		for (const Method& m: index->methodTable) {
+			const std::size_t h = hash(m);
+			auto it = std::lower_bound(slots.begin(), slots.begin() + assigned, std::make_pair(h, std::size_t(0)));
+			if (it == slots.begin() + assigned || it->first != h) {
+				slots.emplace_back(h, slots.size());
+			}
+		}
+		std::sort(slots.begin(), slots.end());
+		index->proxySlots = std::move(slots);
+	}
+
+	m_indexes.emplace_back(std::move(index));
+	m_index.store(m_indexes.back().get(), std::memory_order_release);
+	return *m_indexes.back();
 }
 
+const ClassImpl::Index& ClassImpl::index() const
+{
+	const Index* index = m_index.load(std::memory_order_acquire);
+	if (index == nullptr) {
+		// only the thread that registers an open class can see it
+		return buildIndex();
+	}
+	return *index;
+}
+
+Class::MethodRange ClassImpl::methodsNamed(Symbol name) const
+{
+	const Index& index = this->index();
+	auto range = std::equal_range(index.methodKeys.begin(), index.methodKeys.end(), name, KeyLess<MethodKey>());
+	const Method* first = index.methodTable.data();
+	return Class::MethodRange(first + (range.first - index.methodKeys.begin()), first + (range.second - index.methodKeys.begin()));
+}
+
+Class::MethodRange ClassImpl::methodsNamed(Symbol name, std::size_t numArgs) const
+{
+	const Index& index = this->index();
+	auto range = std::equal_range(index.methodKeys.begin(), index.methodKeys.end(), std::make_pair(name, numArgs), KeyLess<MethodKey>());
+	const Method* first = index.methodTable.data();
+	return Class::MethodRange(first + (range.first - index.methodKeys.begin()), first + (range.second - index.methodKeys.begin()));
+}
+
+Attribute ClassImpl::attribute(Symbol name) const
+{
+	const Index& index = this->index();
+	auto it = std::lower_bound(index.attributeNames.begin(), index.attributeNames.end(), name);
+	if (it != index.attributeNames.end() && *it == name) {
+		return index.attributeTable[it - index.attributeNames.begin()];
+	}
+	return Attribute();
+}
+
+constexpr std::size_t ClassImpl::no_proxy_slot;
+
 void ClassImpl::assert_open() const
 {
 	if (!m_open) throw ::std::logic_error("meta-class is already closed for registration");
@@ -45,14 +197,20 @@ void ClassImpl::assert_open() const
 
 
 ClassImpl::ClassImpl()
-	: m_open(true)
+	: m_hasUnresolvedBases(false)
+	, m_open(true)
+	, m_index(nullptr)
 	, m_stubCreator(nullptr)
+	, m_size(0)
+	, m_alignment(0)
+	, m_destructor(nullptr)
 {}
 
 void ClassImpl::setFullyQualifiedName(const ::std::string& fqn)
 {
 	assert_open();
 	m_fqn = fqn;
+	m_symbol = Symbol::intern(fqn);
 }
 
 void ClassImpl::registerMethod(Method m)
@@ -60,6 +218,7 @@ void ClassImpl::registerMethod(Method m)
 	assert_open();
 	m.setClass(this);
 	m_methods.push_back(m);
+	m_index.store(nullptr, std::memory_order_relaxed);
 }
 
 void ClassImpl::registerConstructor(Constructor c)
@@ -74,42 +233,259 @@ void ClassImpl::registerAttribute(Attribute attr)
 	assert_open();
 	attr.setClass(this);
 	m_attributes.push_back(attr);
+	m_index.store(nullptr, std::memory_order_relaxed);
 }
 
 void ClassImpl::registerSuperClass(const char* className)
 {
 	assert_open();
 	m_unresolvedBases.push_back(className);
+	m_hasUnresolvedBases.store(true, std::memory_order_release);
+}
+
+#ifndef NO_RTTI
+void ClassImpl::registerSuperClass(const char* className, const std::type_info& base, bool offsetKnown, int offset)
+{
+	registerSuperClass(className);
+	m_baseOffsets.push_back({ &base, offsetKnown, offset });
+}
+
+bool ClassImpl::baseOffset(const std::type_info& base, int& offset) const
+{
+	Class c = Class::lookup(base);
+	if (c.isValid()) {
+		if (const Ancestor* a = findAncestor(c.m_impl)) {
+			offset = a->offset;
+			return a->offsetKnown;
+		}
+	}
+
+	// base itself is not registered, but it may be a base of a registered base
+	std::vector<int> offsets;
+	bool unknown = false;
+	collectBaseOffsets(base, offsets, unknown);
+	if (unknown || offsets.size() != 1) {
+		// either a virtual base is involved or base is ambiguous
+		return false;
+	}
+	offset = offsets.front();
+	return true;
+}
+
+void ClassImpl::collectBaseOffsets(const std::type_info& base, std::vector<int>& offsets, bool& unknown) const
+{
+	for (const BaseOffset& b : m_baseOffsets) {
+		if (*b.typeInfo == base) {
+			if (b.known) {
+				offsets.push_back(b.offset);
+			} else {
+				unknown = true;
+			}
+		} else {
+			Class c = Class::lookup(*b.typeInfo);
+			if (c.isValid()) {
+				std::vector<int> inner;
+				c.m_impl->collectBaseOffsets(base, inner, unknown);
+				if (!inner.empty() && !b.known) {
+					// the offset of a virtual base depends on the most derived type
+					unknown = true;
+				}
+				for (int o: inner) {
+					offsets.push_back(b.offset + o);
+				}
+			}
+		}
+	}
+}
+
+bool ClassImpl::baseOffset(const std::type_info& derived, const std::type_info& base, int& offset)
+{
+	Class c = Class::lookup(derived);
+	return c.isValid() && c.m_impl->baseOffset(base, offset);
+}
+
+RegisteredConversion ClassImpl::conversion(const std::type_info& derived, const std::type_info& base, int& offset)
+{
+	Class c = Class::lookup(derived);
+	if (!c.isValid()) {
+		return RegisteredConversion::UNKNOWN;
+	}
+	if (c.m_impl->baseOffset(base, offset)) {
+		return RegisteredConversion::OFFSET;
+	}
+	// a registered class that isn't among the ancestors, as far as the registration tells
+	Class b = Class::lookup(base);
+	if (b.isValid() && !c.m_impl->hasUnresolvedBases() && !c.m_impl->inheritsFrom(b.m_impl)) {
+		return RegisteredConversion::IMPOSSIBLE;
+	}
+	return RegisteredConversion::UNKNOWN;
+}
+
+RegisteredConversion registeredConversion(const std::type_info& from, const std::type_info& to, int& offset)
+{
+	return ClassImpl::conversion(from, to, offset);
+}
+#endif
+
+namespace {
+
+	// members and ancestors shared by several bases are only listed once
+	template<class List, class T>
+	void appendMissing(List& list, const T& item) {
+		if (std::find(list.begin(), list.end(), item) == list.end()) {
+			list.push_back(item);
+		}
+	}
 }
 
 void ClassImpl::registerSuperClassInternal(Class c)
 {
-	m_superclasses.push_back(c);
+	// the lists of c already hold what c inherits
+	appendMissing(m_superclasses, c);
+	for (const Class& s: c.superclasses()) {
+		appendMissing(m_superclasses, s);
+	}
 	for (const Method& m : c.methods()) {
-		m_methods.push_back(m);
+		appendMissing(m_methods, m);
 	}
 	for (const Attribute& a: c.attributes()) {
-		m_attributes.push_back(a);
+		appendMissing(m_attributes, a);
+	}
+}
+
+namespace {
+
+	struct AncestorLess {
+		template<class A>
+		bool operator()(const A& a, const ClassImpl* impl) const {
+			return std::less<const ClassImpl*>()(a.impl, impl);
+		}
+	};
+}
+
+void ClassImpl::registerAncestors(const Class& base)
+{
+#ifndef NO_RTTI
+	bool known = false;
+	int offset = 0;
+	for (const BaseOffset& b : m_baseOffsets) {
+		if (*b.typeInfo == base.m_impl->typeId()) {
+			known = b.known;
+			offset = b.offset;
+		}
+	}
+	registerAncestor({ base.m_impl, 1, known, offset });
+	for (const Ancestor& a : base.m_impl->index().ancestors) {
+		registerAncestor({ a.impl, a.distance + 1, known && a.offsetKnown, offset + a.offset });
+	}
+#else
+	registerAncestor({ base.m_impl, 1 });
+	for (const Ancestor& a : base.m_impl->index().ancestors) {
+		registerAncestor({ a.impl, a.distance + 1 });
 	}
-	for(Class s: c.superclasses()) {
-		registerSuperClassInternal(s);
+#endif
+}
+
+void ClassImpl::registerAncestor(const Ancestor& ancestor)
+{
+	auto it = std::lower_bound(m_ancestors.begin(), m_ancestors.end(), ancestor.impl, AncestorLess());
+	if (it == m_ancestors.end() || it->impl != ancestor.impl) {
+		m_ancestors.insert(it, ancestor);
+	} else {
+		it->distance = std::min(it->distance, ancestor.distance);
+#ifndef NO_RTTI
+		// a second path to the same base: a virtual base or an ambiguous one
+		it->offsetKnown = false;
+#endif
 	}
 }
 
+const ClassImpl::Ancestor* ClassImpl::findAncestor(const ClassImpl* impl) const
+{
+	const std::vector<Ancestor>& ancestors = index().ancestors;
+	auto it = std::lower_bound(ancestors.begin(), ancestors.end(), impl, AncestorLess());
+	if (it != ancestors.end() && it->impl == impl) {
+		return &*it;
+	}
+	return nullptr;
+}
+
 bool ClassImpl::hasUnresolvedBases() const
 {
-	return !m_unresolvedBases.empty();
+	return m_hasUnresolvedBases.load(std::memory_order_acquire);
+}
+
+unsigned int ClassImpl::hierarchyGeneration()
+{
+	return hierarchy_generation.load(std::memory_order_acquire);
+}
+
+void ClassImpl::hierarchyChanged()
+{
+	hierarchy_generation.fetch_add(1, std::memory_order_release);
 }
 
 void ClassImpl::resolveBases()
 {
-	for (auto it = m_unresolvedBases.begin(); it!= m_unresolvedBases.end(); ++it) {
+	if (!hasUnresolvedBases()) {
+		return;
+	}
+	// handles of the class can be created in several threads at once. Looking up
+	// the bases creates handles of other classes, hence the recursive mutex
+	static std::recursive_mutex mutex;
+	std::lock_guard<std::recursive_mutex> lock(mutex);
+
+	bool resolved = false;
+	for (auto it = m_unresolvedBases.begin(); it!= m_unresolvedBases.end(); ) {
 		Class c = Class::lookup(*it);
 		if (c.isValid()) {
 			it = m_unresolvedBases.erase(it);
 			registerSuperClassInternal(c);
+			registerAncestors(c);
+			resolved = true;
+		} else {
+			++it;
+		}
+	}
+	if (resolved) {
+		// a new index for the inherited members, the old one stays valid for ranges taken from it
+		if (m_open) {
+			m_index.store(nullptr, std::memory_order_relaxed);
+		} else {
+			buildIndex();
 		}
 	}
+	m_hasUnresolvedBases.store(!m_unresolvedBases.empty(), std::memory_order_release);
+	if (resolved) {
+		// after the new ancestors are published
+		hierarchyChanged();
+	}
+}
+
+void ClassImpl::setLayout(::std::size_t size, ::std::size_t alignment, ClassDestructor destructor)
+{
+	assert_open();
+	m_size = size;
+	m_alignment = alignment;
+	m_destructor = destructor;
+}
+
+::std::size_t ClassImpl::sizeOf() const
+{
+	return m_size;
+}
+
+::std::size_t ClassImpl::alignOf() const
+{
+	return m_alignment;
+}
+
+void ClassImpl::destroyAt(void* object) const
+{
+	if (m_destructor == nullptr) {
+		throw ::std::runtime_error("Class " + m_fqn + " has no accessible destructor");
+	}
+	m_destructor(object);
 }
 
 #ifndef NO_RTTI
@@ -139,7 +515,24 @@ VariantValue ClassImpl::newInterface(std::shared_ptr<ProxyImpl>& proxyImpl) cons
 
 void ClassImpl::registerInterface(StubCreator sc)
 {
+	assert_open();
 	m_stubCreator = sc;
+	m_index.store(nullptr, std::memory_order_relaxed);
+}
+
+std::size_t ClassImpl::proxySlot(std::size_t method_hash) const
+{
+	const Index& index = this->index();
+	auto it = std::lower_bound(index.proxySlots.begin(), index.proxySlots.end(), std::make_pair(method_hash, std::size_t(0)));
+	if (it == index.proxySlots.end() || it->first != method_hash) {
+		return no_proxy_slot;
+	}
+	return it->second;
+}
+
+std::size_t ClassImpl::proxySlotCount() const
+{
+	return index().proxySlots.size();
 }
 
 #endif
@@ -6,6 +6,7 @@
 #define CLASS_H
 
 #include <algorithm>
+#include <atomic>
 #include <string>
 #include <list>
 #include <memory>
@@ -14,6 +15,7 @@
 #endif
 #include <type_traits>
 #include <stdexcept>
+#include <vector>
 
 #include "variant.h"
 
@@ -23,6 +25,64 @@ class ProxyImpl;
 
 typedef VariantValue (*StubCreator)(std::shared_ptr<ProxyImpl>&);
 
+typedef void (*ClassDestructor)(void* object);
+
+namespace {
+
+	/** Computes the offset of the Base subobject inside a Derived object.
+	 *  The offset can only be determined statically if Base is an accessible,
+	 *  unambiguous, non-virtual base of Derived. This is checked by converting
+	 *  a pointer to member of Base to a pointer to member of Derived, which is
+	 *  ill-formed in all other cases.
+	 */
+	template<class Derived, class Base>
+	class base_offset {
+
+		template<class D, class B>
+		static auto test(int) -> decltype(static_cast<char D::*>(::std::declval<char B::*>()), ::std::true_type());
+
+		template<class D, class B>
+		static ::std::false_type test(...);
+
+		template<class Dummy, bool OK>
+		struct OffsetHelper {
+			static int value() {
+				typename ::std::aligned_storage<sizeof(Derived), alignof(Derived)>::type storage;
+				Derived* derived = reinterpret_cast<Derived*>(&storage);
+				return reinterpret_cast<char*>(static_cast<Base*>(derived)) - reinterpret_cast<char*>(derived);
+			}
+		};
+
+		template<class Dummy>
+		struct OffsetHelper<Dummy, false> {
+			static int value() { return 0; }
+		};
+
+	public:
+		enum { known = decltype(test<Derived, Base>(0))::value };
+
+		static int value() {
+			return OffsetHelper<Derived, known>::value();
+		}
+	};
+
+	// the destructor of T called on an object built with placement new, nullptr if it isn't accessible
+	template<class T, bool Destructible = ::std::is_destructible<T>::value>
+	struct class_destructor {
+		static void destroy(void* object) {
+			static_cast<T*>(object)->~T();
+		}
+
+		static ClassDestructor value() { return &destroy; }
+	};
+
+	template<class T>
+	struct class_destructor<T, false> {
+		static ClassDestructor value() { return nullptr; }
+	};
+
+}
+
 class ClassImpl: public Annotated {
 public:
 	typedef Class::MethodList MethodList;
@@ -31,6 +91,8 @@ public:
 	typedef Class::AttributeList AttributeList;
 		
 	const std::string& fullyQualifiedName() const;
+
+	Symbol symbol() const;
 	
 	const MethodList& methods() const;
 	
@@ -40,12 +102,42 @@ public:
 	
 	const AttributeList& attributes() const;
 
+	/** whether base is a direct or indirect superclass, a search in the ancestor table */
+	bool inheritsFrom(const ClassImpl* base) const;
+
+	// derivation steps on the shortest path to base, -1 if base is no ancestor
+	int inheritanceDistance(const ClassImpl* base) const;
+
+	/** lookups in the name indexes, which are built when the class is closed.
+	 *  While the class is open they are built on demand */
+	Class::MethodRange methodsNamed(Symbol name) const;
+	Class::MethodRange methodsNamed(Symbol name, ::std::size_t numArgs) const;
+	Attribute attribute(Symbol name) const;
+
 	void registerSuperClass(const char* className);
 
+#ifndef NO_RTTI
+	void registerSuperClass(const char* className, const ::std::type_info& base, bool offsetKnown, int offset);
+
+	/** looks up the offset of the (direct or indirect) base class 'base' inside
+	 *  an instance of this class. Returns false if the offset isn't known, either
+	 *  because 'base' is no registered superclass or because it is a virtual base */
+	bool baseOffset(const ::std::type_info& base, int& offset) const;
+
+	static bool baseOffset(const ::std::type_info& derived, const ::std::type_info& base, int& offset);
+
+	static RegisteredConversion conversion(const ::std::type_info& derived, const ::std::type_info& base, int& offset);
+#endif
+
 	void resolveBases();
 
 	bool hasUnresolvedBases() const;
 
+	/** changes whenever a class is registered or a base is resolved, so that
+	 *  decisions taken from the classes can tell they may be outdated */
+	static unsigned int hierarchyGeneration();
+	static void hierarchyChanged();
+
 	bool open() const;
 
 	void close();
@@ -80,23 +172,111 @@ public:
 
 	void registerInterface(StubCreator c);
 
+	/** the slot of the handler of a method among those of this interface, from
+	 *  0 to proxySlotCount(), or no_proxy_slot. The slots of an interface are
+	 *  assigned when its index is built, lookups don't lock */
+	::std::size_t proxySlot(::std::size_t method_hash) const;
+
+	::std::size_t proxySlotCount() const;
+
+	static constexpr ::std::size_t no_proxy_slot = static_cast< ::std::size_t>(-1);
+
+	void setLayout(::std::size_t size, ::std::size_t alignment, ClassDestructor destructor);
+
+	::std::size_t sizeOf() const;
+
+	::std::size_t alignOf() const;
+
+	void destroyAt(void* object) const;
+
 private:
 
 	void registerSuperClassInternal(Class c);
 
+	struct Ancestor {
+		const ClassImpl* impl;
+		// 1 for direct bases
+		int distance;
+#ifndef NO_RTTI
+		// false for virtual bases and for bases reachable on several paths
+		bool offsetKnown;
+		int offset;
+#endif
+	};
+
+	// adds base and all of its ancestors to m_ancestors
+	void registerAncestors(const Class& base);
+
+	void registerAncestor(const Ancestor& ancestor);
+
+	const Ancestor* findAncestor(const ClassImpl* impl) const;
+
+#ifndef NO_RTTI
+	void collectBaseOffsets(const ::std::type_info& base, ::std::vector<int>& offsets, bool& unknown) const;
+
+	struct BaseOffset {
+		const ::std::type_info* typeInfo;
+		bool known;
+		int offset;
+	};
+#endif
+
+	struct MethodKey {
+		Symbol name;
+		::std::size_t numArgs;
+	};
+
+	/** The members as readers see them. m_methods, m_attributes, m_superclasses
+	 *  and m_ancestors are only changed by registration and by resolveBases, which
+	 *  then publish a new snapshot. The tables are flat copies of the methods and
+	 *  attributes sorted by symbol id (and arity), with the keys kept apart */
+	struct Index {
+		MethodList methods;
+		AttributeList attributes;
+		ClassList superclasses;
+		::std::vector<Ancestor> ancestors;
+		::std::vector<Method> methodTable;
+		::std::vector<MethodKey> methodKeys;
+		::std::vector<Attribute> attributeTable;
+		::std::vector<Symbol> attributeNames;
+		// method hashes and their proxy slots sorted by hash, only for interfaces
+		::std::vector< ::std::pair< ::std::size_t, ::std::size_t> > proxySlots;
+	};
+
+	const Index& index() const;
+
+	// builds an index of the current members and publishes it
+	const Index& buildIndex() const;
+
 	void assert_open() const;
 	::std::string m_fqn = "error, meta-class uninitialized";
+	Symbol m_symbol;
 	MethodList m_methods;
 	ConstructorList m_constructors;
 	std::list<const char*> m_unresolvedBases;
+	// Class handles resolve the bases when they are created, this keeps it cheap once they are resolved
+	::std::atomic<bool> m_hasUnresolvedBases;
 	ClassList m_superclasses;
+	// every resolved superclass once, sorted by address, so subclass tests are a binary search
+	::std::vector<Ancestor> m_ancestors;
 	AttributeList m_attributes;
 	bool m_open;
 
+	// nullptr while the index of an open class is out of date. A published index is never
+	// changed, it is replaced when late bases bring new members, so ranges into it stay valid
+	mutable ::std::atomic<const Index*> m_index;
+	// every index ever published, they live as long as the class
+	mutable ::std::vector< ::std::unique_ptr<const Index> > m_indexes;
+
 	StubCreator m_stubCreator;
 
+	::std::size_t m_size;
+	::std::size_t m_alignment;
+	ClassDestructor m_destructor;
+
 #ifndef NO_RTTI
 	const std::type_info* m_typeInfo;
+	::std::vector<BaseOffset> m_baseOffsets;
 #endif
 
 };
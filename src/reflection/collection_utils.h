@@ -6,8 +6,57 @@
 #define COLL_UTILS_H
 
 #include "variant.h"
+#include <array>
+#include <cstddef>
 #include <vector>
 
+/** Non owning view of a contiguous sequence of arguments.
+ *
+ *  Calls take their arguments as a pointer and a length so that callers are
+ *  free to keep them in a std::vector, a std::array or a plain array on the
+ *  stack. The view does not extend the lifetime of the arguments.
+ */
+class ArgumentView {
+public:
+	typedef const VariantValue* const_iterator;
+
+	ArgumentView() : m_data(nullptr), m_size(0) {}
+	ArgumentView(const VariantValue* data, ::std::size_t size) : m_data(data), m_size(size) {}
+	ArgumentView(const ::std::vector<VariantValue>& args) : m_data(args.data()), m_size(args.size()) {}
+
+	template< ::std::size_t N>
+	ArgumentView(const ::std::array<VariantValue, N>& args) : m_data(args.data()), m_size(N) {}
+
+	const VariantValue& operator[](::std::size_t i) const { return m_data[i]; }
+
+	::std::size_t size() const { return m_size; }
+	bool empty() const { return m_size == 0; }
+
+	const_iterator begin() const { return m_data; }
+	const_iterator end() const { return m_data + m_size; }
+
+private:
+	const VariantValue* m_data;
+	::std::size_t m_size;
+};
+
+/** How an argument of a prepared call is accessed. Recorded once by
+ *  Method::bind and Function::prepare for the types of the sample arguments */
+struct PreparedArgument {
+	const TypeDescriptor* type; // type of the sample argument
+	bool isConst;
+	bool direct; // the parameter refers to the stored value (adjusted by offset), otherwise it's converted
+	bool consumed; // the parameter is passed by value and may be moved from the argument
+	int offset;
+};
+
+// builds the arguments of a call in place, std::array<T, 0> is fine so no special case for empty calls
+template<class... T>
+inline ::std::array<VariantValue, sizeof...(T)> make_arguments(T&&... t)
+{
+	return ::std::array<VariantValue, sizeof...(T)>{{ VariantValue(t)... }};
+}
+
 inline void emplace(std::vector<VariantValue>& v )
 {
 	// nothing to do
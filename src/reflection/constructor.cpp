@@ -6,6 +6,7 @@
 
 ConstructorImpl::ConstructorImpl(
 		boundcons c
+		, placementcons pc
 		, int numArgs
 		, const char* argSpellings
 #ifndef NO_RTTI
@@ -13,11 +14,14 @@ ConstructorImpl::ConstructorImpl(
 #endif
 		)
 	: m_numArgs(numArgs)
-	, m_argSpellings(argSpellings)
+	, m_signature(argSpellings
+		, CallableSignature::UNQUALIFIED
 #ifndef NO_RTTI
-	, m_argumentTypes(argumentTypes)
+		, ::std::move(argumentTypes)
 #endif
+		)
 	, m_c(c)
+	, m_pc(pc)
 {}
 
 ::std::size_t ConstructorImpl::numberOfArguments() const
@@ -25,20 +29,30 @@ ConstructorImpl::ConstructorImpl(
 	return m_numArgs;
 }
 
-::std::vector< ::std::string> ConstructorImpl::argumentSpellings() const
+const ::std::vector< ::std::string>& ConstructorImpl::argumentSpellings() const
+{
+	return m_signature.argumentSpellings();
+}
+
+::std::size_t ConstructorImpl::signatureHash() const
 {
-	return splitArgs(m_argSpellings);
+	return m_signature.hash();
 }
 
-VariantValue ConstructorImpl::call(const ::std::vector<VariantValue>& args) const
+VariantValue ConstructorImpl::call(ArgumentView args) const
 {
 	return m_c(args);
 }
 
+void ConstructorImpl::constructAt(void* storage, ArgumentView args) const
+{
+	m_pc(storage, args);
+}
+
 
 #ifndef NO_RTTI
-::std::vector<const ::std::type_info*> ConstructorImpl::argumentTypes() const
+const ::std::vector<const ::std::type_info*>& ConstructorImpl::argumentTypes() const
 {
-	return m_argumentTypes;
+	return m_signature.argumentTypes();
 }
 #endif
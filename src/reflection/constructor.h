@@ -9,11 +9,14 @@
 #include "variant.h"
 #include <tuple>
 #include <array>
+#include <new>
 #include "reflection.h"
+#include "signature.h"
 #include "str_utils.h"
 #include "call_utils.h"
 
-typedef VariantValue (*boundcons)(const ::std::vector<VariantValue>& args);
+typedef VariantValue (*boundcons)(ArgumentView args);
+typedef void (*placementcons)(void* storage, ArgumentView args);
 #include <iostream>
 using namespace std;
 namespace {
@@ -29,23 +32,38 @@ struct constructor_type {
 
 	template<class Ind>
 	struct call_helper<true, Ind> {
-		static VariantValue call(const ::std::vector<VariantValue>& args) {
+		static VariantValue call(ArgumentView args) {
+			throw ::std::runtime_error("Class declares pure virtual members or has a private destructor");
+		}
+
+		static void constructAt(void* storage, ArgumentView args) {
 			throw ::std::runtime_error("Class declares pure virtual members or has a private destructor");
 		}
 	};
 
 	template< ::std::size_t... I, template< ::std::size_t...> class Ind>
 	struct call_helper<false, Ind<I...>> {
-		static VariantValue call(const ::std::vector<VariantValue>& args) {
+		static VariantValue call(ArgumentView args) {
 			verify_call<Arguments, I...>(args);
 			VariantValue ret;
 			ret.construct<Clazz>(args[I].moveValue<typename type_at<Arguments, I>::type>()...);
 			return ret;
 		}
+
+		static void constructAt(void* storage, ArgumentView args) {
+			verify_call<Arguments, I...>(args);
+			new (storage) Clazz(args[I].moveValue<typename type_at<Arguments, I>::type>()...);
+		}
 	};
 
-	static VariantValue bindcall(const ::std::vector<VariantValue>& args) {
-		return call_helper< ::std::is_abstract<Clazz>::value || !::std::is_destructible<Clazz>::value, typename make_indices<sizeof...(Args)>::type>::call(args);
+	typedef call_helper< ::std::is_abstract<Clazz>::value || !::std::is_destructible<Clazz>::value, typename make_indices<sizeof...(Args)>::type> helper;
+
+	static VariantValue bindcall(ArgumentView args) {
+		return helper::call(args);
+	}
+
+	static void bindconstructat(void* storage, ArgumentView args) {
+		helper::constructAt(storage, args);
 	}
 };
 
@@ -56,6 +74,7 @@ public:
 
 	ConstructorImpl(
 			boundcons c
+			, placementcons pc
 			, int numArgs
 			, const char* argSpellings
 #ifndef NO_RTTI
@@ -65,21 +84,22 @@ public:
 
 	::std::size_t numberOfArguments() const;
 
-	::std::vector< ::std::string> argumentSpellings() const;
+	const ::std::vector< ::std::string>& argumentSpellings() const;
 
-	VariantValue call(const ::std::vector<VariantValue>& args) const;
+	::std::size_t signatureHash() const;
 
+	VariantValue call(ArgumentView args) const;
+
+	void constructAt(void* storage, ArgumentView args) const;
 
 #ifndef NO_RTTI
-	::std::vector<const ::std::type_info*> argumentTypes() const;
+	const ::std::vector<const ::std::type_info*>& argumentTypes() const;
 #endif
 private:
-	const char* m_argSpellings;
 	unsigned int m_numArgs;
-#ifndef NO_RTTI
-	::std::vector<const ::std::type_info*> m_argumentTypes;
-#endif
+	const CallableSignature m_signature;
 	boundcons m_c;
+	placementcons m_pc;
 };
 
 namespace {
@@ -89,6 +109,7 @@ Constructor make_constructor(const char* argString) {
 	typedef TypeList<Args...> Arguments;
 	static ConstructorImpl impl(
 				&constructor_type<Clazz, Args...>::bindcall
+				, &constructor_type<Clazz, Args...>::bindconstructat
 				, sizeof...(Args)
 				, argString
 #ifndef NO_RTTI
@@ -6,10 +6,21 @@
 #define CONVERSION_CACHE
 
 #include <typeinfo>
-#include <typeindex>
-#include <unordered_map>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
 
-/** This cache keeps track of the dynamic_cast that can be done */
+/** This cache keeps track of the dynamic_cast that can be done
+ *
+ *  Lookups are wait-free: the cache is an open addressed hash table keyed
+ *  by the address of the type_info. A slot is published by storing its key
+ *  after its value, so a reader that sees the key also sees the value.
+ *  Insertions are rare and serialized by a mutex. When the table gets too
+ *  full it is copied into a bigger one, the old table is kept alive until
+ *  the cache is destroyed because readers might still be using it.
+ */
 
 template<class To>
 class conversion_cache {
@@ -22,31 +33,97 @@ public:
 
 	bool conversionKnown(const std::type_info& from, int& ptrOffset, bool &possible) const
 	{
-		auto it = m_cache.find(from);
-		if (it != m_cache.end()) {
-			const entry& e = it->second;
-			ptrOffset = e.ptrOffset;
-			possible = e.possible;
-			return true;
+		const table* t = m_table.load(std::memory_order_acquire);
+		for (std::size_t i = hash(&from) & t->mask; ; i = (i + 1) & t->mask) {
+			const std::type_info* key = t->slots[i].key.load(std::memory_order_acquire);
+			if (key == &from) {
+				const int value = t->slots[i].value.load(std::memory_order_relaxed);
+				possible = (value & 1) != 0;
+				ptrOffset = possible ? (value - 1) / 2 : 0;
+				return true;
+			} else if (key == nullptr) {
+				return false;
+			}
 		}
-		return false;
 	}
 
 	void registerConversion(const std::type_info& from, int ptrOffset, bool possible)
 	{
-		m_cache[from] = { possible, ptrOffset };
+		std::lock_guard<std::mutex> lock(m_mutex);
+		table* t = m_table.load(std::memory_order_relaxed);
+		if (2 * (t->used + 1) > t->mask + 1) {
+			t = grow(t);
+		}
+		insert(t, &from, possible ? ptrOffset * 2 + 1 : 0);
 	}
 
+	conversion_cache(const conversion_cache&) = delete;
+	conversion_cache& operator=(const conversion_cache&) = delete;
+
 private:
 
-	struct entry {
-		bool possible;
-		int ptrOffset;
+	enum { initial_size = 16 };
+
+	struct slot {
+		std::atomic<const std::type_info*> key;
+		std::atomic<int> value;
+	};
+
+	struct table {
+		explicit table(std::size_t size) : mask(size - 1), used(0), slots(new slot[size]) {
+			for (std::size_t i = 0; i < size; ++i) {
+				slots[i].key.store(nullptr, std::memory_order_relaxed);
+				slots[i].value.store(0, std::memory_order_relaxed);
+			}
+		}
+		const std::size_t mask;
+		std::size_t used;
+		std::unique_ptr<slot[]> slots;
 	};
 
-	typedef std::unordered_map<std::type_index, entry> cache_t;
+	conversion_cache() {
+		m_tables.emplace_back(new table(initial_size));
+		m_table.store(m_tables.back().get(), std::memory_order_release);
+	}
+
+	static std::size_t hash(const std::type_info* key) {
+		// type_info objects are at least pointer aligned, the low bits carry no information
+		const std::uint64_t h = static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(key) >> 3) * 0x9E3779B97F4A7C15ull;
+		return static_cast<std::size_t>(h >> 32);
+	}
+
+	static void insert(table* t, const std::type_info* key, int value) {
+		for (std::size_t i = hash(key) & t->mask; ; i = (i + 1) & t->mask) {
+			const std::type_info* k = t->slots[i].key.load(std::memory_order_relaxed);
+			if (k == key) {
+				return; // already published, the result can't change
+			} else if (k == nullptr) {
+				t->slots[i].value.store(value, std::memory_order_relaxed);
+				t->slots[i].key.store(key, std::memory_order_release);
+				++t->used;
+				return;
+			}
+		}
+	}
+
+	table* grow(table* old) {
+		table* t = new table(2 * (old->mask + 1));
+		m_tables.emplace_back(t);
+		for (std::size_t i = 0; i <= old->mask; ++i) {
+			const std::type_info* key = old->slots[i].key.load(std::memory_order_relaxed);
+			if (key != nullptr) {
+				insert(t, key, old->slots[i].value.load(std::memory_order_relaxed));
+			}
+		}
+		m_table.store(t, std::memory_order_release);
+		return t;
+	}
+
+	std::atomic<table*> m_table;
 
-	cache_t m_cache;
+	// all tables ever published, guarded by m_mutex
+	std::vector<std::unique_ptr<table>> m_tables;
+	std::mutex m_mutex;
 };
 
 #endif /* CONVERSION_CACHE */
@@ -15,16 +15,24 @@ FunctionImpl::FunctionImpl(
 		, const ::std::type_info& returnType
 		, ::std::vector<const ::std::type_info*> argumentTypes
 #endif
+		, preparefunction prepare
+		, preparedcall prepared
 		)
 	: m_name(name)
 	, m_returnSpelling(returnSpelling)
 	, m_numArgs(numArgs)
-	, m_argSpellings(argSpellings)
 #ifndef NO_RTTI
 	, m_returnType(returnType)
-	, m_argumentTypes(argumentTypes)
 #endif
+	, m_signature(argSpellings
+		, CallableSignature::UNQUALIFIED
+#ifndef NO_RTTI
+		, ::std::move(argumentTypes)
+#endif
+		)
 	, m_f(f)
+	, m_prepare(prepare)
+	, m_prepared(prepared)
 {}
 
 FunctionImpl::~FunctionImpl()
@@ -45,9 +53,14 @@ FunctionImpl::~FunctionImpl()
 	return normalizedTypeName(m_returnSpelling);
 }
 
-::std::vector< ::std::string> FunctionImpl::argumentSpellings() const
+const ::std::vector< ::std::string>& FunctionImpl::argumentSpellings() const
+{
+	return m_signature.argumentSpellings();
+}
+
+::std::size_t FunctionImpl::signatureHash() const
 {
-	return splitArgs(m_argSpellings);
+	return m_signature.hash();
 }
 
 #ifndef NO_RTTI
@@ -56,13 +69,23 @@ const ::std::type_info& FunctionImpl::returnType() const
 	return m_returnType;
 }
 
-::std::vector<const ::std::type_info*> FunctionImpl::argumentTypes() const
+const ::std::vector<const ::std::type_info*>& FunctionImpl::argumentTypes() const
 {
-	return m_argumentTypes;
+	return m_signature.argumentTypes();
 }
 #endif
 
-VariantValue FunctionImpl::call(const ::std::vector<VariantValue>& args) const
+VariantValue FunctionImpl::call(ArgumentView args) const
 {
 	return m_f(args);
 }
+
+preparedcall FunctionImpl::preparedCall() const
+{
+	return m_prepare != nullptr ? m_prepared : nullptr;
+}
+
+void FunctionImpl::prepare(ArgumentView args, PreparedArgument* prepared) const
+{
+	m_prepare(args, prepared);
+}
@@ -18,6 +18,7 @@
 #include "typelist.h"
 #include "variant.h"
 #include "str_conversion.h"
+#include "signature.h"
 #include "str_utils.h"
 #include "call_utils.h"
 
@@ -39,27 +40,47 @@ struct function_type<_Result(*)(Args...)> {
 
 	template<class R, ::std::size_t... I, template< ::std::size_t...> class Ind>
 	struct call_helper<R, Ind<I...>> {
-		static VariantValue call(ptr_to_function ptr, const ::std::vector<VariantValue>& args) {
+		static VariantValue call(ptr_to_function ptr, ArgumentView args) {
 			VariantValue ret;
 			verify_call<Arguments, I...>(args);
 			ret.construct<R>(ptr(args[I].moveValue<typename type_at<Arguments, I>::type>()...));
 			return ret;
 		}
+
+		static VariantValue callPrepared(ptr_to_function ptr, ArgumentView args, const PreparedArgument* prepared) {
+			VariantValue ret;
+			ret.construct<R>(ptr(prepared_value<typename type_at<Arguments, I>::type>(args[I], prepared[I])...));
+			return ret;
+		}
 	};
 	
 	template< ::std::size_t... I, template< ::std::size_t...> class Ind>
 	struct call_helper<void, Ind<I...>> {
-		static VariantValue call(ptr_to_function ptr, const ::std::vector<VariantValue>& args) {
+		static VariantValue call(ptr_to_function ptr, ArgumentView args) {
 			verify_call<Arguments, I...>(args);
 			ptr(args[I].moveValue<typename type_at<Arguments, I>::type>()...);
 			return VariantValue();
 		}
+
+		static VariantValue callPrepared(ptr_to_function ptr, ArgumentView args, const PreparedArgument* prepared) {
+			ptr(prepared_value<typename type_at<Arguments, I>::type>(args[I], prepared[I])...);
+			return VariantValue();
+		}
 	};
 
 	template <_Result(*ptr)(Args...)>
-	static VariantValue bindcall(const ::std::vector<VariantValue>& args) {
+	static VariantValue bindcall(ArgumentView args) {
 		return call_helper<Result, typename make_indices<sizeof...(Args)>::type>::call(ptr, args);
 	}
+
+	template <_Result(*ptr)(Args...)>
+	static VariantValue callprepared(void*, ArgumentView args, const PreparedArgument* prepared) {
+		return call_helper<Result, typename make_indices<sizeof...(Args)>::type>::callPrepared(ptr, args, prepared);
+	}
+
+	static void prepare(ArgumentView args, PreparedArgument* prepared) {
+		prepare_arguments<Arguments>(args, prepared);
+	}
 };
 
 }
@@ -78,6 +99,8 @@ public:
 			, const ::std::type_info& returnType
 			, ::std::vector<const ::std::type_info*> argumentTypes
 #endif
+			, preparefunction prepare = nullptr
+			, preparedcall prepared = nullptr
 			);
 
 	~FunctionImpl();
@@ -85,13 +108,18 @@ public:
 	::std::string name() const;
 	::std::size_t numberOfArguments() const;
 	::std::string returnTypeSpelling() const;
-	::std::vector< ::std::string> argumentSpellings() const;
+	const ::std::vector< ::std::string>& argumentSpellings() const;
+	::std::size_t signatureHash() const;
 #ifndef NO_RTTI
 	const ::std::type_info& returnType() const;
-	::std::vector<const ::std::type_info*> argumentTypes() const;
+	const ::std::vector<const ::std::type_info*>& argumentTypes() const;
 #endif
 
-	VariantValue call(const ::std::vector<VariantValue>& args) const;
+	VariantValue call(ArgumentView args) const;
+
+	// nullptr if the function was registered without prepared call support
+	preparedcall preparedCall() const;
+	void prepare(ArgumentView args, PreparedArgument* prepared) const;
 	
 	FunctionImpl(const FunctionImpl&) = delete;
 	FunctionImpl(FunctionImpl&&) = delete;
@@ -101,19 +129,20 @@ public:
 	const char* const m_name;
 	const char* const m_returnSpelling;
 	const unsigned int m_numArgs;
-	const char* const m_argSpellings;
 
 #ifndef NO_RTTI
 	const ::std::type_info& m_returnType;
-	const ::std::vector<const ::std::type_info*> m_argumentTypes;
 #endif
+	const CallableSignature m_signature;
 	const boundfunction m_f;
+	const preparefunction m_prepare;
+	const preparedcall m_prepared;
 };
 
 
 
 template<class FuncPtr>
-Function make_function(boundfunction f, const char* name, const char* resultString, const char* argString)
+Function make_function(boundfunction f, const char* name, const char* resultString, const char* argString, preparedcall prepared)
 {
 	typedef function_type<FuncPtr> FDescr;
 	typedef typename FDescr::Arguments Arguments;
@@ -129,10 +158,18 @@ Function make_function(boundfunction f, const char* name, const char* resultStri
 				, typeid(Result)
 				, get_typeinfo<Arguments>()
 #endif
+				, prepared ? &FDescr::prepare : nullptr
+				, prepared
 				);
 	return &impl;
 }
 
+template<class FuncPtr>
+Function make_function(boundfunction f, const char* name, const char* resultString, const char* argString)
+{
+	return make_function<FuncPtr>(f, name, resultString, argString, nullptr);
+}
+
 
 
 #endif /* FUNCTION_H */
@@ -17,19 +17,28 @@ MethodImpl::MethodImpl(
 		, const ::std::type_info& returnType
 		, ::std::vector<const ::std::type_info*> argumentTypes
 #endif
+		, preparemethod prepare
+		, preparedcall prepared
 		)
 	: m_method(m)
 	, m_name(name)
+	, m_symbol(Symbol::intern(name))
 	, m_returnSpelling(returnSpelling)
-	, m_argSpellings(argSpellings)
 	, m_numArgs(numArguments)
 	, m_isConst(isConst)
 	, m_isVolatile(isVolatile)
 	, m_isStatic(isStatic)
 #ifndef NO_RTTI
 	, m_returnType(returnType)
-	, m_argumentTypes(argumentTypes)
 #endif
+	, m_signature(argSpellings
+		, (isConst ? CallableSignature::CONST_QUALIFIED : 0) | (isVolatile ? CallableSignature::VOLATILE_QUALIFIED : 0)
+#ifndef NO_RTTI
+		, ::std::move(argumentTypes)
+#endif
+		)
+	, m_prepare(prepare)
+	, m_prepared(prepared)
 {}
 
 
@@ -38,14 +47,24 @@ const char* MethodImpl::name() const
 	return m_name;
 }
 
+Symbol MethodImpl::symbol() const
+{
+	return m_symbol;
+}
+
 ::std::size_t MethodImpl::numberOfArguments() const
 {
 	return m_numArgs;
 }
 
-::std::vector< ::std::string> MethodImpl::argumentSpellings() const
+const ::std::vector< ::std::string>& MethodImpl::argumentSpellings() const
+{
+	return m_signature.argumentSpellings();
+}
+
+::std::size_t MethodImpl::signatureHash() const
 {
-	return splitArgs(m_argSpellings);
+	return m_signature.hash();
 }
 
 ::std::string MethodImpl::returnTypeSpelling() const
@@ -74,14 +93,14 @@ const ::std::type_info& MethodImpl::returnType() const
 	return m_returnType;
 }
 
-::std::vector<const ::std::type_info*> MethodImpl::argumentTypes() const
+const ::std::vector<const ::std::type_info*>& MethodImpl::argumentTypes() const
 {
-	return m_argumentTypes;
+	return m_signature.argumentTypes();
 }
 #endif
 
 
-VariantValue MethodImpl::call(const ::std::vector<VariantValue>& args) const
+VariantValue MethodImpl::call(ArgumentView args) const
 {
 	if (args.size() < m_numArgs) {
 		throw ::std::runtime_error("function or constructor called with insufficient number of arguments");
@@ -93,7 +112,7 @@ VariantValue MethodImpl::call(const ::std::vector<VariantValue>& args) const
 	return m_method(v, args);
 }
 
-VariantValue MethodImpl::call(VariantValue& object, const ::std::vector<VariantValue>& args) const
+VariantValue MethodImpl::call(VariantValue& object, ArgumentView args) const
 {
 	if (args.size() < m_numArgs) {
 		throw ::std::runtime_error("function or constructor called with insufficient number of arguments");
@@ -101,7 +120,7 @@ VariantValue MethodImpl::call(VariantValue& object, const ::std::vector<VariantV
 	return m_method(object, args);
 }
 
-VariantValue MethodImpl::call(const VariantValue& object, const ::std::vector<VariantValue>& args) const
+VariantValue MethodImpl::call(const VariantValue& object, ArgumentView args) const
 {
 	if (args.size() < m_numArgs) {
 		throw ::std::runtime_error("function or constructor called with insufficient number of arguments");
@@ -112,7 +131,7 @@ VariantValue MethodImpl::call(const VariantValue& object, const ::std::vector<Va
 	return m_method(object, args);
 }
 
-VariantValue MethodImpl::call(volatile VariantValue& object, const ::std::vector<VariantValue>& args) const
+VariantValue MethodImpl::call(volatile VariantValue& object, ArgumentView args) const
 {
 	if (args.size() < m_numArgs) {
 		throw ::std::runtime_error("function or constructor called with insufficient number of arguments");
@@ -123,7 +142,7 @@ VariantValue MethodImpl::call(volatile VariantValue& object, const ::std::vector
 	return m_method(object, args);
 }
 
-VariantValue MethodImpl::call(const volatile VariantValue& object, const ::std::vector<VariantValue>& args) const
+VariantValue MethodImpl::call(const volatile VariantValue& object, ArgumentView args) const
 {
 	if (args.size() < m_numArgs) {
 		throw ::std::runtime_error("function or constructor called with insufficient number of arguments");
@@ -136,3 +155,16 @@ VariantValue MethodImpl::call(const volatile VariantValue& object, const ::std::
 	}
 	return m_method(object, args);
 }
+
+preparedcall MethodImpl::preparedCall() const
+{
+	return m_prepare != nullptr ? m_prepared : nullptr;
+}
+
+int MethodImpl::prepare(const volatile VariantValue& object, ArgumentView args, PreparedArgument* prepared) const
+{
+	if (args.size() < m_numArgs) {
+		throw ::std::runtime_error("function or constructor called with insufficient number of arguments");
+	}
+	return m_prepare(object, args, prepared);
+}
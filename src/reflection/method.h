@@ -8,6 +8,7 @@
 #include "typelist.h"
 #include "variant.h"
 #include "reflection.h"
+#include "signature.h"
 #include "str_utils.h"
 #include "call_utils.h"
 
@@ -44,28 +45,50 @@ struct method_type<_Result(_Clazz::*)(Args...)> {
 
 		static_assert(size<Arguments>() == sizeof...(I), "number of arguments and number of indices don't match");
 
-		static VariantValue call(ClazzRef object, ptr_to_method ptr, const ::std::vector<VariantValue>& args) {
+		static VariantValue call(ClazzRef object, ptr_to_method ptr, ArgumentView args) {
 			VariantValue ret;
 			ret.construct<Result>((object.*ptr)(args[I].moveValueThrow<typename type_at<Arguments, I>::type>()...));
 			return std::move(ret);
 		}
+
+		static VariantValue callPrepared(ClazzRef object, ptr_to_method ptr, ArgumentView args, const PreparedArgument* prepared) {
+			VariantValue ret;
+			ret.construct<Result>((object.*ptr)(prepared_value<typename type_at<Arguments, I>::type>(args[I], prepared[I])...));
+			return std::move(ret);
+		}
 	};
 
 	template< ::std::size_t... I, template< ::std::size_t...> class Ind>
 	struct call_helper<Ind<I...>, void> {
 		static_assert(size<Arguments>() == sizeof...(I), "number of arguments and number of indices don't match");
-		static VariantValue call(ClazzRef object, ptr_to_method ptr, const ::std::vector<VariantValue>& args) {
+		static VariantValue call(ClazzRef object, ptr_to_method ptr, ArgumentView args) {
 			(object.*ptr)(args[I].moveValueThrow<typename type_at<Arguments, I>::type>()...);
 			return VariantValue();
 		}
+
+		static VariantValue callPrepared(ClazzRef object, ptr_to_method ptr, ArgumentView args, const PreparedArgument* prepared) {
+			(object.*ptr)(prepared_value<typename type_at<Arguments, I>::type>(args[I], prepared[I])...);
+			return VariantValue();
+		}
 	};
 
 	template<_Result(_Clazz::*ptr)(Args...)>
-	static VariantValue bindcall(const volatile VariantValue& object, const ::std::vector<VariantValue>& args)  {
+	static VariantValue bindcall(const volatile VariantValue& object, ArgumentView args)  {
 		Clazz& ref = verifyObject<Clazz>(object, is_const);
 		return call_helper<typename make_indices<sizeof...(Args)>::type, Result>::call(ref, ptr, args);
 	}
 
+	template<_Result(_Clazz::*ptr)(Args...)>
+	static VariantValue callprepared(void* object, ArgumentView args, const PreparedArgument* prepared) {
+		return call_helper<typename make_indices<sizeof...(Args)>::type, Result>::callPrepared(*static_cast<Clazz*>(object), ptr, args, prepared);
+	}
+
+	static int prepare(const volatile VariantValue& object, ArgumentView args, PreparedArgument* prepared) {
+		Clazz& ref = verifyObject<Clazz>(object, is_const);
+		prepare_arguments<Arguments>(args, prepared);
+		return reinterpret_cast<const char*>(&ref) - reinterpret_cast<const char*>(const_cast<const VariantValue&>(object).ptrToValue());
+	}
+
 };
 
 
@@ -91,27 +114,49 @@ struct method_type<_Result(_Clazz::*)(Args...) const> {
 
 		static_assert(size<Arguments>() == sizeof...(I), "number of arguments and number of indices don't match");
 
-		static VariantValue call(ClazzRef object, ptr_to_method ptr, const ::std::vector<VariantValue>& args) {
+		static VariantValue call(ClazzRef object, ptr_to_method ptr, ArgumentView args) {
 			VariantValue ret;
 			ret.construct<Result>((object.*ptr)(args[I].moveValueThrow<typename type_at<Arguments, I>::type>()...));
 			return std::move(ret);
 		}
+
+		static VariantValue callPrepared(ClazzRef object, ptr_to_method ptr, ArgumentView args, const PreparedArgument* prepared) {
+			VariantValue ret;
+			ret.construct<Result>((object.*ptr)(prepared_value<typename type_at<Arguments, I>::type>(args[I], prepared[I])...));
+			return std::move(ret);
+		}
 	};
 
 	template< ::std::size_t... I, template< ::std::size_t...> class Ind>
 	struct call_helper<Ind<I...>, void> {
 		static_assert(size<Arguments>() == sizeof...(I), "number of arguments and number of indices don't match");
-		static VariantValue call(ClazzRef object, ptr_to_method ptr, const ::std::vector<VariantValue>& args) {
+		static VariantValue call(ClazzRef object, ptr_to_method ptr, ArgumentView args) {
 			(object.*ptr)(args[I].moveValueThrow<typename type_at<Arguments, I>::type>()...);
 			return VariantValue();
 		}
+
+		static VariantValue callPrepared(ClazzRef object, ptr_to_method ptr, ArgumentView args, const PreparedArgument* prepared) {
+			(object.*ptr)(prepared_value<typename type_at<Arguments, I>::type>(args[I], prepared[I])...);
+			return VariantValue();
+		}
 	};
 
 	template<_Result(_Clazz::*ptr)(Args...) const>
-	static VariantValue bindcall(const volatile VariantValue& object, const ::std::vector<VariantValue>& args)  {
+	static VariantValue bindcall(const volatile VariantValue& object, ArgumentView args)  {
 		Clazz& ref = verifyObject<Clazz>(object, is_const);
 		return call_helper<typename make_indices<sizeof...(Args)>::type, Result>::call(ref, ptr, args);
 	}
+
+	template<_Result(_Clazz::*ptr)(Args...) const>
+	static VariantValue callprepared(void* object, ArgumentView args, const PreparedArgument* prepared) {
+		return call_helper<typename make_indices<sizeof...(Args)>::type, Result>::callPrepared(*static_cast<Clazz*>(object), ptr, args, prepared);
+	}
+
+	static int prepare(const volatile VariantValue& object, ArgumentView args, PreparedArgument* prepared) {
+		Clazz& ref = verifyObject<Clazz>(object, is_const);
+		prepare_arguments<Arguments>(args, prepared);
+		return reinterpret_cast<const char*>(&ref) - reinterpret_cast<const char*>(const_cast<const VariantValue&>(object).ptrToValue());
+	}
 };
 
 template<class _Clazz, class _Result, class... Args>
@@ -136,27 +181,49 @@ struct method_type<_Result(_Clazz::*)(Args...) volatile> {
 
 		static_assert(size<Arguments>() == sizeof...(I), "number of arguments and number of indices don't match");
 
-		static VariantValue call(ClazzRef object, ptr_to_method ptr, const ::std::vector<VariantValue>& args) {
+		static VariantValue call(ClazzRef object, ptr_to_method ptr, ArgumentView args) {
 			VariantValue ret;
 			ret.construct<Result>((object.*ptr)(args[I].moveValueThrow<typename type_at<Arguments, I>::type>()...));
 			return std::move(ret);
 		}
+
+		static VariantValue callPrepared(ClazzRef object, ptr_to_method ptr, ArgumentView args, const PreparedArgument* prepared) {
+			VariantValue ret;
+			ret.construct<Result>((object.*ptr)(prepared_value<typename type_at<Arguments, I>::type>(args[I], prepared[I])...));
+			return std::move(ret);
+		}
 	};
 
 	template< ::std::size_t... I, template< ::std::size_t...> class Ind>
 	struct call_helper<Ind<I...>, void> {
 		static_assert(size<Arguments>() == sizeof...(I), "number of arguments and number of indices don't match");
-		static VariantValue call(ClazzRef object, ptr_to_method ptr, const ::std::vector<VariantValue>& args) {
+		static VariantValue call(ClazzRef object, ptr_to_method ptr, ArgumentView args) {
 			(object.*ptr)(args[I].moveValueThrow<typename type_at<Arguments, I>::type>()...);
 			return VariantValue();
 		}
+
+		static VariantValue callPrepared(ClazzRef object, ptr_to_method ptr, ArgumentView args, const PreparedArgument* prepared) {
+			(object.*ptr)(prepared_value<typename type_at<Arguments, I>::type>(args[I], prepared[I])...);
+			return VariantValue();
+		}
 	};
 
 	template<_Result(_Clazz::*ptr)(Args...) volatile>
-	static VariantValue bindcall(const volatile VariantValue& object, const ::std::vector<VariantValue>& args)  {
+	static VariantValue bindcall(const volatile VariantValue& object, ArgumentView args)  {
 		Clazz& ref = verifyObject<Clazz>(object, is_const);
 		return call_helper<typename make_indices<sizeof...(Args)>::type, Result>::call(ref, ptr, args);
 	}
+
+	template<_Result(_Clazz::*ptr)(Args...) volatile>
+	static VariantValue callprepared(void* object, ArgumentView args, const PreparedArgument* prepared) {
+		return call_helper<typename make_indices<sizeof...(Args)>::type, Result>::callPrepared(*static_cast<Clazz*>(object), ptr, args, prepared);
+	}
+
+	static int prepare(const volatile VariantValue& object, ArgumentView args, PreparedArgument* prepared) {
+		Clazz& ref = verifyObject<Clazz>(object, is_const);
+		prepare_arguments<Arguments>(args, prepared);
+		return reinterpret_cast<const char*>(&ref) - reinterpret_cast<const char*>(const_cast<const VariantValue&>(object).ptrToValue());
+	}
 };
 
 template<class _Clazz, class _Result, class... Args>
@@ -181,27 +248,49 @@ struct method_type<_Result(_Clazz::*)(Args...) const volatile> {
 
 		static_assert(size<Arguments>() == sizeof...(I), "number of arguments and number of indices don't match");
 
-		static VariantValue call(ClazzRef object, ptr_to_method ptr, const ::std::vector<VariantValue>& args) {
+		static VariantValue call(ClazzRef object, ptr_to_method ptr, ArgumentView args) {
 			VariantValue ret;
 			ret.construct<Result>((object.*ptr)(args[I].moveValueThrow<typename type_at<Arguments, I>::type>()...));
 			return std::move(ret);
 		}
+
+		static VariantValue callPrepared(ClazzRef object, ptr_to_method ptr, ArgumentView args, const PreparedArgument* prepared) {
+			VariantValue ret;
+			ret.construct<Result>((object.*ptr)(prepared_value<typename type_at<Arguments, I>::type>(args[I], prepared[I])...));
+			return std::move(ret);
+		}
 	};
 
 	template< ::std::size_t... I, template< ::std::size_t...> class Ind>
 	struct call_helper<Ind<I...>, void> {
 		static_assert(size<Arguments>() == sizeof...(I), "number of arguments and number of indices don't match");
-		static VariantValue call(ClazzRef object, ptr_to_method ptr, const ::std::vector<VariantValue>& args) {
+		static VariantValue call(ClazzRef object, ptr_to_method ptr, ArgumentView args) {
 			(object.*ptr)(args[I].moveValueThrow<typename type_at<Arguments, I>::type>()...);
 			return VariantValue();
 		}
+
+		static VariantValue callPrepared(ClazzRef object, ptr_to_method ptr, ArgumentView args, const PreparedArgument* prepared) {
+			(object.*ptr)(prepared_value<typename type_at<Arguments, I>::type>(args[I], prepared[I])...);
+			return VariantValue();
+		}
 	};
 
 	template<_Result(_Clazz::*ptr)(Args...) const volatile>
-	static VariantValue bindcall(const volatile VariantValue& object, const ::std::vector<VariantValue>& args) {
+	static VariantValue bindcall(const volatile VariantValue& object, ArgumentView args) {
 		Clazz& ref = verifyObject<Clazz>(object, is_const);
 		return call_helper<typename make_indices<sizeof...(Args)>::type, Result>::call(ref, ptr, args);
 	}
+
+	template<_Result(_Clazz::*ptr)(Args...) const volatile>
+	static VariantValue callprepared(void* object, ArgumentView args, const PreparedArgument* prepared) {
+		return call_helper<typename make_indices<sizeof...(Args)>::type, Result>::callPrepared(*static_cast<Clazz*>(object), ptr, args, prepared);
+	}
+
+	static int prepare(const volatile VariantValue& object, ArgumentView args, PreparedArgument* prepared) {
+		Clazz& ref = verifyObject<Clazz>(object, is_const);
+		prepare_arguments<Arguments>(args, prepared);
+		return reinterpret_cast<const char*>(&ref) - reinterpret_cast<const char*>(const_cast<const VariantValue&>(object).ptrToValue());
+	}
 };
 
 
@@ -220,25 +309,46 @@ struct method_type<_Result(*)(Args...)> {
 
 	template<class R, ::std::size_t... I, template< ::std::size_t...> class Ind>
 	struct call_helper<R, Ind<I...>> {
-		static VariantValue call(ptr_to_method ptr, const ::std::vector<VariantValue>& args) {
+		static VariantValue call(ptr_to_method ptr, ArgumentView args) {
 			VariantValue ret;
 			ret.construct<Result>(ptr(args[I].moveValueThrow<typename type_at<Arguments, I>::type>()...));
 			return std::move(ret);
 		}
+
+		static VariantValue callPrepared(ptr_to_method ptr, ArgumentView args, const PreparedArgument* prepared) {
+			VariantValue ret;
+			ret.construct<Result>(ptr(prepared_value<typename type_at<Arguments, I>::type>(args[I], prepared[I])...));
+			return std::move(ret);
+		}
 	};
 
 	template< ::std::size_t... I, template< ::std::size_t...> class Ind>
 	struct call_helper<void, Ind<I...>> {
-		static VariantValue call(ptr_to_method ptr, const ::std::vector<VariantValue>& args) {
+		static VariantValue call(ptr_to_method ptr, ArgumentView args) {
 			ptr(args[I].moveValueThrow<typename type_at<Arguments, I>::type>()...);
 			return VariantValue();
 		}
+
+		static VariantValue callPrepared(ptr_to_method ptr, ArgumentView args, const PreparedArgument* prepared) {
+			ptr(prepared_value<typename type_at<Arguments, I>::type>(args[I], prepared[I])...);
+			return VariantValue();
+		}
 	};
 
 	template <_Result(*ptr)(Args...)>
-	static VariantValue bindcall(const volatile VariantValue&, const ::std::vector<VariantValue>& args)  {
+	static VariantValue bindcall(const volatile VariantValue&, ArgumentView args)  {
 		return call_helper<Result, typename make_indices<sizeof...(Args)>::type>::call(ptr, args);
 	}
+
+	template <_Result(*ptr)(Args...)>
+	static VariantValue callprepared(void*, ArgumentView args, const PreparedArgument* prepared) {
+		return call_helper<Result, typename make_indices<sizeof...(Args)>::type>::callPrepared(ptr, args, prepared);
+	}
+
+	static int prepare(const volatile VariantValue&, ArgumentView args, PreparedArgument* prepared) {
+		prepare_arguments<Arguments>(args, prepared);
+		return 0;
+	}
 };
 
 }
@@ -262,11 +372,15 @@ public:
 			, const ::std::type_info& returnType
 			, ::std::vector<const ::std::type_info*> argumentTypes
 #endif
+			, preparemethod prepare = nullptr
+			, preparedcall prepared = nullptr
 			);
 
 	const char* name() const;
+	Symbol symbol() const;
 	::std::size_t numberOfArguments() const;
-	::std::vector< ::std::string> argumentSpellings() const;
+	const ::std::vector< ::std::string>& argumentSpellings() const;
+	::std::size_t signatureHash() const;
 
 	::std::string returnTypeSpelling() const;
 
@@ -276,15 +390,19 @@ public:
 
 #ifndef NO_RTTI
 	const ::std::type_info& returnType() const;
-	::std::vector<const ::std::type_info*> argumentTypes() const;
+	const ::std::vector<const ::std::type_info*>& argumentTypes() const;
 #endif
 
 
-	VariantValue call(const ::std::vector<VariantValue>& args) const;
-	VariantValue call(VariantValue& object, const ::std::vector<VariantValue>& args) const;
-	VariantValue call(const VariantValue& object, const ::std::vector<VariantValue>& args) const;
-	VariantValue call(volatile VariantValue& object, const ::std::vector<VariantValue>& args) const;
-	VariantValue call(const volatile VariantValue& object, const ::std::vector<VariantValue>& args) const;
+	VariantValue call(ArgumentView args) const;
+	VariantValue call(VariantValue& object, ArgumentView args) const;
+	VariantValue call(const VariantValue& object, ArgumentView args) const;
+	VariantValue call(volatile VariantValue& object, ArgumentView args) const;
+	VariantValue call(const volatile VariantValue& object, ArgumentView args) const;
+
+	// nullptr if the method was registered without prepared call support
+	preparedcall preparedCall() const;
+	int prepare(const volatile VariantValue& object, ArgumentView args, PreparedArgument* prepared) const;
 	
 	MethodImpl(const MethodImpl&) = delete;
 	MethodImpl(MethodImpl&&) = delete;
@@ -293,16 +411,18 @@ public:
 
 	const boundmethod m_method;
 	const char* const m_name;
+	const Symbol m_symbol;
 	const char* const m_returnSpelling;
-	const char* const m_argSpellings;
 	const unsigned int m_numArgs;
 	const unsigned int m_isConst : 1;
 	const unsigned int m_isVolatile : 1;
 	const unsigned int m_isStatic : 1;
 #ifndef NO_RTTI
 	const ::std::type_info& m_returnType;
-	const ::std::vector<const ::std::type_info*> m_argumentTypes;
 #endif
+	const CallableSignature m_signature;
+	const preparemethod m_prepare;
+	const preparedcall m_prepared;
 };
 
 
@@ -11,26 +11,58 @@
 void ProxyImpl::registerInterface(ClassImpl* iface)
 {
 	std::shared_ptr<ProxyImpl> strongRef(weakThis);
-	m_interfaces[iface] = std::move(iface->newInterface(strongRef));
+	Interface& entry = m_interfaces[iface];
+	entry.slots = { m_handlers.size(), iface->proxySlotCount() };
+	m_handlers.resize(m_handlers.size() + entry.slots.count);
+	// the stub reads its block when it is built. Kept on the heap, so that the
+	// references handed out by ref() keep the stub alive
+	entry.stub = iface->newInterface(strongRef).createReference();
+}
+
+::std::size_t ProxyImpl::slotOf(const ClassImpl* iface, size_t method_hash)
+{
+	return iface->proxySlot(method_hash);
+}
+
+ProxyImpl::Slots ProxyImpl::slotsOf(ClassImpl* iface) const
+{
+	auto it = m_interfaces.find(iface);
+	if (it == m_interfaces.end()) {
+		return { 0, 0 };
+	}
+	return it->second.slots;
 }
 
 void ProxyImpl::registerHandler(size_t method_hash, Proxy::MethodHandler mh)
 {
-	m_map[method_hash] = mh;
+	// interfaces that share a base have a slot each for its methods
+	for (const auto& iface: m_interfaces) {
+		const Slots& slots = iface.second.slots;
+		const std::size_t slot = iface.first->proxySlot(method_hash);
+		if (slot < slots.count) {
+			m_handlers[slots.base + slot] = mh;
+		}
+	}
 }
 
 bool ProxyImpl::hasHandler(size_t method_hash) const {
-	return (m_map.find(method_hash) != m_map.end());
+	for (const auto& iface: m_interfaces) {
+		const Slots& slots = iface.second.slots;
+		const std::size_t slot = iface.first->proxySlot(method_hash);
+		if (slot < slots.count && m_handlers[slots.base + slot]) {
+			return true;
+		}
+	}
+	return false;
 }
 
-VariantValue ProxyImpl::callArgArray(size_t method_hash, const ::std::vector<VariantValue>& vargs) const
+VariantValue ProxyImpl::callArgArray(const Slots& slots, std::size_t slot, ArgumentView args) const
 {
-	auto it = m_map.find(method_hash);
-	if (it == m_map.end()) {
+	if (slot >= slots.count || !m_handlers[slots.base + slot]) {
 		throw std::logic_error("method not implemented");
 	}
 
-	return it->second(vargs);
+	return m_handlers[slots.base + slot](args);
 }
 
 std::list<ClassImpl*> ProxyImpl::interfaces() const
@@ -49,7 +81,7 @@ VariantValue ProxyImpl::ref(ClassImpl* clazz) const
 {
 	auto it = m_interfaces.find(clazz);
 	if (it != m_interfaces.end()) {
-		return it->second.createReference();
+		return it->second.stub.createReference();
 	}
 	return VariantValue();
 }
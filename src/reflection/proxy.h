@@ -19,26 +19,45 @@ class ProxyImpl;
 class ClassImpl;
 
 
+/** The handlers of a proxy are kept in a dense table. The methods of an
+ *  interface are numbered from 0, and every interface of the proxy gets a
+ *  block of the table for its methods when it is registered. The stubs
+ *  generated by REFL_STUB_METHOD look up their slot once and keep it, and
+ *  each stub keeps the block of its interface, so a call through a stub is
+ *  an index into the table with the arguments on the stack.
+ */
 class ProxyImpl {
 public:
 
+	// the handlers of the methods of an interface in the table of a proxy
+	struct Slots {
+		::std::size_t base;
+		::std::size_t count;
+	};
+
 	ProxyImpl() = default;
 
 	ProxyImpl(const ProxyImpl& that) = delete;
 
 	void registerInterface(ClassImpl* cimpl);
 
-    void registerHandler(size_t method_hash, Proxy::MethodHandler);
+	/** the slot of the method with the given hash among those of iface,
+	 *  calls through a slot the interface doesn't have throw */
+	static ::std::size_t slotOf(const ClassImpl* iface, size_t method_hash);
+
+	// the block of a registered interface
+	Slots slotsOf(ClassImpl* iface) const;
+
+	void registerHandler(size_t method_hash, Proxy::MethodHandler);
 
 	bool hasHandler(size_t method_hash) const;
 
-	VariantValue callArgArray(size_t method_hash, const ::std::vector<VariantValue>& vargs) const;
+	VariantValue callArgArray(const Slots& slots, ::std::size_t slot, ArgumentView args) const;
 
 	template<class... Args>
-	VariantValue call(size_t method_hash, const Args&... args) const {
-		::std::vector<VariantValue> vargs;
-		emplace(vargs, args...);
-		return callArgArray(method_hash, vargs );
+	VariantValue call(const Slots& slots, ::std::size_t slot, const Args&... args) const {
+		const auto vargs = make_arguments(args...);
+		return callArgArray(slots, slot, vargs);
 	}
 
 	VariantValue ref(ClassImpl* clazz) const;
@@ -52,11 +71,15 @@ public:
 
 
 private:
-	typedef size_t hash_t;
-	typedef std::map<hash_t, Proxy::MethodHandler > methmap;
-	typedef std::map<ClassImpl*, VariantValue > ifacemap;
+	struct Interface {
+		Slots slots;
+		VariantValue stub;
+	};
+
+	typedef std::map<ClassImpl*, Interface > ifacemap;
 
-	methmap m_map;
+	// the blocks of the interfaces, slots without a handler hold an empty function
+	::std::vector<Proxy::MethodHandler> m_handlers;
 	ifacemap m_interfaces;
 	int m_handleCount = 0;
 };
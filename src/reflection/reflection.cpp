@@ -13,10 +13,74 @@
 #include "proxy.h"
 
 #include <algorithm>
+#include <cstring>
+#include <exception>
 #include <sstream>
+#include <thread>
+
+namespace {
+
+	// batches smaller than this per thread aren't worth a thread
+	const ::std::size_t minBatchPerThread = 4096;
+
+	// runs body(begin, end) over [0, size), split across up to numThreads threads.
+	// The first exception thrown by a thread is rethrown in the caller
+	template<class Body>
+	void batchLoop(::std::size_t size, unsigned int numThreads, const Body& body) {
+		::std::size_t chunks = ::std::min< ::std::size_t>(numThreads, size / minBatchPerThread);
+		if (chunks <= 1) {
+			body(0, size);
+			return;
+		}
+		::std::vector< ::std::thread> threads;
+		::std::vector< ::std::exception_ptr> errors(chunks);
+		const ::std::size_t chunkSize = (size + chunks - 1) / chunks;
+		for (::std::size_t c = 1; c < chunks; ++c) {
+			threads.emplace_back([&, c]() {
+				try {
+					body(c * chunkSize, ::std::min(size, (c + 1) * chunkSize));
+				} catch (...) {
+					errors[c] = ::std::current_exception();
+				}
+			});
+		}
+		try {
+			body(0, chunkSize);
+		} catch (...) {
+			errors[0] = ::std::current_exception();
+		}
+		for (::std::thread& t: threads) {
+			t.join();
+		}
+		for (const ::std::exception_ptr& e: errors) {
+			if (e) {
+				::std::rethrow_exception(e);
+			}
+		}
+	}
+
+}
 
 //--------attribute-----------------------------------------------
 
+RawAttributeAccessor::RawAttributeAccessor()
+	: m_type(nullptr)
+	, m_offset(0)
+	, m_size(0)
+	, m_isConst(false)
+	, m_isTriviallyCopyable(false) {}
+
+void RawAttributeAccessor::copy(void* to, const void* from) const
+{
+	if (!m_isTriviallyCopyable) {
+		throw ::std::runtime_error("attribute can't be copied as raw memory");
+	}
+	if (m_isConst) {
+		throw ::std::runtime_error("cannot change value of const attribute");
+	}
+	::std::memcpy(static_cast<char*>(to) + m_offset, static_cast<const char*>(from) + m_offset, m_size);
+}
+
 bool Attribute::isValid() const
 {
 	return (m_impl != nullptr);
@@ -55,6 +119,11 @@ Attribute& Attribute::operator=(Attribute&& rhs) {
 	return m_impl->name();
 }
 
+Symbol Attribute::symbol() const {
+	check_valid();
+	return m_impl->symbol();
+}
+
 ::std::string Attribute::typeSpelling() const
 {
 	check_valid();
@@ -103,6 +172,27 @@ void Attribute::set(const VariantValue& object, const VariantValue& value) const
 	return m_impl->set(object, value);
 }
 
+void Attribute::getBatch(ArgumentView objects, VariantValue* results, unsigned int numThreads) const {
+	check_valid();
+	batchLoop(objects.size(), numThreads, [&](::std::size_t begin, ::std::size_t end) {
+		m_impl->getBatch(ArgumentView(objects.begin() + begin, end - begin), results + begin);
+	});
+}
+
+RawAttributeAccessor Attribute::rawAccessor() const {
+	check_valid();
+	if (m_impl->isStatic()) {
+		throw ::std::runtime_error("static attributes have no offset");
+	}
+	RawAttributeAccessor ret;
+	ret.m_type = &m_impl->descriptor();
+	ret.m_offset = m_impl->offset();
+	ret.m_size = m_impl->descriptor().sizeOf;
+	ret.m_isConst = m_impl->isConst();
+	ret.m_isTriviallyCopyable = m_impl->descriptor().isPod();
+	return ret;
+}
+
 Class Attribute::getClass() const
 {
 	return Class(m_class);
@@ -169,6 +259,11 @@ const std::string& Class::fullyQualifiedName() const {
 	return m_impl->fullyQualifiedName();
 }
 
+Symbol Class::symbol() const {
+	check_valid();
+	return m_impl->symbol();
+}
+
 #ifndef NO_RTTI
 const std::type_info& Class::typeId() const {
 	check_valid();
@@ -178,8 +273,12 @@ const std::type_info& Class::typeId() const {
 	
 bool Class::isSubClassOf(const Class& rhs) const {
 	check_valid();
-	const ClassList& sups = m_impl->superclasses();
-	return (::std::find(sups.begin(), sups.end(), rhs) != sups.end());
+	return m_impl->inheritsFrom(rhs.m_impl);
+}
+
+int Class::inheritanceDistance(const Class& base) const {
+	check_valid();
+	return m_impl->inheritanceDistance(base.m_impl);
 }
 	
 const Class::MethodList& Class::methods() const {
@@ -223,6 +322,38 @@ Class::MethodList Class::findAllMethods(std::function<bool(const Method& m)> cri
 	return findAll(criteria, m_impl->methods());
 }
 
+Class::MethodRange Class::methodsNamed(const char* name) const
+{
+	return methodsNamed(Symbol::find(name));
+}
+
+Class::MethodRange Class::methodsNamed(const ::std::string& name) const
+{
+	return methodsNamed(Symbol::find(name));
+}
+
+Class::MethodRange Class::methodsNamed(Symbol name) const
+{
+	check_valid();
+	return m_impl->methodsNamed(name);
+}
+
+Class::MethodRange Class::methodsNamed(const char* name, ::std::size_t numArgs) const
+{
+	return methodsNamed(Symbol::find(name), numArgs);
+}
+
+Class::MethodRange Class::methodsNamed(const ::std::string& name, ::std::size_t numArgs) const
+{
+	return methodsNamed(Symbol::find(name), numArgs);
+}
+
+Class::MethodRange Class::methodsNamed(Symbol name, ::std::size_t numArgs) const
+{
+	check_valid();
+	return m_impl->methodsNamed(name, numArgs);
+}
+
 const Class::ConstructorList& Class::constructors() const {
 	check_valid();
 	return m_impl->constructors();
@@ -247,7 +378,23 @@ const Class::AttributeList& Class::attributes() const {
 
 Attribute Class::getAttribute(const std::string& name) const
 {
-	return findAttribute([&](const Attribute& a){ return a.name() == name; });
+	return attribute(Symbol::find(name));
+}
+
+Attribute Class::attribute(const char* name) const
+{
+	return attribute(Symbol::find(name));
+}
+
+Attribute Class::attribute(const ::std::string& name) const
+{
+	return attribute(Symbol::find(name));
+}
+
+Attribute Class::attribute(Symbol name) const
+{
+	check_valid();
+	return m_impl->attribute(name);
 }
 
 Attribute Class::findAttribute(std::function<bool(const Attribute& m)> criteria) const
@@ -285,6 +432,11 @@ Class Class::lookup(const ::std::string& name)
 	return ClassRegistry::instance().forName(name);
 }
 
+Class Class::lookup(Symbol name)
+{
+	return ClassRegistry::instance().forName(name);
+}
+
 #ifndef NO_RTTI
 Class Class::lookup(const ::std::type_info& id)
 {
@@ -301,35 +453,122 @@ bool Class::hasUnresolvedBases() const
 	return m_impl->hasUnresolvedBases();
 }
 
-const Class ClassRegistry::forName(const ::std::string& name) const
+::std::size_t Class::sizeOf() const
 {
-	auto it = m_registryByName.find(name);
-	if (it != m_registryByName.end()) {
-		return it->second;
-	} else {
+	check_valid();
+	return m_impl->sizeOf();
+}
+
+::std::size_t Class::alignOf() const
+{
+	check_valid();
+	return m_impl->alignOf();
+}
+
+void Class::destroyAt(void* object) const
+{
+	check_valid();
+	m_impl->destroyAt(object);
+}
+
+template<class Key>
+Class ClassRegistry::get(registry_map< Key, Entry >& registry, const Key& key, const Entry* e)
+{
+	if (e == nullptr) {
 		return Class();
+	} else if (e->factory == nullptr) {
+		return Class(e->impl);
 	}
+	const ClassFactory factory = e->factory;
+	const Class c = factory();
+	// built before taking the lock of the map
+	const Entry built = { nullptr, c.m_impl };
+	registry.update(key, [&](Entry& entry) {
+		// unless the class was registered again in the meantime
+		if (entry.factory == factory) {
+			entry = built;
+		}
+	});
+	return c;
+}
+
+const Class ClassRegistry::forName(const ::std::string& name) const
+{
+	return forName(Symbol::find(name));
+}
+
+const Class ClassRegistry::forName(Symbol name) const
+{
+	return get(m_registryByName, name, m_registryByName.find(name));
 }
 
 #ifndef NO_RTTI
 const Class ClassRegistry::forTypeId(const ::std::type_info& id) const
 {
-	auto it = m_registryByTypeId.find(id);
-	if (it != m_registryByTypeId.end()) {
-		return it->second;
-	} else {
+	const ::std::type_index key(id);
+	return get(m_registryByTypeId, key, m_registryByTypeId.find(key));
+}
+
+void ClassRegistry::registerPointerTypes(const ::std::type_info& pointer, const ::std::type_info& constPointer, ClassFactory factory)
+{
+	m_registryByPointerTypeId.assign(::std::type_index(pointer), { factory, false });
+	m_registryByPointerTypeId.assign(::std::type_index(constPointer), { factory, true });
+	ClassImpl::hierarchyChanged();
+}
+
+const Class ClassRegistry::forPointerTypeId(const ::std::type_info& id, bool& pointsToConst) const
+{
+	const PointerEntry* e = m_registryByPointerTypeId.find(::std::type_index(id));
+	if (e == nullptr) {
 		return Class();
 	}
+	pointsToConst = e->pointsToConst;
+	return e->factory();
+}
+
+bool registeredPointerConversion(const ::std::type_info& from, const ::std::type_info& to, int& offset)
+{
+	bool fromConst = false;
+	bool toConst = false;
+	const Class derived = ClassRegistry::instance().forPointerTypeId(from, fromConst);
+	const Class base = ClassRegistry::instance().forPointerTypeId(to, toConst);
+	if (!derived.isValid() || !base.isValid() || (fromConst && !toConst)) {
+		return false;
+	}
+	if (derived == base) {
+		offset = 0;
+		return true;
+	}
+	return ClassImpl::baseOffset(derived.typeId(), base.typeId(), offset);
 }
 #endif
 
 void ClassRegistry::registerClass(const Class& c)
 {
-	m_registryByName[c.fullyQualifiedName()] = c;
+	const Entry e = { nullptr, c.m_impl };
+	m_registryByName.assign(Symbol::intern(c.fullyQualifiedName()), e);
 #ifndef NO_RTTI
-	m_registryByTypeId[c.typeId()] = c;
+	m_registryByTypeId.assign(::std::type_index(c.typeId()), e);
 #endif
+	ClassImpl::hierarchyChanged();
+}
+
+#ifndef NO_RTTI
+void ClassRegistry::registerClass(const char* name, const ::std::type_info& id, ClassFactory factory)
+{
+	const Entry e = { factory, nullptr };
+	m_registryByName.assign(Symbol::intern(name), e);
+	m_registryByTypeId.assign(::std::type_index(id), e);
+	ClassImpl::hierarchyChanged();
 }
+#else
+void ClassRegistry::registerClass(const char* name, ClassFactory factory)
+{
+	const Entry e = { factory, nullptr };
+	m_registryByName.assign(Symbol::intern(name), e);
+	ClassImpl::hierarchyChanged();
+}
+#endif
 
 ClassRegistry& ClassRegistry::instance()
 {
@@ -353,11 +592,11 @@ namespace {
 			return SAME;
 		}
 
-		if (find(c2.superclasses().begin(), c2.superclasses().end(), c1) != c2.superclasses().end()) {
+		if (c2.isSubClassOf(c1)) {
 			return MORE_ABSTRACT;
 		}
 
-		if (find(c1.superclasses().begin(), c1.superclasses().end(), c2) != c1.superclasses().end()) {
+		if (c1.isSubClassOf(c2)) {
 			return LESS_ABSTRACT;
 		}
 
@@ -418,29 +657,40 @@ Constructor::Constructor(ConstructorImpl* impl, ClassImpl* cimpl)
 	return m_impl->numberOfArguments();
 }
 
-::std::vector< ::std::string> Constructor::argumentSpellings() const
+const ::std::vector< ::std::string>& Constructor::argumentSpellings() const
 {
 	check_valid();
 	return m_impl->argumentSpellings();
 }
 
+::std::size_t Constructor::signatureHash() const
+{
+	check_valid();
+	return m_impl->signatureHash();
+}
+
 bool Constructor::isDefaultConstructor() const {
 	check_valid();
 	return numberOfArguments() == 0;
 }
 
 #ifndef NO_RTTI
-::std::vector<const ::std::type_info*> Constructor::argumentTypes() const {
+const ::std::vector<const ::std::type_info*>& Constructor::argumentTypes() const {
 	check_valid();
 	return m_impl->argumentTypes();
 }
 #endif
 
-VariantValue Constructor::callArgArray(const ::std::vector<VariantValue>& vargs) const {
+VariantValue Constructor::callArgArray(ArgumentView vargs) const {
 	check_valid();
 	return m_impl->call(vargs);
 }
 
+void Constructor::constructAtArgArray(void* storage, ArgumentView vargs) const {
+	check_valid();
+	m_impl->constructAt(storage, vargs);
+}
+
 Class Constructor::getClass() const
 {
 	return Class(m_class);
@@ -535,6 +785,11 @@ Method& Method::operator=(Method&& rhs) {
 	return m_impl->name();
 }
 
+Symbol Method::symbol() const {
+	check_valid();
+	return m_impl->symbol();
+}
+
 ::std::size_t Method::numberOfArguments() const {
 	check_valid();
 	return m_impl->numberOfArguments();
@@ -546,13 +801,18 @@ Method& Method::operator=(Method&& rhs) {
 	return m_impl->returnTypeSpelling();
 }
 
-::std::vector< ::std::string> Method::argumentSpellings() const {
+const ::std::vector< ::std::string>& Method::argumentSpellings() const {
 	check_valid();
 	return m_impl->argumentSpellings();
 }
 
+::std::size_t Method::signatureHash() const {
+	check_valid();
+	return m_impl->signatureHash();
+}
+
 #ifndef NO_RTTI
-::std::vector<const ::std::type_info*> Method::argumentTypes() const {
+const ::std::vector<const ::std::type_info*>& Method::argumentTypes() const {
 	check_valid();
 	return m_impl->argumentTypes();	
 }
@@ -578,31 +838,109 @@ bool Method::isStatic() const {
 	return m_impl->isStatic();
 }
 
-VariantValue Method::callArgArray(const ::std::vector<VariantValue>& vargs) const {
+VariantValue Method::callArgArray(ArgumentView vargs) const {
 	check_valid();
 	return m_impl->call(vargs );	
 }
 
-VariantValue Method::callArgArray(VariantValue& object, const ::std::vector<VariantValue>& vargs) const {
+VariantValue Method::callArgArray(VariantValue& object, ArgumentView vargs) const {
 	check_valid();
 	return m_impl->call(object, vargs );
 }
 
-VariantValue Method::callArgArray(const VariantValue& object, const ::std::vector<VariantValue>& vargs) const {
+VariantValue Method::callArgArray(const VariantValue& object, ArgumentView vargs) const {
 	check_valid();
 	return m_impl->call(object, vargs );	
 }
 
-VariantValue Method::callArgArray(volatile VariantValue& object, const ::std::vector<VariantValue>& vargs) const {
+VariantValue Method::callArgArray(volatile VariantValue& object, ArgumentView vargs) const {
 	check_valid();
 	return m_impl->call(object, vargs );	
 }
 
-VariantValue Method::callArgArray(const volatile VariantValue& object, const ::std::vector<VariantValue>& vargs) const {
+VariantValue Method::callArgArray(const volatile VariantValue& object, ArgumentView vargs) const {
 	check_valid();
 	return m_impl->call(object, vargs );	
 }
 
+PreparedCall Method::bind(VariantValue& object, ArgumentView vargs) const {
+	check_valid();
+	PreparedCall ret;
+	ret.m_call = m_impl->preparedCall();
+	ret.m_hasObject = !m_impl->isStatic();
+	ret.m_isConst = m_impl->isConst();
+	if (ret.m_call == nullptr) {
+		ret.m_method = *this;
+		return ret;
+	}
+	ret.m_arguments.resize(m_impl->numberOfArguments());
+	const int offset = m_impl->prepare(object, vargs, ret.m_arguments.data());
+	if (ret.m_hasObject) {
+		ret.m_object.type = object.typeDescriptor();
+		ret.m_object.isConst = object.isConst();
+		ret.m_object.direct = true;
+		ret.m_object.consumed = false;
+		ret.m_object.offset = offset;
+	}
+	return ret;
+}
+
+PreparedCall Method::bind(const VariantValue& object, ArgumentView vargs) const {
+	check_valid();
+	if (!m_impl->isConst() && !m_impl->isStatic()) {
+		throw ::std::runtime_error("Called non-const method of const object");
+	}
+	return bind(const_cast<VariantValue&>(object), vargs);
+}
+
+void Method::callBatch(VariantValue* objects, ::std::size_t count, ArgumentView vargs, VariantValue* results, unsigned int numThreads) const {
+	check_valid();
+	if (m_impl->isStatic()) {
+		throw ::std::runtime_error("batch call of a static method");
+	}
+	batchLoop(count, numThreads, [&](::std::size_t begin, ::std::size_t end) {
+		// parameters passed by value move from their arguments, so those get a fresh copy for
+		// every call, the others refer to the values of vargs as in callArgArray. vargs itself
+		// is only read, by all threads. Moving leaves POD values as they were
+		::std::vector<VariantValue> args;
+		::std::vector< ::std::size_t> consumed;
+		PreparedCall call;
+		for (::std::size_t i = begin; i < end; ++i) {
+			if (!call.isValid() || !call.acceptsObject(objects[i])) {
+				// binding only looks at the arguments
+				call = bind(objects[i], vargs);
+				if (args.empty()) {
+					for (::std::size_t j = 0; j < vargs.size(); ++j) {
+						if (!vargs[j].isPOD() && call.consumesArgument(j)) {
+							consumed.push_back(j);
+						}
+					}
+					if (!consumed.empty()) {
+						// shares the holders, unlike a copy. Growing would copy them
+						args.reserve(vargs.size());
+						for (const VariantValue& arg: vargs) {
+							args.push_back(arg.createReference());
+						}
+					}
+				}
+			}
+			for (::std::size_t j: consumed) {
+				args[j] = vargs[j];
+			}
+			results[i] = call.callObject(objects[i], consumed.empty() ? vargs : ArgumentView(args));
+		}
+	});
+}
+
+PreparedCall Method::bind(ArgumentView vargs) const {
+	check_valid();
+	if (!m_impl->isStatic()) {
+		throw ::std::runtime_error("non-static method bound without an object");
+	}
+	const VariantValue none;
+	return bind(none, vargs);
+}
+
 Class Method::getClass() const {
 	return Class(m_class);
 }
@@ -635,6 +973,8 @@ bool overrides(const Method& m1, const Method& m2)
 
 	if (m1.isVolatile() != m2.isVolatile()) return false;
 
+	if (m1.signatureHash() != m2.signatureHash()) return false;
+
 	// costly tests
 	if (!inheritanceRelation(m1.getClass(), m2.getClass())) return false;
 
@@ -643,8 +983,8 @@ bool overrides(const Method& m1, const Method& m2)
 
 #ifndef NO_RTTI
 
-	auto args1 = m1.argumentTypes();
-	auto args2 = m2.argumentTypes();
+	const auto& args1 = m1.argumentTypes();
+	const auto& args2 = m2.argumentTypes();
 
 	auto it1 = begin(args1);
 	auto it2 = begin(args2);
@@ -654,8 +994,8 @@ bool overrides(const Method& m1, const Method& m2)
 
 #else
 
-	auto args1 = m1.argumentSpellings();
-	auto args2 = m2.argumentSpellings();
+	const auto& args1 = m1.argumentSpellings();
+	const auto& args2 = m2.argumentSpellings();
 
 	auto it1 = begin(args1);
 	auto it2 = begin(args2);
@@ -691,8 +1031,8 @@ bool overloads(const Method& m1, const Method& m2)
 
 #ifndef NO_RTTI
 
-		auto args1 = m1.argumentTypes();
-		auto args2 = m2.argumentTypes();
+		const auto& args1 = m1.argumentTypes();
+		const auto& args2 = m2.argumentTypes();
 
 		auto it1 = begin(args1);
 		auto it2 = begin(args2);
@@ -706,8 +1046,8 @@ bool overloads(const Method& m1, const Method& m2)
 
 #else
 		// less safe
-		auto args1 = m1.argumentSpellings();
-		auto args2 = m2.argumentSpellings();
+		const auto& args1 = m1.argumentSpellings();
+		const auto& args2 = m2.argumentSpellings();
 
 		auto it1 = begin(args1);
 		auto it2 = begin(args2);
@@ -785,19 +1125,24 @@ const ::std::type_info& Function::returnType() const {
 	return m_impl->returnTypeSpelling();
 }
 
-::std::vector< ::std::string> Function::argumentSpellings() const {
+const ::std::vector< ::std::string>& Function::argumentSpellings() const {
 	check_valid();
 	return m_impl->argumentSpellings();
 }
 
+::std::size_t Function::signatureHash() const {
+	check_valid();
+	return m_impl->signatureHash();
+}
+
 #ifndef NO_RTTI
-::std::vector<const ::std::type_info*> Function::argumentTypes() const {
+const ::std::vector<const ::std::type_info*>& Function::argumentTypes() const {
 	check_valid();
 	return m_impl->argumentTypes();
 }
 #endif
 
-VariantValue Function::callArgArray(const ::std::vector<VariantValue>& vargs) const
+VariantValue Function::callArgArray(ArgumentView vargs) const
 {
 	check_valid();
 	return m_impl->call(vargs);
@@ -808,30 +1153,250 @@ Function::Function(FunctionImpl* impl)
 	, m_impl(impl)
 {}
 
+PreparedCall Function::prepare(ArgumentView vargs) const
+{
+	check_valid();
+	PreparedCall ret;
+	ret.m_call = m_impl->preparedCall();
+	if (ret.m_call == nullptr) {
+		ret.m_function = *this;
+	} else {
+		ret.m_arguments.resize(m_impl->numberOfArguments());
+		m_impl->prepare(vargs, ret.m_arguments.data());
+	}
+	return ret;
+}
+
 const ::std::list<Function>& Function::findFunctions(const ::std::string& name)
 {
 	return FunctionRegistry::instance().findFunction(name);
 }
 
+const ::std::list<Function>& Function::findFunctions(Symbol name)
+{
+	return FunctionRegistry::instance().findFunction(name);
+}
+
+#ifndef NO_RTTI
+Function Function::resolve(const ::std::string& name, ArgumentView args)
+{
+	return resolve(Symbol::find(name), args);
+}
+
+Function Function::resolve(Symbol name, ArgumentView args)
+{
+	return FunctionRegistry::instance().resolve(name, args);
+}
+#endif
+
+
+FunctionRegistry::FunctionRegistry()
+#ifndef NO_RTTI
+	: m_generation(0)
+	, m_cachedResolutions(0)
+#endif
+{}
 
 const ::std::list<Function>& FunctionRegistry::findFunction(const ::std::string& name) const
 {
-	auto it = m_registry.find(name);
-	if (it == m_registry.end()) {
-		return emptyList;
-	} else {
-		return it->second;
-	}
+	return findFunction(Symbol::find(name));
+}
+
+const ::std::list<Function>& FunctionRegistry::findFunction(Symbol name) const
+{
+	const ::std::list<Function>* functions = m_registry.find(name);
+	return functions ? *functions : emptyList;
 }
 
 void FunctionRegistry::registerFunction(const ::std::string& name, const Function& func)
 {
-	auto it = m_registry.find(name);
-	if (it == m_registry.end()) {
-		it = m_registry.insert(make_pair(name, ::std::list<Function>())).first;
+	// the list is copied, readers might still hold the previous one
+	m_registry.update(Symbol::intern(name), [&](::std::list<Function>& functions) {
+		functions.push_back(func);
+	});
+#ifndef NO_RTTI
+	m_generation.fetch_add(1, ::std::memory_order_release);
+#endif
+}
+
+#ifndef NO_RTTI
+namespace {
+
+	::std::size_t combineHash(::std::size_t h, const TypeDescriptor* type) {
+		return (h ^ reinterpret_cast< ::std::size_t>(type)) * 1099511628211ull;
+	}
+
+	bool isArithmeticType(const ::std::type_info& type) {
+		static const ::std::type_info* const types[] = {
+			&typeid(bool), &typeid(char), &typeid(signed char), &typeid(unsigned char),
+			&typeid(short), &typeid(unsigned short), &typeid(int), &typeid(unsigned int),
+			&typeid(long), &typeid(unsigned long), &typeid(long long), &typeid(unsigned long long),
+			&typeid(float), &typeid(double), &typeid(long double)
+		};
+		for (const ::std::type_info* t: types) {
+			if (*t == type) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	enum ArgumentMatch {
+		NO_MATCH = 0,
+		ARITHMETIC_CONVERSION = 1,
+		DERIVED_TO_BASE = 2,
+		EXACT = 3
+	};
+
+	struct ArgumentRank {
+		ArgumentMatch match;
+		// derivation steps of a DERIVED_TO_BASE conversion, nearer bases are better
+		int distance;
+
+		bool operator<(const ArgumentRank& rhs) const {
+			return match < rhs.match || (match == rhs.match && distance > rhs.distance);
+		}
+	};
+
+	// distance 0 adds a const to a pointer to the same class
+	ArgumentRank derivedToBase(const Class& derived, const Class& base) {
+		const int distance = derived.isValid() && base.isValid() ? derived.inheritanceDistance(base) : -1;
+		return distance < 0 ? ArgumentRank{ NO_MATCH, 0 } : ArgumentRank{ DERIVED_TO_BASE, distance };
+	}
+
+	ArgumentRank matchArgument(const VariantValue& arg, const ::std::type_info& param) {
+		if (!arg.isValid()) {
+			return { NO_MATCH, 0 };
+		}
+		const ::std::type_info& type = arg.typeId();
+		if (type == param) {
+			return { EXACT, 0 };
+		} else if (arg.isArithmetical() && isArithmeticType(param)) {
+			return { ARITHMETIC_CONVERSION, 0 };
+		} else if (arg.typeDescriptor()->category == TypeDescriptor::TypeCategories::POINTER) {
+			// only the conversions that the call can make
+			int offset;
+			if (!registeredPointerConversion(type, param, offset)) {
+				return { NO_MATCH, 0 };
+			}
+			bool pointsToConst;
+			return derivedToBase(ClassRegistry::instance().forPointerTypeId(type, pointsToConst),
+								 ClassRegistry::instance().forPointerTypeId(param, pointsToConst));
+		}
+		return derivedToBase(Class::lookup(type), Class::lookup(param));
+	}
+}
+
+::std::size_t FunctionRegistry::SignatureHash::operator()(const Signature& s) const
+{
+	::std::size_t h = s.name.hash();
+	for (const TypeDescriptor* type: s.types) {
+		h = combineHash(h, type);
+	}
+	return h;
+}
+
+Function FunctionRegistry::pickOverload(Symbol name, ArgumentView args, bool& ambiguous) const
+{
+	struct Candidate {
+		Function function;
+		::std::vector<ArgumentRank> matches;
+	};
+	::std::vector<Candidate> candidates;
+
+	for (const Function& f: findFunction(name)) {
+		if (f.numberOfArguments() != args.size()) {
+			continue;
+		}
+		const ::std::vector<const ::std::type_info*>& types = f.argumentTypes();
+		Candidate c{ f, {} };
+		for (::std::size_t i = 0; i < args.size(); ++i) {
+			const ArgumentRank m = matchArgument(args[i], *types[i]);
+			if (m.match == NO_MATCH) {
+				break;
+			}
+			c.matches.push_back(m);
+		}
+		if (c.matches.size() == args.size()) {
+			candidates.push_back(::std::move(c));
+		}
+	}
+
+	// like C++, the best overload is at least as good as any other for every argument and better for one
+	auto better = [](const Candidate& c1, const Candidate& c2) {
+		bool strictly = false;
+		for (::std::size_t i = 0; i < c1.matches.size(); ++i) {
+			if (c1.matches[i] < c2.matches[i]) {
+				return false;
+			}
+			strictly = strictly || c2.matches[i] < c1.matches[i];
+		}
+		return strictly;
+	};
+
+	ambiguous = false;
+	for (const Candidate& c: candidates) {
+		bool best = true;
+		for (const Candidate& other: candidates) {
+			if (&other != &c && !better(c, other)) {
+				best = false;
+				break;
+			}
+		}
+		if (best) {
+			return c.function;
+		}
+	}
+	ambiguous = !candidates.empty();
+	return Function();
+}
+
+Function FunctionRegistry::resolve(Symbol name, ArgumentView args)
+{
+	::std::size_t h = name.hash();
+	for (const VariantValue& arg: args) {
+		h = combineHash(h, arg.typeDescriptor());
 	}
-	it->second.push_back(func);
+	const unsigned int generation = m_generation.load(::std::memory_order_acquire);
+	const unsigned int hierarchyGeneration = ClassImpl::hierarchyGeneration();
+
+	const Resolution* cached = m_resolutions.find(h, [&](const Signature& s) {
+		if (s.name != name || s.types.size() != args.size()) {
+			return false;
+		}
+		for (::std::size_t i = 0; i < args.size(); ++i) {
+			if (s.types[i] != args[i].typeDescriptor()) {
+				return false;
+			}
+		}
+		return true;
+	});
+
+	Resolution r;
+	if (cached != nullptr && cached->generation == generation && cached->hierarchyGeneration == hierarchyGeneration) {
+		r = *cached;
+	} else {
+		r.function = pickOverload(name, args, r.ambiguous);
+		r.generation = generation;
+		r.hierarchyGeneration = hierarchyGeneration;
+
+		// replacing a stale decision adds a node that is never freed, so once loading
+		// libraries has outdated too many, the remaining signatures are resolved every time
+		if (m_cachedResolutions.fetch_add(1, ::std::memory_order_relaxed) < max_cached_resolutions) {
+			Signature s{ name, {} };
+			for (const VariantValue& arg: args) {
+				s.types.push_back(arg.typeDescriptor());
+			}
+			m_resolutions.assign(s, r);
+		}
+	}
+
+	if (r.ambiguous) {
+		throw ::std::runtime_error(strconv::fmt_str("call of overloaded function %1 is ambiguous", name.str()));
+	}
+	return r.function;
 }
+#endif
 
 FunctionRegistry& FunctionRegistry::instance() {
 	static FunctionRegistry instance;
@@ -848,6 +1413,123 @@ namespace std {
 	}
 }
 
+//--------prepared call----------------------------------------
+
+PreparedCall::PreparedCall()
+	: m_call(nullptr)
+	, m_hasObject(false)
+	, m_isConst(false)
+	, m_object() {}
+
+bool PreparedCall::isValid() const
+{
+	return m_call != nullptr || m_method.isValid() || m_function.isValid();
+}
+
+void PreparedCall::check_valid() const
+{
+	if (!isValid()) {
+		throw std::runtime_error("Invalid use of uninitialized PreparedCall handle");
+	}
+}
+
+::std::size_t PreparedCall::numberOfArguments() const
+{
+	check_valid();
+	if (m_method.isValid()) {
+		return m_method.numberOfArguments();
+	} else if (m_function.isValid()) {
+		return m_function.numberOfArguments();
+	}
+	return m_arguments.size();
+}
+
+void PreparedCall::checkArguments(ArgumentView vargs) const
+{
+	if (vargs.size() < m_arguments.size()) {
+		throw ::std::runtime_error("prepared call with insufficient number of arguments");
+	}
+	for (::std::size_t i = 0; i < m_arguments.size(); ++i) {
+		if (vargs[i].typeDescriptor() != m_arguments[i].type || vargs[i].isConst() != m_arguments[i].isConst) {
+			throw ::std::runtime_error("prepared call with arguments of other types than the prepared ones");
+		}
+	}
+}
+
+VariantValue PreparedCall::callArgArray(ArgumentView vargs) const
+{
+	check_valid();
+	if (m_hasObject) {
+		throw ::std::runtime_error("prepared method call without an object");
+	}
+	if (m_call == nullptr) {
+		return m_method.isValid() ? m_method.callArgArray(vargs) : m_function.callArgArray(vargs);
+	}
+	checkArguments(vargs);
+	return m_call(nullptr, vargs, m_arguments.data());
+}
+
+VariantValue PreparedCall::callArgArray(VariantValue& object, ArgumentView vargs) const
+{
+	check_valid();
+	if (!m_hasObject) {
+		return callArgArray(vargs);
+	}
+	if (m_call == nullptr) {
+		return m_method.callArgArray(object, vargs);
+	}
+	return callPrepared(object, vargs);
+}
+
+VariantValue PreparedCall::callArgArray(const VariantValue& object, ArgumentView vargs) const
+{
+	check_valid();
+	if (!m_hasObject) {
+		return callArgArray(vargs);
+	}
+	if (m_call == nullptr) {
+		return m_method.callArgArray(object, vargs);
+	}
+	if (!m_isConst) {
+		throw ::std::runtime_error("Called non-const method of const object");
+	}
+	return callPrepared(object, vargs);
+}
+
+VariantValue PreparedCall::callPrepared(const VariantValue& object, ArgumentView vargs) const
+{
+	if (object.typeDescriptor() != m_object.type || object.isConst() != m_object.isConst) {
+		throw ::std::runtime_error("prepared call with an object of another type than the prepared one");
+	}
+	checkArguments(vargs);
+	return callObject(object, vargs);
+}
+
+bool PreparedCall::consumesArgument(::std::size_t i) const
+{
+	// without prepared call support the parameters are unknown
+	return m_call == nullptr || (i < m_arguments.size() && m_arguments[i].consumed);
+}
+
+bool PreparedCall::acceptsObject(const VariantValue& object) const
+{
+	return m_call == nullptr || (object.isValid() && object.typeDescriptor() == m_object.type && object.isConst() == m_object.isConst);
+}
+
+VariantValue PreparedCall::callObject(VariantValue& object, ArgumentView vargs) const
+{
+	if (m_call == nullptr) {
+		return m_method.callArgArray(object, vargs);
+	}
+	return callObject(static_cast<const VariantValue&>(object), vargs);
+}
+
+VariantValue PreparedCall::callObject(const VariantValue& object, ArgumentView vargs) const
+{
+	char* ptr = const_cast<char*>(reinterpret_cast<const char*>(object.ptrToValue()));
+	return m_call(ptr + m_object.offset, vargs, m_arguments.data());
+}
+
 //--------proxy------------------------------------------------
 
 Proxy::~Proxy() {
@@ -29,8 +29,10 @@
 #include "collection_utils.h"
 #include "variant.h"
 
+#include <cstdint>
 #include <set>
 #include <list>
+#include <string>
 #ifndef NO_RTTI
 #include <typeinfo>
 #endif
@@ -65,8 +67,127 @@ private:
 	Annotated& m_instance;
 };
 
+/** Interned name of a class or member.
+ *
+ *  Every distinct name gets a small integer id in a global table. Class, method
+ *  and attribute names are interned when they are registered, so comparing two
+ *  symbols is an integer compare and the name indexes of the classes are keyed
+ *  on the ids. The hash of the name is computed once and kept in the handle.
+ *  The default constructed symbol is invalid and isn't equal to any name.
+ */
+class Symbol {
+public:
+
+	Symbol() : m_id(0), m_hash(0) {}
+
+	/** the symbol of name, which is added to the table if needed */
+	static Symbol intern(const char* name);
+	static Symbol intern(const ::std::string& name);
+
+	/** the symbol of name if it was ever interned, an invalid symbol otherwise */
+	static Symbol find(const char* name);
+	static Symbol find(const ::std::string& name);
+
+	bool isValid() const { return m_id != 0; }
+
+	::std::uint32_t id() const { return m_id; }
+	::std::size_t hash() const { return m_hash; }
+
+	const ::std::string& str() const;
+
+private:
+
+	Symbol(::std::uint32_t id, ::std::size_t hash) : m_id(id), m_hash(hash) {}
+
+	::std::uint32_t m_id;
+	::std::size_t m_hash;
+
+	friend class SymbolTable;
+};
+
+inline bool operator==(const Symbol& s1, const Symbol& s2)
+{
+	return s1.id() == s2.id();
+}
+
+inline bool operator!=(const Symbol& s1, const Symbol& s2)
+{
+	return s1.id() != s2.id();
+}
+
+// by id, which is the order of interning, not the alphabetical order
+inline bool operator<(const Symbol& s1, const Symbol& s2)
+{
+	return s1.id() < s2.id();
+}
+
+namespace std {
+	template<>
+	struct hash< ::Symbol> {
+		size_t operator()(const Symbol& s) const {
+			return s.hash();
+		}
+	};
+}
+
 class AbstractAttributeImpl;
 
+/** Typed access to a non-static attribute through its offset inside the object.
+ *
+ *  The object pointers must point to an object of the class that declares the
+ *  attribute, e.g. VariantValue::ptrToValue of a value of that exact class.
+ *  The only check made is a comparison of the requested type with the type of
+ *  the attribute, so reads and writes cost about as much as direct member access.
+ */
+class RawAttributeAccessor {
+public:
+
+	RawAttributeAccessor();
+
+	bool isValid() const { return m_type != nullptr; }
+
+	::std::ptrdiff_t offset() const { return m_offset; }
+	::std::size_t size() const { return m_size; }
+
+	// the attribute can be copied with memcpy
+	bool isTriviallyCopyable() const { return m_isTriviallyCopyable; }
+
+	template<class T>
+	const T& get(const void* object) const {
+		check_type<T>();
+		return *reinterpret_cast<const T*>(static_cast<const char*>(object) + m_offset);
+	}
+
+	template<class T>
+	void set(void* object, const T& value) const {
+		check_type<T>();
+		if (m_isConst) {
+			throw ::std::runtime_error("cannot change value of const attribute");
+		}
+		*reinterpret_cast<T*>(static_cast<char*>(object) + m_offset) = value;
+	}
+
+	// copies the attribute between two objects, only for trivially copyable attributes
+	void copy(void* to, const void* from) const;
+
+private:
+
+	template<class T>
+	void check_type() const {
+		if (&type_descriptor<typename ::std::remove_cv<T>::type>::value != m_type) {
+			throw ::std::runtime_error("attribute accessed as a value of another type");
+		}
+	}
+
+	const TypeDescriptor* m_type;
+	::std::ptrdiff_t m_offset;
+	::std::size_t m_size;
+	bool m_isConst;
+	bool m_isTriviallyCopyable;
+
+	friend class Attribute;
+};
+
 class Attribute: public AnnotatedFrontend {
 public:
 	
@@ -77,6 +198,7 @@ public:
 	Attribute& operator=(Attribute&& rhs);
 	
 	::std::string name() const;
+	Symbol symbol() const;
 	::std::string typeSpelling() const;
 	
 #ifndef NO_RTTI
@@ -93,6 +215,18 @@ public:
 	void set(VariantValue& object, const VariantValue& value) const;
 	void set(const VariantValue& object, const VariantValue& value) const;
 
+	/** reads the attribute of each object into results, which must have room for objects.size() values.
+	 *  The class of the objects is verified once for each run of objects of the same type.
+	 *  Big batches are split across numThreads threads */
+	void getBatch(ArgumentView objects, VariantValue* results, unsigned int numThreads = 1) const;
+	void getBatch(ArgumentView objects, ::std::vector<VariantValue>& results, unsigned int numThreads = 1) const {
+		results.resize(objects.size());
+		getBatch(objects, results.data(), numThreads);
+	}
+
+	// throws for static attributes
+	RawAttributeAccessor rawAccessor() const;
+
 	bool isValid() const;
 
 	Class getClass() const;
@@ -114,6 +248,7 @@ private:
 	friend Attribute make_attribute(const char* name, A ptr, const char* arg);
 	template<class C, class A>
 	friend Attribute make_static_attribute(const char* name, A ptr, const char* arg);
+	friend class SerializationPlan;
 
 	friend struct std::hash<Attribute>;
 	friend class ClassImpl;
@@ -149,22 +284,37 @@ public:
 	bool isValid() const;
 
 	::std::size_t numberOfArguments() const;
-	::std::vector< ::std::string> argumentSpellings() const;
+	const ::std::vector< ::std::string>& argumentSpellings() const;
+
+	/** hash of the argument types, equal for callables that accept the same arguments */
+	::std::size_t signatureHash() const;
 	
 	bool isDefaultConstructor() const;
 	
 #ifndef NO_RTTI
-	::std::vector<const ::std::type_info*> argumentTypes() const;
+	const ::std::vector<const ::std::type_info*>& argumentTypes() const;
 #endif
 	
 	template<class... Args>
 	VariantValue call(Args&&... args) const {
-		::std::vector<VariantValue> vargs;
-		emplace(vargs, args...);
+		const auto vargs = make_arguments(args...);
 		return callArgArray(vargs);
 	}
 
-	VariantValue callArgArray(const ::std::vector<VariantValue>& vargs) const ;
+	VariantValue callArgArray(ArgumentView vargs) const;
+	VariantValue callArgArray(const ::std::vector<VariantValue>& vargs) const { return callArgArray(ArgumentView(vargs)); }
+
+	/** builds the object in storage instead of on the heap. storage must hold
+	 *  getClass().sizeOf() bytes aligned to getClass().alignOf(), the object
+	 *  must be destroyed with Class::destroyAt. If the constructor throws
+	 *  nothing has been built in storage */
+	template<class... Args>
+	void constructAt(void* storage, Args&&... args) const {
+		const auto vargs = make_arguments(args...);
+		constructAtArgArray(storage, vargs);
+	}
+
+	void constructAtArgArray(void* storage, ArgumentView vargs) const;
 
 	Class getClass() const;
 	
@@ -202,7 +352,13 @@ inline bool operator!=(const Constructor& c1, const Constructor& c2) {
 
 class MethodImpl;
 
-typedef VariantValue (*boundmethod)(const volatile VariantValue&, const ::std::vector<VariantValue>& args);
+typedef VariantValue (*boundmethod)(const volatile VariantValue&, ArgumentView args);
+
+// entry points for prepared calls, see PreparedCall
+typedef int (*preparemethod)(const volatile VariantValue& object, ArgumentView args, PreparedArgument* prepared);
+typedef VariantValue (*preparedcall)(void* object, ArgumentView args, const PreparedArgument* prepared);
+
+class PreparedCall;
 
 class Method: public AnnotatedFrontend {
 public:
@@ -214,12 +370,17 @@ public:
 	Method& operator=(Method&& rhs);
 	
 	::std::string name() const;
+	Symbol symbol() const;
 	::std::size_t numberOfArguments() const;
 	::std::string returnSpelling() const;
-	::std::vector< ::std::string> argumentSpellings() const;
+	const ::std::vector< ::std::string>& argumentSpellings() const;
+
+	/** hash of the argument types and of const and volatile, equal for
+	 *  methods that accept the same arguments on the same objects */
+	::std::size_t signatureHash() const;
 
 #ifndef NO_RTTI
-	::std::vector<const ::std::type_info*> argumentTypes() const;
+	const ::std::vector<const ::std::type_info*>& argumentTypes() const;
 	const ::std::type_info& returnType() const;
 #endif
 
@@ -229,40 +390,61 @@ public:
 
 	template<class... Args>
 	VariantValue call(Args&&... args) const {
-		::std::vector<VariantValue> vargs;
-		emplace(vargs, args...);
+		const auto vargs = make_arguments(args...);
 		return callArgArray(vargs );
 	}
 	template<class... Args>
 	VariantValue call(VariantValue& object, Args&&... args) const {
-		::std::vector<VariantValue> vargs;
-		emplace(vargs, args...);
+		const auto vargs = make_arguments(args...);
 		return callArgArray(object, vargs );
 	}
 	template<class... Args>
 	VariantValue call(const VariantValue& object, Args&&... args) const {
-		::std::vector<VariantValue> vargs;
-		emplace(vargs, args...);
+		const auto vargs = make_arguments(args...);
 		return callArgArray(object, vargs );
 	}
 	template<class... Args>
 	VariantValue call(volatile VariantValue& object, Args&&... args) const {
-		::std::vector<VariantValue> vargs;
-		emplace(vargs, args...);
+		const auto vargs = make_arguments(args...);
 		return callArgArray(object, vargs );
 	}
 	template<class... Args>
 	VariantValue call(const volatile VariantValue& object, Args&&... args) const {
-		::std::vector<VariantValue> vargs;
-		emplace(vargs, args...);
+		const auto vargs = make_arguments(args...);
 		return callArgArray(object, vargs );
 	}
 
-	VariantValue callArgArray(const ::std::vector<VariantValue>& vargs) const;
-	VariantValue callArgArray(VariantValue& object, const ::std::vector<VariantValue>& vargs) const;
-	VariantValue callArgArray(const VariantValue& object, const ::std::vector<VariantValue>& vargs) const;
-	VariantValue callArgArray(volatile VariantValue& object, const ::std::vector<VariantValue>& vargs) const;
-	VariantValue callArgArray(const volatile VariantValue& object, const ::std::vector<VariantValue>& vargs) const;
+	VariantValue callArgArray(ArgumentView vargs) const;
+	VariantValue callArgArray(VariantValue& object, ArgumentView vargs) const;
+	VariantValue callArgArray(const VariantValue& object, ArgumentView vargs) const;
+	VariantValue callArgArray(volatile VariantValue& object, ArgumentView vargs) const;
+	VariantValue callArgArray(const volatile VariantValue& object, ArgumentView vargs) const;
+
+	VariantValue callArgArray(const ::std::vector<VariantValue>& vargs) const { return callArgArray(ArgumentView(vargs)); }
+	VariantValue callArgArray(VariantValue& object, const ::std::vector<VariantValue>& vargs) const { return callArgArray(object, ArgumentView(vargs)); }
+	VariantValue callArgArray(const VariantValue& object, const ::std::vector<VariantValue>& vargs) const { return callArgArray(object, ArgumentView(vargs)); }
+	VariantValue callArgArray(volatile VariantValue& object, const ::std::vector<VariantValue>& vargs) const { return callArgArray(object, ArgumentView(vargs)); }
+	VariantValue callArgArray(const volatile VariantValue& object, const ::std::vector<VariantValue>& vargs) const { return callArgArray(object, ArgumentView(vargs)); }
+
+	/** checks object and arguments once, the returned call can be repeated with values of the same types */
+	PreparedCall bind(VariantValue& object, ArgumentView vargs) const;
+	PreparedCall bind(const VariantValue& object, ArgumentView vargs) const;
+
+	// for static methods
+	PreparedCall bind(ArgumentView vargs) const;
+
+	/** calls the method on each of count objects with the same arguments and stores the results,
+	 *  results must have room for count values. Non-const methods may change the objects, only
+	 *  the held value decides whether an object is const. Types are checked once for each run of
+	 *  objects of the same type, as in bind. Parameters passed by value get their own copy of the
+	 *  argument in each call, so they see the same value every time, while reference parameters
+	 *  refer to the arguments themselves, as in callArgArray. Big batches are split across
+	 *  numThreads threads */
+	void callBatch(VariantValue* objects, ::std::size_t count, ArgumentView vargs, VariantValue* results, unsigned int numThreads = 1) const;
+	void callBatch(::std::vector<VariantValue>& objects, ArgumentView vargs, ::std::vector<VariantValue>& results, unsigned int numThreads = 1) const {
+		results.resize(objects.size());
+		callBatch(objects.data(), objects.size(), vargs, results.data(), numThreads);
+	}
 
 	Class getClass() const;
 
@@ -324,6 +506,31 @@ public:
 	typedef ::std::list<Class> ClassList;
 	typedef ::std::list<Attribute> AttributeList;
 
+	/** contiguous range of methods, returned by the name keyed lookups.
+	 *  Stays valid as long as the class exists. It doesn't see methods that
+	 *  are inherited later, from bases that are resolved when a library
+	 *  loads, the name has to be looked up again for those */
+	class MethodRange {
+	public:
+		typedef const Method* const_iterator;
+
+		MethodRange() : m_begin(nullptr), m_end(nullptr) {}
+		MethodRange(const Method* begin, const Method* end) : m_begin(begin), m_end(end) {}
+
+		const_iterator begin() const { return m_begin; }
+		const_iterator end() const { return m_end; }
+
+		::std::size_t size() const { return m_end - m_begin; }
+		bool empty() const { return m_begin == m_end; }
+
+		const Method& operator[](::std::size_t i) const { return m_begin[i]; }
+		const Method& front() const { return *m_begin; }
+
+	private:
+		const Method* m_begin;
+		const Method* m_end;
+	};
+
 	Class();
 	
 	Class(const Class& rhs);
@@ -339,6 +546,8 @@ public:
 	std::string simpleName() const;
 	
 	const std::string& fullyQualifiedName() const;
+
+	Symbol symbol() const;
 	
 #ifndef NO_RTTI
 	const ::std::type_info& typeId() const;
@@ -350,12 +559,27 @@ public:
 #endif
 	
 	bool isSubClassOf(const Class& rhs) const;
+
+	/** the number of derivation steps from this class to base on the shortest
+	 *  path, 0 for the class itself and -1 if base is not one of its bases */
+	int inheritanceDistance(const Class& base) const;
 		
 	const MethodList& methods() const;
 
 	Method findMethod(std::function<bool(const Method& m)> criteria) const;
 
 	MethodList findAllMethods(std::function<bool(const Method& m)> criteria) const;
+
+	/** all methods (including inherited ones) with the given name, in registration order.
+	 *  The lookups also work while the class is being registered, but are slower then */
+	MethodRange methodsNamed(const char* name) const;
+	MethodRange methodsNamed(const ::std::string& name) const;
+	MethodRange methodsNamed(Symbol name) const;
+
+	/** the overloads of 'name' taking exactly numArgs arguments */
+	MethodRange methodsNamed(const char* name, ::std::size_t numArgs) const;
+	MethodRange methodsNamed(const ::std::string& name, ::std::size_t numArgs) const;
+	MethodRange methodsNamed(Symbol name, ::std::size_t numArgs) const;
 	
 	const ConstructorList& constructors() const;
 
@@ -367,6 +591,11 @@ public:
 
 	Attribute getAttribute(const std::string& name) const;
 
+	/** same as getAttribute, but uses the name index of the class */
+	Attribute attribute(const char* name) const;
+	Attribute attribute(const ::std::string& name) const;
+	Attribute attribute(Symbol name) const;
+
 	Attribute findAttribute(std::function<bool(const Attribute& m)> criteria) const;
 
 	AttributeList findAllAttributes(std::function<bool(const Attribute& m)> criteria) const;
@@ -378,6 +607,7 @@ public:
 	ClassList findAllSuperClasses(std::function<bool(const Class& m)> criteria) const;
 
 	static Class lookup(const ::std::string& name);
+	static Class lookup(Symbol name);
 
 #ifndef NO_RTTI
 	static Class lookup(const ::std::type_info& id);
@@ -386,6 +616,14 @@ public:
 	bool isInterface() const;
 
 	bool hasUnresolvedBases() const;
+
+	/** size and alignment of an instance, for storage passed to Constructor::constructAt */
+	::std::size_t sizeOf() const;
+	::std::size_t alignOf() const;
+
+	/** runs the destructor of the instance at object, which must have been
+	 *  built by one of the constructors of this class. The storage isn't freed */
+	void destroyAt(void* object) const;
 	
 private:
 
@@ -401,6 +639,8 @@ private:
 	friend class Attribute;
 	friend class Method;
 	friend class Proxy;
+	friend class ClassImpl;
+	friend class ClassRegistry;
 };
 
 
@@ -433,7 +673,9 @@ bool inheritedBy(const Class& c1, const Class& c2);
 
 class FunctionImpl;
 
-typedef VariantValue (*boundfunction)(const ::std::vector<VariantValue>& args);
+typedef VariantValue (*boundfunction)(ArgumentView args);
+
+typedef void (*preparefunction)(ArgumentView args, PreparedArgument* prepared);
 
 class Function: public AnnotatedFrontend {
 public:
@@ -453,23 +695,41 @@ public:
 
 	::std::size_t numberOfArguments() const;
 	::std::string returnSpelling() const;
-	::std::vector< ::std::string> argumentSpellings() const;
+	const ::std::vector< ::std::string>& argumentSpellings() const;
+
+	/** hash of the argument types, equal for callables that accept the same arguments */
+	::std::size_t signatureHash() const;
 
 #ifndef NO_RTTI
 	const ::std::type_info& returnType() const;
-	::std::vector<const ::std::type_info*> argumentTypes() const;
+	const ::std::vector<const ::std::type_info*>& argumentTypes() const;
 #endif
 
 	template<class... Args>
 	VariantValue call(Args&&... args) const {
-		::std::vector<VariantValue> vargs;
-		emplace(vargs, args...);
+		const auto vargs = make_arguments(args...);
 		return callArgArray(vargs);
 	}
 
-	VariantValue callArgArray(const ::std::vector<VariantValue>& vargs) const;
+	VariantValue callArgArray(ArgumentView vargs) const;
+	VariantValue callArgArray(const ::std::vector<VariantValue>& vargs) const { return callArgArray(ArgumentView(vargs)); }
+
+	/** checks the arguments once, the returned call can be repeated with values of the same types */
+	PreparedCall prepare(ArgumentView vargs) const;
 
 	static const FunctionList& findFunctions(const ::std::string& name);
+	static const FunctionList& findFunctions(Symbol name);
+
+#ifndef NO_RTTI
+	/** the overload of name whose argumentTypes() fit the types of args best.
+	 *  An argument of the exact type is better than one of a derived class, which
+	 *  is better than an arithmetic conversion. Returns an invalid function if no
+	 *  overload fits and throws if several fit equally well. The decision is
+	 *  cached for the name and the argument types, so that repeated calls only
+	 *  cost a hash lookup */
+	static Function resolve(const ::std::string& name, ArgumentView args);
+	static Function resolve(Symbol name, ArgumentView args);
+#endif
 
 private:
 
@@ -480,6 +740,10 @@ private:
 
 	template<class FuncPtr>
 	friend Function make_function(boundfunction bf, const char* name, const char* rString, const char* argString);
+	template<class FuncPtr>
+	friend Function make_function(boundfunction bf, const char* name, const char* rString, const char* argString, preparedcall prepared);
+	template<class FuncType>
+	friend class FuncRegHelper;
 	friend struct std::hash<Function>;
 };
 
@@ -499,6 +763,64 @@ inline bool operator!=(const Function& f1, const Function& f2) {
 	return !(f1 == f2);
 }
 
+/** A method or function call whose types were checked in advance.
+ *
+ *  Method::bind and Function::prepare look at a sample object and sample
+ *  arguments once: they verify the object, find base class offsets and decide
+ *  which arguments can be passed without conversion. Invoking the prepared call
+ *  only compares the types of the values with the recorded ones, then adjusts
+ *  the pointers and calls the method. Passing values of other types (or with
+ *  another constness) throws a runtime_error.
+ */
+class PreparedCall {
+public:
+
+	PreparedCall();
+
+	bool isValid() const;
+
+	::std::size_t numberOfArguments() const;
+
+	// for functions and static methods
+	VariantValue callArgArray(ArgumentView vargs) const;
+	VariantValue callArgArray(VariantValue& object, ArgumentView vargs) const;
+	VariantValue callArgArray(const VariantValue& object, ArgumentView vargs) const;
+
+	VariantValue callArgArray(const ::std::vector<VariantValue>& vargs) const { return callArgArray(ArgumentView(vargs)); }
+	VariantValue callArgArray(VariantValue& object, const ::std::vector<VariantValue>& vargs) const { return callArgArray(object, ArgumentView(vargs)); }
+	VariantValue callArgArray(const VariantValue& object, const ::std::vector<VariantValue>& vargs) const { return callArgArray(object, ArgumentView(vargs)); }
+
+private:
+
+	void check_valid() const;
+
+	void checkArguments(ArgumentView vargs) const;
+
+	VariantValue callPrepared(const VariantValue& object, ArgumentView vargs) const;
+
+	bool acceptsObject(const VariantValue& object) const;
+
+	// the parameter at i may move from its argument
+	bool consumesArgument(::std::size_t i) const;
+
+	// no checks, the object and the arguments are known to match
+	VariantValue callObject(VariantValue& object, ArgumentView vargs) const;
+	VariantValue callObject(const VariantValue& object, ArgumentView vargs) const;
+
+	preparedcall m_call;
+	bool m_hasObject;
+	bool m_isConst; // the method is const
+	PreparedArgument m_object;
+	::std::vector<PreparedArgument> m_arguments;
+
+	// used instead of m_call for methods and functions registered without prepared call support
+	Method m_method;
+	Function m_function;
+
+	friend class Method;
+	friend class Function;
+};
+
 class ProxyImpl;
 
 class Proxy {
@@ -519,7 +841,8 @@ public:
 	~Proxy();
 
 	typedef std::list<Class> IFaceList;
-	typedef std::function<VariantValue(const std::vector<VariantValue>&)> MethodHandler;
+	// called with the arguments of the stub call, which only live as long as the call
+	typedef std::function<VariantValue(ArgumentView)> MethodHandler;
 
 	Proxy(Class iface);
 
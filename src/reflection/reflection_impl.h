@@ -12,7 +12,7 @@
 #include "method.h"
 #include "proxy.h"
 #include "reflection.h"
-#include <unordered_map>
+#include "registry_map.h"
 #include <list>
 
 #ifndef NO_RTTI
@@ -24,14 +24,35 @@
 #define UNIQUE TOKENPASTE2(Unique_, __LINE__)
 #define COMMA ,
 
+/** Lookups may run in any thread, also while libraries with more classes are
+ *  being loaded: they are lock-free and always see a consistent registry.
+ *
+ *  REFL_BEGIN_CLASS only registers the name and a factory, the meta-class with
+ *  its methods, constructors and attributes is built on the first lookup */
 class ClassRegistry {
 public:
+	typedef Class (*ClassFactory)();
+
 	void registerClass(const Class& c);
 
+#ifndef NO_RTTI
+	void registerClass(const char* name, const ::std::type_info& id, ClassFactory factory);
+#else
+	void registerClass(const char* name, ClassFactory factory);
+#endif
+
 	const Class forName(const ::std::string& name) const;
 
+	const Class forName(Symbol name) const;
+
 #ifndef NO_RTTI
 	const Class forTypeId(const ::std::type_info& id) const;
+
+	// the classes of pointer arguments, pointer types are only needed to resolve overloads
+	void registerPointerTypes(const ::std::type_info& pointer, const ::std::type_info& constPointer, ClassFactory factory);
+
+	// the class that a pointer of type id points to, invalid for other types
+	const Class forPointerTypeId(const ::std::type_info& id, bool& pointsToConst) const;
 #endif
 
 	static ClassRegistry& instance();
@@ -39,9 +60,28 @@ public:
 private:
 	ClassRegistry() {}
 
-	::std::unordered_map< ::std::string, Class > m_registryByName;
+	/** either a factory or the built class. A plain pointer, since the map
+	 *  copies entries while holding its lock and copying a Class handle
+	 *  resolves its bases, which takes locks of its own */
+	struct Entry {
+		ClassFactory factory;
+		ClassImpl* impl;
+	};
+
+	// builds the class of e on its first lookup and replaces e with the built class
+	template<class Key>
+	static Class get(registry_map< Key, Entry >& registry, const Key& key, const Entry* e);
+
+	mutable registry_map< Symbol, Entry > m_registryByName;
 #ifndef NO_RTTI
-	::std::unordered_map< ::std::type_index, Class > m_registryByTypeId;
+	mutable registry_map< ::std::type_index, Entry > m_registryByTypeId;
+
+	struct PointerEntry {
+		ClassFactory factory;
+		bool pointsToConst;
+	};
+
+	registry_map< ::std::type_index, PointerEntry > m_registryByPointerTypeId;
 #endif
 };
 
@@ -50,7 +90,12 @@ namespace {
 	template<class Clazz>
 	struct ClassRegHelper {
 		ClassRegHelper( const char* name ) {
-			ClassRegistry::instance().registerClass(ClassOf<Clazz>());
+#ifndef NO_RTTI
+			ClassRegistry::instance().registerClass(name, typeid(Clazz), &ClassOf<Clazz>);
+			ClassRegistry::instance().registerPointerTypes(typeid(Clazz*), typeid(const Clazz*), &ClassOf<Clazz>);
+#else
+			ClassRegistry::instance().registerClass(name, &ClassOf<Clazz>);
+#endif
 		}
 	};
 
@@ -63,9 +108,10 @@ namespace {
 template<> ClassImpl* ClassImpl::inst<CLASS_NAME>() {\
 	typedef CLASS_NAME ThisClass;\
 	static ClassImpl instance;\
-	if (instance.open()) {\
-	instance.setTypeInfo(typeid(ThisClass)); \
-		instance.setFullyQualifiedName(#CLASS_NAME);
+	static const bool closed = [] {\
+		instance.setTypeInfo(typeid(ThisClass)); \
+		instance.setFullyQualifiedName(#CLASS_NAME);\
+		instance.setLayout(sizeof(ThisClass), alignof(ThisClass), class_destructor<ThisClass>::value());
 
 #else
 
@@ -74,20 +120,32 @@ template<> ClassImpl* ClassImpl::inst<CLASS_NAME>() {\
 template<> ClassImpl* ClassImpl::inst<CLASS_NAME>() {\
 	typedef CLASS_NAME ThisClass;\
 	static ClassImpl instance;\
-	if (instance.open()) {\
-		instance.setFullyQualifiedName(#CLASS_NAME);
+	static const bool closed = [] {\
+		instance.setFullyQualifiedName(#CLASS_NAME);\
+		instance.setLayout(sizeof(ThisClass), alignof(ThisClass), class_destructor<ThisClass>::value());
 
 #endif
 
 #define REFL_END_CLASS \
 	instance.close();\
-}\
+	return true;\
+}();\
+(void)closed;\
 return &instance;\
 }
 
+#ifndef NO_RTTI
+
+#define REFL_SUPER_CLASS(CLASS_NAME) \
+instance.registerSuperClass(#CLASS_NAME, typeid(CLASS_NAME), base_offset<ThisClass, CLASS_NAME>::known, base_offset<ThisClass, CLASS_NAME>::value());
+
+#else
+
 #define REFL_SUPER_CLASS(CLASS_NAME) \
 instance.registerSuperClass(#CLASS_NAME);
 
+#endif
+
 
 #ifndef NO_RTTI
 
@@ -104,6 +162,8 @@ static MethodImpl impl(\
 			  false\
 			  , typeid(typename method_type<RESULT(ThisClass::*)(__VA_ARGS__)>::Result)\
 			  , get_typeinfo<typename method_type<RESULT(ThisClass::*)(__VA_ARGS__)>::Arguments>()\
+			  , &method_type<RESULT(ThisClass::*)(__VA_ARGS__)>::prepare\
+			  , &method_type<RESULT(ThisClass::*)(__VA_ARGS__)>::callprepared<&ThisClass::METHOD_NAME>\
 			  );\
 instance.registerMethod(Method(&impl));\
 }
@@ -121,6 +181,8 @@ static MethodImpl impl(\
 			  false\
 			  , typeid(typename method_type<RESULT(ThisClass::*)(__VA_ARGS__) const>::Result)\
 			  , get_typeinfo<typename method_type<RESULT(ThisClass::*)(__VA_ARGS__) const>::Arguments>()\
+			  , &method_type<RESULT(ThisClass::*)(__VA_ARGS__) const>::prepare\
+			  , &method_type<RESULT(ThisClass::*)(__VA_ARGS__) const>::callprepared<&ThisClass::METHOD_NAME>\
 			  );\
 instance.registerMethod(Method(&impl));\
 }
@@ -138,6 +200,8 @@ static MethodImpl impl(\
 			  false\
 			  , typeid(typename method_type<RESULT(ThisClass::*)(__VA_ARGS__) volatile>::Result)\
 			  , get_typeinfo<typename method_type<RESULT(ThisClass::*)(__VA_ARGS__) volatile>::Arguments>()\
+			  , &method_type<RESULT(ThisClass::*)(__VA_ARGS__) volatile>::prepare\
+			  , &method_type<RESULT(ThisClass::*)(__VA_ARGS__) volatile>::callprepared<&ThisClass::METHOD_NAME>\
 			  );\
 instance.registerMethod(Method(&impl));\
 }
@@ -155,6 +219,8 @@ static MethodImpl impl(\
 			  false\
 			  , typeid(typename method_type<RESULT(ThisClass::*)(__VA_ARGS__) const volatile>::Result)\
 			  , get_typeinfo<typename method_type<RESULT(ThisClass::*)(__VA_ARGS__) const volatile>::Arguments>()\
+			  , &method_type<RESULT(ThisClass::*)(__VA_ARGS__) const volatile>::prepare\
+			  , &method_type<RESULT(ThisClass::*)(__VA_ARGS__) const volatile>::callprepared<&ThisClass::METHOD_NAME>\
 			  );\
 instance.registerMethod(Method(&impl));\
 }
@@ -172,6 +238,8 @@ static MethodImpl impl(\
 			true\
 			, typeid(typename method_type<RESULT(*)(__VA_ARGS__)>::Result)\
 			, get_typeinfo<typename method_type<RESULT(*)(__VA_ARGS__)>::Arguments>()\
+			, &method_type<RESULT(*)(__VA_ARGS__)>::prepare\
+			, &method_type<RESULT(*)(__VA_ARGS__)>::callprepared<&ThisClass::METHOD_NAME>\
 			);\
 instance.registerMethod(Method(&impl));\
 }
@@ -190,6 +258,8 @@ static MethodImpl impl(\
 			  method_type<RESULT(ThisClass::*)(__VA_ARGS__)>::is_const,\
 			  method_type<RESULT(ThisClass::*)(__VA_ARGS__)>::is_volatile,\
 			  false\
+			  , &method_type<RESULT(ThisClass::*)(__VA_ARGS__)>::prepare\
+			  , &method_type<RESULT(ThisClass::*)(__VA_ARGS__)>::callprepared<&ThisClass::METHOD_NAME>\
 			  );\
 instance.registerMethod(Method(&impl));\
 }
@@ -205,6 +275,8 @@ static MethodImpl impl(\
 			  method_type<RESULT(ThisClass::*)(__VA_ARGS__) const>::is_const,\
 			  method_type<RESULT(ThisClass::*)(__VA_ARGS__) const>::is_volatile,\
 			  false\
+			  , &method_type<RESULT(ThisClass::*)(__VA_ARGS__) const>::prepare\
+			  , &method_type<RESULT(ThisClass::*)(__VA_ARGS__) const>::callprepared<&ThisClass::METHOD_NAME>\
 			  );\
 instance.registerMethod(Method(&impl));\
 }
@@ -220,6 +292,8 @@ static MethodImpl impl(\
 			  method_type<RESULT(ThisClass::*)(__VA_ARGS__) volatile>::is_const,\
 			  method_type<RESULT(ThisClass::*)(__VA_ARGS__) volatile>::is_volatile,\
 			  false\
+			  , &method_type<RESULT(ThisClass::*)(__VA_ARGS__) volatile>::prepare\
+			  , &method_type<RESULT(ThisClass::*)(__VA_ARGS__) volatile>::callprepared<&ThisClass::METHOD_NAME>\
 			  );\
 instance.registerMethod(Method(&impl));\
 }
@@ -235,6 +309,8 @@ static MethodImpl impl(\
 			  method_type<RESULT(ThisClass::*)(__VA_ARGS__) const volatile>::is_const,\
 			  method_type<RESULT(ThisClass::*)(__VA_ARGS__) const volatile>::is_volatile,\
 			  false\
+			  , &method_type<RESULT(ThisClass::*)(__VA_ARGS__) const volatile>::prepare\
+			  , &method_type<RESULT(ThisClass::*)(__VA_ARGS__) const volatile>::callprepared<&ThisClass::METHOD_NAME>\
 			  );\
 instance.registerMethod(Method(&impl));\
 }
@@ -250,6 +326,8 @@ static MethodImpl impl(\
 			false,\
 			false,\
 			true\
+			, &method_type<RESULT(*)(__VA_ARGS__)>::prepare\
+			, &method_type<RESULT(*)(__VA_ARGS__)>::callprepared<&ThisClass::METHOD_NAME>\
 			);\
 instance.registerMethod(Method(&impl));\
 }
@@ -263,39 +341,147 @@ instance.registerMethod(Method(&impl));\
 	static StaticAttributeImpl<ThisClass, decltype(&ThisClass::ATTRIBUTE_NAME)> impl##ATTRIBUTE_NAME(#ATTRIBUTE_NAME, &ThisClass::ATTRIBUTE_NAME, #TYPE_SPELLING);\
 	instance.registerAttribute(&impl##ATTRIBUTE_NAME);
 
+// one impl per registration, so each keeps the argument spellings it was given
+#ifndef NO_RTTI
+
+#define REFL_DEFAULT_CONSTRUCTOR(...) \
+{\
+static ConstructorImpl impl(\
+			&constructor_type<ThisClass>::bindcall,\
+			&constructor_type<ThisClass>::bindconstructat,\
+			0,\
+			""\
+			, get_typeinfo<TypeList<> >()\
+			);\
+instance.registerConstructor(Constructor(&impl));\
+}
+
+#define REFL_CONSTRUCTOR(...) \
+{\
+static ConstructorImpl impl(\
+			&constructor_type<ThisClass, __VA_ARGS__>::bindcall,\
+			&constructor_type<ThisClass, __VA_ARGS__>::bindconstructat,\
+			typelist_size<TypeList<__VA_ARGS__> >::value,\
+			#__VA_ARGS__\
+			, get_typeinfo<TypeList<__VA_ARGS__> >()\
+			);\
+instance.registerConstructor(Constructor(&impl));\
+}
+
+#else
+
 #define REFL_DEFAULT_CONSTRUCTOR(...) \
-	instance.registerConstructor(make_constructor<ThisClass>(""));
+{\
+static ConstructorImpl impl(\
+			&constructor_type<ThisClass>::bindcall,\
+			&constructor_type<ThisClass>::bindconstructat,\
+			0,\
+			""\
+			);\
+instance.registerConstructor(Constructor(&impl));\
+}
 
 #define REFL_CONSTRUCTOR(...) \
-	instance.registerConstructor(make_constructor<ThisClass, __VA_ARGS__>(#__VA_ARGS__));
+{\
+static ConstructorImpl impl(\
+			&constructor_type<ThisClass, __VA_ARGS__>::bindcall,\
+			&constructor_type<ThisClass, __VA_ARGS__>::bindconstructat,\
+			typelist_size<TypeList<__VA_ARGS__> >::value,\
+			#__VA_ARGS__\
+			);\
+instance.registerConstructor(Constructor(&impl));\
+}
+
+#endif
 
 
 #define REFL_STUB(STUBCLASS) \
 	instance.registerInterface(STUBCLASS::create);
 
 
+// lookups are lock-free like the ones of the ClassRegistry
 class FunctionRegistry {
 public:
 
 	const ::std::list<Function>& findFunction(const ::std::string& name) const;
+	const ::std::list<Function>& findFunction(Symbol name) const;
 	void registerFunction(const ::std::string& name, const Function& func);
 
+#ifndef NO_RTTI
+	/** the overload of name that takes arguments of the types of args, see Function::resolve.
+	 *  The decision is cached for the name and the types of the arguments */
+	Function resolve(Symbol name, ArgumentView args);
+#endif
+
 	static FunctionRegistry& instance();
 
 private:
-	FunctionRegistry() {}
+	FunctionRegistry();
 
-	::std::map< ::std::string, ::std::list<Function> > m_registry;
+	registry_map< Symbol, ::std::list<Function> > m_registry;
 	const ::std::list<Function> emptyList;
+
+#ifndef NO_RTTI
+	struct Signature {
+		Symbol name;
+		::std::vector<const TypeDescriptor*> types;
+	};
+
+	struct SignatureHash {
+		::std::size_t operator()(const Signature& s) const;
+	};
+
+	struct SignatureEqual {
+		bool operator()(const Signature& s1, const Signature& s2) const {
+			return s1.name == s2.name && s1.types == s2.types;
+		}
+	};
+
+	struct Resolution {
+		Function function; // invalid if no overload fits
+		bool ambiguous;
+		unsigned int generation; // decisions of older generations were made with fewer overloads
+		unsigned int hierarchyGeneration; // or with fewer classes and bases, see ClassImpl
+	};
+
+	Function pickOverload(Symbol name, ArgumentView args, bool& ambiguous) const;
+
+	enum { max_cached_resolutions = 1 << 16 };
+
+	registry_map< Signature, Resolution, SignatureHash, SignatureEqual > m_resolutions;
+	::std::atomic<unsigned int> m_generation;
+	// nodes of the cache are never freed, see resolve
+	::std::atomic< ::std::size_t> m_cachedResolutions;
+#endif
 };
 
 
 
+// owns the metadata of one registered function. make_function keeps one per
+// signature, which functions with the same signature can't share
 template<class FuncType>
-struct FuncRegHelper {
-	FuncRegHelper( boundfunction bf, const char* name, const char* rString, const char* args ) {
-		FunctionRegistry::instance().registerFunction(name, make_function<FuncType>(bf, name, rString, args));
+class FuncRegHelper {
+public:
+	FuncRegHelper( boundfunction bf, preparedcall prepared, const char* name, const char* rString, const char* args )
+		: m_impl(
+			bf
+			, name
+			, rString
+			, typelist_size<typename function_type<FuncType>::Arguments>::value
+			, args
+#ifndef NO_RTTI
+			, typeid(typename function_type<FuncType>::Result)
+			, get_typeinfo<typename function_type<FuncType>::Arguments>()
+#endif
+			, &function_type<FuncType>::prepare
+			, prepared
+			)
+	{
+		FunctionRegistry::instance().registerFunction(name, Function(&m_impl));
 	}
+
+private:
+	FunctionImpl m_impl;
 };
 
 /*
@@ -303,7 +489,7 @@ struct FuncRegHelper {
 	static FuncRegHelper<RESULT (*)(__VA_ARGS__)> UNIQUE(#NAME, &NAME, #RESULT, #__VA_ARGS__);
 */
 #define REFL_FUNCTION(NAME, RESULT, ...) \
-	static FuncRegHelper<RESULT (*)(__VA_ARGS__)> UNIQUE(&function_type<RESULT (*)(__VA_ARGS__)>::bindcall<&NAME>, #NAME, #RESULT, #__VA_ARGS__);
+	static FuncRegHelper<RESULT (*)(__VA_ARGS__)> UNIQUE(&function_type<RESULT (*)(__VA_ARGS__)>::bindcall<&NAME>, &function_type<RESULT (*)(__VA_ARGS__)>::callprepared<&NAME>, #NAME, #RESULT, #__VA_ARGS__);
 
 
 /* macro wizardry reference:
@@ -543,33 +729,39 @@ struct FuncRegHelper {
 #define TYPE_ARGNAME(...) _TYPE_ARGNAME(NARG(__VA_ARGS__), __VA_ARGS__)
 
 #define REFL_BEGIN_STUB(CLASS, STUBCLASSNAME) \
+	template<> ClassImpl* ClassImpl::inst<CLASS>();\
 	namespace {\
 		class STUBCLASSNAME: public CLASS {\
 			std::shared_ptr<ProxyImpl> impl;\
+			const ProxyImpl::Slots slots;\
 		public:\
-			STUBCLASSNAME(std::shared_ptr<ProxyImpl>& pi) : impl(pi){}\
+			STUBCLASSNAME(std::shared_ptr<ProxyImpl>& pi) : impl(pi), slots(pi->slotsOf(ClassImpl::inst<CLASS>())) {}\
 			typedef CLASS ThisClass;\
 			static VariantValue create(std::shared_ptr<ProxyImpl>& pImpl) { VariantValue ret; ret.construct<STUBCLASSNAME>(pImpl); return std::move(ret); }
 
 #define REFL_STUB_METHOD(CLASS, METHOD_NAME, RESULT, ...) \
 	RESULT METHOD_NAME ( TYPE_ARGNAME(__VA_ARGS__) ) override {\
-		return impl->call(reinterpret_cast<size_t>(&method_type<RESULT(CLASS::*)(__VA_ARGS__)>::bindcall<&CLASS::METHOD_NAME>), ARGNAME(__VA_ARGS__)).moveValueThrow<RESULT>();\
+		static const ::std::size_t slot = ProxyImpl::slotOf(ClassImpl::inst<ThisClass>(), reinterpret_cast<size_t>(&method_type<RESULT(CLASS::*)(__VA_ARGS__)>::bindcall<&CLASS::METHOD_NAME>));\
+		return impl->call(slots, slot, ARGNAME(__VA_ARGS__)).moveValueThrow<RESULT>();\
 	}
 
 #define REFL_STUB_CONST_METHOD(CLASS, METHOD_NAME, RESULT, ...) \
 	RESULT METHOD_NAME ( TYPE_ARGNAME(__VA_ARGS__) ) const override {\
-		return impl->call(reinterpret_cast<size_t>(&method_type<RESULT(CLASS::*)(__VA_ARGS__) const>::bindcall<&CLASS::METHOD_NAME>), ARGNAME(__VA_ARGS__)).moveValueThrow<RESULT>();\
+		static const ::std::size_t slot = ProxyImpl::slotOf(ClassImpl::inst<ThisClass>(), reinterpret_cast<size_t>(&method_type<RESULT(CLASS::*)(__VA_ARGS__) const>::bindcall<&CLASS::METHOD_NAME>));\
+		return impl->call(slots, slot, ARGNAME(__VA_ARGS__)).moveValueThrow<RESULT>();\
 	}
 
 #define REFL_STUB_VOLATILE_METHOD(CLASS, METHOD_NAME, RESULT, ...) \
 	RESULT METHOD_NAME ( TYPE_ARGNAME(__VA_ARGS__) ) volatile override {\
-		return impl->call(reinterpret_cast<size_t>(&method_type<RESULT(CLASS::*)(__VA_ARGS__) volatile>::bindcall<&CLASS::METHOD_NAME>), ARGNAME(__VA_ARGS__)).moveValueThrow<RESULT>();\
+		static const ::std::size_t slot = ProxyImpl::slotOf(ClassImpl::inst<ThisClass>(), reinterpret_cast<size_t>(&method_type<RESULT(CLASS::*)(__VA_ARGS__) volatile>::bindcall<&CLASS::METHOD_NAME>));\
+		return impl->call(slots, slot, ARGNAME(__VA_ARGS__)).moveValueThrow<RESULT>();\
 	}
 
 
 #define REFL_STUB_CONST_VOLATILE_METHOD(CLASS, METHOD_NAME, RESULT, ...) \
 	RESULT METHOD_NAME ( TYPE_ARGNAME(__VA_ARGS__) ) const volatile override {\
-		return impl->call(reinterpret_cast<size_t>(&method_type<RESULT(CLASS::*)(__VA_ARGS__) const volatile>::bindcall<&ThisClass::METHOD_NAME>), ARGNAME(__VA_ARGS__)).moveValueThrow<RESULT>();\
+		static const ::std::size_t slot = ProxyImpl::slotOf(ClassImpl::inst<ThisClass>(), reinterpret_cast<size_t>(&method_type<RESULT(CLASS::*)(__VA_ARGS__) const volatile>::bindcall<&ThisClass::METHOD_NAME>));\
+		return impl->call(slots, slot, ARGNAME(__VA_ARGS__)).moveValueThrow<RESULT>();\
 	}
 
 
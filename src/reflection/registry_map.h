@@ -0,0 +1,144 @@
+/*
+** SelfPortrait API
+** See Copyright Notice in reflection.h
+*/
+#ifndef REGISTRY_MAP_H
+#define REGISTRY_MAP_H
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/** Map for the global registries, which are read by any thread while
+ *  libraries with more metadata are being loaded.
+ *
+ *  Reads are lock-free: the map is an open addressed hash table of pointers
+ *  to immutable nodes. Writers are serialized by a mutex and never change a
+ *  published node, they publish a copy with the new value in its slot, or a
+ *  copy of the whole table when it gets too full. Replaced nodes and tables
+ *  are kept until the map is destroyed, so a reader never sees freed memory
+ *  and the values returned by find stay valid, with the value they had when
+ *  they were found.
+ */
+template<class Key, class Value, class Hash = ::std::hash<Key>, class Equal = ::std::equal_to<Key> >
+class registry_map {
+public:
+
+	registry_map() {
+		m_tables.emplace_back(new table(initial_size));
+		m_table.store(m_tables.back().get(), ::std::memory_order_release);
+	}
+
+	registry_map(const registry_map&) = delete;
+	registry_map& operator=(const registry_map&) = delete;
+
+	// nullptr if there is no value for key
+	const Value* find(const Key& key) const {
+		return find(Hash()(key), [&](const Key& k) { return Equal()(k, key); });
+	}
+
+	/** lookup without building a key: h must be the hash of the key that
+	 *  matches, matches(k) tells whether k is the key that is looked for */
+	template<class Match>
+	const Value* find(::std::size_t h, const Match& matches) const {
+		const table* t = m_table.load(::std::memory_order_acquire);
+		for (::std::size_t i = h & t->mask; ; i = (i + 1) & t->mask) {
+			const node* n = t->slots[i].load(::std::memory_order_acquire);
+			if (n == nullptr) {
+				return nullptr;
+			} else if (n->hash == h && matches(n->key)) {
+				return &n->value;
+			}
+		}
+	}
+
+	void assign(const Key& key, const Value& value) {
+		update(key, [&](Value& v) { v = value; });
+	}
+
+	// publishes f applied to a copy of the value of key, or to a default constructed value
+	template<class F>
+	void update(const Key& key, F f) {
+		::std::lock_guard< ::std::mutex> lock(m_mutex);
+		const ::std::size_t h = Hash()(key);
+		table* t = m_table.load(::std::memory_order_relaxed);
+		::std::size_t i = h & t->mask;
+		const node* old = nullptr;
+		for (; (old = t->slots[i].load(::std::memory_order_relaxed)) != nullptr; i = (i + 1) & t->mask) {
+			if (old->hash == h && Equal()(old->key, key)) {
+				break;
+			}
+		}
+
+		::std::unique_ptr<node> n(old ? new node(*old) : new node(key, h));
+		f(n->value);
+		m_nodes.emplace_back(n.get());
+		const node* published = n.release();
+
+		if (old != nullptr) {
+			t->slots[i].store(published, ::std::memory_order_release);
+		} else {
+			if (2 * (t->used + 1) > t->mask + 1) {
+				t = grow(t);
+			}
+			insert(t, published);
+		}
+	}
+
+private:
+
+	enum { initial_size = 64 };
+
+	struct node {
+		node(const Key& k, ::std::size_t h) : key(k), hash(h), value() {}
+		const Key key;
+		const ::std::size_t hash;
+		Value value;
+	};
+
+	struct table {
+		explicit table(::std::size_t size) : mask(size - 1), used(0), slots(new ::std::atomic<const node*>[size]) {
+			for (::std::size_t i = 0; i < size; ++i) {
+				slots[i].store(nullptr, ::std::memory_order_relaxed);
+			}
+		}
+		const ::std::size_t mask;
+		::std::size_t used;
+		::std::unique_ptr< ::std::atomic<const node*>[]> slots;
+	};
+
+	static void insert(table* t, const node* n) {
+		for (::std::size_t i = n->hash & t->mask; ; i = (i + 1) & t->mask) {
+			if (t->slots[i].load(::std::memory_order_relaxed) == nullptr) {
+				t->slots[i].store(n, ::std::memory_order_release);
+				++t->used;
+				return;
+			}
+		}
+	}
+
+	table* grow(table* old) {
+		table* t = new table(2 * (old->mask + 1));
+		m_tables.emplace_back(t);
+		for (::std::size_t i = 0; i <= old->mask; ++i) {
+			const node* n = old->slots[i].load(::std::memory_order_relaxed);
+			if (n != nullptr) {
+				insert(t, n);
+			}
+		}
+		m_table.store(t, ::std::memory_order_release);
+		return t;
+	}
+
+	::std::atomic<table*> m_table;
+
+	// everything ever published, guarded by m_mutex
+	::std::vector< ::std::unique_ptr<table> > m_tables;
+	::std::vector< ::std::unique_ptr<const node> > m_nodes;
+	::std::mutex m_mutex;
+};
+
+#endif /* REGISTRY_MAP_H */
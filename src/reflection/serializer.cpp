@@ -0,0 +1,500 @@
+/*
+** SelfPortrait API
+** See Copyright Notice in reflection.h
+*/
+#include "serializer.h"
+#include "attribute.h"
+#include "class.h"
+#include "registry_map.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+constexpr SerialType serial_type< ::std::string>::value;
+constexpr SerialType serial_type< ::std::vector<bool> >::value;
+
+/** The compiled form of the attributes of a class. */
+class SerializationPlan {
+public:
+
+	struct Codec {
+		SerialType::Kind kind;
+		// bytes copied for TRIVIAL, otherwise the size of the C++ value
+		::std::size_t size;
+		const SerialType* type;
+		const SerializationPlan* plan;  // OBJECT
+		const Codec* element;           // VECTOR
+		// the fewest bytes a value is written to, set for the elements of vectors
+		::std::size_t minSize;
+	};
+
+	struct Field {
+		::std::ptrdiff_t offset;
+		Codec codec;
+	};
+
+	static const SerializationPlan* get(const Class& clazz);
+
+	Class clazz;
+	::std::size_t size;
+	// sorted by offset, neighbouring TRIVIAL attributes merged
+	::std::vector<Field> fields;
+	// the whole object is one TRIVIAL field
+	bool flat;
+	bool hasConstAttributes;
+
+private:
+
+	struct ClassLess {
+		bool operator()(const Class& c1, const Class& c2) const {
+			return ::std::hash<Class>()(c1) < ::std::hash<Class>()(c2);
+		}
+	};
+
+	typedef ::std::map<Class, SerializationPlan*, ClassLess> Pending;
+
+	static const SerializationPlan* compile(const Class& clazz, Pending& pending);
+
+	Codec compileCodec(const SerialType& type, const ::std::string& name, Pending& pending);
+
+	static bool reachesConstAttributes(const Codec& codec);
+
+	static ::std::size_t minEncodedSize(const Codec& codec);
+
+	void mergeFields();
+
+	// element codecs of vectors, addresses must be stable
+	::std::deque<Codec> m_elements;
+};
+
+namespace {
+
+	struct ClassHash {
+		::std::size_t operator()(const Class& c) const {
+			return ::std::hash<Class>()(c);
+		}
+	};
+
+	// compiled plans are never freed, like the metadata they describe
+	registry_map<Class, const SerializationPlan*, ClassHash>& plans() {
+		static registry_map<Class, const SerializationPlan*, ClassHash> inst;
+		return inst;
+	}
+
+	::std::mutex& compileMutex() {
+		static ::std::mutex inst;
+		return inst;
+	}
+
+	::std::deque< ::std::unique_ptr<SerializationPlan> >& planStorage() {
+		static ::std::deque< ::std::unique_ptr<SerializationPlan> > inst;
+		return inst;
+	}
+
+	typedef ::std::uint32_t length_type;
+
+	// small values are gathered in a local chunk, appending them one by one costs more than copying them
+	class Output {
+	public:
+		explicit Output(::std::string& buffer) : m_buffer(buffer), m_used(0) {}
+
+		void put(const void* data, ::std::size_t size) {
+			if (chunk_size - m_used < size) {
+				flush();
+				if (size > chunk_size / 4) {
+					m_buffer.append(static_cast<const char*>(data), size);
+					return;
+				}
+			}
+			// data of an empty vector may be null
+			if (size != 0) {
+				::std::memcpy(m_chunk + m_used, data, size);
+				m_used += size;
+			}
+		}
+
+		void putLength(::std::size_t length) {
+			if (length > ::std::numeric_limits<length_type>::max()) {
+				throw ::std::runtime_error("value too long to be serialized");
+			}
+			const length_type l = static_cast<length_type>(length);
+			put(&l, sizeof(l));
+		}
+
+		void flush() {
+			m_buffer.append(m_chunk, m_used);
+			m_used = 0;
+		}
+
+	private:
+		enum { chunk_size = 4096 };
+
+		::std::string& m_buffer;
+		::std::size_t m_used;
+		char m_chunk[chunk_size];
+	};
+
+	class Input {
+	public:
+		Input(const char* data, ::std::size_t size) : m_begin(data), m_cursor(data), m_end(data + size) {}
+
+		::std::size_t remaining() const { return m_end - m_cursor; }
+
+		::std::size_t consumed() const { return m_cursor - m_begin; }
+
+		const char* take(::std::size_t size) {
+			if (remaining() < size) {
+				throw ::std::runtime_error("serialized data is truncated");
+			}
+			const char* ret = m_cursor;
+			m_cursor += size;
+			return ret;
+		}
+
+		void get(void* data, ::std::size_t size) {
+			const char* p = take(size);
+			// data of an empty vector may be null
+			if (size != 0) {
+				::std::memcpy(data, p, size);
+			}
+		}
+
+		::std::size_t getLength() {
+			length_type l;
+			get(&l, sizeof(l));
+			return l;
+		}
+
+	private:
+		const char* m_begin;
+		const char* m_cursor;
+		const char* m_end;
+	};
+
+	void writeObject(const SerializationPlan& plan, const char* object, Output& out);
+	void readObject(const SerializationPlan& plan, char* object, Input& in);
+
+	void writeValue(const SerializationPlan::Codec& codec, const char* value, Output& out)
+	{
+		switch (codec.kind) {
+			case SerialType::TRIVIAL:
+				out.put(value, codec.size);
+				break;
+			case SerialType::STRING: {
+				const ::std::string& s = *reinterpret_cast<const ::std::string*>(value);
+				out.putLength(s.size());
+				out.put(s.data(), s.size());
+				break;
+			}
+			case SerialType::VECTOR: {
+				const SerializationPlan::Codec& element = *codec.element;
+				const ::std::size_t count = codec.type->count(value);
+				const char* data = static_cast<const char*>(codec.type->data(value));
+				out.putLength(count);
+				if (element.kind == SerialType::TRIVIAL || (element.kind == SerialType::OBJECT && element.plan->flat)) {
+					out.put(data, count * element.size);
+				} else {
+					for (::std::size_t i = 0; i < count; ++i) {
+						writeValue(element, data + i * element.size, out);
+					}
+				}
+				break;
+			}
+			case SerialType::OBJECT:
+				writeObject(*codec.plan, value, out);
+				break;
+			case SerialType::UNSUPPORTED:
+				break;
+		}
+	}
+
+	void readValue(const SerializationPlan::Codec& codec, char* value, Input& in)
+	{
+		switch (codec.kind) {
+			case SerialType::TRIVIAL:
+				in.get(value, codec.size);
+				break;
+			case SerialType::STRING: {
+				const ::std::size_t length = in.getLength();
+				reinterpret_cast< ::std::string*>(value)->assign(in.take(length), length);
+				break;
+			}
+			case SerialType::VECTOR: {
+				const SerializationPlan::Codec& element = *codec.element;
+				const ::std::size_t count = in.getLength();
+				const bool bulk = element.kind == SerialType::TRIVIAL || (element.kind == SerialType::OBJECT && element.plan->flat);
+				// don't let a corrupt length allocate more than the data can fill
+				if (count != 0 && element.minSize == 0) {
+					throw ::std::runtime_error("vector elements without serialized data can't be read");
+				}
+				if (count != 0 && in.remaining() / element.minSize < count) {
+					throw ::std::runtime_error("serialized data is truncated");
+				}
+				if (codec.type->resize == nullptr) {
+					throw ::std::runtime_error("vector elements can't be default constructed");
+				}
+				char* data = static_cast<char*>(codec.type->resize(value, count));
+				if (bulk) {
+					in.get(data, count * element.size);
+				} else {
+					for (::std::size_t i = 0; i < count; ++i) {
+						readValue(element, data + i * element.size, in);
+					}
+				}
+				break;
+			}
+			case SerialType::OBJECT:
+				readObject(*codec.plan, value, in);
+				break;
+			case SerialType::UNSUPPORTED:
+				break;
+		}
+	}
+
+	void writeObject(const SerializationPlan& plan, const char* object, Output& out)
+	{
+		for (const SerializationPlan::Field& f: plan.fields) {
+			writeValue(f.codec, object + f.offset, out);
+		}
+	}
+
+	void readObject(const SerializationPlan& plan, char* object, Input& in)
+	{
+		for (const SerializationPlan::Field& f: plan.fields) {
+			readValue(f.codec, object + f.offset, in);
+		}
+	}
+}
+
+const SerializationPlan* SerializationPlan::get(const Class& clazz)
+{
+	if (const SerializationPlan* const* p = plans().find(clazz)) {
+		return *p;
+	}
+	::std::lock_guard< ::std::mutex> lock(compileMutex());
+	if (const SerializationPlan* const* p = plans().find(clazz)) {
+		return *p;
+	}
+	Pending pending;
+	const SerializationPlan* plan = compile(clazz, pending);
+
+	// reading a nested object writes its attributes too, repeated because nesting may be cyclic
+	for (bool changed = true; changed; ) {
+		changed = false;
+		for (const auto& p: pending) {
+			SerializationPlan* pl = p.second;
+			for (const Field& f: pl->fields) {
+				if (!pl->hasConstAttributes && reachesConstAttributes(f.codec)) {
+					pl->hasConstAttributes = true;
+					changed = true;
+				}
+			}
+		}
+	}
+
+	// objects nest by value without cycles, so their sizes are known once every plan is complete
+	for (const auto& p: pending) {
+		for (Codec& element: p.second->m_elements) {
+			element.minSize = minEncodedSize(element);
+		}
+	}
+
+	// published together, once every nested plan is complete
+	for (const auto& p: pending) {
+		plans().assign(p.first, p.second);
+	}
+	return plan;
+}
+
+const SerializationPlan* SerializationPlan::compile(const Class& clazz, Pending& pending)
+{
+	if (const SerializationPlan* const* p = plans().find(clazz)) {
+		return *p;
+	}
+	// classes can contain vectors of themselves
+	auto it = pending.find(clazz);
+	if (it != pending.end()) {
+		return it->second;
+	}
+
+	planStorage().emplace_back(new SerializationPlan());
+	SerializationPlan* plan = planStorage().back().get();
+	pending.emplace(clazz, plan);
+
+	plan->clazz = clazz;
+	plan->size = clazz.sizeOf();
+	plan->flat = false;
+	plan->hasConstAttributes = false;
+
+	for (const Attribute& a: clazz.attributes()) {
+		if (a.isStatic()) {
+			continue;
+		}
+		Field f;
+		f.offset = a.m_impl->offset();
+		if (a.getClass() != clazz) {
+#ifndef NO_RTTI
+			int base = 0;
+			if (!ClassImpl::baseOffset(clazz.typeId(), a.getClass().typeId(), base)) {
+				throw ::std::runtime_error("attribute " + a.name() + " is inherited from a virtual or ambiguous base of " + clazz.fullyQualifiedName());
+			}
+			f.offset += base;
+#else
+			throw ::std::runtime_error("inherited attribute " + a.name() + " can't be located without RTTI");
+#endif
+		}
+		f.codec = plan->compileCodec(a.m_impl->serialType(), a.name(), pending);
+		plan->hasConstAttributes = plan->hasConstAttributes || a.isConst();
+		plan->fields.push_back(f);
+	}
+
+	::std::stable_sort(plan->fields.begin(), plan->fields.end(), [](const Field& f1, const Field& f2) {
+		return f1.offset < f2.offset;
+	});
+
+	plan->mergeFields();
+	return plan;
+}
+
+void SerializationPlan::mergeFields()
+{
+	::std::vector<Field> merged;
+	for (Field f: fields) {
+		// nested objects that are copied whole are copied with their neighbours.
+		// Plans that are still being compiled aren't flat yet, they only nest through vectors
+		if (f.codec.kind == SerialType::OBJECT && f.codec.plan->flat) {
+			hasConstAttributes = hasConstAttributes || f.codec.plan->hasConstAttributes;
+			f.codec.kind = SerialType::TRIVIAL;
+		}
+		if (!merged.empty() && f.codec.kind == SerialType::TRIVIAL && merged.back().codec.kind == SerialType::TRIVIAL
+				&& merged.back().offset + static_cast< ::std::ptrdiff_t>(merged.back().codec.size) == f.offset) {
+			merged.back().codec.size += f.codec.size;
+		} else {
+			merged.push_back(f);
+		}
+	}
+	fields.swap(merged);
+
+	flat = fields.size() == 1 && fields[0].codec.kind == SerialType::TRIVIAL
+		&& fields[0].offset == 0 && fields[0].codec.size == size;
+}
+
+bool SerializationPlan::reachesConstAttributes(const Codec& codec)
+{
+	switch (codec.kind) {
+		case SerialType::VECTOR:
+			return reachesConstAttributes(*codec.element);
+		case SerialType::OBJECT:
+			return codec.plan->hasConstAttributes;
+		default:
+			return false;
+	}
+}
+
+::std::size_t SerializationPlan::minEncodedSize(const Codec& codec)
+{
+	switch (codec.kind) {
+		case SerialType::TRIVIAL:
+			return codec.size;
+		case SerialType::STRING:
+		case SerialType::VECTOR:
+			return sizeof(length_type);
+		case SerialType::OBJECT: {
+			::std::size_t size = 0;
+			for (const Field& f: codec.plan->fields) {
+				size += minEncodedSize(f.codec);
+			}
+			return size;
+		}
+		default:
+			return 0;
+	}
+}
+
+SerializationPlan::Codec SerializationPlan::compileCodec(const SerialType& type, const ::std::string& name, Pending& pending)
+{
+	Codec c{ type.kind, type.size, &type, nullptr, nullptr, 0 };
+	switch (type.kind) {
+		case SerialType::TRIVIAL:
+		case SerialType::STRING:
+			break;
+		case SerialType::VECTOR:
+			m_elements.push_back(compileCodec(*type.element, name, pending));
+			c.element = &m_elements.back();
+			break;
+		case SerialType::OBJECT: {
+#ifndef NO_RTTI
+			Class nested = Class::lookup(*type.type);
+			if (!nested.isValid()) {
+				throw ::std::runtime_error("attribute " + name + " has the unregistered class " + type.type->name());
+			}
+			c.plan = compile(nested, pending);
+#else
+			throw ::std::runtime_error("attribute " + name + " of class type can't be serialized without RTTI");
+#endif
+			break;
+		}
+		case SerialType::UNSUPPORTED:
+			throw ::std::runtime_error("attribute " + name + " has a type that can't be serialized");
+	}
+	return c;
+}
+
+BinarySerializer::BinarySerializer(const Class& clazz)
+	: m_plan(SerializationPlan::get(clazz))
+{}
+
+Class BinarySerializer::getClass() const
+{
+	return m_plan->clazz;
+}
+
+void BinarySerializer::write(const void* object, ::std::string& out) const
+{
+	Output o(out);
+	writeObject(*m_plan, static_cast<const char*>(object), o);
+	o.flush();
+}
+
+void BinarySerializer::writeArray(const void* objects, ::std::size_t count, ::std::string& out) const
+{
+	Output o(out);
+	const char* object = static_cast<const char*>(objects);
+	if (m_plan->flat) {
+		o.put(object, count * m_plan->size);
+	} else {
+		for (::std::size_t i = 0; i < count; ++i, object += m_plan->size) {
+			writeObject(*m_plan, object, o);
+		}
+	}
+	o.flush();
+}
+
+::std::size_t BinarySerializer::read(void* object, const char* data, ::std::size_t size) const
+{
+	return readArray(object, 1, data, size);
+}
+
+::std::size_t BinarySerializer::readArray(void* objects, ::std::size_t count, const char* data, ::std::size_t size) const
+{
+	if (m_plan->hasConstAttributes) {
+		throw ::std::runtime_error("cannot read into const attributes of " + m_plan->clazz.fullyQualifiedName());
+	}
+	Input in(data, size);
+	char* object = static_cast<char*>(objects);
+	if (m_plan->flat) {
+		in.get(object, count * m_plan->size);
+		return in.consumed();
+	}
+	for (::std::size_t i = 0; i < count; ++i, object += m_plan->size) {
+		readObject(*m_plan, object, in);
+	}
+	return in.consumed();
+}
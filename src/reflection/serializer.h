@@ -0,0 +1,191 @@
+/*
+** SelfPortrait API
+** See Copyright Notice in reflection.h
+*/
+#ifndef SERIALIZER_H
+#define SERIALIZER_H
+
+#include <cstddef>
+#include <string>
+#include <type_traits>
+#ifndef NO_RTTI
+#include <typeinfo>
+#endif
+#include <vector>
+
+#include "reflection.h"
+
+/** How a value of an attribute is encoded, built at compile time for the
+ *  type of each registered attribute. */
+struct SerialType {
+	enum Kind {
+		TRIVIAL,     // arithmetic and enum values, copied as they are
+		STRING,      // ::std::string, length and characters
+		VECTOR,      // ::std::vector, length and elements
+		OBJECT,      // a registered class, its attributes
+		UNSUPPORTED
+	};
+
+	Kind kind;
+	::std::size_t size;
+#ifndef NO_RTTI
+	// the class of OBJECT values
+	const ::std::type_info* type;
+#endif
+
+	// for VECTOR values
+	const SerialType* element;
+	::std::size_t (*count)(const void* vector);
+	const void* (*data)(const void* vector);
+	// nullptr if the elements can't be default constructed
+	void* (*resize)(void* vector, ::std::size_t count);
+};
+
+namespace serial_type_impl {
+
+	template<class T>
+	struct vector_access {
+		static ::std::size_t count(const void* vector) {
+			return static_cast<const ::std::vector<T>*>(vector)->size();
+		}
+
+		static const void* data(const void* vector) {
+			return static_cast<const ::std::vector<T>*>(vector)->data();
+		}
+
+		template<bool Resizable = ::std::is_default_constructible<T>::value, class Dummy = void>
+		struct resizer {
+			static void* resize(void* vector, ::std::size_t count) {
+				::std::vector<T>* v = static_cast< ::std::vector<T>*>(vector);
+				v->resize(count);
+				return v->data();
+			}
+
+			static constexpr void* (*value)(void*, ::std::size_t) = &resize;
+		};
+
+		template<class Dummy>
+		struct resizer<false, Dummy> {
+			static constexpr void* (*value)(void*, ::std::size_t) = nullptr;
+		};
+	};
+
+	template<class T>
+	constexpr SerialType::Kind kind() {
+		return ::std::is_arithmetic<T>::value || ::std::is_enum<T>::value ? SerialType::TRIVIAL
+			: ::std::is_class<T>::value ? SerialType::OBJECT
+			: SerialType::UNSUPPORTED;
+	}
+}
+
+template<class T>
+struct serial_type {
+	static constexpr SerialType value = {
+		serial_type_impl::kind<T>(),
+		sizeof(T),
+#ifndef NO_RTTI
+		&typeid(T),
+#endif
+		nullptr,
+		nullptr,
+		nullptr,
+		nullptr
+	};
+};
+
+template<class T>
+constexpr SerialType serial_type<T>::value;
+
+template<>
+struct serial_type< ::std::string> {
+	static constexpr SerialType value = {
+		SerialType::STRING,
+		sizeof(::std::string),
+#ifndef NO_RTTI
+		nullptr,
+#endif
+		nullptr,
+		nullptr,
+		nullptr,
+		nullptr
+	};
+};
+
+template<class T>
+struct serial_type< ::std::vector<T> > {
+	typedef serial_type_impl::vector_access<T> access;
+
+	static constexpr SerialType value = {
+		SerialType::VECTOR,
+		sizeof(::std::vector<T>),
+#ifndef NO_RTTI
+		nullptr,
+#endif
+		&serial_type<T>::value,
+		&access::count,
+		&access::data,
+		access::template resizer<>::value
+	};
+};
+
+template<class T>
+constexpr SerialType serial_type< ::std::vector<T> >::value;
+
+// packed bits, there is no element storage to copy
+template<>
+struct serial_type< ::std::vector<bool> > {
+	static constexpr SerialType value = {
+		SerialType::UNSUPPORTED,
+		sizeof(::std::vector<bool>),
+#ifndef NO_RTTI
+		nullptr,
+#endif
+		nullptr,
+		nullptr,
+		nullptr,
+		nullptr
+	};
+};
+
+class SerializationPlan;
+
+/** Writes the non-static attributes of objects of a registered class to a
+ *  compact binary format, and reads them back.
+ *
+ *  The attributes are compiled once per class into a plan of offsets and
+ *  codecs, so no names are looked up and no values are boxed in VariantValue
+ *  while objects are written or read. Attributes that are next to each other
+ *  in memory are copied together, and classes made only of such attributes
+ *  are copied whole. Attributes can be arithmetic or enum values,
+ *  ::std::string, ::std::vector of supported types or registered classes.
+ *
+ *  Values are written in the native representation of the machine, lengths
+ *  as 32 bit unsigned integers, so data is only portable between machines
+ *  of the same architecture.
+ */
+class BinarySerializer {
+public:
+
+	// throws if an attribute of clazz, or of a nested class, has an unsupported type
+	explicit BinarySerializer(const Class& clazz);
+
+	Class getClass() const;
+
+	// appends the attributes of object, which must point to an instance of the class
+	void write(const void* object, ::std::string& out) const;
+
+	// count objects that follow each other at intervals of Class::sizeOf()
+	void writeArray(const void* objects, ::std::size_t count, ::std::string& out) const;
+
+	/** assigns the attributes read from data to object, an existing instance
+	 *  of the class. Returns the number of bytes read, throws if the data is
+	 *  too short or the class has const attributes */
+	::std::size_t read(void* object, const char* data, ::std::size_t size) const;
+
+	::std::size_t readArray(void* objects, ::std::size_t count, const char* data, ::std::size_t size) const;
+
+private:
+	const SerializationPlan* m_plan;
+};
+
+#endif /* SERIALIZER_H */
@@ -0,0 +1,65 @@
+/*
+** SelfPortrait API
+** See Copyright Notice in reflection.h
+*/
+#include "signature.h"
+#include "str_utils.h"
+
+#include <cstdint>
+
+CallableSignature::CallableSignature(
+		const char* argSpellings
+		, unsigned int qualifiers
+#ifndef NO_RTTI
+		, ::std::vector<const ::std::type_info*> argumentTypes
+#endif
+		)
+	: m_argSpellings(argSpellings)
+	, m_qualifiers(qualifiers)
+#ifndef NO_RTTI
+	, m_argumentTypes(::std::move(argumentTypes))
+#endif
+	, m_hash(0)
+{}
+
+const ::std::vector< ::std::string>& CallableSignature::argumentSpellings() const
+{
+	::std::call_once(m_computed, &CallableSignature::compute, this);
+	return m_spellings;
+}
+
+::std::size_t CallableSignature::hash() const
+{
+	::std::call_once(m_computed, &CallableSignature::compute, this);
+	return m_hash;
+}
+
+namespace {
+
+	// FNV-1a over words
+	void mix(::std::uint64_t& h, ::std::uint64_t v) {
+		h = (h ^ v) * 0x100000001b3ull;
+	}
+}
+
+void CallableSignature::compute() const
+{
+	m_spellings = splitArgs(m_argSpellings);
+
+	::std::uint64_t h = 0xcbf29ce484222325ull;
+#ifndef NO_RTTI
+	// the types are more reliable than the spellings, which may use typedefs
+	for (const ::std::type_info* t: m_argumentTypes) {
+		mix(h, t->hash_code());
+	}
+#else
+	for (const ::std::string& s: m_spellings) {
+		for (char c: s) {
+			mix(h, static_cast<unsigned char>(c));
+		}
+		mix(h, ',');
+	}
+#endif
+	mix(h, m_qualifiers);
+	m_hash = static_cast< ::std::size_t>(h ^ (h >> 32));
+}
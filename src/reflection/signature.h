@@ -0,0 +1,68 @@
+/*
+** SelfPortrait API
+** See Copyright Notice in reflection.h
+*/
+#ifndef SIGNATURE_H
+#define SIGNATURE_H
+
+#include <cstddef>
+#include <mutex>
+#include <string>
+#ifndef NO_RTTI
+#include <typeinfo>
+#endif
+#include <vector>
+
+/** The argument list of a method, constructor or function.
+ *
+ *  Splitting the spellings into normalized type names is costly and most
+ *  callables are never inspected, so the spellings and the signature hash are
+ *  computed once, on first use, by whichever thread asks first. Afterwards
+ *  they are handed out by reference.
+ */
+class CallableSignature {
+public:
+
+	enum Qualifiers {
+		UNQUALIFIED = 0,
+		CONST_QUALIFIED = 1,
+		VOLATILE_QUALIFIED = 2
+	};
+
+	CallableSignature(
+			const char* argSpellings
+			, unsigned int qualifiers
+#ifndef NO_RTTI
+			, ::std::vector<const ::std::type_info*> argumentTypes
+#endif
+			);
+
+	const ::std::vector< ::std::string>& argumentSpellings() const;
+
+#ifndef NO_RTTI
+	const ::std::vector<const ::std::type_info*>& argumentTypes() const { return m_argumentTypes; }
+#endif
+
+	/** hash of the argument types and qualifiers. Callables that accept the
+	 *  same arguments have the same hash */
+	::std::size_t hash() const;
+
+	CallableSignature(const CallableSignature&) = delete;
+	CallableSignature& operator=(const CallableSignature&) = delete;
+
+private:
+
+	void compute() const;
+
+	const char* const m_argSpellings;
+	const unsigned int m_qualifiers;
+#ifndef NO_RTTI
+	const ::std::vector<const ::std::type_info*> m_argumentTypes;
+#endif
+
+	mutable ::std::once_flag m_computed;
+	mutable ::std::vector< ::std::string> m_spellings;
+	mutable ::std::size_t m_hash;
+};
+
+#endif /* SIGNATURE_H */
@@ -26,7 +26,15 @@
 #define STRING_CONVERSION_H
 
 #include <sstream>
+#include <algorithm>
 #include <cctype>
+#include <cerrno>
+#include <clocale>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
 #include <vector>
 #include <type_traits>
 #include <stdexcept>
@@ -67,16 +75,238 @@ namespace string_conversion_impl {
     template<class T> using parseable = decltype(supports_istream(std::declval<T>()));
 	
 	enum class ConversionTo {
+		Number,
 		ConvertsToString,
 		Printable,
 		None
 	};
 	
 	enum class ConversionFrom {
+		Number,
 		StringConvertsTo,
 		Parseable,
 		None
 	};
+
+	// enough for any number written by format_number, including the terminating 0
+	enum { max_number_chars = 32 };
+
+	/** Integers and floating point numbers are converted without streams: no
+	 *  allocation and no locale. Characters and bools keep the stream path,
+	 *  which prints them as characters and "0"/"1" */
+	template<class T>
+	constexpr bool is_number() {
+		return ::std::is_arithmetic<T>::value
+			&& !::std::is_same<typename ::std::remove_cv<T>::type, bool>::value
+			&& !::std::is_same<typename ::std::remove_cv<T>::type, char>::value
+			&& !::std::is_same<typename ::std::remove_cv<T>::type, signed char>::value
+			&& !::std::is_same<typename ::std::remove_cv<T>::type, unsigned char>::value
+			&& !::std::is_same<typename ::std::remove_cv<T>::type, wchar_t>::value
+			&& !::std::is_same<typename ::std::remove_cv<T>::type, char16_t>::value
+			&& !::std::is_same<typename ::std::remove_cv<T>::type, char32_t>::value;
+	}
+
+	// the C library functions used for floating point numbers only depend on the locale for this
+	inline char decimal_point() {
+		return *::std::localeconv()->decimal_point;
+	}
+
+	inline bool is_space(char c) {
+		return c == ' ' || (c >= '\t' && c <= '\r');
+	}
+
+	template<class T>
+	struct float_traits;
+
+	template<>
+	struct float_traits<float> {
+		// digits that always survive a round-trip and digits that always suffice for one
+		enum { min_digits = 6, max_digits = 9 };
+		static int print(char* buf, int precision, float f) { return ::std::snprintf(buf, max_number_chars, "%.*g", precision, static_cast<double>(f)); }
+		static float parse(const char* str, char** end) { return ::std::strtof(str, end); }
+	};
+
+	template<>
+	struct float_traits<double> {
+		enum { min_digits = 15, max_digits = 17 };
+		static int print(char* buf, int precision, double d) { return ::std::snprintf(buf, max_number_chars, "%.*g", precision, d); }
+		static double parse(const char* str, char** end) { return ::std::strtod(str, end); }
+	};
+
+	template<>
+	struct float_traits<long double> {
+		enum { min_digits = ::std::numeric_limits<long double>::digits10, max_digits = ::std::numeric_limits<long double>::digits10 + 3 };
+		static int print(char* buf, int precision, long double d) { return ::std::snprintf(buf, max_number_chars, "%.*Lg", precision, d); }
+		static long double parse(const char* str, char** end) { return ::std::strtold(str, end); }
+	};
+
+	template<class T>
+	char* format_number(char* buf, T value, ::std::true_type /*integral*/) {
+		typedef typename ::std::make_unsigned<T>::type U;
+		U u = static_cast<U>(value);
+		if (value < T(0)) {
+			*buf++ = '-';
+			u = U(0) - u;
+		}
+		char digits[max_number_chars];
+		char* first = digits + max_number_chars;
+		do {
+			*--first = static_cast<char>('0' + u % 10);
+			u /= 10;
+		} while (u != 0);
+		return ::std::copy(first, digits + max_number_chars, buf);
+	}
+
+	/** Most numbers in text have a few decimals. If value is such a number with
+	 *  up to 8 decimals it is written without the C library, with the same
+	 *  digits that "%.15g" gives */
+	inline bool format_short_decimal(char*& buf, double value) {
+		static const double powers[] = { 1, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8 };
+		const double magnitude = value < 0 ? -value : value;
+		if (!(magnitude >= 1e-4 && magnitude < 1e15)) {
+			return false;
+		}
+		for (int decimals = 0; decimals < 9; ++decimals) {
+			const double scaled = magnitude * powers[decimals];
+			if (scaled >= 1e15) {
+				return false;
+			}
+			unsigned long long n = static_cast<unsigned long long>(scaled);
+			// both are exact, so the division gives the value that the decimal string reads back as
+			if (static_cast<double>(n) == scaled && static_cast<double>(n) / powers[decimals] == magnitude) {
+				if (value < 0) {
+					*buf++ = '-';
+				}
+				char digits[max_number_chars];
+				char* first = digits + max_number_chars;
+				for (int i = 0; i < decimals; ++i) {
+					*--first = static_cast<char>('0' + n % 10);
+					n /= 10;
+				}
+				char* last = digits + max_number_chars;
+				while (last != first && last[-1] == '0') {
+					--last;
+				}
+				if (last != first) {
+					*--first = '.';
+				}
+				do {
+					*--first = static_cast<char>('0' + n % 10);
+					n /= 10;
+				} while (n != 0);
+				buf = ::std::copy(first, last, buf);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	template<class T>
+	bool format_short_decimal(char*&, T) {
+		return false;
+	}
+
+	// the shortest representation that reads back as the same value
+	template<class T>
+	char* format_number(char* buf, T value, ::std::false_type /*floating point*/) {
+		typedef float_traits<typename ::std::remove_cv<T>::type> traits;
+		if (format_short_decimal(buf, value)) {
+			return buf;
+		}
+		int length = 0;
+		for (int precision = traits::min_digits; ; ++precision) {
+			length = traits::print(buf, precision, value);
+			if (precision == traits::max_digits || value != value || traits::parse(buf, nullptr) == value) {
+				break;
+			}
+		}
+		const char point = decimal_point();
+		if (point != '.') {
+			::std::replace(buf, buf + length, point, '.');
+		}
+		return buf + length;
+	}
+
+	// writes value to buf, which has room for max_number_chars, and returns the end of the number
+	template<class T>
+	char* format_number(char* buf, T value) {
+		return format_number(buf, value, ::std::is_integral<T>());
+	}
+
+	/** Parses a number at the beginning of str like operator>> would: leading
+	 *  whitespace is skipped, anything after the number is ignored and a value
+	 *  out of range fails with the largest value of the right sign */
+	template<class T>
+	bool parse_number(const char* str, T& value, ::std::true_type /*integral*/) {
+		typedef typename ::std::make_unsigned<T>::type U;
+		while (is_space(*str)) {
+			++str;
+		}
+		bool negative = false;
+		if (*str == '+' || *str == '-') {
+			negative = *str == '-';
+			++str;
+		}
+		value = T(0);
+		if (*str < '0' || *str > '9') {
+			return false;
+		}
+		// the most negative value has a magnitude one larger than the maximum
+		const U limit = ::std::is_signed<T>::value ? U(::std::numeric_limits<T>::max()) + U(negative ? 1 : 0) : ::std::numeric_limits<U>::max();
+		U u = 0;
+		bool overflow = false;
+		for (; *str >= '0' && *str <= '9'; ++str) {
+			const U digit = static_cast<U>(*str - '0');
+			if (u > (limit - digit) / 10) {
+				overflow = true;
+			} else {
+				u = u * 10 + digit;
+			}
+		}
+		if (overflow) {
+			value = negative && ::std::is_signed<T>::value ? ::std::numeric_limits<T>::min() : ::std::numeric_limits<T>::max();
+			return false;
+		} else if (!negative) {
+			value = static_cast<T>(u);
+		} else if (::std::is_signed<T>::value) {
+			value = u == 0 ? T(0) : static_cast<T>(-static_cast<T>(u - 1) - 1);
+		} else {
+			// like strtoul
+			value = static_cast<T>(U(0) - u);
+		}
+		return true;
+	}
+
+	template<class T>
+	bool parse_number(const char* str, T& value, ::std::false_type /*floating point*/) {
+		typedef float_traits<typename ::std::remove_cv<T>::type> traits;
+		::std::string translated;
+		const char point = decimal_point();
+		if (point != '.' && ::std::strchr(str, '.') != nullptr) {
+			translated = str;
+			::std::replace(translated.begin(), translated.end(), '.', point);
+			str = translated.c_str();
+		}
+		char* end = nullptr;
+		const int saved = errno;
+		errno = 0;
+		value = traits::parse(str, &end);
+		const bool overflow = errno == ERANGE && (value == ::std::numeric_limits<T>::infinity() || value == -::std::numeric_limits<T>::infinity());
+		errno = saved;
+		if (end == str) {
+			value = T(0);
+			return false;
+		} else if (overflow) {
+			value = value > T(0) ? ::std::numeric_limits<T>::max() : -::std::numeric_limits<T>::max();
+			return false;
+		}
+		return true;
+	}
+
+	template<class T>
+	bool parse_number(const char* str, T& value) {
+		return parse_number(str, value, ::std::is_integral<T>());
+	}
 	
 	template<class T, enum ConversionTo>
 	struct ouput_helper {
@@ -86,6 +316,15 @@ namespace string_conversion_impl {
 		}
 	};
 
+	template<class T>
+	struct ouput_helper<T, ConversionTo::Number> {
+		static ::std::string print(const T& t, bool * success) {
+			if (success != nullptr) *success = true;
+			char buf[max_number_chars];
+			return ::std::string(buf, format_number(buf, t));
+		}
+	};
+
 	template<class T>
 	struct ouput_helper<T, ConversionTo::ConvertsToString> {
 		static ::std::string print(const T& t, bool * success) {
@@ -114,6 +353,19 @@ namespace string_conversion_impl {
 		}
 	};
 	
+	template<class T>
+	struct input_helper<T, ConversionFrom::Number> {
+		static T parse(const char* str, bool * success) {
+			typename ::std::remove_cv<T>::type t;
+			const bool ok = parse_number(str, t);
+			if (success) *success = ok;
+			return t;
+		}
+		static T parse(const ::std::string& str, bool * success) {
+			return parse(str.c_str(), success);
+		}
+	};
+
 	template<class T>
 	struct input_helper<T, ConversionFrom::StringConvertsTo> {
 		static T parse(const ::std::string& str, bool * success) {
@@ -135,7 +387,9 @@ namespace string_conversion_impl {
 	
 	template<class T>
 	constexpr ConversionTo conversionToType() {
-		return ::std::is_convertible<T, ::std::string>::value 
+		return is_number<T>()
+					? ConversionTo::Number
+					: ::std::is_convertible<T, ::std::string>::value
 					? ConversionTo::ConvertsToString 
 					: printable<T>::value
 						?
@@ -145,7 +399,9 @@ namespace string_conversion_impl {
 	
 	template<class T>
 	constexpr ConversionFrom conversionFromType() {
-		return ::std::is_convertible< ::std::string, T>::value 
+		return is_number<T>()
+					? ConversionFrom::Number
+					: ::std::is_convertible< ::std::string, T>::value
 					? ConversionFrom::StringConvertsTo
 					: parseable<T>::value
 						?
@@ -182,6 +438,24 @@ T fromString(const ::std::string& str, bool* success = nullptr) {
 	return string_conversion_impl::input_helper<T, string_conversion_impl::conversionFromType<T>()>::parse(str, success);
 }
 
+// numbers are parsed in place, other types get a std::string
+template<class T>
+T fromString(const char* str, bool* success = nullptr) {
+	return string_conversion_impl::input_helper<T, string_conversion_impl::conversionFromType<T>()>::parse(str, success);
+}
+
+/** Writes an integer or floating point number to buf without allocating, in
+ *  the "C" locale whatever the current one is, and returns the end. Floating
+ *  point numbers get the fewest digits that read back as the same value. */
+template<class T>
+char* toChars(char* buf, T value) {
+	static_assert(string_conversion_impl::is_number<T>(), "toChars only writes numbers");
+	return string_conversion_impl::format_number(buf, value);
+}
+
+// size of a buffer that fits any number written by toChars
+constexpr ::std::size_t max_number_chars = string_conversion_impl::max_number_chars;
+
 
 template<class... T>
 ::std::string fmt_str(const char* fmt, const T&... t)
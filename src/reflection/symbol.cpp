@@ -0,0 +1,171 @@
+/*
+** SelfPortrait API
+** See Copyright Notice in reflection.h
+*/
+#include "reflection.h"
+
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+/** The names interned so far.
+ *
+ *  Finding a name is lock-free: the names are kept in an open addressed hash
+ *  table of pointers to immutable entries, published like the slots of
+ *  conversion_cache. Interning a new name and mapping an id back to its string
+ *  are serialized by a mutex, both only happen at registration or for messages.
+ */
+class SymbolTable {
+public:
+
+	static SymbolTable& instance() {
+		static SymbolTable inst;
+		return inst;
+	}
+
+	Symbol find(const char* name, ::std::size_t length) const {
+		const ::std::size_t h = hash(name, length);
+		const Entry* e = lookup(m_table.load(::std::memory_order_acquire), name, length, h);
+		return e ? Symbol(e->id, e->hash) : Symbol();
+	}
+
+	Symbol intern(const char* name, ::std::size_t length) {
+		const ::std::size_t h = hash(name, length);
+		const Entry* e = lookup(m_table.load(::std::memory_order_acquire), name, length, h);
+		if (e == nullptr) {
+			::std::lock_guard< ::std::mutex> lock(m_mutex);
+			table* t = m_table.load(::std::memory_order_relaxed);
+			e = lookup(t, name, length, h);
+			if (e == nullptr) {
+				if (m_entries.size() >= 0xFFFFFFFEu) {
+					throw ::std::runtime_error("too many symbols");
+				}
+				m_entries.push_back({ h, static_cast< ::std::uint32_t>(m_entries.size() + 1), ::std::string(name, length) });
+				e = &m_entries.back();
+				if (2 * (t->used + 1) > t->mask + 1) {
+					t = grow(t);
+				}
+				insert(t, e);
+			}
+		}
+		return Symbol(e->id, e->hash);
+	}
+
+	const ::std::string& str(::std::uint32_t id) {
+		static const ::std::string invalid;
+		if (id == 0) {
+			return invalid;
+		}
+		::std::lock_guard< ::std::mutex> lock(m_mutex);
+		// deque elements don't move when the deque grows
+		return m_entries[id - 1].name;
+	}
+
+	SymbolTable(const SymbolTable&) = delete;
+	SymbolTable& operator=(const SymbolTable&) = delete;
+
+private:
+
+	enum { initial_size = 1024 };
+
+	struct Entry {
+		::std::size_t hash;
+		::std::uint32_t id;
+		::std::string name;
+	};
+
+	struct table {
+		explicit table(::std::size_t size) : mask(size - 1), used(0), slots(new ::std::atomic<const Entry*>[size]) {
+			for (::std::size_t i = 0; i < size; ++i) {
+				slots[i].store(nullptr, ::std::memory_order_relaxed);
+			}
+		}
+		const ::std::size_t mask;
+		::std::size_t used;
+		::std::unique_ptr< ::std::atomic<const Entry*>[]> slots;
+	};
+
+	SymbolTable() {
+		m_tables.emplace_back(new table(initial_size));
+		m_table.store(m_tables.back().get(), ::std::memory_order_release);
+	}
+
+	// FNV-1a
+	static ::std::size_t hash(const char* name, ::std::size_t length) {
+		::std::uint64_t h = 0xcbf29ce484222325ull;
+		for (::std::size_t i = 0; i < length; ++i) {
+			h = (h ^ static_cast<unsigned char>(name[i])) * 0x100000001b3ull;
+		}
+		return static_cast< ::std::size_t>(h ^ (h >> 32));
+	}
+
+	static const Entry* lookup(const table* t, const char* name, ::std::size_t length, ::std::size_t h) {
+		for (::std::size_t i = h & t->mask; ; i = (i + 1) & t->mask) {
+			const Entry* e = t->slots[i].load(::std::memory_order_acquire);
+			if (e == nullptr) {
+				return nullptr;
+			} else if (e->hash == h && e->name.size() == length && ::std::memcmp(e->name.data(), name, length) == 0) {
+				return e;
+			}
+		}
+	}
+
+	static void insert(table* t, const Entry* e) {
+		for (::std::size_t i = e->hash & t->mask; ; i = (i + 1) & t->mask) {
+			if (t->slots[i].load(::std::memory_order_relaxed) == nullptr) {
+				t->slots[i].store(e, ::std::memory_order_release);
+				++t->used;
+				return;
+			}
+		}
+	}
+
+	table* grow(table* old) {
+		table* t = new table(2 * (old->mask + 1));
+		m_tables.emplace_back(t);
+		for (::std::size_t i = 0; i <= old->mask; ++i) {
+			const Entry* e = old->slots[i].load(::std::memory_order_relaxed);
+			if (e != nullptr) {
+				insert(t, e);
+			}
+		}
+		m_table.store(t, ::std::memory_order_release);
+		return t;
+	}
+
+	::std::atomic<table*> m_table;
+
+	// guarded by m_mutex, old tables are kept because readers might still be using them
+	::std::vector< ::std::unique_ptr<table>> m_tables;
+	::std::deque<Entry> m_entries;
+	::std::mutex m_mutex;
+};
+
+Symbol Symbol::intern(const char* name)
+{
+	return SymbolTable::instance().intern(name, ::std::strlen(name));
+}
+
+Symbol Symbol::intern(const ::std::string& name)
+{
+	return SymbolTable::instance().intern(name.data(), name.size());
+}
+
+Symbol Symbol::find(const char* name)
+{
+	return SymbolTable::instance().find(name, ::std::strlen(name));
+}
+
+Symbol Symbol::find(const ::std::string& name)
+{
+	return SymbolTable::instance().find(name.data(), name.size());
+}
+
+const ::std::string& Symbol::str() const
+{
+	return SymbolTable::instance().str(m_id);
+}
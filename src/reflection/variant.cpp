@@ -49,6 +49,9 @@ void VariantValue::destroyEmbedded()
         case Types::STRING:
             m_string.~ValueHolder<std::string>();
             break;
+        case Types::INPLACE:
+            impl()->~IValueHolder();
+            break;
     }
 }
 
@@ -97,6 +100,9 @@ VariantValue::VariantValue(const VariantValue& rhs)
         case Types::STRING:
             new(&m_string) ValueHolder<std::string>(rhs.m_string);
             break;
+        case Types::INPLACE:
+            rhs.impl()->cloneInto(&m_inplace);
+            break;
     }
 }
 
@@ -140,6 +146,10 @@ VariantValue::VariantValue(VariantValue&& rhs)
         case Types::STRING:
             new(&m_string) ValueHolder<std::string>(std::move(rhs.m_string));
             break;
+        case Types::INPLACE:
+            // inplace values are trivially copyable
+            rhs.impl()->cloneInto(&m_inplace);
+            break;
     }
 }
 
@@ -185,6 +195,9 @@ VariantValue& VariantValue::operator=(const VariantValue& rhs)
         case Types::STRING:
             new(&m_string) ValueHolder<std::string>(rhs.m_string);
             break;
+        case Types::INPLACE:
+            rhs.impl()->cloneInto(&m_inplace);
+            break;
     }
 
 	return *this;
@@ -232,16 +245,36 @@ VariantValue& VariantValue::operator=(VariantValue&& rhs)
         case Types::STRING:
             new(&m_string) ValueHolder<std::string>(std::move(rhs.m_string));
             break;
+        case Types::INPLACE:
+            // inplace values are trivially copyable
+            rhs.impl()->cloneInto(&m_inplace);
+            break;
     }
 	return *this;
 }
 
 
+VariantValue VariantValue::createReference() {
+    if (m_embedded == Types::INPLACE) {
+        // only a value on the heap can outlive this variant
+        shared_ptr<IValueHolder> holder(impl()->clone());
+        destroyEmbedded();
+        m_embedded = Types::DEFAULT;
+        new(&m_impl) shared_ptr<IValueHolder>(::std::move(holder));
+    }
+    return static_cast<const VariantValue*>(this)->createReference();
+}
+
 VariantValue VariantValue::createReference() const {
 	VariantValue ret;
 
     if (m_embedded == Types::DEFAULT) {
         ret.m_impl = m_impl;
+    } else if (m_embedded == Types::INPLACE) {
+        // the reference doesn't extend the lifetime of the value
+        ret.destroyEmbedded();
+        ret.m_embedded = Types::INPLACE;
+        impl()->referenceInto(&ret.m_inplace);
     } else {
         ret = *this;
     }
@@ -301,13 +334,6 @@ bool VariantValue::isPOD() const
     return impl()->alignOf();
 }
 
-// If the type is a POD and you know what you're doing, you can memcpy it, but beware of the alignment
-const void * VariantValue::ptrToValue() const
-{
-	check_valid();
-    return impl()->ptrToValue();
-}
-
 bool VariantValue::operator==(const VariantValue& that) const
 {
 
@@ -338,3 +364,23 @@ bool VariantValue::operator!=(const VariantValue& that) const
     return !(*this == that);
 }
 
+
+// raw attribute accessors check the type by the address of its descriptor,
+// defining the common ones here gives every module that loads the library
+// the same descriptor, even if the module itself is loaded later
+template struct type_descriptor<bool>;
+template struct type_descriptor<char>;
+template struct type_descriptor<signed char>;
+template struct type_descriptor<unsigned char>;
+template struct type_descriptor<short>;
+template struct type_descriptor<unsigned short>;
+template struct type_descriptor<int>;
+template struct type_descriptor<unsigned int>;
+template struct type_descriptor<long>;
+template struct type_descriptor<unsigned long>;
+template struct type_descriptor<long long>;
+template struct type_descriptor<unsigned long long>;
+template struct type_descriptor<float>;
+template struct type_descriptor<double>;
+template struct type_descriptor<long double>;
+template struct type_descriptor< ::std::string>;
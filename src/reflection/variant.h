@@ -20,6 +20,7 @@
 #include "str_conversion.h"
 #include "typeutils.h"
 #include "conversion_cache.h"
+#include "variant_arena.h"
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
@@ -27,6 +28,13 @@
 #include <iostream>
 using namespace std;
 
+/* Trivial values up to this size (and references) are stored inside the
+ * VariantValue instead of being allocated on the heap. Can be overridden at
+ * compile time, but the library and its clients must agree on the value. */
+#ifndef SELFPORTRAIT_VARIANT_INPLACE_SIZE
+#define SELFPORTRAIT_VARIANT_INPLACE_SIZE 32
+#endif
+
 namespace {
 
 namespace number_conversion {
@@ -74,10 +82,10 @@ namespace number_conversion {
 	// usualy used for string literals
 	template<>
 	struct convert<const char*, true> {
-		static dst_int_t convertToInteger(const ::std::string& str, bool* success) {
+		static dst_int_t convertToInteger(const char* str, bool* success) {
             return ::strconv::fromString<dst_int_t>(str, success);
 		}
-		static dst_float_t convertToFloat(const ::std::string& str, bool* success) {
+		static dst_float_t convertToFloat(const char* str, bool* success) {
             return ::strconv::fromString<dst_float_t>(str, success);
 		}
 	};
@@ -211,13 +219,51 @@ struct NoopPointerPacker {
 template<class T>
 using PointerPacker = typename Select<sizeof(void*) == 8, PointerPacker_x86_64<T>, NoopPointerPacker<T>>::type;
 
-class IValueHolder {
-public:
+/* One byte tag for the arithmetic types and std::string. Comparing tags is
+ * cheaper than comparing type_infos, and lets numeric conversions between
+ * these types be done inline. Every other type is tagged OTHER. */
+enum class ValueTag : unsigned char {
+	OTHER,
+	BOOL,
+	CHAR,
+	SCHAR,
+	UCHAR,
+	SHORT,
+	USHORT,
+	INT,
+	UINT,
+	LONG,
+	ULONG,
+	LLONG,
+	ULLONG,
+	FLOAT,
+	DOUBLE,
+	LDOUBLE,
+	STRING
+};
 
-    enum {
-        max_sizeof = 0xffff,
-        max_sizeof_bits = 16
-    };
+template<class T> struct value_tag                  : ::std::integral_constant<ValueTag, ValueTag::OTHER> {};
+template<> struct value_tag<bool>                   : ::std::integral_constant<ValueTag, ValueTag::BOOL> {};
+template<> struct value_tag<char>                   : ::std::integral_constant<ValueTag, ValueTag::CHAR> {};
+template<> struct value_tag<signed char>            : ::std::integral_constant<ValueTag, ValueTag::SCHAR> {};
+template<> struct value_tag<unsigned char>          : ::std::integral_constant<ValueTag, ValueTag::UCHAR> {};
+template<> struct value_tag<short>                  : ::std::integral_constant<ValueTag, ValueTag::SHORT> {};
+template<> struct value_tag<unsigned short>         : ::std::integral_constant<ValueTag, ValueTag::USHORT> {};
+template<> struct value_tag<int>                    : ::std::integral_constant<ValueTag, ValueTag::INT> {};
+template<> struct value_tag<unsigned int>           : ::std::integral_constant<ValueTag, ValueTag::UINT> {};
+template<> struct value_tag<long>                   : ::std::integral_constant<ValueTag, ValueTag::LONG> {};
+template<> struct value_tag<unsigned long>          : ::std::integral_constant<ValueTag, ValueTag::ULONG> {};
+template<> struct value_tag<long long>              : ::std::integral_constant<ValueTag, ValueTag::LLONG> {};
+template<> struct value_tag<unsigned long long>     : ::std::integral_constant<ValueTag, ValueTag::ULLONG> {};
+template<> struct value_tag<float>                  : ::std::integral_constant<ValueTag, ValueTag::FLOAT> {};
+template<> struct value_tag<double>                 : ::std::integral_constant<ValueTag, ValueTag::DOUBLE> {};
+template<> struct value_tag<long double>            : ::std::integral_constant<ValueTag, ValueTag::LDOUBLE> {};
+template<> struct value_tag< ::std::string>         : ::std::integral_constant<ValueTag, ValueTag::STRING> {};
+
+/* Everything a value holder needs to know about its value type that doesn't
+ * depend on the holder itself. There is one constant instance per type, so the
+ * holders only carry a pointer to it instead of several virtual functions. */
+struct TypeDescriptor {
 
     enum class TypeCategories {
         POD = 0,
@@ -228,25 +274,76 @@ public:
         NONE = 5
     };
 
-    TypeCategories resolveCategory(bool isPod,
+    static constexpr TypeCategories resolveCategory(bool isPod,
                                bool isIntegral,
                                bool isFloatingPoint,
                                bool isPointer,
                                bool isStdString) {
+        return isIntegral ? TypeCategories::INTEGRAL :
+               isFloatingPoint ? TypeCategories::FLOATING :
+               isPointer ? TypeCategories::POINTER :
+               isStdString ? TypeCategories::STDSTRING :
+               isPod ? TypeCategories::POD :
+               TypeCategories::NONE;
+    }
+
+    ValueTag tag;
+    TypeCategories category;
+    ::std::size_t sizeOf;
+    ::std::size_t alignOf;
+
+    // values of POD types can be copied with memcpy
+    constexpr bool isPod() const {
+        return category != TypeCategories::NONE && category != TypeCategories::STDSTRING;
+    }
+
+    number_return (*convertToNumber)(const void* value, NumberType t);
+    ::std::string (*convertToString)(const void* value);
+};
+
+template<class T>
+struct type_descriptor {
 
-            if (isIntegral) {
-                return TypeCategories::INTEGRAL;
-            } else if (isFloatingPoint) {
-                return TypeCategories::FLOATING;
-            } else if (isPointer) {
-                return TypeCategories::POINTER;
-            } else if (isStdString) {
-                return TypeCategories::STDSTRING;
-            } else if (isPod) {
-                return TypeCategories::POD;
-            }
-            return TypeCategories::NONE;
+    static number_return convertToNumber(const void* value, NumberType t) {
+        number_return r;
+        if (t == NumberType::INTEGER) {
+            r.i = ::convertToInteger(*static_cast<const T*>(value));
+        } else {
+            r.f = ::convertToFloatingPoint(*static_cast<const T*>(value));
         }
+        return r;
+    }
+
+    static ::std::string convertToString(const void* value) {
+        return strconv::toString(*static_cast<const T*>(value));
+    }
+
+    static constexpr TypeDescriptor value = {
+        value_tag<T>::value,
+        TypeDescriptor::resolveCategory(::std::is_pod<T>::value,
+                                        ::std::is_integral<T>::value,
+                                        ::std::is_floating_point<T>::value,
+                                        ::std::is_pointer<T>::value,
+                                        ::std::is_same< ::std::string, T>::value),
+        sizeof(T),
+        alignof(T),
+        &type_descriptor::convertToNumber,
+        &type_descriptor::convertToString
+    };
+};
+
+template<class T>
+constexpr TypeDescriptor type_descriptor<T>::value;
+
+class IValueHolder {
+public:
+
+    enum {
+        max_sizeof = 0xffff,
+        max_sizeof_bits = 16
+    };
+
+    typedef TypeDescriptor::TypeCategories TypeCategories;
 
     IValueHolder(
             const void* ptr,
@@ -254,22 +351,14 @@ public:
 #ifndef NO_RTTI
 			const ::std::type_info& typeId,
 #endif
-			std::size_t sizeOf,
-			std::size_t alignOf,
-			bool isPod,
-			bool isIntegral,
-			bool isFloatingPoint,
-			bool isPointer,
-			bool isStdString,
+			const TypeDescriptor& descriptor,
 			bool isConst)
-        : m_offset(reinterpret_cast<ptrdiff_t>(ptr)-reinterpret_cast<ptrdiff_t>(this))
+        : m_descriptor(&descriptor)
+        , m_offset(reinterpret_cast<ptrdiff_t>(ptr)-reinterpret_cast<ptrdiff_t>(this))
         , m_offsetToPtr(!valInStruct)
 #ifndef NO_RTTI
         , m_typeId(PointerPacker<std::type_info>::ptr_pack(&typeId))
 #endif
-		, m_sizeOf(sizeOf)
-		, m_alignOf(alignOf)
-        , m_category(static_cast<unsigned int>(resolveCategory(isPod,isIntegral,isFloatingPoint,isPointer,isStdString)))
 		, m_isConst(isConst)
     {
         assert(reinterpret_cast<ptrdiff_t>(ptr)-reinterpret_cast<ptrdiff_t>(this) > 0);
@@ -305,27 +394,61 @@ public:
     }
 #endif
 	
-	::std::size_t sizeOf() const { return m_sizeOf; }
+	::std::size_t sizeOf() const { return m_descriptor->sizeOf; }
 	
-	::std::size_t alignOf() const { return m_alignOf; }
+	::std::size_t alignOf() const { return m_descriptor->alignOf; }
 	
-    bool isPOD() const { return m_category == static_cast<unsigned int>(TypeCategories::POD) || isIntegral() || isFloatingPoint() || isPointer(); }
+    bool isPOD() const { return m_descriptor->category == TypeCategories::POD || isIntegral() || isFloatingPoint() || isPointer(); }
 
-    bool isIntegral() const { return m_category == static_cast<unsigned int>(TypeCategories::INTEGRAL); }
+    bool isIntegral() const { return m_descriptor->category == TypeCategories::INTEGRAL; }
 
-    bool isFloatingPoint() const { return m_category == static_cast<unsigned int>(TypeCategories::FLOATING); }
+    bool isFloatingPoint() const { return m_descriptor->category == TypeCategories::FLOATING; }
 
-    bool isPointer() const { return m_category == static_cast<unsigned int>(TypeCategories::POINTER); }
+    bool isPointer() const { return m_descriptor->category == TypeCategories::POINTER; }
 
-    bool isStdString() const { return m_category == static_cast<unsigned int>(TypeCategories::STDSTRING); }
+    bool isStdString() const { return m_descriptor->category == TypeCategories::STDSTRING; }
 
 	bool isConst() const { return m_isConst; }
 
+	ValueTag tag() const { return m_descriptor->tag; }
+
+	const TypeDescriptor* descriptor() const { return m_descriptor; }
+
 	virtual void throwCast() const = 0;
+
+	// copies the holder into buffer, only supported for holders that are stored inplace
+	virtual IValueHolder* cloneInto(void* buffer) const = 0;
+
+	// constructs a holder in buffer that references this value, only supported for holders that are stored inplace
+	virtual IValueHolder* referenceInto(void* buffer) const = 0;
 	
-	virtual ::std::string convertToString() const = 0;
+	::std::string convertToString() const {
+		return m_descriptor->convertToString(ptrToValue());
+	}
 
-	virtual number_return convertToNumber(NumberType t) const = 0;
+	number_return convertToNumber(NumberType t) const {
+		const void* value = ptrToValue();
+		// the arithmetic types are converted inline, no need for an indirect call
+		switch (tag()) {
+			case ValueTag::BOOL:    return toNumber<bool>(value, t);
+			case ValueTag::CHAR:    return toNumber<char>(value, t);
+			case ValueTag::SCHAR:   return toNumber<signed char>(value, t);
+			case ValueTag::UCHAR:   return toNumber<unsigned char>(value, t);
+			case ValueTag::SHORT:   return toNumber<short>(value, t);
+			case ValueTag::USHORT:  return toNumber<unsigned short>(value, t);
+			case ValueTag::INT:     return toNumber<int>(value, t);
+			case ValueTag::UINT:    return toNumber<unsigned int>(value, t);
+			case ValueTag::LONG:    return toNumber<long>(value, t);
+			case ValueTag::ULONG:   return toNumber<unsigned long>(value, t);
+			case ValueTag::LLONG:   return toNumber<long long>(value, t);
+			case ValueTag::ULLONG:  return toNumber<unsigned long long>(value, t);
+			case ValueTag::FLOAT:   return toNumber<float>(value, t);
+			case ValueTag::DOUBLE:  return toNumber<double>(value, t);
+			case ValueTag::LDOUBLE: return toNumber<long double>(value, t);
+			default:
+				return m_descriptor->convertToNumber(value, t);
+		}
+	}
 
 	virtual ~IValueHolder() noexcept {}
 	IValueHolder() = default;
@@ -333,6 +456,19 @@ public:
 	IValueHolder& operator=(const IValueHolder&) = delete;
 
 private:
+	template<class T>
+	static number_return toNumber(const void* value, NumberType t) {
+		number_return r;
+		if (t == NumberType::INTEGER) {
+			r.i = static_cast<number_conversion::dst_int_t>(*static_cast<const T*>(value));
+		} else {
+			r.f = static_cast<number_conversion::dst_float_t>(*static_cast<const T*>(value));
+		}
+		return r;
+	}
+
+    const TypeDescriptor* const m_descriptor;
+
     const unsigned long m_offset : 6;
     const unsigned long m_offsetToPtr : 1;
 
@@ -340,15 +476,34 @@ private:
     const unsigned long m_typeId : PointerPacker<std::type_info>::usable_bits;
 #endif
 
-    const unsigned long m_sizeOf: max_sizeof_bits;
+	const unsigned long m_isConst : 1;
+};
+
+//namespace {
+
+namespace inplace_storage {
+	enum {
+		size = sizeof(IValueHolder) + SELFPORTRAIT_VARIANT_INPLACE_SIZE,
+		alignment = alignment_helper::max_alignment
+	};
+}
 
-    const unsigned long m_alignOf: alignment_helper::max_alignment_bits;
+template <class T>
+class ValueHolder;
 
-    const unsigned int m_category: 3;
-	const unsigned int m_isConst : 1;
+template<class T>
+struct is_inplace {
+	enum {
+		value = ::std::is_trivial<T>::value
+				&& sizeof(T) <= SELFPORTRAIT_VARIANT_INPLACE_SIZE
+				&& alignof(T) <= alignof(IValueHolder)
+	};
 };
 
-//namespace {
+template<class T>
+struct is_inplace<T&> {
+	enum { value = true };
+};
 
 template <class T>
 class ValueHolder: public IValueHolder {
@@ -369,6 +524,28 @@ class ValueHolder: public IValueHolder {
 
     typedef CloneHelper<T, ::std::is_constructible<T, const T&>::value> Cloner;
 
+	template<class Dummy, bool OK>
+	struct InplaceHelper {
+		static IValueHolder* cloneInto(const ValueHolder* holder, void* buffer) {
+			return new(buffer) ValueHolder(holder->m_value);
+		}
+		static IValueHolder* referenceInto(const ValueHolder* holder, void* buffer) {
+			return new(buffer) ValueHolder<T&>(const_cast<T&>(holder->m_value));
+		}
+	};
+
+	template<class Dummy>
+	struct InplaceHelper<Dummy, false> {
+		static IValueHolder* cloneInto(const ValueHolder*, void*) {
+			throw std::logic_error("type is not stored inplace");
+		}
+		static IValueHolder* referenceInto(const ValueHolder*, void*) {
+			throw std::logic_error("type is not stored inplace");
+		}
+	};
+
+	typedef InplaceHelper<T, is_inplace<T>::value> Inplace;
+
 
 	template<class U,bool OK>
 	struct CompareHelper {
@@ -396,13 +573,7 @@ public:
 #ifndef NO_RTTI
 					   typeid(ValueType),
 #endif
-					   sizeof(ValueType),
-					   alignof(ValueType),
-					   ::std::is_pod<ValueType>::value,
-					   ::std::is_integral<ValueType>::value,
-					   ::std::is_floating_point<ValueType>::value,
-					   ::std::is_pointer<ValueType>::value,
-                       ::std::is_same<std::string, ValueType>::value,
+					   type_descriptor<typename ::std::remove_cv<ValueType>::type>::value,
 					   normalize_type<T>::is_const),
 		m_value( ::std::forward<Args>(args)...)
     {
@@ -419,13 +590,7 @@ public:
 #ifndef NO_RTTI
                        typeid(ValueType),
 #endif
-                       sizeof(ValueType),
-                       alignof(ValueType),
-                       ::std::is_pod<ValueType>::value,
-                       ::std::is_integral<ValueType>::value,
-                       ::std::is_floating_point<ValueType>::value,
-                       ::std::is_pointer<ValueType>::value,
-                       ::std::is_same<std::string, ValueType>::value,
+                       type_descriptor<typename ::std::remove_cv<ValueType>::type>::value,
                        normalize_type<T>::is_const),
         m_value( that.m_value )
     {}
@@ -435,13 +600,7 @@ public:
 #ifndef NO_RTTI
                        typeid(ValueType),
 #endif
-                       sizeof(ValueType),
-                       alignof(ValueType),
-                       ::std::is_pod<ValueType>::value,
-                       ::std::is_integral<ValueType>::value,
-                       ::std::is_floating_point<ValueType>::value,
-                       ::std::is_pointer<ValueType>::value,
-                       ::std::is_same<std::string, ValueType>::value,
+                       type_descriptor<typename ::std::remove_cv<ValueType>::type>::value,
                        normalize_type<T>::is_const),
         m_value( that.m_value )
     {}
@@ -463,22 +622,16 @@ public:
 		return false;
 	}
 
-	virtual ::std::string convertToString() const override {
-            return ::std::move(strconv::toString(m_value));
+	virtual void throwCast() const {
+		throw const_cast<ValueType*>(&m_value);
 	}
 
-	virtual number_return convertToNumber(NumberType t) const {
-		number_return r;
-        if (t == NumberType::INTEGER) {
-            r.i = ::convertToInteger(m_value);
-        } else {
-			r.f = ::convertToFloatingPoint(m_value);
-        }
-		return r;
+	IValueHolder* cloneInto(void* buffer) const override {
+		return Inplace::cloneInto(this, buffer);
 	}
 
-	virtual void throwCast() const {
-		throw const_cast<ValueType*>(&m_value);
+	IValueHolder* referenceInto(void* buffer) const override {
+		return Inplace::referenceInto(this, buffer);
 	}
 
 private:
@@ -534,13 +687,7 @@ public:
 #ifndef NO_RTTI
 					   typeid(ValueType),
 #endif
-					   sizeof(ValueType),
-					   alignof(ValueType),
-					   ::std::is_pod<ValueType>::value,
-					   ::std::is_integral<ValueType>::value,
-					   ::std::is_floating_point<ValueType>::value,
-					   ::std::is_pointer<ValueType>::value,
-                       ::std::is_same<std::string, ValueType>::value,
+					   type_descriptor<typename ::std::remove_cv<ValueType>::type>::value,
                        normalize_type<T>::is_const),
           m_value(v), m_ptr(&v) {
         static_assert(alignof(ValueType) < alignment_helper::max_alignment, "unsupported alignment size");
@@ -568,23 +715,16 @@ public:
 		return false;
 	}
 
-
-	virtual ::std::string convertToString() const override {
-            return ::std::move(strconv::toString(m_value));
+	virtual void throwCast() const {
+		throw &m_value;
 	}
 
-	virtual number_return convertToNumber(NumberType t) const {
-		number_return r;
-		if (t == NumberType::INTEGER) {
-			r.i = ::convertToInteger(m_value);
-		} else {
-			r.f = ::convertToFloatingPoint(m_value);
-		}
-		return r;
+	IValueHolder* cloneInto(void* buffer) const override {
+		return new(buffer) ValueHolder(m_value);
 	}
 
-	virtual void throwCast() const {
-		throw &m_value;
+	IValueHolder* referenceInto(void* buffer) const override {
+		return new(buffer) ValueHolder(m_value);
 	}
 
 private:
@@ -641,13 +781,7 @@ public:
 #ifndef NO_RTTI
                        typeid(ValueType),
 #endif
-                       sizeof(ValueType),
-                       alignof(ValueType),
-                       ::std::is_pod<ValueType>::value,
-                       ::std::is_integral<ValueType>::value,
-                       ::std::is_floating_point<ValueType>::value,
-                       ::std::is_pointer<ValueType>::value,
-                       ::std::is_same<std::string, ValueType>::value,
+                       type_descriptor<typename ::std::remove_cv<ValueType>::type>::value,
                        normalize_type<T>::is_const),
           m_value(v), m_ptr(&v) {
         static_assert(alignof(ValueType) < alignment_helper::max_alignment, "unsupported alignment size");
@@ -675,23 +809,16 @@ public:
         return false;
     }
 
-
-    virtual ::std::string convertToString() const override {
-            return ::std::move(strconv::toString(m_value));
+    virtual void throwCast() const {
+        throw &m_value;
     }
 
-    virtual number_return convertToNumber(NumberType t) const {
-        number_return r;
-        if (t == NumberType::INTEGER) {
-            r.i = ::convertToInteger(m_value);
-        } else {
-            r.f = ::convertToFloatingPoint(m_value);
-        }
-        return r;
+    IValueHolder* cloneInto(void*) const override {
+        throw std::logic_error("type is not stored inplace");
     }
 
-    virtual void throwCast() const {
-        throw &m_value;
+    IValueHolder* referenceInto(void*) const override {
+        throw std::logic_error("type is not stored inplace");
     }
 
 private:
@@ -703,7 +830,30 @@ private:
 
 //}
 
-// A variant value contains a value type by value
+#ifndef NO_RTTI
+enum class RegisteredConversion {
+	UNKNOWN,     // the registered classes can't tell, the value has to be thrown
+	IMPOSSIBLE,  // both classes are registered and 'to' is no base of 'from'
+	OFFSET       // 'to' is a base at a known offset
+};
+
+/** Decides a conversion from the class 'from' to its base 'to' with the
+ *  superclasses registered with REFL_SUPER_CLASS. Only bases that were
+ *  registered are known, a registered class doesn't convert to a base its
+ *  registration doesn't mention. Virtual and ambiguous bases are UNKNOWN */
+RegisteredConversion registeredConversion(const ::std::type_info& from, const ::std::type_info& to, int& offset);
+
+/** The same for the pointer types 'from' and 'to' of registered classes,
+ *  true if a pointer converts by adding offset. A pointer to const doesn't
+ *  convert to a pointer to non const */
+bool registeredPointerConversion(const ::std::type_info& from, const ::std::type_info& to, int& offset);
+#endif
+
+/** A variant value contains a value type by value
+ *
+ *  Copies of a variant copy the value, no matter whether it is stored on the
+ *  heap or inplace. Variants made with createReference share it instead.
+ */
 class VariantValue {
 public:
 	//! Creates an empty variant
@@ -745,21 +895,19 @@ public:
 
 	template<class ValueType>
     VariantValue(const ValueType& t) : m_embedded(Types::DEFAULT) {
-        new(&m_impl) shared_ptr<IValueHolder>(new ValueHolder<ValueType>(t));
+        initHolder<ValueType>(t);
     }
 
 	template<class ValueType>
     VariantValue(ValueType* t) : m_embedded(Types::DEFAULT) {
-
-        new(&m_impl) shared_ptr<IValueHolder>(new ValueHolder<ValueType*>(t));
+        initHolder<ValueType*>(t);
     }
 
 
 	template<class ValueType, class... Args>
 	VariantValue& construct(Args&&... args) {
         destroyEmbedded();
-        m_embedded = Types::DEFAULT;
-        new(&m_impl) shared_ptr<IValueHolder>(new ValueHolder<ValueType>( ::std::forward<Args>(args)... ));
+        initHolder<ValueType>( ::std::forward<Args>(args)... );
 		return *this;
 	}
 
@@ -811,8 +959,7 @@ public:
 	template<class ValueType>
 	VariantValue& operator=(ValueType value) {
         destroyEmbedded();
-        m_embedded = Types::DEFAULT;
-        new(&m_impl) shared_ptr<IValueHolder>(new ValueHolder<ValueType>( value ));
+        initHolder<ValueType>( value );
 		return *this;
 	}
 
@@ -883,6 +1030,13 @@ public:
         return *this;
     }
 
+	/** a variant that shares the value of this one, the reference keeps the
+	 *  value alive. A value stored inplace is moved to the heap first, which
+	 *  invalidates references and pointers to it that were taken before */
+	VariantValue createReference();
+
+	/** same as above, but an inplace value can't be moved: the reference to it
+	 *  is only valid as long as this variant holds the value */
 	VariantValue createReference() const;
 	
 	template<class ValueType>
@@ -899,33 +1053,75 @@ public:
 	
 private:
 
+	// arithmetic types and std::string are recognized by their tag, no type_info comparison needed.
+	// Returns false if the tag doesn't decide the conversion
+	template<class ValueType>
+	bool matchTag(typename normalize_type<ValueType>::ptr_type& ptr) const {
+		typedef value_tag<typename ::std::remove_cv<typename ::std::remove_reference<ValueType>::type>::type> Tag;
+
+		if (Tag::value == ValueTag::OTHER) {
+			return false;
+		}
+		const ValueTag tag = impl()->tag();
+		if (tag == Tag::value) {
+			const bool constOk = !impl()->isConst() || normalize_type<ValueType>::is_const;
+			ptr = constOk ? reinterpret_cast<typename normalize_type<ValueType>::ptr_type>(const_cast<void*>(impl()->ptrToValue())) : nullptr;
+			return true;
+		}
+		// a class derived from std::string is the only other type that can be converted to one
+		ptr = nullptr;
+		return tag != ValueTag::OTHER || Tag::value != ValueTag::STRING;
+	}
+
 #ifndef NO_RTTI
 	template<class ValueType>
     typename normalize_type<ValueType>::ptr_type isAPriv() const {
 
+		typename normalize_type<ValueType>::ptr_type tagged;
+		if (matchTag<ValueType>(tagged)) {
+			return tagged;
+		}
+
         const std::type_info& from = impl()->typeId();
 		const std::type_info& to   = typeid(ValueType);
 
+        const bool implConst = impl()->isConst();
+        const bool constOk = !implConst || (implConst && normalize_type<ValueType>::is_const);
+
 		if (from == to) {
-            if (!impl()->isConst() || (impl()->isConst() && normalize_type<ValueType>::is_const)) {
-                return reinterpret_cast<typename normalize_type<ValueType>::ptr_type>(const_cast<void*>(impl()->ptrToValue()));
-			}
+			// the answer depends on the held value, it isn't cached
+			return constOk ? reinterpret_cast<typename normalize_type<ValueType>::ptr_type>(const_cast<void*>(impl()->ptrToValue())) : nullptr;
 		}
 
 		int offset;
 		bool possible;
 		if (conversion_cache<ValueType>::instance().conversionKnown(from, offset, possible)) {
 			if (possible) {
-                const bool implConst = impl()->isConst();
-				if (!implConst || (implConst && normalize_type<ValueType>::is_const)) {
-                    return reinterpret_cast<typename normalize_type<ValueType>::ptr_type>(reinterpret_cast<char*>(const_cast<void*>(impl()->ptrToValue()))+offset);
-				}
+				return constOk ? reinterpret_cast<typename normalize_type<ValueType>::ptr_type>(reinterpret_cast<char*>(const_cast<void*>(impl()->ptrToValue()))+offset) : nullptr;
 			} else {
 				// conversion is known to fail, we won't even try
 				return nullptr;
 			}
+		} else if (!::std::is_void<typename normalize_type<ValueType>::type>::value
+				   && (impl()->isIntegral() || impl()->isFloatingPoint() || impl()->isStdString())) {
+			// arithmetic types and strings have no base classes
+			conversion_cache<ValueType>::instance().registerConversion(from, 0, false);
+			return nullptr;
+		} else {
+			// the class hierarchy is known from registration, no need to throw
+			switch (registeredConversion(from, to, offset)) {
+				case RegisteredConversion::OFFSET:
+					conversion_cache<ValueType>::instance().registerConversion(from, offset, true);
+					return constOk ? reinterpret_cast<typename normalize_type<ValueType>::ptr_type>(reinterpret_cast<char*>(const_cast<void*>(impl()->ptrToValue()))+offset) : nullptr;
+				case RegisteredConversion::IMPOSSIBLE:
+					conversion_cache<ValueType>::instance().registerConversion(from, 0, false);
+					return nullptr;
+				case RegisteredConversion::UNKNOWN:
+					break;
+			}
 		}
 
+		// fallback for types whose hierarchy wasn't registered
 		try {
             impl()->throwCast();
 		} catch(typename normalize_type<ValueType>::ptr_type ptr) {
@@ -942,6 +1138,11 @@ private:
 	template<class ValueType>
 	typename normalize_type<ValueType>::ptr_type isAPriv() const {
 
+		typename normalize_type<ValueType>::ptr_type tagged;
+		if (matchTag<ValueType>(tagged)) {
+			return tagged;
+		}
+
 		try {
             impl()->throwCast();
 		} catch(typename normalize_type<ValueType>::ptr_type ptr) {
@@ -965,8 +1166,10 @@ private:
 				if (success != nullptr) *success = true;
 				return ptr;
 			} catch(...) { }
-			if (success != nullptr) *success = false;
-            return type();
+			type ptr;
+			const bool converted = convertPointer(holder, ptr);
+			if (success != nullptr) *success = converted;
+            return converted ? ptr : type();
 		}
         static type value(const IValueHolder* holder) {
 			try {
@@ -974,8 +1177,26 @@ private:
             } catch (type& ptr) {
 				return ptr;
 			} catch(...) { }
+			type ptr;
+			if (convertPointer(holder, ptr)) {
+				return ptr;
+			}
 			throw std::runtime_error("failed to convert variant to pointer");
 		}
+
+		// a pointer to a registered class converts to a pointer to one of its bases
+		static bool convertPointer(const IValueHolder* holder, type& ptr) {
+#ifndef NO_RTTI
+			int offset;
+			if (holder->descriptor()->category == TypeDescriptor::TypeCategories::POINTER
+				&& registeredPointerConversion(holder->typeId(), typeid(type), offset)) {
+				char* from = *static_cast<char* const*>(holder->ptrToValue());
+				ptr = reinterpret_cast<type>(from == nullptr ? nullptr : from + offset);
+				return true;
+			}
+#endif
+			return false;
+		}
 	};
 
 	template<class ValueType>
@@ -1181,7 +1402,22 @@ public:
 	::std::size_t alignOf() const;
 	
 	// If the type is a POD and you know what you're doing, you can memcpy it, but beware of the alignment
-	const void * ptrToValue() const;
+	const void * ptrToValue() const {
+		check_valid();
+		return impl()->ptrToValue();
+	}
+
+	// Identifies the type of the value, the descriptor is shared by all values of the same type.
+	// Returns nullptr for an empty variant
+	const TypeDescriptor* typeDescriptor() const {
+		return isValid() ? impl()->descriptor() : nullptr;
+	}
+
+	// The value is const, e.g. the variant holds a const reference
+	bool isConst() const {
+		check_valid();
+		return impl()->isConst();
+	}
 
     /* These two cannot be global functions, otherwise implicit
      * type conversions and suddenly everything is comparable
@@ -1204,7 +1440,8 @@ private:
         UINT64,
         DOUBLE,
         FLOAT,
-        STRING
+        STRING,
+        INPLACE
     };
 
     Types m_embedded;
@@ -1224,8 +1461,36 @@ private:
         ValueHolder<double>          m_double;
         ValueHolder<float>            m_float;
         ValueHolder<std::string>   m_string;
+
+        // any other ValueHolder<T> for which is_inplace<T> holds
+        ::std::aligned_storage<inplace_storage::size, inplace_storage::alignment>::type m_inplace;
     };
 
+    template<class ValueType, class... Args>
+    void initHolder(Args&&... args) {
+        initHolderImpl<ValueType>(::std::integral_constant<bool, is_inplace<ValueType>::value>(), ::std::forward<Args>(args)...);
+    }
+
+    template<class ValueType, class... Args>
+    void initHolderImpl(::std::true_type, Args&&... args) {
+        static_assert(sizeof(ValueHolder<ValueType>) <= sizeof(m_inplace), "inplace storage too small");
+        m_embedded = Types::INPLACE;
+        new(&m_inplace) ValueHolder<ValueType>( ::std::forward<Args>(args)... );
+    }
+
+    template<class ValueType, class... Args>
+    void initHolderImpl(::std::false_type, Args&&... args) {
+        m_embedded = Types::DEFAULT;
+        VariantArena* arena = VariantArena::current();
+        if (arena == nullptr) {
+            new(&m_impl) shared_ptr<IValueHolder>(new ValueHolder<ValueType>( ::std::forward<Args>(args)... ));
+        } else {
+            // the holder and the control block in one allocation from the arena
+            new(&m_impl) shared_ptr<IValueHolder>(::std::allocate_shared<ValueHolder<ValueType>>(
+                arena->allocator<ValueHolder<ValueType>>(), ::std::forward<Args>(args)... ));
+        }
+    }
+
     IValueHolder* impl() {
         switch (m_embedded) {
             case Types::DEFAULT:
@@ -1249,9 +1514,12 @@ private:
             case Types::DOUBLE:
                 return &m_double;
             case Types::FLOAT:
-                return &m_double;
+                return &m_float;
             case Types::STRING:
                 return &m_string;
+            case Types::INPLACE:
+                // ValueHolders derive only from IValueHolder, it's located at the start of the object
+                return reinterpret_cast<IValueHolder*>(&m_inplace);
         }
         return m_impl.get();
     }
@@ -0,0 +1,81 @@
+/*
+** SelfPortrait API
+** See Copyright Notice in reflection.h
+*/
+#include "variant_arena.h"
+
+#include <algorithm>
+#include <new>
+
+namespace {
+	// blocks double up to this size, larger values get a block of their own
+	const ::std::size_t max_block_size = 1 << 20;
+
+	thread_local VariantArena* current_arena = nullptr;
+}
+
+VariantArenaRegion* VariantArenaRegion::create(::std::size_t blockSize)
+{
+	blockSize = ::std::max(blockSize, 4 * sizeof(VariantArenaRegion));
+	char* first = static_cast<char*>(::operator new(blockSize));
+	return new (first) VariantArenaRegion(first + blockSize, blockSize);
+}
+
+VariantArenaRegion::VariantArenaRegion(char* end, ::std::size_t blockSize)
+	: m_references(1)
+	, m_cursor(reinterpret_cast<char*>(this + 1))
+	, m_end(end)
+	, m_blockSize(::std::min(2 * blockSize, ::std::max(blockSize, ::std::size_t(max_block_size))))
+	, m_reserved(blockSize)
+	, m_blocks(nullptr)
+{}
+
+VariantArenaRegion::~VariantArenaRegion()
+{
+	while (m_blocks != nullptr) {
+		Block* next = m_blocks->next;
+		::operator delete(m_blocks);
+		m_blocks = next;
+	}
+}
+
+void VariantArenaRegion::destroy()
+{
+	this->~VariantArenaRegion();
+	::operator delete(this);
+}
+
+void* VariantArenaRegion::allocateBlock(::std::size_t size, ::std::size_t alignment)
+{
+	const ::std::size_t blockSize = ::std::max(m_blockSize, sizeof(Block) + size + alignment);
+	Block* block = static_cast<Block*>(::operator new(blockSize));
+	block->next = m_blocks;
+	m_blocks = block;
+	m_reserved += blockSize;
+	m_blockSize = ::std::min(2 * m_blockSize, ::std::max(m_blockSize, ::std::size_t(max_block_size)));
+
+	m_cursor = reinterpret_cast<char*>(block + 1);
+	m_end = reinterpret_cast<char*>(block) + blockSize;
+	return allocate(size, alignment);
+}
+
+VariantArena::VariantArena(::std::size_t blockSize)
+	: m_region(nullptr)
+	, m_blockSize(blockSize)
+	, m_previous(current_arena)
+{
+	current_arena = this;
+}
+
+VariantArena::~VariantArena()
+{
+	current_arena = m_previous;
+	if (m_region != nullptr) {
+		m_region->release();
+	}
+}
+
+VariantArena* VariantArena::current()
+{
+	return current_arena;
+}
@@ -0,0 +1,148 @@
+/*
+** SelfPortrait API
+** See Copyright Notice in reflection.h
+*/
+#ifndef VARIANT_ARENA_H
+#define VARIANT_ARENA_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/** The memory of a VariantArena. Allocations bump a pointer through blocks
+ *  that are only freed together, deallocations just count down. The region
+ *  lives at the start of its first block.
+ *
+ *  Allocating is only done by the thread that owns the arena, but values
+ *  may be released by any thread. The region counts its live allocations
+ *  plus one for the arena, and frees itself when the count drops to zero.
+ */
+class VariantArenaRegion {
+public:
+
+	static VariantArenaRegion* create(::std::size_t blockSize);
+
+	VariantArenaRegion(const VariantArenaRegion&) = delete;
+	VariantArenaRegion& operator=(const VariantArenaRegion&) = delete;
+
+	void* allocate(::std::size_t size, ::std::size_t alignment) {
+		const ::std::uintptr_t p = (reinterpret_cast< ::std::uintptr_t>(m_cursor) + alignment - 1) & ~::std::uintptr_t(alignment - 1);
+		if (p + size > reinterpret_cast< ::std::uintptr_t>(m_end)) {
+			return allocateBlock(size, alignment);
+		}
+		m_cursor = reinterpret_cast<char*>(p + size);
+		m_references.fetch_add(1, ::std::memory_order_relaxed);
+		return reinterpret_cast<void*>(p);
+	}
+
+	void release() {
+		if (m_references.fetch_sub(1, ::std::memory_order_acq_rel) == 1) {
+			destroy();
+		}
+	}
+
+	::std::size_t bytesReserved() const { return m_reserved; }
+
+private:
+
+	// header of the blocks after the first one
+	struct Block {
+		Block* next;
+	};
+
+	VariantArenaRegion(char* end, ::std::size_t blockSize);
+	~VariantArenaRegion();
+
+	void* allocateBlock(::std::size_t size, ::std::size_t alignment);
+
+	void destroy();
+
+	::std::atomic< ::std::size_t> m_references;
+	char* m_cursor;
+	char* m_end;
+	::std::size_t m_blockSize;
+	::std::size_t m_reserved;
+	Block* m_blocks;
+};
+
+template<class T>
+class VariantArenaAllocator {
+public:
+	typedef T value_type;
+
+	explicit VariantArenaAllocator(VariantArenaRegion* region) : m_region(region) {}
+
+	template<class U>
+	VariantArenaAllocator(const VariantArenaAllocator<U>& rhs) : m_region(rhs.region()) {}
+
+	T* allocate(::std::size_t n) {
+		return static_cast<T*>(m_region->allocate(n * sizeof(T), alignof(T)));
+	}
+
+	void deallocate(T*, ::std::size_t) {
+		m_region->release();
+	}
+
+	VariantArenaRegion* region() const { return m_region; }
+
+private:
+	VariantArenaRegion* m_region;
+};
+
+template<class T, class U>
+bool operator==(const VariantArenaAllocator<T>& a1, const VariantArenaAllocator<U>& a2) {
+	return a1.region() == a2.region();
+}
+
+template<class T, class U>
+bool operator!=(const VariantArenaAllocator<T>& a1, const VariantArenaAllocator<U>& a2) {
+	return a1.region() != a2.region();
+}
+
+/** Scope for request-sized reflective work.
+ *
+ *  While an arena is alive, the values that a VariantValue built on the same
+ *  thread can't store inplace are allocated, together with their shared_ptr
+ *  control block, from the arena instead of the heap. The memory is handed
+ *  back in bulk when the arena and every value allocated from it are gone,
+ *  so a value that escapes the scope keeps the memory alive instead of
+ *  dangling. Copies of values are not allocated from the arena.
+ *
+ *  Arenas nest, the innermost one is used. They must be destroyed in the
+ *  reverse order of their construction, by the thread that created them,
+ *  which is what block scoped variables do.
+ */
+class VariantArena {
+public:
+
+	enum { default_block_size = 4096 };
+
+	explicit VariantArena(::std::size_t blockSize = default_block_size);
+
+	~VariantArena();
+
+	VariantArena(const VariantArena&) = delete;
+	VariantArena& operator=(const VariantArena&) = delete;
+
+	// the innermost arena of the calling thread, nullptr if there is none
+	static VariantArena* current();
+
+	template<class T>
+	VariantArenaAllocator<T> allocator() {
+		if (m_region == nullptr) {
+			m_region = VariantArenaRegion::create(m_blockSize);
+		}
+		return VariantArenaAllocator<T>(m_region);
+	}
+
+	// memory taken from the heap so far
+	::std::size_t bytesReserved() const { return m_region ? m_region->bytesReserved() : 0; }
+
+private:
+	// created with the first allocation, an arena that is never used costs nothing
+	VariantArenaRegion* m_region;
+	const ::std::size_t m_blockSize;
+	VariantArena* m_previous;
+};
+
+#endif /* VARIANT_ARENA_H */
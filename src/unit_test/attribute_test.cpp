@@ -15,6 +15,7 @@
 
 #include <iostream>
 #include <string>
+#include <vector>
 using namespace std;
 
 
@@ -44,6 +45,38 @@ namespace AttributeTest {
         std::unique_ptr<int> attr1;
     };
 
+	class FieldsBase {
+	public:
+		int count;
+		std::string label;
+
+		FieldsBase() : count(3), label("base") {}
+	};
+
+	class Fields : public FieldsBase {
+	public:
+		bool flag;
+		char letter;
+		short small;
+		unsigned long big;
+		float ratio;
+		double precise;
+		std::string name;
+		std::vector<int> values;
+
+		Fields() : flag(true), letter('a'), small(-2), big(5000000000ul), ratio(0.5f), precise(0.25), name("fields"), values{1, 2} {}
+
+		// hides the attribute of the base class
+		int count() const { return 7; }
+
+		bool operator==(const Fields& rhs) const { return name == rhs.name; }
+
+		static const Fields& constant() {
+			static const Fields fields;
+			return fields;
+		}
+	};
+
 }
 
 REFL_BEGIN_CLASS(AttributeTest::Test)
@@ -63,6 +96,29 @@ REFL_BEGIN_CLASS(AttributeTest::Test3)
 REFL_ATTRIBUTE(attr1, std::unique_ptr<int>)
 REFL_END_CLASS
 
+
+REFL_BEGIN_CLASS(AttributeTest::FieldsBase)
+	REFL_ATTRIBUTE(count, int)
+	REFL_ATTRIBUTE(label, std::string)
+	REFL_DEFAULT_CONSTRUCTOR()
+REFL_END_CLASS
+
+
+REFL_BEGIN_CLASS(AttributeTest::Fields)
+	REFL_SUPER_CLASS(AttributeTest::FieldsBase)
+	REFL_ATTRIBUTE(flag, bool)
+	REFL_ATTRIBUTE(letter, char)
+	REFL_ATTRIBUTE(small, short)
+	REFL_ATTRIBUTE(big, unsigned long)
+	REFL_ATTRIBUTE(ratio, float)
+	REFL_ATTRIBUTE(precise, double)
+	REFL_ATTRIBUTE(name, std::string)
+	REFL_ATTRIBUTE(values, std::vector<int>)
+	REFL_CONST_METHOD(count, int)
+	REFL_STATIC_METHOD(constant, const AttributeTest::Fields&)
+	REFL_DEFAULT_CONSTRUCTOR()
+REFL_END_CLASS
+
 using namespace AttributeTest;
 
 void AttributeTestSuite::testVanillaAttribute()
@@ -160,6 +216,32 @@ void AttributeTestSuite::testLuaAPI()
 }
 
 
+void AttributeTestSuite::testLuaFieldAccess()
+{
+	LuaUtils::LuaStateHolder L;
+	LuaUtils::addTestFunctionsAndPaths(&*L);
+
+	if (luaL_loadfile(L, strconv::fmt_str("%1/attribute_test.lua", srcpath()).c_str()) || lua_pcall(L,0,0,0)) {
+		luaL_error(L, "cannot run config file: %s\n", lua_tostring(L, -1));
+	}
+
+	LuaUtils::callFunc<bool>(L, "testFieldAccess");
+}
+
+
+void AttributeTestSuite::testLuaClassComparison()
+{
+	LuaUtils::LuaStateHolder L;
+	LuaUtils::addTestFunctionsAndPaths(&*L);
+
+	if (luaL_loadfile(L, strconv::fmt_str("%1/attribute_test.lua", srcpath()).c_str()) || lua_pcall(L,0,0,0)) {
+		luaL_error(L, "cannot run config file: %s\n", lua_tostring(L, -1));
+	}
+
+	LuaUtils::callFunc<bool>(L, "testClassComparison");
+}
+
+
 void AttributeTestSuite::testHash()
 {
 	using namespace std;
@@ -203,3 +285,78 @@ void AttributeTestSuite::testNonAssignableAttribute()
 {
     static_assert(std::is_copy_assignable<std::unique_ptr<int>>::value == false, "unique_ptr should not be assignable");
 }
+
+void AttributeTestSuite::testGetBatch()
+{
+	Class test = Class::lookup("AttributeTest::Test");
+	Attribute attr1 = test.attribute("attr1");
+	Attribute attr3 = test.attribute("attr3");
+
+	std::vector<VariantValue> objects(10000);
+	for (std::size_t i = 0; i < objects.size(); ++i) {
+		objects[i] = Test();
+		attr1.set(objects[i], int(i));
+	}
+
+	std::vector<VariantValue> results;
+	attr1.getBatch(objects, results);
+	TS_ASSERT_EQUALS(results.size(), objects.size());
+	TS_ASSERT_EQUALS(results[0].value<const int&>(), 0);
+	TS_ASSERT_EQUALS(results[9999].value<const int&>(), 9999);
+
+	// the results refer to the attributes of the objects
+	attr1.set(objects[5], 1005);
+	TS_ASSERT_EQUALS(results[5].value<const int&>(), 1005);
+
+	std::vector<VariantValue> parallel;
+	attr1.getBatch(objects, parallel, 4);
+	for (std::size_t i = 0; i < objects.size(); ++i) {
+		TS_ASSERT_EQUALS(parallel[i].value<const int&>(), results[i].value<const int&>());
+	}
+
+	attr3.getBatch(ArgumentView(objects.data(), 2), results);
+	TS_ASSERT_EQUALS(results.size(), 2);
+	TS_ASSERT_EQUALS(results[1].value<const int&>(), 103);
+
+	objects[7000] = Test2();
+	TS_ASSERT_THROWS(attr1.getBatch(objects, results), std::runtime_error);
+	TS_ASSERT_THROWS(attr1.getBatch(objects, results, 4), std::runtime_error);
+}
+
+void AttributeTestSuite::testRawAccessor()
+{
+	Class test = Class::lookup("AttributeTest::Test");
+	RawAttributeAccessor attr1 = test.attribute("attr1").rawAccessor();
+	RawAttributeAccessor attr2 = test.attribute("attr2").rawAccessor();
+
+	TS_ASSERT(attr1.isValid());
+	TS_ASSERT_EQUALS(attr1.size(), sizeof(int));
+	TS_ASSERT(attr1.isTriviallyCopyable());
+
+	Test t1, t2;
+	TS_ASSERT_EQUALS(attr2.offset(), reinterpret_cast<const char*>(&t1.attr2) - reinterpret_cast<const char*>(&t1));
+	TS_ASSERT_EQUALS(attr1.get<int>(&t1), 101);
+	TS_ASSERT_EQUALS(attr2.get<const int>(&t1), 102);
+
+	attr1.set(&t1, 201);
+	TS_ASSERT_EQUALS(t1.attr1, 201);
+	TS_ASSERT_THROWS(attr2.set(&t1, 202), std::runtime_error);
+	TS_ASSERT_THROWS(attr1.get<long>(&t1), std::runtime_error);
+	TS_ASSERT_THROWS(attr1.set(&t1, 2.5), std::runtime_error);
+
+	attr1.copy(&t2, &t1);
+	TS_ASSERT_EQUALS(t2.attr1, 201);
+	TS_ASSERT_THROWS(attr2.copy(&t2, &t1), std::runtime_error);
+
+	// works on the value held by a variant
+	VariantValue v = Test();
+	attr1.set(const_cast<void*>(v.ptrToValue()), 301);
+	TS_ASSERT_EQUALS(v.value<Test&>().attr1, 301);
+
+	RawAttributeAccessor unique = Class::lookup("AttributeTest::Test3").attribute("attr1").rawAccessor();
+	TS_ASSERT(!unique.isTriviallyCopyable());
+	TS_ASSERT_THROWS(unique.copy(&t2, &t1), std::runtime_error);
+
+	TS_ASSERT_THROWS(test.attribute("attr3").rawAccessor(), std::runtime_error);
+	TS_ASSERT(!RawAttributeAccessor().isValid());
+}
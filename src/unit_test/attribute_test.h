@@ -17,9 +17,13 @@ public:
 	void testConstAttribute();
 	void testStaticAttribute();
 	void testLuaAPI();
+	void testLuaFieldAccess();
+	void testLuaClassComparison();
 	void testHash();
 	void testClassRef();
     void testNonAssignableAttribute();
+	void testGetBatch();
+	void testRawAccessor();
 };
 
 
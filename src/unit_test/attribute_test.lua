@@ -115,3 +115,106 @@ function testAttribute()
 
     return true
 end
+
+
+function testFieldAccess()
+
+    local Fields = Class.lookup("AttributeTest::Fields")
+    local f = Fields:construct()
+
+    -- attributes declared by the class are read at their offset
+    TS_ASSERT[[ f.flag == 1 ]]
+    TS_ASSERT[[ f.letter == string.byte("a") ]]
+    TS_ASSERT[[ f.small == -2 ]]
+    TS_ASSERT[[ f.big == 5000000000 ]]
+    TS_ASSERT[[ f.ratio == 0.5 ]]
+    TS_ASSERT[[ f.precise == 0.25 ]]
+    TS_ASSERT[[ f.name == "fields" ]]
+
+    f.letter = string.byte("z")
+    f.small = 12
+    f.big = 6000000000
+    f.ratio = 1.5
+    f.precise = 2.25
+    f.name = "with\0zero"
+    TS_ASSERT[[ f.letter == string.byte("z") ]]
+    TS_ASSERT[[ f.small == 12 ]]
+    TS_ASSERT[[ f.big == 6000000000 ]]
+    TS_ASSERT[[ f.ratio == 1.5 ]]
+    TS_ASSERT[[ f.precise == 2.25 ]]
+    TS_ASSERT[[ f.name == "with\0zero" ]]
+
+    -- other values are converted by the attribute
+    f.small = "7"
+    TS_ASSERT[[ f.small == 7 ]]
+    f.flag = false
+    TS_ASSERT[[ f.flag == 0 ]]
+
+    -- containers stay in the object
+    TS_ASSERT[[ type(f.values) == "userdata" ]]
+    local values = f.values:totable()
+    TS_ASSERT[[ #values == 2 and values[1] == 1 and values[2] == 2 ]]
+
+    -- inherited attributes, unless a method hides them
+    TS_ASSERT[[ f.label == "base" ]]
+    f.label = "changed"
+    TS_ASSERT[[ f.label == "changed" ]]
+    TS_ASSERT[[ f:count() == 7 ]]
+
+    -- the accessors of a class are shared by its objects
+    local g = Fields:construct()
+    TS_ASSERT[[ g.small == -2 ]]
+    TS_ASSERT[[ g.label == "base" ]]
+
+    -- const objects can be read, not written
+    local c = Fields:findMethod(function(m) return m:name() == "constant" end):call()
+    TS_ASSERT[[ c.small == -2 ]]
+    TS_ASSERT[[ c.name == "fields" ]]
+    if pcall(function() c.small = 1 end) then
+        TS_FAIL("expected exception when setting an attribute of a const object")
+    end
+    if pcall(function() c.name = "other" end) then
+        TS_FAIL("expected exception when setting an attribute of a const object")
+    end
+    TS_ASSERT[[ c.small == -2 ]]
+
+    if pcall(function() f.missing = 1 end) then
+        TS_FAIL("expected exception when setting an attribute that does not exist")
+    end
+
+    collectgarbage("collect")
+
+    return true
+end
+
+function testClassComparison()
+
+    local Fields = Class.lookup("AttributeTest::Fields")
+    local FieldsBase = Class.lookup("AttributeTest::FieldsBase")
+    local Test = Class.lookup("AttributeTest::Test")
+
+    local f1 = Fields:construct()
+    local f2 = Fields:construct()
+    local b = FieldsBase:construct()
+    local t = Test:construct()
+    local n = Variant.new(3)
+
+    -- every class metatable has the metamethods of the default one
+    TS_ASSERT[[ rawequal(getmetatable(f1).__eq, getmetatable(n).__eq) ]]
+    TS_ASSERT[[ rawequal(getmetatable(f1).__eq, getmetatable(b).__eq) ]]
+    TS_ASSERT[[ rawequal(getmetatable(f1).__eq, getmetatable(t).__eq) ]]
+    TS_ASSERT[[ rawequal(getmetatable(f1).__add, getmetatable(t).__add) ]]
+    TS_ASSERT[[ not rawequal(getmetatable(f1), getmetatable(t)) ]]
+
+    TS_ASSERT[[ f1 == f2 ]]
+    f2.name = "other"
+    TS_ASSERT[[ f1 ~= f2 ]]
+
+    -- values of different classes are compared without errors
+    TS_ASSERT[[ f1 ~= b ]]
+    TS_ASSERT[[ f1 ~= t ]]
+    TS_ASSERT[[ t ~= n ]]
+    TS_ASSERT[[ n == Variant.new(3) ]]
+
+    return true
+end
@@ -10,9 +10,12 @@
 
 #include <lua.hpp>
 
+#include <atomic>
+#include <chrono>
 #include <iostream>
 #include <string>
 #include <algorithm>
+#include <thread>
 
 using namespace std;
 
@@ -71,6 +74,49 @@ namespace ClassTest {
 	public:
 		void method1() {}
 	};
+
+	class VirtualDerived: public virtual TestBase2 {
+	public:
+		int attribute1 = 7;
+	};
+
+	class Test3: public Test1 {
+	public:
+		int attribute3 = 9;
+	};
+
+	// only looked up by testLazyClassBuild
+	class Lazy: public TestBase2 {
+	public:
+		int method1() const { return 1; }
+		int method2() const { return 2; }
+	};
+
+	// LateBase is only registered by testLateBase, the way a library loaded at runtime registers its classes
+	class LateBase {
+	public:
+		int lateMethod() const { return 3; }
+	};
+
+	class LateDerived: public LateBase {
+	public:
+		int derivedMethod() const { return 4; }
+	};
+
+	// registered by testConcurrentLateBase while other threads read LateDerived2
+	class LateBase2 {
+	public:
+		int lateAttribute = 5;
+		int lateMethod() const { return 3; }
+	};
+
+	class LateDerived2: public LateBase2 {
+	public:
+		int derivedAttribute = 6;
+		int derivedMethod() const { return 4; }
+	};
+
+	int answer() { return 42; }
 }
 
 REFL_BEGIN_CLASS(ClassTest::TestBase1)
@@ -105,6 +151,66 @@ REFL_BEGIN_CLASS(ClassTest::Test2)
 	REFL_DEFAULT_CONSTRUCTOR()
 REFL_END_CLASS
 
+REFL_BEGIN_CLASS(ClassTest::VirtualDerived)
+	REFL_SUPER_CLASS(ClassTest::TestBase2)
+	REFL_ATTRIBUTE(attribute1, int)
+	REFL_DEFAULT_CONSTRUCTOR()
+REFL_END_CLASS
+
+REFL_BEGIN_CLASS(ClassTest::Test3)
+	REFL_SUPER_CLASS(ClassTest::Test1)
+	REFL_ATTRIBUTE(attribute3, int)
+	REFL_DEFAULT_CONSTRUCTOR()
+REFL_END_CLASS
+
+REFL_BEGIN_CLASS(ClassTest::Lazy)
+	REFL_SUPER_CLASS(ClassTest::TestBase2)
+	REFL_CONST_METHOD(method1, int)
+	REFL_CONST_METHOD(method2, int)
+	REFL_DEFAULT_CONSTRUCTOR()
+REFL_END_CLASS
+
+REFL_BEGIN_CLASS(ClassTest::LateDerived)
+	REFL_SUPER_CLASS(ClassTest::LateBase)
+	REFL_CONST_METHOD(derivedMethod, int)
+	REFL_DEFAULT_CONSTRUCTOR()
+REFL_END_CLASS
+
+// REFL_BEGIN_CLASS without its static registration
+template<> ClassImpl* ClassImpl::inst<ClassTest::LateBase>() {
+	typedef ClassTest::LateBase ThisClass;
+	static ClassImpl instance;
+	static const bool closed = [] {
+#ifndef NO_RTTI
+		instance.setTypeInfo(typeid(ThisClass));
+#endif
+		instance.setFullyQualifiedName("ClassTest::LateBase");
+		instance.setLayout(sizeof(ThisClass), alignof(ThisClass), class_destructor<ThisClass>::value());
+		REFL_CONST_METHOD(lateMethod, int)
+REFL_END_CLASS
+
+REFL_BEGIN_CLASS(ClassTest::LateDerived2)
+	REFL_SUPER_CLASS(ClassTest::LateBase2)
+	REFL_ATTRIBUTE(derivedAttribute, int)
+	REFL_CONST_METHOD(derivedMethod, int)
+	REFL_DEFAULT_CONSTRUCTOR()
+REFL_END_CLASS
+
+template<> ClassImpl* ClassImpl::inst<ClassTest::LateBase2>() {
+	typedef ClassTest::LateBase2 ThisClass;
+	static ClassImpl instance;
+	static const bool closed = [] {
+#ifndef NO_RTTI
+		instance.setTypeInfo(typeid(ThisClass));
+#endif
+		instance.setFullyQualifiedName("ClassTest::LateBase2");
+		instance.setLayout(sizeof(ThisClass), alignof(ThisClass), class_destructor<ThisClass>::value());
+		REFL_ATTRIBUTE(lateAttribute, int)
+		REFL_CONST_METHOD(lateMethod, int)
+REFL_END_CLASS
+
+REFL_FUNCTION(ClassTest::answer, int)
+
 
 using namespace ClassTest;
 
@@ -405,6 +511,23 @@ void ClassTestSuite::testMethodSearch()
 
 	TS_ASSERT(!m30.isValid());
 	TS_ASSERT_THROWS_ANYTHING(m30.isConst());
+
+	Class::MethodRange method2 = test.methodsNamed("method2");
+	TS_ASSERT_EQUALS(method2.size(), 2);
+	TS_ASSERT(method2[0].getClass() == test); // own methods come before inherited ones
+	TS_ASSERT(method2[1].getClass() == Class::lookup("ClassTest::TestBase1"));
+
+	TS_ASSERT_EQUALS(test.methodsNamed(std::string("operator=")).size(), 2);
+	TS_ASSERT_EQUALS(test.methodsNamed("operator=", 1).size(), 2);
+	TS_ASSERT(test.methodsNamed("operator=", 0).empty());
+	TS_ASSERT_EQUALS(test.methodsNamed("base2Method1", 0).front().name(), "base2Method1");
+	TS_ASSERT(test.methodsNamed("method30").empty());
+
+	for (const Method& m: test.methodsNamed("method1")) {
+		TS_ASSERT_EQUALS(m.name(), "method1");
+	}
+
+	TS_ASSERT_THROWS_ANYTHING(Class().methodsNamed("method1"));
 }
 
 
@@ -433,9 +556,111 @@ void ClassTestSuite::testAttributeSearch()
 	});
 	TS_ASSERT(!a3.isValid());
 	TS_ASSERT_THROWS_ANYTHING(a3.isConst());
+
+	TS_ASSERT(test.attribute("attribute1") == a1);
+	TS_ASSERT(test.getAttribute("attribute1") == a1);
+	TS_ASSERT_EQUALS(test.attribute(std::string("attribute2")).name(), "attribute2");
+	TS_ASSERT(!test.attribute("attribute").isValid());
+	TS_ASSERT(!test.attribute("attribute3").isValid());
 }
 
 
+void ClassTestSuite::testSymbols()
+{
+	Class test = Class::lookup("ClassTest::Test1");
+
+	// names are interned at registration
+	Symbol method2 = Symbol::find("method2");
+	TS_ASSERT(method2.isValid());
+	TS_ASSERT_EQUALS(method2.str(), "method2");
+	TS_ASSERT(Symbol::intern("method2") == method2);
+	TS_ASSERT(Symbol::find(std::string("method2")) == method2);
+	TS_ASSERT_EQUALS(std::hash<Symbol>()(method2), method2.hash());
+	TS_ASSERT(Symbol::find("method1") != method2);
+
+	TS_ASSERT(!Symbol::find("ClassTest::noSuchName").isValid());
+	TS_ASSERT(!Symbol().isValid());
+	TS_ASSERT_EQUALS(Symbol().str(), "");
+	TS_ASSERT(Symbol::intern("ClassTest::noSuchName").isValid());
+	TS_ASSERT(Symbol::find("ClassTest::noSuchName") == Symbol::intern("ClassTest::noSuchName"));
+
+	TS_ASSERT(Class::lookup(test.symbol()) == test);
+	TS_ASSERT(Class::lookup(Symbol::find("ClassTest::Test1")) == test);
+	TS_ASSERT(!Class::lookup(Symbol()).isValid());
+	TS_ASSERT(!Class::lookup(Symbol::intern("ClassTest::noSuchName")).isValid());
+
+	Class::MethodRange methods = test.methodsNamed(method2);
+	TS_ASSERT_EQUALS(methods.size(), 2);
+	for (const Method& m: methods) {
+		TS_ASSERT(m.symbol() == method2);
+	}
+	TS_ASSERT_EQUALS(test.methodsNamed(Symbol::find("operator="), 1).size(), 2);
+	TS_ASSERT(test.methodsNamed(Symbol()).empty());
+	TS_ASSERT(test.methodsNamed(Symbol::intern("ClassTest::noSuchName")).empty());
+
+	Symbol attribute1 = Symbol::find("attribute1");
+	TS_ASSERT(test.attribute(attribute1) == test.attribute("attribute1"));
+	TS_ASSERT(test.attribute(attribute1).symbol() == attribute1);
+	TS_ASSERT(!test.attribute(Symbol()).isValid());
+	TS_ASSERT_THROWS_ANYTHING(Class().attribute(attribute1));
+}
+
+
+void ClassTestSuite::testConcurrentLookup()
+{
+	// a writer registers functions and re-registers classes the way a library
+	// loaded at runtime does, while readers look them up
+	static const int numFunctions = 5000;
+
+	Class test = Class::lookup("ClassTest::Test1");
+	Function answer = Function::findFunctions("ClassTest::answer").front();
+
+	std::atomic<int> published(0);
+	std::atomic<bool> done(false);
+	std::atomic<int> failures(0);
+
+	std::vector<std::thread> readers;
+	for (int t = 0; t < 4; ++t) {
+		readers.emplace_back([&]() {
+			std::size_t overloads = 0;
+			for (int i = 0; !done.load(); ++i) {
+				if (Class::lookup("ClassTest::Test1") != test) ++failures;
+				if (Class::lookup(typeid(ClassTest::Test1)) != test) ++failures;
+				if (Class::lookup("ClassTest::Test1").methodsNamed("method2").size() != 2) ++failures;
+				if (Function::findFunctions("ClassTest::answer").front().call().value<int>() != 42) ++failures;
+
+				const int n = published.load();
+				if (n > 0 && Function::findFunctions(strconv::fmt_str("ClassTest::concurrent%1", i % n)).size() != 1) ++failures;
+
+				// a list that is being appended to never shrinks
+				const std::size_t size = Function::findFunctions("ClassTest::overloaded").size();
+				if (size < overloads) ++failures;
+				overloads = size;
+			}
+		});
+	}
+
+	for (int i = 0; i < numFunctions; ++i) {
+		FunctionRegistry::instance().registerFunction(strconv::fmt_str("ClassTest::concurrent%1", i), answer);
+		published.store(i + 1);
+		if (i % 10 == 0) {
+			FunctionRegistry::instance().registerFunction("ClassTest::overloaded", answer);
+			ClassRegistry::instance().registerClass(test);
+		}
+	}
+	done.store(true);
+	for (std::thread& t: readers) {
+		t.join();
+	}
+
+	TS_ASSERT_EQUALS(failures.load(), 0);
+	TS_ASSERT_EQUALS(Function::findFunctions("ClassTest::overloaded").size(), numFunctions / 10);
+	for (int i = 0; i < numFunctions; ++i) {
+		TS_ASSERT_EQUALS(Function::findFunctions(strconv::fmt_str("ClassTest::concurrent%1", i)).size(), 1);
+	}
+	TS_ASSERT(Class::lookup("ClassTest::Test1") == test);
+}
+
 void ClassTestSuite::testConstructorSearch()
 {
 	Class test = Class::lookup("ClassTest::Test1");
@@ -481,3 +706,194 @@ void ClassTestSuite::testPrivateDestructor()
 
 	TS_ASSERT_THROWS_ANYTHING(c.call());
 }
+
+void ClassTestSuite::testBaseConversion()
+{
+	VariantValue v;
+	v.construct<Test1>();
+
+	Test1& t = v.value<Test1&>();
+
+	// TestBase2 is not the first base, so it lives at a non-zero offset
+	TS_ASSERT(v.isA<TestBase2>())
+	TS_ASSERT_EQUALS(&v.value<TestBase2&>(), static_cast<TestBase2*>(&t));
+	TS_ASSERT_EQUALS(v.value<TestBase2&>().base2Method1(), 6);
+	TS_ASSERT(v.isA<TestBase1>())
+	TS_ASSERT_EQUALS(&v.value<TestBase1&>(), static_cast<TestBase1*>(&t));
+	TS_ASSERT(!v.isA<VirtualDerived>())
+
+	// virtual bases are resolved at runtime
+	VariantValue vd;
+	vd.construct<VirtualDerived>();
+	TS_ASSERT(vd.isA<TestBase2>())
+	TS_ASSERT_EQUALS(&vd.value<TestBase2&>(), static_cast<TestBase2*>(&vd.value<VirtualDerived&>()));
+}
+
+void ClassTestSuite::testFailedBaseConversion()
+{
+	VariantValue v;
+	v.construct<Test3>();
+	TS_ASSERT(!v.isA<VirtualDerived>())
+	TS_ASSERT(!v.isA<Test2>())
+
+	// a const value doesn't convert to a non-const base, which mustn't be remembered for other values
+	const Test3 t;
+	VariantValue cref;
+	cref.construct<const Test3&>(t);
+	TS_ASSERT(!cref.isA<TestBase1&>())
+	TS_ASSERT(cref.isA<const TestBase1&>())
+	TS_ASSERT(v.isA<TestBase1&>())
+
+#ifndef NO_RTTI
+	int offset = -1;
+	TS_ASSERT(registeredConversion(typeid(Test3), typeid(VirtualDerived), offset) == RegisteredConversion::IMPOSSIBLE);
+	TS_ASSERT(registeredConversion(typeid(TestBase2), typeid(Test1), offset) == RegisteredConversion::IMPOSSIBLE);
+	TS_ASSERT(registeredConversion(typeid(Test3), typeid(TestBase1), offset) == RegisteredConversion::OFFSET);
+	// virtual bases and unregistered classes are left to the exception based cast
+	TS_ASSERT(registeredConversion(typeid(VirtualDerived), typeid(TestBase2), offset) == RegisteredConversion::UNKNOWN);
+	TS_ASSERT(registeredConversion(typeid(Test3), typeid(std::string), offset) == RegisteredConversion::UNKNOWN);
+#endif
+}
+
+void ClassTestSuite::testIndirectSuperClasses()
+{
+	Class test3 = ClassOf<Test3>();
+	Class test1 = ClassOf<Test1>();
+	Class base1 = ClassOf<TestBase1>();
+	Class base2 = ClassOf<TestBase2>();
+
+	TS_ASSERT(test3.isSubClassOf(test1));
+	TS_ASSERT(test3.isSubClassOf(base1));
+	TS_ASSERT(test3.isSubClassOf(base2));
+	TS_ASSERT(!test3.isSubClassOf(test3));
+	TS_ASSERT(!test1.isSubClassOf(test3));
+	TS_ASSERT(!base2.isSubClassOf(test3));
+	TS_ASSERT(!test3.isSubClassOf(ClassOf<VirtualDerived>()));
+	TS_ASSERT(!test3.isSubClassOf(Class()));
+
+	TS_ASSERT(inherits(test3, base2));
+	TS_ASSERT(inheritedBy(base2, test3));
+	TS_ASSERT(!inheritanceRelation(test3, ClassOf<Test2>()));
+
+	// the offsets of indirect bases are summed up along the path
+	VariantValue v;
+	v.construct<Test3>();
+	Test3& t = v.value<Test3&>();
+	TS_ASSERT_EQUALS(&v.value<TestBase2&>(), static_cast<TestBase2*>(&t));
+	TS_ASSERT_EQUALS(&v.value<Test1&>(), static_cast<Test1*>(&t));
+
+#ifndef NO_RTTI
+	int offset = -1;
+	TS_ASSERT(ClassImpl::baseOffset(typeid(Test3), typeid(TestBase2), offset));
+	TS_ASSERT_EQUALS(offset, reinterpret_cast<char*>(static_cast<TestBase2*>(&t)) - reinterpret_cast<char*>(&t));
+	TS_ASSERT(!ClassImpl::baseOffset(typeid(VirtualDerived), typeid(TestBase2), offset));
+#endif
+}
+
+void ClassTestSuite::testLazyClassBuild()
+{
+	// the meta-class is built by whichever thread looks it up first
+	std::atomic<bool> go(false);
+	std::atomic<int> failures(0);
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; ++t) {
+		threads.emplace_back([&, t]() {
+			while (!go.load()) {}
+			Class c = t % 2 ? Class::lookup("ClassTest::Lazy") : Class::lookup(typeid(ClassTest::Lazy));
+			if (!c.isValid() || c.methods().size() != 3 || c.constructors().size() != 1) ++failures;
+			if (!c.isSubClassOf(ClassOf<TestBase2>())) ++failures;
+			if (c.methodsNamed("method2").size() != 1) ++failures;
+		});
+	}
+	go.store(true);
+	for (std::thread& t: threads) {
+		t.join();
+	}
+	TS_ASSERT_EQUALS(failures.load(), 0);
+	TS_ASSERT_EQUALS(Class::lookup("ClassTest::Lazy"), ClassOf<Lazy>());
+}
+
+void ClassTestSuite::testLateBase()
+{
+	Class derived = Class::lookup("ClassTest::LateDerived");
+	TS_ASSERT(derived.hasUnresolvedBases());
+	TS_ASSERT(derived.methodsNamed("lateMethod").empty());
+	Class::MethodRange before = derived.methodsNamed("derivedMethod");
+	TS_ASSERT_EQUALS(before.size(), 1);
+
+#ifndef NO_RTTI
+	ClassRegistry::instance().registerClass("ClassTest::LateBase", typeid(ClassTest::LateBase), &ClassOf<ClassTest::LateBase>);
+#else
+	ClassRegistry::instance().registerClass("ClassTest::LateBase", &ClassOf<ClassTest::LateBase>);
+#endif
+
+	// a new handle resolves the base and replaces the name index
+	Class again = Class::lookup("ClassTest::LateDerived");
+	TS_ASSERT(!again.hasUnresolvedBases());
+	TS_ASSERT(again.isSubClassOf(Class::lookup("ClassTest::LateBase")));
+	TS_ASSERT_EQUALS(again.methodsNamed("lateMethod").size(), 1);
+	TS_ASSERT_EQUALS(again.methodsNamed("derivedMethod").size(), 1);
+
+	// ranges into the old index stay valid
+	TS_ASSERT_EQUALS(before.size(), 1);
+	TS_ASSERT_EQUALS(before.begin()->name(), "derivedMethod");
+	const VariantValue object = LateDerived();
+	TS_ASSERT_EQUALS(before.begin()->call(object).value<int>(), 4);
+}
+
+void ClassTestSuite::testConcurrentLateBase()
+{
+	// readers keep a handle that was taken while the base was missing
+	Class derived = Class::lookup("ClassTest::LateDerived2");
+	TS_ASSERT(derived.hasUnresolvedBases());
+
+	std::atomic<bool> registered(false);
+	std::atomic<bool> done(false);
+	std::atomic<int> failures(0);
+
+	std::vector<std::thread> readers;
+	for (int t = 0; t < 4; ++t) {
+		readers.emplace_back([&]() {
+			bool seen = false;
+			while (!done.load()) {
+				// once a reader saw the base it never loses it
+				const bool before = registered.load();
+				Class c = Class::lookup("ClassTest::LateDerived2");
+				// a list, once returned, is never changed
+				const Class::MethodList& methodList = derived.methods();
+				const std::size_t methods = std::distance(methodList.begin(), methodList.end());
+				const std::size_t attributes = c.attributes().size();
+				const bool complete = !c.methodsNamed("lateMethod").empty();
+				if (derived.methodsNamed("derivedMethod").size() != 1) ++failures;
+				if (methods < 1 || attributes < 1) ++failures;
+				if (before && (!complete || attributes != 2 || c.superclasses().size() != 1)) ++failures;
+				if (seen && !complete) ++failures;
+				seen = complete;
+				for (const Class& s: c.superclasses()) {
+					if (s.fullyQualifiedName() != "ClassTest::LateBase2") ++failures;
+				}
+			}
+		});
+	}
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(5));
+#ifndef NO_RTTI
+	ClassRegistry::instance().registerClass("ClassTest::LateBase2", typeid(ClassTest::LateBase2), &ClassOf<ClassTest::LateBase2>);
+#else
+	ClassRegistry::instance().registerClass("ClassTest::LateBase2", &ClassOf<ClassTest::LateBase2>);
+#endif
+	// resolves the base, unless a reader got there first
+	Class resolved = Class::lookup("ClassTest::LateDerived2");
+	registered.store(true);
+	std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	done.store(true);
+
+	for (std::thread& t: readers) {
+		t.join();
+	}
+	TS_ASSERT_EQUALS(failures.load(), 0);
+	TS_ASSERT(!resolved.hasUnresolvedBases());
+	TS_ASSERT(resolved.isSubClassOf(Class::lookup("ClassTest::LateBase2")));
+	TS_ASSERT_EQUALS(resolved.methodsNamed("lateMethod").size(), 1);
+	TS_ASSERT_EQUALS(resolved.attributes().size(), 2);
+}
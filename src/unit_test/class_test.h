@@ -18,9 +18,17 @@ public:
 	void testClassHash();
 	void testMethodSearch();
 	void testAttributeSearch();
+	void testSymbols();
+	void testConcurrentLookup();
 	void testConstructorSearch();
 	void testSuperClassSearch();
 	void testPrivateDestructor();
+	void testBaseConversion();
+	void testFailedBaseConversion();
+	void testIndirectSuperClasses();
+	void testLazyClassBuild();
+	void testLateBase();
+	void testConcurrentLateBase();
 };
 
 
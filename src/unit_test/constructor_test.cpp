@@ -58,6 +58,25 @@ namespace ConstructorTest {
         int attr1;
     };
 
+	// counts the live instances to check the reflected destructor
+	class Test4 {
+	public:
+		Test4(int arg1) : attr1(arg1) { ++instances; }
+		~Test4() { --instances; }
+
+		int attr1;
+		static int instances;
+	};
+
+	int Test4::instances = 0;
+
+	class Test5 {
+	public:
+		Test5() {}
+	private:
+		~Test5() {}
+	};
+
 }
 
 
@@ -81,6 +100,14 @@ REFL_CONSTRUCTOR(int)
 REFL_ATTRIBUTE(attr1, int)
 REFL_END_CLASS
 
+REFL_BEGIN_CLASS(ConstructorTest::Test4)
+REFL_CONSTRUCTOR(int)
+REFL_END_CLASS
+
+REFL_BEGIN_CLASS(ConstructorTest::Test5)
+REFL_DEFAULT_CONSTRUCTOR()
+REFL_END_CLASS
+
 
 using namespace ConstructorTest;
 
@@ -186,3 +213,37 @@ void ConstructorTestSuite::testClassRef()
 
 	TS_ASSERT_DIFFERS(c1.getClass(), test2);
 }
+
+void ConstructorTestSuite::testConstructAt()
+{
+	Class test = Class::lookup("ConstructorTest::Test");
+	TS_ASSERT_EQUALS(test.sizeOf(), sizeof(Test));
+	TS_ASSERT_EQUALS(test.alignOf(), alignof(Test));
+
+	// several objects in one contiguous buffer
+	::std::aligned_storage<sizeof(Test), alignof(Test)>::type storage[3];
+	Constructor c2 = test.findConstructor([](const Constructor& c) { return c.numberOfArguments() == 2; });
+	for (int i = 0; i < 3; ++i) {
+		c2.constructAt(&storage[i], i, 2 * i);
+	}
+	const Test* objects = reinterpret_cast<const Test*>(storage);
+	TS_ASSERT_EQUALS(objects[2].attr1, 2);
+	TS_ASSERT_EQUALS(objects[2].attr2, 4);
+	for (int i = 0; i < 3; ++i) {
+		test.destroyAt(&storage[i]);
+	}
+
+	// wrong arguments leave the storage untouched
+	TS_ASSERT_THROWS(c2.constructAt(&storage[0], 1), ::std::runtime_error);
+
+	Class test4 = Class::lookup("ConstructorTest::Test4");
+	::std::aligned_storage<sizeof(Test4), alignof(Test4)>::type storage4;
+	test4.constructors().front().constructAt(&storage4, 7);
+	TS_ASSERT_EQUALS(Test4::instances, 1);
+	TS_ASSERT_EQUALS(reinterpret_cast<Test4*>(&storage4)->attr1, 7);
+	test4.destroyAt(&storage4);
+	TS_ASSERT_EQUALS(Test4::instances, 0);
+
+	Class test5 = Class::lookup("ConstructorTest::Test5");
+	TS_ASSERT_THROWS(test5.destroyAt(&storage4), ::std::runtime_error);
+}
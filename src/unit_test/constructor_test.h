@@ -17,6 +17,7 @@ public:
 	void testLuaAPI();
 	void testConstructorHash();
 	void testClassRef();
+	void testConstructAt();
 };
 
 
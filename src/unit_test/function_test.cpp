@@ -12,8 +12,11 @@
 
 #include <lua.hpp>
 
+#include <cstring>
 #include <iostream>
+#include <map>
 #include <string>
+#include <vector>
 using namespace std;
 
 
@@ -32,6 +35,81 @@ namespace FunctionTest {
 REFL_FUNCTION(FunctionTest::globalFunction, double, double, double)
 REFL_FUNCTION(FunctionTest::globalFunction, int, int, int)
 
+// the overloads resolved by testOverloadResolution
+namespace ResolveTest {
+
+	struct Shape {
+		virtual ~Shape() {}
+	};
+
+	struct Circle: public Shape {};
+
+	struct Ring: public Circle {};
+
+	struct Square: public Shape {};
+
+	int describe(const Shape&) { return 1; }
+	int describe(const Circle&) { return 2; }
+	int describe(const Square&) { return 3; }
+	int describe(int) { return 4; }
+
+	int point(Shape*) { return 1; }
+	int point(Circle*) { return 2; }
+
+	int inspect(const Shape*) { return 1; }
+
+	// registered by testOverloadResolution after a call was resolved, like the classes of a library loaded at runtime
+	struct LateShape {
+		virtual ~LateShape() {}
+	};
+
+	struct LateSquare: public LateShape {};
+
+	int measure(const LateShape&) { return 1; }
+}
+
+REFL_BEGIN_CLASS(ResolveTest::Shape)
+	REFL_DEFAULT_CONSTRUCTOR()
+REFL_END_CLASS
+
+REFL_BEGIN_CLASS(ResolveTest::Circle)
+	REFL_SUPER_CLASS(ResolveTest::Shape)
+	REFL_DEFAULT_CONSTRUCTOR()
+REFL_END_CLASS
+
+REFL_BEGIN_CLASS(ResolveTest::Ring)
+	REFL_SUPER_CLASS(ResolveTest::Circle)
+	REFL_DEFAULT_CONSTRUCTOR()
+REFL_END_CLASS
+
+REFL_BEGIN_CLASS(ResolveTest::Square)
+	REFL_SUPER_CLASS(ResolveTest::Shape)
+	REFL_DEFAULT_CONSTRUCTOR()
+REFL_END_CLASS
+
+REFL_FUNCTION(ResolveTest::describe, int, const ResolveTest::Shape &)
+REFL_FUNCTION(ResolveTest::describe, int, const ResolveTest::Circle &)
+REFL_FUNCTION(ResolveTest::describe, int, int)
+REFL_FUNCTION(ResolveTest::point, int, ResolveTest::Shape *)
+REFL_FUNCTION(ResolveTest::point, int, ResolveTest::Circle *)
+REFL_FUNCTION(ResolveTest::inspect, int, const ResolveTest::Shape *)
+
+REFL_BEGIN_CLASS(ResolveTest::LateSquare)
+	REFL_SUPER_CLASS(ResolveTest::LateShape)
+	REFL_DEFAULT_CONSTRUCTOR()
+REFL_END_CLASS
+
+template<> ClassImpl* ClassImpl::inst<ResolveTest::LateShape>() {
+	typedef ResolveTest::LateShape ThisClass;
+	static ClassImpl instance;
+	static const bool closed = [] {
+		instance.setTypeInfo(typeid(ThisClass));
+		instance.setFullyQualifiedName("ResolveTest::LateShape");
+		instance.setLayout(sizeof(ThisClass), alignof(ThisClass), class_destructor<ThisClass>::value());
+REFL_END_CLASS
+
+REFL_FUNCTION(ResolveTest::measure, int, const ResolveTest::LateShape &)
+
 
 void FunctionTestSuite::testFunction()
 {
@@ -164,6 +242,52 @@ namespace FunctionTest {
 	int paramByConstReference(const CopyCount& c) {
 		return c.id();
 	}
+
+	struct Point {
+		Point() : x(0), y(0), label("origin") {}
+		int x;
+		double y;
+		std::string label;
+	};
+
+	Point translate(const Point& p, int dx) {
+		Point ret = p;
+		ret.x += dx;
+		return ret;
+	}
+
+	int sumAll(const std::vector<int>& values) {
+		int sum = 0;
+		for (int v: values) {
+			sum += v;
+		}
+		return sum;
+	}
+
+	typedef std::map<std::string, int> LengthMap;
+
+	LengthMap lengths(const std::vector<std::string>& words) {
+		LengthMap ret;
+		for (const std::string& w: words) {
+			ret[w] = w.size();
+		}
+		return ret;
+	}
+
+	std::vector<int>& history() {
+		static std::vector<int> values;
+		return values;
+	}
+
+	void record(int value) {
+		history().push_back(value);
+	}
+
+	// each parameter type has its own argument marshaler in the Lua module
+	int stringLength(std::string text) { return text.size(); }
+	int cStringLength(const char* text) { return std::strlen(text); }
+	int truncated(int value) { return value; }
+	long long negated(long long value) { return -value; }
 }
 
 
@@ -186,6 +310,23 @@ REFL_FUNCTION(FunctionTest::paramByValue, int, FunctionTest::CopyCount)
 REFL_FUNCTION(FunctionTest::paramByReference, int, FunctionTest::CopyCount&)
 REFL_FUNCTION(FunctionTest::paramByConstReference, int, const FunctionTest::CopyCount&)
 
+REFL_BEGIN_CLASS(FunctionTest::Point)
+	REFL_DEFAULT_CONSTRUCTOR()
+	REFL_ATTRIBUTE(x, int)
+	REFL_ATTRIBUTE(y, double)
+	REFL_ATTRIBUTE(label, std::string)
+REFL_END_CLASS
+
+REFL_FUNCTION(FunctionTest::translate, FunctionTest::Point, const FunctionTest::Point&, int)
+REFL_FUNCTION(FunctionTest::sumAll, int, const std::vector<int>&)
+REFL_FUNCTION(FunctionTest::lengths, FunctionTest::LengthMap, const std::vector<std::string>&)
+REFL_FUNCTION(FunctionTest::history, std::vector<int>&)
+REFL_FUNCTION(FunctionTest::record, void, int)
+REFL_FUNCTION(FunctionTest::stringLength, int, std::string)
+REFL_FUNCTION(FunctionTest::cStringLength, int, const char*)
+REFL_FUNCTION(FunctionTest::truncated, int, int)
+REFL_FUNCTION(FunctionTest::negated, long long, long long)
+
 using namespace FunctionTest;
 
 void FunctionTestSuite::testReturnByValue()
@@ -270,9 +411,14 @@ void FunctionTestSuite::testParametersByValue()
 	int reflectionCopies = CopyCount::numberOfCopies();
 	int reflectionMoves = CopyCount::numberOfMoves();
 
+	// checking the argument doesn't move it, only passing it does
 	TS_ASSERT_EQUALS(reflectionCopies, 1);
-	TS_ASSERT_EQUALS(reflectionMoves,  2);
+	TS_ASSERT_EQUALS(reflectionMoves,  1);
 	TS_ASSERT(!c.hasBeenMoved());
+
+	Function length = Function::findFunctions("FunctionTest::stringLength").front();
+	TS_ASSERT_EQUALS(length.call(std::string("hello")).value<int>(), 5);
+	TS_ASSERT_EQUALS(length.call("hello").value<int>(), 5);
 }
 
 
@@ -324,6 +470,35 @@ void FunctionTestSuite::testParametersByConstReference()
 }
 
 
+void FunctionTestSuite::testArgumentView()
+{
+	auto f = make_function<int (*)(const CopyCount&)>(&function_type<int (*)(const CopyCount&)>::bindcall<&paramByConstReference>, "paramByConstReference", "int", "const CopyCount&");
+
+	CopyCount c(21);
+
+	VariantValue params[2];
+	params[0].construct<CopyCount&>(c);
+
+	CopyCount::resetAll();
+
+	// extra arguments are ignored, missing ones are an error
+	VariantValue r = f.callArgArray(ArgumentView(params, 2));
+	TS_ASSERT_EQUALS(r.value<int>(), 21);
+	TS_ASSERT_EQUALS(CopyCount::numberOfCopies(), 0);
+
+	TS_ASSERT_THROWS(f.callArgArray(ArgumentView(params, 0)), std::runtime_error);
+	TS_ASSERT_THROWS(f.callArgArray(ArgumentView()), std::runtime_error);
+
+	std::vector<VariantValue> vargs(params, params + 1);
+	r = f.callArgArray(vargs);
+	TS_ASSERT_EQUALS(r.value<int>(), 21);
+
+	const auto aargs = make_arguments(c);
+	TS_ASSERT_EQUALS(ArgumentView(aargs).size(), 1);
+	r = f.callArgArray(aargs);
+	TS_ASSERT_EQUALS(r.value<int>(), 21);
+}
+
 
 void FunctionTestSuite::testLuaAPI()
 {
@@ -402,6 +577,95 @@ void FunctionTestSuite::testLuaParameterByConstReference()
 	LuaUtils::callFunc<bool>(L, "testParameterByConstReference");
 }
 
+void FunctionTestSuite::testLuaTableConversion()
+{
+	LuaUtils::LuaStateHolder L;
+    LuaUtils::addTestFunctionsAndPaths(&*L);
+
+    if (luaL_loadfile(L, strconv::fmt_str("%1/function_test.lua", srcpath()).c_str()) || lua_pcall(L,0,0,0)) {
+		luaL_error(L, "cannot run config file: %s\n", lua_tostring(L, -1));
+	}
+	LuaUtils::callFunc<bool>(L, "testTableConversion");
+}
+
+void FunctionTestSuite::testLuaArgumentMarshaling()
+{
+	LuaUtils::LuaStateHolder L;
+    LuaUtils::addTestFunctionsAndPaths(&*L);
+
+    if (luaL_loadfile(L, strconv::fmt_str("%1/function_test.lua", srcpath()).c_str()) || lua_pcall(L,0,0,0)) {
+		luaL_error(L, "cannot run config file: %s\n", lua_tostring(L, -1));
+	}
+	LuaUtils::callFunc<bool>(L, "testArgumentMarshaling");
+}
+
+
+void FunctionTestSuite::testOverloadResolution()
+{
+	using namespace FunctionTest;
+
+	Function f = Function::resolve("FunctionTest::globalFunction", make_arguments(1, 2));
+	TS_ASSERT(f.isValid());
+	TS_ASSERT_EQUALS(f.returnSpelling(), "int");
+	TS_ASSERT_EQUALS(Function::resolve("FunctionTest::globalFunction", make_arguments(1, 2)), f);
+
+	f = Function::resolve("FunctionTest::globalFunction", make_arguments(1.5, 2.5));
+	TS_ASSERT_EQUALS(f.returnSpelling(), "double");
+	TS_ASSERT_DELTA(f.call(1.5, 2.5).value<double>(), 4.0, 0.0001);
+
+	// every overload needs a conversion for one of the arguments
+	TS_ASSERT_THROWS(Function::resolve("FunctionTest::globalFunction", make_arguments(1, 2.5)), std::runtime_error);
+	TS_ASSERT_THROWS(Function::resolve("FunctionTest::globalFunction", make_arguments(1.5f, 2.5f)), std::runtime_error);
+
+	TS_ASSERT(!Function::resolve("FunctionTest::globalFunction", make_arguments(1)).isValid());
+	TS_ASSERT(!Function::resolve("FunctionTest::globalFunction", make_arguments(std::string("1"), 2)).isValid());
+	TS_ASSERT(!Function::resolve("FunctionTest::noSuchFunction", make_arguments(1, 2)).isValid());
+
+	using namespace ResolveTest;
+
+	// an exact type is better than a base class, a nearer base better than a farther one
+	Circle circle;
+	Ring ring;
+	Square square;
+	TS_ASSERT_EQUALS(Function::resolve("ResolveTest::describe", make_arguments(circle)).call(circle).value<int>(), 2);
+	TS_ASSERT_EQUALS(Function::resolve("ResolveTest::describe", make_arguments(ring)).call(ring).value<int>(), 2);
+	TS_ASSERT_EQUALS(Function::resolve("ResolveTest::describe", make_arguments(square)).call(square).value<int>(), 1);
+	TS_ASSERT_EQUALS(Function::resolve("ResolveTest::describe", make_arguments(Shape())).call(Shape()).value<int>(), 1);
+	TS_ASSERT_EQUALS(Function::resolve(Symbol::find("ResolveTest::describe"), make_arguments('a')).call('a').value<int>(), 4);
+
+	// pointers convert to pointers to their bases, and may gain a const
+	Shape* shapePtr = &square;
+	const Circle* constCircle = &circle;
+	TS_ASSERT_EQUALS(Function::resolve("ResolveTest::point", make_arguments(&ring)).call(&ring).value<int>(), 2);
+	TS_ASSERT_EQUALS(Function::resolve("ResolveTest::point", make_arguments(&circle)).call(&circle).value<int>(), 2);
+	TS_ASSERT_EQUALS(Function::resolve("ResolveTest::point", make_arguments(&square)).call(&square).value<int>(), 1);
+	TS_ASSERT_EQUALS(Function::resolve("ResolveTest::point", make_arguments(shapePtr)).call(shapePtr).value<int>(), 1);
+	TS_ASSERT(!Function::resolve("ResolveTest::point", make_arguments(constCircle)).isValid());
+	TS_ASSERT_EQUALS(Function::resolve("ResolveTest::inspect", make_arguments(&ring)).call(&ring).value<int>(), 1);
+	TS_ASSERT_EQUALS(Function::resolve("ResolveTest::inspect", make_arguments(constCircle)).call(constCircle).value<int>(), 1);
+	TS_ASSERT(!Function::resolve("ResolveTest::inspect", make_arguments(&ring, &ring)).isValid());
+
+	const VariantValue ringPtr = &ring;
+	TS_ASSERT_EQUALS(ringPtr.convertTo<Shape*>(), static_cast<Shape*>(&ring));
+	TS_ASSERT_EQUALS(ringPtr.convertTo<const Circle*>(), static_cast<const Circle*>(&ring));
+	TS_ASSERT_EQUALS(VariantValue(static_cast<Ring*>(nullptr)).convertTo<Shape*>(), nullptr);
+
+	TS_ASSERT_EQUALS(Function::resolve("ResolveTest::describe", make_arguments(square)).call(square).value<int>(), 1);
+	{
+		// an overload registered later, like the ones of a library loaded at runtime, replaces the cached decision
+		REFL_FUNCTION(ResolveTest::describe, int, const ResolveTest::Square &)
+	}
+	TS_ASSERT_EQUALS(Function::resolve("ResolveTest::describe", make_arguments(square)).call(square).value<int>(), 3);
+	TS_ASSERT_EQUALS(Function::resolve("ResolveTest::describe", make_arguments(circle)).call(circle).value<int>(), 2);
+
+	// so does a class registered later, and with it the base of a class that was missing it
+	LateSquare lateSquare;
+	TS_ASSERT(!Function::resolve("ResolveTest::measure", make_arguments(lateSquare)).isValid());
+	ClassRegistry::instance().registerClass("ResolveTest::LateShape", typeid(LateShape), &ClassOf<LateShape>);
+	ClassRegistry::instance().registerPointerTypes(typeid(LateShape*), typeid(const LateShape*), &ClassOf<LateShape>);
+	TS_ASSERT_EQUALS(Function::resolve("ResolveTest::measure", make_arguments(lateSquare)).call(lateSquare).value<int>(), 1);
+}
+
 
 void FunctionTestSuite::testFunctionHash()
 {
@@ -20,6 +20,7 @@ public:
 	void testParametersByValue();
 	void testParametersByReference();
 	void testParametersByConstReference();
+	void testArgumentView();
 	void testLuaAPI();
 	void testLuaReturnByValue();
 	void testLuaReturnByReference();
@@ -27,6 +28,9 @@ public:
 	void testLuaParameterByValue();
 	void testLuaParameterByReference();
 	void testLuaParameterByConstReference();
+	void testLuaTableConversion();
+	void testLuaArgumentMarshaling();
+	void testOverloadResolution();
 	void testFunctionHash();
 };
 
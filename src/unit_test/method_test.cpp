@@ -44,6 +44,13 @@ namespace MethodTest {
 		int method2() { return 667; }
 	};
 
+	class Text {
+	public:
+		int length(std::string text) const { return text.size(); }
+		void append(std::vector<int>& lengths) const { lengths.push_back(lengths.size()); }
+		void appendLength(std::vector<int>& lengths, std::string text) const { lengths.push_back(text.size()); }
+	};
+
     class Logger {
     public:
         Logger(int) {}
@@ -77,6 +84,13 @@ REFL_BEGIN_CLASS(MethodTest::Test2)
 REFL_END_CLASS
 
 
+REFL_BEGIN_CLASS(MethodTest::Text)
+	REFL_DEFAULT_CONSTRUCTOR()
+	REFL_CONST_METHOD(length, int, std::string)
+	REFL_CONST_METHOD(append, void, std::vector<int>&)
+	REFL_CONST_METHOD(appendLength, void, std::vector<int>&, std::string)
+REFL_END_CLASS
+
 REFL_BEGIN_CLASS(MethodTest::Base)
 	REFL_DEFAULT_CONSTRUCTOR()
 	REFL_METHOD(method1, int)
@@ -267,6 +281,35 @@ void MethodTestSuite::testMethodHash()
 	TS_ASSERT_EQUALS(mmap[m3], 3);
 }
 
+void MethodTestSuite::testSignatureHash()
+{
+	Class test = Class::lookup("MethodTest::Test1");
+	Method method1 = test.methodsNamed("method1").front();
+	Method method2 = test.methodsNamed("method2").front();
+	Method method3 = test.methodsNamed("method3").front();
+	Method method4 = test.methodsNamed("method4", 1).front();
+	Method method4b = test.methodsNamed("method4", 2).front();
+
+	// computed once and handed out by reference
+	TS_ASSERT_EQUALS(&method4b.argumentSpellings(), &method4b.argumentSpellings());
+	TS_ASSERT_EQUALS(method4b.argumentSpellings().size(), 2);
+	TS_ASSERT_EQUALS(method4b.argumentSpellings()[1], "int");
+	WITH_RTTI(TS_ASSERT_EQUALS(&method4b.argumentTypes(), &method4b.argumentTypes()));
+
+	TS_ASSERT_EQUALS(method1.signatureHash(), method1.signatureHash());
+	TS_ASSERT_DIFFERS(method1.signatureHash(), method2.signatureHash());
+	TS_ASSERT_DIFFERS(method1.signatureHash(), method3.signatureHash());
+	TS_ASSERT_DIFFERS(method2.signatureHash(), method4.signatureHash());
+	TS_ASSERT_DIFFERS(method4.signatureHash(), method4b.signatureHash());
+
+	// an override accepts the same arguments
+	Method base = Class::lookup("MethodTest::Base").methodsNamed("method1").front();
+	Method derived = Class::lookup("MethodTest::Derived").methodsNamed("method1").front();
+	TS_ASSERT_EQUALS(base.signatureHash(), derived.signatureHash());
+	TS_ASSERT(overrides(derived, base));
+	TS_ASSERT(!overrides(method1, base));
+}
+
 void MethodTestSuite::testClassRef()
 {
 
@@ -427,3 +470,132 @@ void MethodTestSuite::testLoggerCase()
     m3.callArgArray(obj, {str1});
     m4.callArgArray(obj, {str1});
 }
+
+
+void MethodTestSuite::testPreparedCall()
+{
+	Class test = Class::lookup("MethodTest::Test1");
+	Method m1 = *test.methodsNamed("method1").begin();
+	Method m2 = *test.methodsNamed("method2").begin();
+	Method m5 = *test.methodsNamed("method5").begin();
+
+	VariantValue v1 = Test1();
+	VariantValue arg = 3;
+
+	PreparedCall call = m1.bind(v1, ArgumentView(&arg, 1));
+	TS_ASSERT(call.isValid());
+	TS_ASSERT_EQUALS(call.numberOfArguments(), 1);
+	TS_ASSERT_EQUALS(call.callArgArray(v1, ArgumentView(&arg, 1)).value<int>(), 6);
+
+	arg = 5;
+	TS_ASSERT_EQUALS(call.callArgArray(v1, ArgumentView(&arg, 1)).value<int>(), 10);
+
+	// the types are fixed when binding
+	VariantValue darg = 5.0;
+	TS_ASSERT_THROWS(call.callArgArray(v1, ArgumentView(&darg, 1)), std::runtime_error);
+	VariantValue other = Test2();
+	TS_ASSERT_THROWS(call.callArgArray(other, ArgumentView(&arg, 1)), std::runtime_error);
+	TS_ASSERT_THROWS(call.callArgArray(v1, ArgumentView()), std::runtime_error);
+	TS_ASSERT_THROWS(call.callArgArray(ArgumentView(&arg, 1)), std::runtime_error);
+
+	// but may need a conversion
+	PreparedCall converting = m1.bind(v1, ArgumentView(&darg, 1));
+	TS_ASSERT_EQUALS(converting.callArgArray(v1, ArgumentView(&darg, 1)).value<int>(), 10);
+
+	const VariantValue v2 = Test1();
+	TS_ASSERT_THROWS(m1.bind(v2, ArgumentView(&arg, 1)), std::runtime_error);
+	TS_ASSERT_THROWS(call.callArgArray(v2, ArgumentView(&arg, 1)), std::runtime_error);
+	TS_ASSERT_THROWS(m1.bind(other, ArgumentView(&arg, 1)), std::runtime_error);
+
+	PreparedCall constCall = m2.bind(v2, ArgumentView(&arg, 1));
+	TS_ASSERT_EQUALS(constCall.callArgArray(v2, ArgumentView(&arg, 1)).value<int>(), 15);
+
+	PreparedCall staticCall = m5.bind(ArgumentView(&arg, 1));
+	TS_ASSERT_EQUALS(staticCall.callArgArray(ArgumentView(&arg, 1)).value<int>(), 30);
+	TS_ASSERT_THROWS(m1.bind(ArgumentView(&arg, 1)), std::runtime_error);
+
+	// methods of the base class are called through the base class subobject
+	Class derived = Class::lookup("MethodTest::Derived");
+	Method bm1 = derived.findMethod([&](const Method& m) { return m.name() == "method1" && m.getClass() != derived; });
+	Method bm2 = derived.findMethod([&](const Method& m) { return m.name() == "method2" && m.getClass() != derived; });
+	VariantValue d = Derived();
+	TS_ASSERT_EQUALS(bm1.bind(d, ArgumentView()).callArgArray(d, ArgumentView()).value<int>(), 556);
+	TS_ASSERT_EQUALS(bm2.bind(d, ArgumentView()).callArgArray(d, ArgumentView()).value<int>(), 666);
+
+	// methods created without prepared call support still can be bound
+	auto method = make_method<int(Test1::*)(int)>(&method_type<int(Test1::*)(int)>::bindcall<&Test1::method1>, "method1", "int", "int");
+	PreparedCall fallback = method.bind(v1, ArgumentView(&arg, 1));
+	TS_ASSERT(fallback.isValid());
+	TS_ASSERT_EQUALS(fallback.callArgArray(v1, ArgumentView(&arg, 1)).value<int>(), 10);
+
+	TS_ASSERT(!PreparedCall().isValid());
+	TS_ASSERT_THROWS(PreparedCall().callArgArray(ArgumentView()), std::runtime_error);
+}
+
+void MethodTestSuite::testCallBatch()
+{
+	Class test = Class::lookup("MethodTest::Test1");
+	Method m1 = *test.methodsNamed("method1").begin();
+	Method m5 = *test.methodsNamed("method5").begin();
+
+	std::vector<VariantValue> objects(10000, Test1());
+	const auto args = make_arguments(3);
+
+	std::vector<VariantValue> results;
+	m1.callBatch(objects, args, results);
+	TS_ASSERT_EQUALS(results.size(), objects.size());
+	TS_ASSERT_EQUALS(results[0].value<int>(), 6);
+	TS_ASSERT_EQUALS(results[9999].value<int>(), 6);
+
+	std::vector<VariantValue> parallel;
+	m1.callBatch(objects, args, parallel, 4);
+	TS_ASSERT_EQUALS(parallel.size(), objects.size());
+	TS_ASSERT_EQUALS(parallel[0].value<int>(), 6);
+	TS_ASSERT_EQUALS(parallel[9999].value<int>(), 6);
+
+	// objects of different types are rechecked, base class methods see the derived objects
+	Class derived = Class::lookup("MethodTest::Derived");
+	Method bm1 = derived.findMethod([&](const Method& m) { return m.name() == "method1" && m.getClass() != derived; });
+	std::vector<VariantValue> mixed = { Base(), Derived(), Derived(), Base() };
+	bm1.callBatch(mixed, ArgumentView(), results);
+	TS_ASSERT_EQUALS(results[0].value<int>(), 555);
+	TS_ASSERT_EQUALS(results[1].value<int>(), 556);
+	TS_ASSERT_EQUALS(results[2].value<int>(), 556);
+	TS_ASSERT_EQUALS(results[3].value<int>(), 555);
+
+	// a string passed by value is copied for each call instead of being moved away by the first one
+	Method length = *Class::lookup("MethodTest::Text").methodsNamed("length").begin();
+	std::vector<VariantValue> texts(10000, Text());
+	const std::vector<VariantValue> word = { std::string("hello") };
+	for (unsigned int threads: { 1, 4 }) {
+		length.callBatch(texts, word, results, threads);
+		TS_ASSERT_EQUALS(results[0].value<int>(), 5);
+		TS_ASSERT_EQUALS(results[1].value<int>(), 5);
+		TS_ASSERT_EQUALS(results[5000].value<int>(), 5);
+		TS_ASSERT_EQUALS(results[9999].value<int>(), 5);
+	}
+	TS_ASSERT_EQUALS(word[0].value<std::string>(), "hello");
+
+	// reference parameters refer to the arguments themselves, as in a loop of callArgArray
+	Class text = Class::lookup("MethodTest::Text");
+	Method append = *text.methodsNamed("append").begin();
+	VariantValue lengths = std::vector<int>{ 0 };
+	const VariantValue shared[] = { lengths.createReference() };
+	std::vector<VariantValue> few(3, Text());
+	append.callBatch(few, ArgumentView(shared, 1), results);
+	TS_ASSERT_EQUALS(lengths.value<std::vector<int>>().size(), 4);
+	TS_ASSERT_EQUALS(lengths.value<std::vector<int>>()[3], 3);
+
+	// also next to parameters passed by value, which still get their own copies
+	Method appendLength = *text.methodsNamed("appendLength").begin();
+	const VariantValue mixedArgs[] = { lengths.createReference(), std::string("hello") };
+	appendLength.callBatch(few, ArgumentView(mixedArgs, 2), results);
+	TS_ASSERT_EQUALS(lengths.value<std::vector<int>>().size(), 7);
+	TS_ASSERT_EQUALS(lengths.value<std::vector<int>>()[6], 5);
+	TS_ASSERT_EQUALS(mixedArgs[1].value<std::string>(), "hello");
+
+	objects[7000] = Test2();
+	TS_ASSERT_THROWS(m1.callBatch(objects, args, results), std::runtime_error);
+	TS_ASSERT_THROWS(m1.callBatch(objects, args, results, 4), std::runtime_error);
+	TS_ASSERT_THROWS(m5.callBatch(objects, args, results), std::runtime_error);
+}
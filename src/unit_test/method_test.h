@@ -20,10 +20,13 @@ public:
 	void testStaticMethod();
 	void testLuaAPI();
 	void testMethodHash();
+	void testSignatureHash();
 	void testClassRef();
 	void testFullName();
 	void testMethodOverriding();
     void testLoggerCase();
+	void testPreparedCall();
+	void testCallBatch();
 };
 
 
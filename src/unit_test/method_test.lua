@@ -37,6 +37,9 @@ function testMethod()
 
     TS_ASSERT[[ method5:call(3) == 18 ]]
 
+    -- static methods called through an object don't get the object
+    TS_ASSERT[[ v1:method5(3) == 18 ]]
+
 
     local m1 = TestClass:findMethod(function(m) return m:name() == "method1" end)
     local m2 = TestClass:findMethod(function(m) return m:name() == "method2" end)
@@ -8,8 +8,10 @@
 
 #include "test_utils.h"
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <vector>
 using namespace std;
 
 namespace {
@@ -30,18 +32,61 @@ namespace {
         return strconv::fmt_str("%1/../parser/selfportraitc", binpath());
 	}
 
+	void compare(const string& expected_output, const string& output);
+
+	void runparser(const string& args, const string& output)
+	{
+        auto parser_cmd = strconv::fmt_str("%1 %2 -o %3", parser(), args, output);
+        if (system(parser_cmd.c_str()) != 0) {
+			std::cerr << "parser command may have failed" << std::endl;
+            std::cerr << "(" << parser_cmd << ")"<< std::endl;
+		}
+	}
+
+	// writes the expected output of a run over several headers, made of the references of the single
+	// headers: all their include directives, then their definitions in order. This matches the
+	// sorted output of the parser only if the functions all come before the classes
+	void merge_references(const vector<string>& referenceNames, const string& output)
+	{
+		vector<string> includes;
+		vector<string> definitions;
+		for (const string& name: referenceNames) {
+			ifstream reference(exp_output_file(name));
+			TS_ASSERT(reference.is_open());
+
+			string line;
+			while (getline(reference, line) && !line.empty()) {
+				if (find(includes.begin(), includes.end(), line) == includes.end()) {
+					includes.push_back(line);
+				}
+			}
+			while (getline(reference, line)) {
+				definitions.push_back(line);
+			}
+		}
+
+		ofstream o_file(output);
+		for (const string& line: includes) {
+			o_file << line << "\n";
+		}
+		o_file << "\n";
+		for (const string& line: definitions) {
+			o_file << line << "\n";
+		}
+	}
+
 	void runtest(const string& inputName, const string& referenceName, const string& outputName)
 	{
 		string source_file = input_file(inputName);
 		string expected_output = exp_output_file(referenceName);
 		string output = output_file(outputName);
 
-        auto parser_cmd = strconv::fmt_str("%1 %2 -o %3", parser(), source_file, output);
-        if (system(parser_cmd.c_str()) != 0) {
-			std::cerr << "parser command may have failed" << std::endl;
-            std::cerr << "(" << parser_cmd << ")"<< std::endl;
-		}
+		runparser(source_file, output);
+		compare(expected_output, output);
+	}
 
+	void compare(const string& expected_output, const string& output)
+	{
 		ifstream exp_o_file(expected_output);
 		TS_ASSERT(exp_o_file.is_open());
 
@@ -110,3 +155,30 @@ void ParserTestSuite::testTemplates()
 	runtest("templates.h", "templates.cpp", "templates.cpp");
 }
 
+
+void ParserTestSuite::testMultipleHeaders()
+{
+	string list = output_file("multiple_headers.txt");
+	{
+		ofstream l(list);
+		l << input_file("functions.h") << "\n" << input_file("simple_class.h") << "\n";
+		// parsed twice, the definitions must appear once
+		l << input_file("simple_class.h") << "\n";
+	}
+
+	// functions.h has only functions and simple_class.h only classes
+	string expected_output = output_file("multiple_headers.cpp");
+	merge_references({ "functions.cpp", "simple_class.cpp" }, expected_output);
+
+	string output = output_file("multiple_headers_out.cpp");
+	runparser(strconv::fmt_str("--header-list %1 --jobs 2", list), output);
+	compare(expected_output, output);
+
+	// one class or function per shard
+	runparser(strconv::fmt_str("--header-list %1 --shards 100", list), output_file("sharded.cpp"));
+	for (int i = 0; i < 12; ++i) {
+		ifstream shard(output_file(strconv::fmt_str("sharded.%1.cpp", i)));
+		TS_ASSERT(shard.is_open());
+	}
+	TS_ASSERT(!ifstream(output_file("sharded.12.cpp")).is_open());
+}
@@ -28,6 +28,7 @@ public:
 	void testInheritance();
 	void testInterface();
 	void testTemplates();
+	void testMultipleHeaders();
 };
 
 
@@ -19,6 +19,14 @@ namespace ProxyTest {
 	};
 
 
+	class Calculator {
+	public:
+		virtual ~Calculator() {}
+
+		virtual int add(int, int) = 0;
+		virtual int sub(int, int) const = 0;
+	};
+
 	class Client {
 	private:
 		Test* m_test = nullptr;
@@ -45,6 +53,17 @@ REFL_BEGIN_CLASS(ProxyTest::Test)
 	REFL_STUB(TestStub)
 REFL_END_CLASS
 
+REFL_BEGIN_STUB(ProxyTest::Calculator, CalculatorStub)
+REFL_STUB_METHOD(ProxyTest::Calculator, add, int, int, int)
+REFL_STUB_CONST_METHOD(ProxyTest::Calculator, sub, int, int, int)
+REFL_END_STUB
+
+REFL_BEGIN_CLASS(ProxyTest::Calculator)
+	REFL_METHOD(add, int, int, int)
+	REFL_CONST_METHOD(sub, int, int, int)
+	REFL_STUB(CalculatorStub)
+REFL_END_CLASS
+
 REFL_BEGIN_CLASS(ProxyTest::Client)
 	REFL_DEFAULT_CONSTRUCTOR()
 	REFL_METHOD(setTest, void, ProxyTest::Test*)
@@ -69,7 +88,7 @@ void ProxyTestSuite::testProxy()
 		TS_ASSERT_EQUALS(ifaces.size(), 1)
 		TS_ASSERT_EQUALS(ifaces.front(), test)
 
-		proxy.addImplementation(m, [](const std::vector<VariantValue>& args) -> VariantValue {
+		proxy.addImplementation(m, [](ArgumentView args) -> VariantValue {
 			TS_ASSERT(args.size() == 2);
 			TS_ASSERT(args[0].isA<int>());
 			TS_ASSERT(args[1].isA<int>());
@@ -111,7 +130,7 @@ void ProxyTestSuite::testClient()
 	TS_ASSERT_EQUALS(ifaces.size(), 1)
 	TS_ASSERT_EQUALS(ifaces.front(), test)
 
-	proxy.addImplementation(m, [](const std::vector<VariantValue>& args) -> VariantValue {
+	proxy.addImplementation(m, [](ArgumentView args) -> VariantValue {
 		TS_ASSERT(args.size() == 2);
 		TS_ASSERT(args[0].isA<int>());
 		TS_ASSERT(args[1].isA<int>());
@@ -159,6 +178,113 @@ void ProxyTestSuite::testClient()
 }
 
 
+void ProxyTestSuite::testPartialImplementation()
+{
+	Class calculator = Class::lookup("ProxyTest::Calculator");
+
+	TS_ASSERT(calculator.isInterface());
+
+	Method add = calculator.methodsNamed("add").front();
+	Method sub = calculator.methodsNamed("sub").front();
+
+	Proxy proxy(calculator);
+	proxy.addImplementation(add, [](ArgumentView args) -> VariantValue {
+		TS_ASSERT_EQUALS(args.size(), 2);
+		return VariantValue(args[0].value<int>() + args[1].value<int>());
+	});
+
+	TS_ASSERT(proxy.hasImplementation(add));
+	TS_ASSERT(!proxy.hasImplementation(sub));
+
+	VariantValue handle = proxy.reference(calculator);
+	auto& stub = handle.convertTo<ProxyTest::Calculator&>();
+
+	TS_ASSERT_EQUALS(stub.add(3, 5), 8);
+	TS_ASSERT_THROWS(stub.sub(3, 5), std::logic_error);
+
+	// handlers can be added after the reference was taken, other proxies of the interface don't see them
+	proxy.addImplementation(sub, [](ArgumentView args) -> VariantValue {
+		return VariantValue(args[0].value<int>() - args[1].value<int>());
+	});
+	TS_ASSERT_EQUALS(stub.sub(3, 5), -2);
+
+	Proxy other(calculator);
+	TS_ASSERT(!other.hasImplementation(add));
+	VariantValue otherHandle = other.reference(calculator);
+	TS_ASSERT_THROWS(otherHandle.convertTo<ProxyTest::Calculator&>().add(1, 2), std::logic_error);
+	TS_ASSERT_EQUALS(stub.add(1, 2), 3);
+}
+
+
+void ProxyTestSuite::testSeveralInterfaces()
+{
+	Class test = Class::lookup("ProxyTest::Test");
+	Class calculator = Class::lookup("ProxyTest::Calculator");
+	Class client = Class::lookup("ProxyTest::Client");
+
+	Method method1 = test.methodsNamed("method1").front();
+	Method add = calculator.methodsNamed("add").front();
+	Method sub = calculator.methodsNamed("sub").front();
+	Method doSomething = client.methodsNamed("doSomething").front();
+
+	Proxy proxy{test, calculator};
+
+	// asking doesn't reserve anything, methods of other classes are never implemented
+	TS_ASSERT(!proxy.hasImplementation(method1));
+	TS_ASSERT(!proxy.hasImplementation(doSomething));
+
+	proxy.addImplementation(method1, [](ArgumentView args) -> VariantValue {
+		return VariantValue(args[0].value<int>() * args[1].value<int>());
+	});
+	proxy.addImplementation(add, [](ArgumentView args) -> VariantValue {
+		return VariantValue(args[0].value<int>() + args[1].value<int>());
+	});
+	proxy.addImplementation(doSomething, [](ArgumentView) -> VariantValue {
+		return VariantValue(0);
+	});
+
+	TS_ASSERT(proxy.hasImplementation(method1));
+	TS_ASSERT(proxy.hasImplementation(add));
+	TS_ASSERT(!proxy.hasImplementation(sub));
+	TS_ASSERT(!proxy.hasImplementation(doSomething));
+
+	VariantValue testHandle = proxy.reference(test);
+	VariantValue calculatorHandle = proxy.reference(calculator);
+	auto& testStub = testHandle.convertTo<ProxyTest::Test&>();
+	auto& calculatorStub = calculatorHandle.convertTo<ProxyTest::Calculator&>();
+
+	TS_ASSERT_EQUALS(testStub.method1(3, 5), 15);
+	TS_ASSERT_EQUALS(calculatorStub.add(3, 5), 8);
+	TS_ASSERT_THROWS(calculatorStub.sub(3, 5), std::logic_error);
+
+	// a proxy of only one of the interfaces
+	Proxy single(calculator);
+	single.addImplementation(method1, [](ArgumentView) -> VariantValue {
+		return VariantValue(0);
+	});
+	TS_ASSERT(!single.hasImplementation(method1));
+	VariantValue singleHandle = single.reference(calculator);
+	TS_ASSERT_THROWS(singleHandle.convertTo<ProxyTest::Calculator&>().add(1, 2), std::logic_error);
+}
+
+
+void ProxyTestSuite::testSlotsPerInterface()
+{
+	// the methods of every interface are numbered from 0, whatever was registered before it
+	for (ClassImpl* iface: { ClassImpl::inst<ProxyTest::Test>(), ClassImpl::inst<ProxyTest::Calculator>() }) {
+		TS_ASSERT_EQUALS(iface->proxySlotCount(), iface->methods().size());
+		std::vector<bool> used(iface->proxySlotCount(), false);
+		for (const Method& m: iface->methods()) {
+			const std::size_t slot = iface->proxySlot(std::hash<Method>()(m));
+			TS_ASSERT(slot < used.size());
+			if (slot < used.size()) {
+				TS_ASSERT(!used[slot]);
+				used[slot] = true;
+			}
+		}
+	}
+}
+
 void ProxyTestSuite::testLuaAPI()
 {
 	LuaUtils::LuaStateHolder L;
@@ -15,6 +15,9 @@ public:
 
 	void testProxy();
 	void testClient();
+	void testPartialImplementation();
+	void testSeveralInterfaces();
+	void testSlotsPerInterface();
 	void testLuaAPI();
 };
 
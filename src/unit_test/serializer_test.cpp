@@ -0,0 +1,279 @@
+/*
+** SelfPortrait API
+** See Copyright Notice in reflection.h
+*/
+#include "serializer_test.h"
+#include "serializer.h"
+#include "reflection.h"
+#include "reflection_impl.h"
+
+#include "test_utils.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace SerializerTest {
+
+	struct Point {
+		double x;
+		double y;
+	};
+
+	enum class Color { RED, GREEN };
+
+	struct Shape {
+		std::string name;
+		Color color;
+		int id;
+		Point origin;
+		std::vector<Point> points;
+		std::vector<std::string> tags;
+		std::vector<Shape> children;
+	};
+
+	struct Base {
+		int a;
+	};
+
+	struct Other {
+		int b;
+	};
+
+	struct Derived: public Base, public Other {
+		short c;
+	};
+
+	struct Middle: public Base {
+		int m;
+	};
+
+	struct Leaf: public Middle {
+		int l;
+	};
+
+	struct WithPointer {
+		int* p;
+	};
+
+	struct WithConst {
+		WithConst() : a(1) {}
+		const int a;
+	};
+
+	struct Record {
+		std::string text;
+	};
+
+	struct Records {
+		std::vector<Record> records;
+	};
+
+	struct Empty {};
+
+	struct Empties {
+		std::vector<Empty> items;
+	};
+}
+
+REFL_BEGIN_CLASS(SerializerTest::Point)
+	REFL_DEFAULT_CONSTRUCTOR()
+	REFL_ATTRIBUTE(y, double)
+	REFL_ATTRIBUTE(x, double)
+REFL_END_CLASS
+
+REFL_BEGIN_CLASS(SerializerTest::Shape)
+	REFL_DEFAULT_CONSTRUCTOR()
+	REFL_ATTRIBUTE(name, std::string)
+	REFL_ATTRIBUTE(color, SerializerTest::Color)
+	REFL_ATTRIBUTE(id, int)
+	REFL_ATTRIBUTE(origin, SerializerTest::Point)
+	REFL_ATTRIBUTE(points, std::vector<SerializerTest::Point>)
+	REFL_ATTRIBUTE(tags, std::vector<std::string>)
+	REFL_ATTRIBUTE(children, std::vector<SerializerTest::Shape>)
+REFL_END_CLASS
+
+REFL_BEGIN_CLASS(SerializerTest::Base)
+	REFL_ATTRIBUTE(a, int)
+REFL_END_CLASS
+
+REFL_BEGIN_CLASS(SerializerTest::Other)
+	REFL_ATTRIBUTE(b, int)
+REFL_END_CLASS
+
+REFL_BEGIN_CLASS(SerializerTest::Derived)
+	REFL_SUPER_CLASS(SerializerTest::Base)
+	REFL_SUPER_CLASS(SerializerTest::Other)
+	REFL_ATTRIBUTE(c, short)
+REFL_END_CLASS
+
+REFL_BEGIN_CLASS(SerializerTest::Middle)
+	REFL_SUPER_CLASS(SerializerTest::Base)
+	REFL_ATTRIBUTE(m, int)
+REFL_END_CLASS
+
+REFL_BEGIN_CLASS(SerializerTest::Leaf)
+	REFL_SUPER_CLASS(SerializerTest::Middle)
+	REFL_ATTRIBUTE(l, int)
+REFL_END_CLASS
+
+REFL_BEGIN_CLASS(SerializerTest::WithPointer)
+	REFL_ATTRIBUTE(p, int*)
+REFL_END_CLASS
+
+REFL_BEGIN_CLASS(SerializerTest::WithConst)
+	REFL_ATTRIBUTE(a, const int)
+REFL_END_CLASS
+
+REFL_BEGIN_CLASS(SerializerTest::Record)
+	REFL_DEFAULT_CONSTRUCTOR()
+	REFL_ATTRIBUTE(text, std::string)
+REFL_END_CLASS
+
+REFL_BEGIN_CLASS(SerializerTest::Records)
+	REFL_ATTRIBUTE(records, std::vector<SerializerTest::Record>)
+REFL_END_CLASS
+
+REFL_BEGIN_CLASS(SerializerTest::Empty)
+	REFL_DEFAULT_CONSTRUCTOR()
+REFL_END_CLASS
+
+REFL_BEGIN_CLASS(SerializerTest::Empties)
+	REFL_ATTRIBUTE(items, std::vector<SerializerTest::Empty>)
+REFL_END_CLASS
+
+using namespace SerializerTest;
+
+void SerializerTestSuite::testFlat()
+{
+	BinarySerializer s(Class::lookup("SerializerTest::Point"));
+	TS_ASSERT_EQUALS(s.getClass(), Class::lookup("SerializerTest::Point"));
+
+	// both attributes are copied at once, whatever the registration order
+	Point points[3] = { { 1, 2 }, { 3, 4 }, { 5, 6 } };
+	std::string data;
+	s.writeArray(points, 3, data);
+	TS_ASSERT_EQUALS(data.size(), sizeof(points));
+
+	Point read[3] = {};
+	TS_ASSERT_EQUALS(s.readArray(read, 3, data.data(), data.size()), data.size());
+	TS_ASSERT_EQUALS(read[2].x, 5);
+	TS_ASSERT_EQUALS(read[2].y, 6);
+}
+
+void SerializerTestSuite::testNested()
+{
+	Shape shape;
+	shape.name = "polygon";
+	shape.color = Color::GREEN;
+	shape.id = 7;
+	shape.origin = { 0.5, 1.5 };
+	shape.points = { { 1, 2 }, { 3, 4 } };
+	shape.tags = { "closed", "", "convex" };
+	shape.children.resize(2);
+	shape.children[1].name = "child";
+	shape.children[1].points = { { 9, 10 } };
+
+	BinarySerializer s(Class::lookup("SerializerTest::Shape"));
+	std::string data;
+	s.write(&shape, data);
+	s.write(&shape.children[1], data);
+
+	Shape read;
+	read.tags = { "overwritten" };
+	Shape child;
+	const std::size_t size = s.read(&read, data.data(), data.size());
+	TS_ASSERT_EQUALS(s.read(&child, data.data() + size, data.size() - size), data.size() - size);
+
+	TS_ASSERT_EQUALS(read.name, "polygon");
+	TS_ASSERT(read.color == Color::GREEN);
+	TS_ASSERT_EQUALS(read.id, 7);
+	TS_ASSERT_EQUALS(read.origin.y, 1.5);
+	TS_ASSERT_EQUALS(read.points.size(), 2);
+	TS_ASSERT_EQUALS(read.points[1].x, 3);
+	TS_ASSERT_EQUALS(read.tags.size(), 3);
+	TS_ASSERT_EQUALS(read.tags[2], "convex");
+	TS_ASSERT_EQUALS(read.children.size(), 2);
+	TS_ASSERT_EQUALS(read.children[1].name, "child");
+	TS_ASSERT_EQUALS(read.children[1].points[0].y, 10);
+	TS_ASSERT_EQUALS(child.name, "child");
+}
+
+void SerializerTestSuite::testInherited()
+{
+	Derived d;
+	d.a = 1;
+	d.b = 2;
+	d.c = 3;
+
+	BinarySerializer s(Class::lookup("SerializerTest::Derived"));
+	std::string data;
+	s.write(&d, data);
+	TS_ASSERT_EQUALS(data.size(), 2 * sizeof(int) + sizeof(short));
+
+	Derived read;
+	s.read(&read, data.data(), data.size());
+	TS_ASSERT_EQUALS(read.a, 1);
+	TS_ASSERT_EQUALS(read.b, 2);
+	TS_ASSERT_EQUALS(read.c, 3);
+}
+
+void SerializerTestSuite::testInheritedTwice()
+{
+	// the attributes of the grandparent are listed once
+	Class leafClass = Class::lookup("SerializerTest::Leaf");
+	TS_ASSERT_EQUALS(leafClass.attributes().size(), 3);
+	TS_ASSERT_EQUALS(leafClass.superclasses().size(), 2);
+
+	Leaf leaf;
+	leaf.a = 1;
+	leaf.m = 2;
+	leaf.l = 3;
+
+	BinarySerializer s(leafClass);
+	std::string data;
+	s.write(&leaf, data);
+	TS_ASSERT_EQUALS(data.size(), 3 * sizeof(int));
+
+	Leaf read;
+	TS_ASSERT_EQUALS(s.read(&read, data.data(), data.size()), data.size());
+	TS_ASSERT_EQUALS(read.a, 1);
+	TS_ASSERT_EQUALS(read.m, 2);
+	TS_ASSERT_EQUALS(read.l, 3);
+}
+
+void SerializerTestSuite::testErrors()
+{
+	TS_ASSERT_THROWS(BinarySerializer(Class::lookup("SerializerTest::WithPointer")), std::runtime_error);
+
+	Shape shape;
+	shape.tags = { "tag" };
+	BinarySerializer s(Class::lookup("SerializerTest::Shape"));
+	std::string data;
+	s.write(&shape, data);
+	Shape read;
+	TS_ASSERT_THROWS(s.read(&read, data.data(), data.size() - 1), std::runtime_error);
+
+	// a corrupt length doesn't allocate
+	std::string corrupt(data.size() + 64, '\xff');
+	TS_ASSERT_THROWS(s.read(&read, corrupt.data(), corrupt.size()), std::runtime_error);
+
+	// nor does one of elements that aren't copied whole
+	const std::uint32_t count = 200000000;
+	std::string length(reinterpret_cast<const char*>(&count), sizeof(count));
+	Records records;
+	BinarySerializer rs(Class::lookup("SerializerTest::Records"));
+	TS_ASSERT_THROWS(rs.read(&records, length.data(), length.size()), std::runtime_error);
+	TS_ASSERT(records.records.empty());
+
+	// elements written to no bytes can't bound the length
+	Empties empties;
+	BinarySerializer es(Class::lookup("SerializerTest::Empties"));
+	TS_ASSERT_THROWS(es.read(&empties, length.data(), length.size()), std::runtime_error);
+	TS_ASSERT(empties.items.empty());
+
+	WithConst c;
+	BinarySerializer cs(Class::lookup("SerializerTest::WithConst"));
+	cs.write(&c, data);
+	TS_ASSERT_THROWS(cs.read(&c, data.data(), data.size()), std::runtime_error);
+}
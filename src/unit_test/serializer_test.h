@@ -0,0 +1,24 @@
+/*
+** SelfPortrait API
+** See Copyright Notice in reflection.h
+*/
+#ifndef SERIALIZER_TEST_H
+#define SERIALIZER_TEST_H
+
+#include <cxxtest/TestSuite.h>
+
+class SerializerTestSuite : public CxxTest::TestSuite
+{
+public:
+	
+	// test methods must begin with "test", otherwise cxxtestgen ignores them
+
+	void testFlat();
+	void testNested();
+	void testInherited();
+	void testInheritedTwice();
+	void testErrors();
+};
+
+
+#endif /* SERIALIZER_TEST_H */
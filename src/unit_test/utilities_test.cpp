@@ -8,6 +8,8 @@
 #include "reflection.h"
 
 
+#include <clocale>
+#include <limits>
 #include <type_traits>
 #include <iostream>
 #include <string>
@@ -163,3 +165,53 @@ void UtilitiesTestSuite::testConversionsFromStr()
     NoConversions t3 = strconv::fromString<NoConversions>("whatever", &success);
 	TS_ASSERT(!success);
 }
+
+void UtilitiesTestSuite::testNumberConversions()
+{
+	TS_ASSERT_EQUALS(strconv::toString(-42), "-42");
+	TS_ASSERT_EQUALS(strconv::toString(std::numeric_limits<long long>::min()), "-9223372036854775808");
+	TS_ASSERT_EQUALS(strconv::toString(std::numeric_limits<unsigned long long>::max()), "18446744073709551615");
+	TS_ASSERT_EQUALS(strconv::toString('a'), "a"); // characters are still printed as such
+
+	TS_ASSERT_EQUALS(strconv::toString(2.75), "2.75");
+	TS_ASSERT_EQUALS(strconv::toString(0.1), "0.1");
+	TS_ASSERT_EQUALS(strconv::toString(0.1f), "0.1");
+	TS_ASSERT_EQUALS(strconv::toString(0.1 + 0.2), "0.30000000000000004");
+	TS_ASSERT_EQUALS(strconv::toString(1e300), "1e+300");
+
+	const double doubles[] = { 1.0 / 3, -2.0 / 3, 1e-310, 6.02214076e23, std::numeric_limits<double>::max(), std::numeric_limits<double>::min() };
+	for (double d: doubles) {
+		TS_ASSERT_EQUALS(strconv::fromString<double>(strconv::toString(d)), d);
+	}
+	const float floats[] = { 1.0f / 3, 16777217.0f, std::numeric_limits<float>::max() };
+	for (float f: floats) {
+		TS_ASSERT_EQUALS(strconv::fromString<float>(strconv::toString(f)), f);
+	}
+
+	bool success = false;
+	TS_ASSERT_EQUALS(strconv::fromString<int>(" 12abc", &success), 12);
+	TS_ASSERT(success);
+	TS_ASSERT_EQUALS(strconv::fromString<int>("1.23", &success), 1);
+	TS_ASSERT(success);
+	TS_ASSERT_EQUALS(strconv::fromString<int>("-2147483648", &success), std::numeric_limits<int>::min());
+	TS_ASSERT(success);
+	strconv::fromString<int>("abc", &success);
+	TS_ASSERT(!success);
+	TS_ASSERT_EQUALS(strconv::fromString<short>("40000", &success), std::numeric_limits<short>::max());
+	TS_ASSERT(!success);
+	TS_ASSERT_EQUALS(strconv::fromString<double>(std::string("1.5e3"), &success), 1500.0);
+	TS_ASSERT(success);
+	strconv::fromString<double>("1e999", &success);
+	TS_ASSERT(!success);
+
+	char buf[strconv::max_number_chars];
+	TS_ASSERT_EQUALS(std::string(buf, strconv::toChars(buf, 123u)), "123");
+	TS_ASSERT_EQUALS(std::string(buf, strconv::toChars(buf, -0.5)), "-0.5");
+
+	// a locale with a decimal comma changes nothing
+	if (std::setlocale(LC_NUMERIC, "de_DE.UTF-8") != nullptr) {
+		TS_ASSERT_EQUALS(strconv::toString(2.5), "2.5");
+		TS_ASSERT_EQUALS(strconv::fromString<double>("2.5"), 2.5);
+		std::setlocale(LC_NUMERIC, "C");
+	}
+}
@@ -16,6 +16,7 @@ public:
 	void testTypelist();
 	void testConversionsToStr();
 	void testConversionsFromStr();
+	void testNumberConversions();
 };
 
 
@@ -4,8 +4,11 @@
 */
 #include "variant_test.h"
 
+#include <atomic>
 #include <iostream>
 #include <string>
+#include <thread>
+#include <vector>
 #include <boost/date_time/gregorian/gregorian.hpp>
 #include "lua_utils.h"
 #include "test_utils.h"
@@ -178,6 +181,211 @@ void VariantTestSuite::testBaseConversion()
 	TS_ASSERT_EQUALS(bref.method1(), 5.3);
 }
 
+namespace {
+	struct Small {
+		int a;
+		double b;
+	};
+
+	struct Large {
+		char data[256];
+	};
+}
+
+void VariantTestSuite::testInplace()
+{
+	Small small = { 1, 2.5 };
+	VariantValue v1(small);
+	TS_ASSERT(v1.isEmbedded());
+	TS_ASSERT(v1.isA<Small>());
+	TS_ASSERT_EQUALS(v1.value<Small&>().a, 1);
+
+	VariantValue v2 = v1;
+	TS_ASSERT(v2.isEmbedded());
+	v2.value<Small&>().a = 2;
+	TS_ASSERT_EQUALS(v1.value<Small&>().a, 1);
+	TS_ASSERT_EQUALS(v2.value<Small&>().a, 2);
+
+	// a reference to an inplace value must see modifications of the original
+	VariantValue ref = v1.createReference();
+	ref.value<Small&>().a = 3;
+	TS_ASSERT_EQUALS(v1.value<Small&>().a, 3);
+	TS_ASSERT_EQUALS(&ref.value<Small&>(), &v1.value<Small&>());
+
+	// the reference keeps the value alive, like the references to values on the heap
+	VariantValue kept;
+	{
+		VariantValue v4(small);
+		kept = v4.createReference();
+		kept.value<Small&>().a = 4;
+		TS_ASSERT_EQUALS(v4.value<Small&>().a, 4);
+	}
+	TS_ASSERT_EQUALS(kept.value<Small&>().a, 4);
+
+	// a const variant keeps its value inplace, the reference is only valid as long as the variant
+	const VariantValue v5(small);
+	VariantValue cref = v5.createReference();
+	TS_ASSERT(v5.isEmbedded());
+	TS_ASSERT_EQUALS(&cref.value<const Small&>(), &v5.value<const Small&>());
+
+	VariantValue moved = ::std::move(v2);
+	TS_ASSERT_EQUALS(moved.value<const Small&>().b, 2.5);
+
+	int i = 5;
+	VariantValue ptr(&i);
+	TS_ASSERT(ptr.isEmbedded());
+	TS_ASSERT_EQUALS(*ptr.value<int*>(), 5);
+
+	Large large;
+	VariantValue v3(large);
+	TS_ASSERT(!v3.isEmbedded());
+	TS_ASSERT(v3.isA<Large>());
+}
+
+void VariantTestSuite::testArena()
+{
+	TS_ASSERT(VariantArena::current() == nullptr);
+
+	VariantValue escaped;
+	VariantValue copy;
+	{
+		VariantArena arena;
+		TS_ASSERT_EQUALS(VariantArena::current(), &arena);
+		TS_ASSERT_EQUALS(arena.bytesReserved(), 0);
+
+		// embedded values don't need the arena
+		VariantValue i(3);
+		TS_ASSERT_EQUALS(arena.bytesReserved(), 0);
+
+		VariantValue v1(::std::vector<int>{ 1, 2, 3 });
+		TS_ASSERT(!v1.isEmbedded());
+		TS_ASSERT(arena.bytesReserved() > 0);
+		TS_ASSERT_EQUALS(v1.value<const ::std::vector<int>&>()[2], 3);
+
+		{
+			VariantArena inner;
+			TS_ASSERT_EQUALS(VariantArena::current(), &inner);
+			VariantValue v2(::std::vector<int>{ 4 });
+			TS_ASSERT(inner.bytesReserved() > 0);
+		}
+		TS_ASSERT_EQUALS(VariantArena::current(), &arena);
+
+		copy = v1;
+		escaped = ::std::move(v1);
+	}
+	TS_ASSERT(VariantArena::current() == nullptr);
+
+	// values that outlive the scope keep the memory alive
+	TS_ASSERT_EQUALS(escaped.value<const ::std::vector<int>&>().size(), 3);
+	TS_ASSERT_EQUALS(copy.value<const ::std::vector<int>&>()[0], 1);
+	escaped = VariantValue();
+	TS_ASSERT_EQUALS(copy.value<const ::std::vector<int>&>()[1], 2);
+
+	// released by another thread
+	{
+		VariantArena arena;
+		escaped = VariantValue(::std::vector<int>{ 5, 6 });
+	}
+	::std::thread t([&] { escaped = VariantValue(); });
+	t.join();
+	TS_ASSERT(!escaped.isValid());
+}
+
+namespace {
+	struct DerivedString : public std::string {
+		DerivedString() : std::string("derived") {}
+	};
+}
+
+void VariantTestSuite::testTaggedConversion()
+{
+	VariantValue d(2.75);
+	TS_ASSERT(d.isA<double>());
+	TS_ASSERT(d.isA<const double&>());
+	TS_ASSERT(!d.isA<float>());
+	TS_ASSERT(!d.isA<int>());
+	TS_ASSERT_EQUALS(d.convertTo<int>(), 2);
+	TS_ASSERT_EQUALS(d.convertTo<float>(), 2.75f);
+	TS_ASSERT_EQUALS(d.convertTo<std::string>(), "2.75");
+
+	long l = 7;
+	VariantValue lv(l);
+	TS_ASSERT(lv.isA<long>());
+	TS_ASSERT(!lv.isA<long long>()); // distinct types even if they have the same size
+	TS_ASSERT_EQUALS(lv.convertTo<unsigned char>(), 7);
+	TS_ASSERT_EQUALS(lv.convertTo<double>(), 7.0);
+
+	const int ci = 3;
+	VariantValue cref;
+	cref.construct<const int&>(ci);
+	TS_ASSERT(cref.isA<const int&>());
+	TS_ASSERT(!cref.isA<int&>());
+	TS_ASSERT_EQUALS(&cref.value<const int&>(), &ci);
+	bool ok = false;
+	cref.convertTo<int&>(&ok);
+	TS_ASSERT(!ok);
+	TS_ASSERT_EQUALS(cref.convertTo<long>(), 3);
+
+	VariantValue s(std::string("12"));
+	TS_ASSERT(s.isA<std::string>());
+	TS_ASSERT(!s.isA<int>());
+	TS_ASSERT_EQUALS(s.convertTo<int>(), 12);
+
+	// not tagged as a string, but convertible to one
+	VariantValue ds;
+	ds.construct<DerivedString>();
+	TS_ASSERT(ds.isA<std::string>());
+	TS_ASSERT_EQUALS(ds.value<const std::string&>(), "derived");
+}
+
+namespace {
+	template<int N>
+	struct Tag {};
+
+	template<int N>
+	struct fill_tags {
+		static void fill(std::vector<VariantValue>& values) {
+			values.emplace_back();
+			values.back().construct<Tag<N>>();
+			fill_tags<N-1>::fill(values);
+		}
+	};
+
+	template<>
+	struct fill_tags<0> {
+		static void fill(std::vector<VariantValue>&) {}
+	};
+}
+
+void VariantTestSuite::testConcurrentConversion()
+{
+	// more types than fit into the initial conversion cache
+	std::vector<VariantValue> values;
+	fill_tags<40>::fill(values);
+
+	std::atomic<int> failures(0);
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 8; ++t) {
+		threads.emplace_back([&values, &failures]() {
+			VariantValue derived;
+			derived.construct<Derived>();
+			for (int i = 0; i < 100; ++i) {
+				for (const VariantValue& v: values) {
+					if (v.isA<Base>()) ++failures;
+				}
+				if (!derived.isA<Base>()) ++failures;
+				if (&derived.convertTo<Base&>() != &derived.convertTo<Derived&>()) ++failures;
+			}
+		});
+	}
+	for (std::thread& t: threads) {
+		t.join();
+	}
+
+	TS_ASSERT_EQUALS(failures.load(), 0);
+}
+
 namespace {
 enum class Units {
     INV_VOLUME = 1,
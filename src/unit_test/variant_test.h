@@ -20,6 +20,10 @@ public:
 	void testConversions();
 	void testNonCopyable();
 	void testBaseConversion();
+	void testConcurrentConversion();
+	void testInplace();
+	void testArena();
+	void testTaggedConversion();
     void testEnum();
     void testPrintable();
 };
@@ -107,16 +107,23 @@ namespace LuaUtils {
 	};
 
 	template<> struct LuaValue<std::string> {
+		// Lua strings may contain zeros
 		static std::string getStackValue(lua_State* L, int pos) {
-			return luaL_checkstring(L, pos);
+			size_t len = 0;
+			const char* str = luaL_checklstring(L, pos, &len);
+			return std::string(str, len);
 		}
 		static void pushValue(lua_State* L, const std::string& value) {
-			lua_pushstring(L, value.c_str());
+			lua_pushlstring(L, value.data(), value.size());
 		}
 		static int size() { return 1; }
 	};
 
 	template<> struct LuaValue<const char*> {
+		// points into the Lua string, only valid while it is on the stack
+		static const char* getStackValue(lua_State* L, int pos) {
+			return luaL_checkstring(L, pos);
+		}
 		static void pushValue(lua_State* L, const char* value) {
 			lua_pushstring(L, value);
 		}
@@ -173,19 +180,24 @@ namespace LuaUtils {
 		static int size() { return std::tuple_size<TType>::value; }
 	};
 
+	template<class C> void reserve(C&, std::size_t) {}
+	template<class T> void reserve(std::vector<T>& c, std::size_t size) { c.reserve(size); }
+
 	template<class C> struct LuaCollection {
 		typedef typename C::value_type value_type;
 		static C getStackValue(lua_State* L, int pos) {
 			C ret;
-			luaL_checktype(L, pos, LUA_TTABLE);
+			const int ppos = (pos < 0) ? lua_gettop(L) + pos + 1 : pos;
+			luaL_checktype(L, ppos, LUA_TTABLE);
 #ifdef LUA52
-            const int size = lua_rawlen(L, pos);
+            const int size = lua_rawlen(L, ppos);
 #else
-            const int size = lua_objlen(L, pos);
+            const int size = lua_objlen(L, ppos);
 #endif
+			reserve(ret, size);
 
 			for (int i = 1; i <= size; ++i) {
-				lua_rawgeti(L, pos, i);
+				lua_rawgeti(L, ppos, i);
 				ret.emplace_back(LuaValue<value_type>::getStackValue(L, -1));
 				lua_pop(L, 1);
 			}
@@ -227,10 +239,10 @@ namespace LuaUtils {
 		static void pushValue(lua_State* L, const M& map) {
 			lua_createtable(L, 0, map.size());
 
-			for (auto el: map) {
+			for (const auto& el: map) {
 				LuaValue<key_type>::pushValue(L, el.first);
 				LuaValue<mapped_type>::pushValue(L, el.second);
-				lua_settable(L, -3);
+				lua_rawset(L, -3);
 			}
 		}
 		static int size() { return 1; }